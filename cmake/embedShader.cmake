@@ -0,0 +1,11 @@
+# Turns a SPIR-V binary into a C header, in the same format as `xxd -i`.
+# Usage: cmake -DINPUT=<file.spv> -DOUTPUT=<header.h> -DVARIABLE=<name> -P embedShader.cmake
+
+file(READ ${INPUT} contents HEX)
+string(LENGTH "${contents}" hexLength)
+math(EXPR byteCount "${hexLength} / 2")
+
+string(REGEX REPLACE "([0-9a-f][0-9a-f])" "0x\\1, " bytes "${contents}")
+string(REGEX REPLACE "((0x[0-9a-f][0-9a-f], ){12})" "\\1\n  " bytes "${bytes}")
+
+file(WRITE ${OUTPUT} "unsigned char ${VARIABLE}[] = {\n  ${bytes}\n};\nunsigned int ${VARIABLE}_len = ${byteCount};\n")
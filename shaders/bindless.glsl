@@ -0,0 +1,20 @@
+// Global bindless resource set, mirrors the bindings in src/bindless.hpp.
+// Resources are addressed by the stable index they got when registered on the host.
+
+#extension GL_EXT_nonuniform_qualifier : require
+
+layout(set = 0, binding = 0) uniform texture2D bindlessTextures[];
+layout(set = 0, binding = 1) uniform sampler bindlessSamplers[];
+
+// Storage buffers alias the same binding with whatever block layout the shader needs, e.g.
+// BINDLESS_STORAGE_BUFFER(Vertices, { Vertex vertices[]; }) gives bindlessVertices[index].vertices[i]
+#define BINDLESS_STORAGE_BUFFER(Name, Contents) \
+    layout(set = 0, binding = 2) readonly buffer Bindless##Name Contents bindless##Name[]
+
+// same for buffers the shader writes to
+#define BINDLESS_RW_STORAGE_BUFFER(Name, Contents) \
+    layout(set = 0, binding = 2) buffer Bindless##Name Contents bindless##Name[]
+
+vec4 sampleBindless(uint textureIndex, uint samplerIndex, vec2 uv) {
+    return texture(sampler2D(bindlessTextures[nonuniformEXT(textureIndex)], bindlessSamplers[nonuniformEXT(samplerIndex)]), uv);
+}
@@ -1,5 +1,33 @@
 @echo off
-glslc shader.vert -o vert.spv
-glslc shader.frag -o frag.spv
+glslc --target-env=vulkan1.3 shader.vert -o vert.spv
+glslc --target-env=vulkan1.3 shader.frag -o frag.spv
+glslc --target-env=vulkan1.3 downsample.comp -o downsample.spv
+glslc --target-env=vulkan1.3 meshlet.vert -o meshlet_vert.spv
+glslc --target-env=vulkan1.3 meshlet.task -o task.spv
+glslc --target-env=vulkan1.3 meshlet.mesh -o mesh.spv
+glslc --target-env=vulkan1.3 meshletCull.comp -o meshlet_cull.spv
+glslc --target-env=vulkan1.3 occlusionCull.comp -o occlusion_cull.spv
+glslc --target-env=vulkan1.3 lightCull.comp -o light_cull.spv
+glslc --target-env=vulkan1.3 gbuffer.frag -o gbuffer_frag.spv
+glslc --target-env=vulkan1.3 fullscreen.vert -o fullscreen_vert.spv
+glslc --target-env=vulkan1.3 deferredLighting.frag -o deferred_lighting.spv
+glslc --target-env=vulkan1.3 deferredLightingLocalRead.frag -o deferred_lighting_local_read.spv
+glslc --target-env=vulkan1.3 upscale.frag -o upscale.spv
+glslc --target-env=vulkan1.3 overlay.vert -o overlay_vert.spv
+glslc --target-env=vulkan1.3 overlay.frag -o overlay_frag.spv
 xxd -i vert.spv include/vertexShader.h
 xxd -i frag.spv include/fragmentShader.h
+xxd -i downsample.spv include/downsampleShader.h
+xxd -i meshlet_vert.spv include/meshletVertexShader.h
+xxd -i task.spv include/taskShader.h
+xxd -i mesh.spv include/meshShader.h
+xxd -i meshlet_cull.spv include/meshletCullShader.h
+xxd -i occlusion_cull.spv include/occlusionCullShader.h
+xxd -i light_cull.spv include/lightCullShader.h
+xxd -i gbuffer_frag.spv include/gbufferFragmentShader.h
+xxd -i fullscreen_vert.spv include/fullscreenVertexShader.h
+xxd -i deferred_lighting.spv include/deferredLightingShader.h
+xxd -i deferred_lighting_local_read.spv include/deferredLightingLocalReadShader.h
+xxd -i upscale.spv include/upscaleShader.h
+xxd -i overlay_vert.spv include/overlayVertexShader.h
+xxd -i overlay_frag.spv include/overlayFragmentShader.h
@@ -0,0 +1,33 @@
+// Push constants and G-buffer decoding of the deferred lighting pass, mirrors src/deferredLighting.hpp.
+
+#include "bindless.glsl"
+#include "octahedral.glsl"
+#include "sceneTypes.glsl"
+#include "shading.glsl"
+
+layout(push_constant) uniform LightingConstants {
+    uint frameDataIndex;
+    uint lightBufferIndex;
+    uint clusterBufferIndex;
+    // sampled fallback only, bindless indices of the G-buffer and depth textures
+    uint albedoTextureIndex;
+    uint normalTextureIndex;
+    uint depthTextureIndex;
+    uint samplerIndex;
+} lighting;
+
+BINDLESS_STORAGE_BUFFER(Frames, { FrameData frame; });
+
+// Shades the G-buffer texel at fragCoord, pixels nothing was drawn to stay black.
+vec3 shadeGBuffer(vec2 fragCoord, vec3 albedo, vec2 encodedNormal, float depth) {
+    if (depth >= 1.0) {
+        return vec3(0);
+    }
+
+    FrameData frame = bindlessFrames[lighting.frameDataIndex].frame;
+    vec2 ndc = fragCoord / frame.viewport.xy * 2.0 - 1.0;
+    vec4 position = frame.inverseViewProj * vec4(ndc, depth, 1);
+
+    return shadeSurface(frame, lighting.lightBufferIndex, lighting.clusterBufferIndex, fragCoord,
+                        position.xyz / position.w, octahedralDecode(encodedNormal), albedo);
+}
@@ -0,0 +1,19 @@
+#version 450
+
+// Lighting pass of the deferred path on devices without VK_KHR_dynamic_rendering_local_read. Runs as a render pass of
+// its own and reads the G-buffer and depth through the bindless set.
+
+#include "deferred.glsl"
+
+layout(location = 0) out vec4 outColor;
+
+vec4 fetch(uint textureIndex) {
+    return texelFetch(sampler2D(bindlessTextures[textureIndex], bindlessSamplers[lighting.samplerIndex]),
+                      ivec2(gl_FragCoord.xy), 0);
+}
+
+void main() {
+    vec3 color = shadeGBuffer(gl_FragCoord.xy, fetch(lighting.albedoTextureIndex).rgb,
+                              fetch(lighting.normalTextureIndex).xy, fetch(lighting.depthTextureIndex).r);
+    outColor = vec4(color, 1);
+}
@@ -0,0 +1,19 @@
+#version 450
+
+// Lighting pass of the deferred path with VK_KHR_dynamic_rendering_local_read. It is drawn in the same rendering as
+// the geometry pass and reads the G-buffer and depth as input attachments at the fragment's own position, so tile
+// based GPUs never have to write the G-buffer out to memory.
+
+#include "deferred.glsl"
+
+layout(input_attachment_index = 0, set = 1, binding = 0) uniform subpassInput gbufferAlbedo;
+layout(input_attachment_index = 1, set = 1, binding = 1) uniform subpassInput gbufferNormal;
+layout(input_attachment_index = 2, set = 1, binding = 2) uniform subpassInput gbufferDepth;
+
+layout(location = 0) out vec4 outColor;
+
+void main() {
+    vec3 color = shadeGBuffer(gl_FragCoord.xy, subpassLoad(gbufferAlbedo).rgb, subpassLoad(gbufferNormal).xy,
+                              subpassLoad(gbufferDepth).r);
+    outColor = vec4(color, 1);
+}
@@ -0,0 +1,20 @@
+#version 450
+
+// Geometry pass of the deferred path, see src/deferredLighting.hpp. Attachment 0 is the lit output written later by
+// the lighting pass, the surface goes into the packed G-buffer: albedo as RGBA8 and the normal octahedral encoded
+// into two snorm16 channels. The position is reconstructed from the depth buffer.
+
+#include "scene.glsl"
+#include "shading.glsl"
+
+layout(location = 0) in vec3 worldPosition;
+layout(location = 1) in vec3 worldNormal;
+
+layout(location = 1) out vec4 outAlbedo;
+layout(location = 2) out vec2 outNormal;
+
+void main() {
+    vec3 normal = normalize(worldNormal);
+    outAlbedo = vec4(surfaceAlbedo(normal), 1);
+    outNormal = octahedralEncode(normal);
+}
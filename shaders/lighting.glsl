@@ -0,0 +1,49 @@
+// Clustered light lists and light evaluation, mirrors src/lightClustering.hpp. Needs sceneTypes.glsl.
+// The view frustum is split into ClusterGridX * ClusterGridY screen tiles and ClusterGridZ depth slices spaced
+// logarithmically between the near and far plane. Each froxel owns ClusterStride uints of the cluster buffer: the
+// light count followed by the indices of up to MaxLightsPerCluster lights touching it.
+
+const uint ClusterGridX = 16;
+const uint ClusterGridY = 9;
+const uint ClusterGridZ = 24;
+const uint ClusterCount = ClusterGridX * ClusterGridY * ClusterGridZ;
+const uint MaxLightsPerCluster = 255;
+const uint ClusterStride = MaxLightsPerCluster + 1;
+
+uint clusterSlice(FrameData frame, float viewDepth) {
+    float slice = log(max(viewDepth, 1e-6)) * frame.clusterGrid.z + frame.clusterGrid.w;
+    return uint(clamp(slice, 0.0, float(ClusterGridZ - 1)));
+}
+
+uint clusterIndex(uvec3 cluster) {
+    return (cluster.z * ClusterGridY + cluster.y) * ClusterGridX + cluster.x;
+}
+
+// froxel of a fragment, viewDepth is the distance along the view direction
+uint clusterIndexAt(FrameData frame, vec2 fragCoord, float viewDepth) {
+    uvec2 tile = min(uvec2(fragCoord / frame.clusterGrid.xy), uvec2(ClusterGridX - 1, ClusterGridY - 1));
+    return clusterIndex(uvec3(tile, clusterSlice(frame, viewDepth)));
+}
+
+// Radiance reflected towards the camera by a surface lit by one light. The falloff only depends on the distance
+// relative to the range, so the lights look the same at any scene scale.
+vec3 shadeLight(Light light, vec3 position, vec3 normal, vec3 toCamera, vec3 albedo) {
+    vec3 toLight = light.position - position;
+    float distance = length(toLight);
+    if (distance >= light.range) {
+        return vec3(0);
+    }
+    toLight /= max(distance, 1e-6);
+
+    float relative = distance / light.range;
+    float window = clamp(1.0 - relative * relative * relative * relative, 0.0, 1.0);
+    float attenuation = window * window / (1.0 + 25.0 * relative * relative);
+
+    if (light.type == LightTypeSpot) {
+        attenuation *= smoothstep(light.spotCosOuter, light.spotCosInner, dot(-toLight, light.direction));
+    }
+
+    float diffuse = max(dot(normal, toLight), 0.0);
+    float specular = pow(max(dot(normal, normalize(toLight + toCamera)), 0.0), 32.0) * 0.25;
+    return light.color * attenuation * (albedo * diffuse + specular * step(0.0, diffuse));
+}
@@ -0,0 +1,28 @@
+#version 450
+
+// Draws one meshlet of one instance per indirect draw for the compute culling path. firstInstance of every draw is
+// its slot in the draw buffer, which also names the meshlet and the instance, and the vertices are pulled from the
+// bindless buffers instead of vertex input.
+
+#include "scene.glsl"
+
+BINDLESS_STORAGE_BUFFER(Draws, {
+    uint drawCount;
+    uint padding[3];
+    MeshletDraw draws[];
+});
+
+layout(location = 0) out vec3 worldPosition;
+layout(location = 1) out vec3 worldNormal;
+
+void main() {
+    MeshletDraw meshletDraw = bindlessDraws[draw.drawBufferIndex].draws[uint(gl_InstanceIndex)];
+    Meshlet meshlet = loadMeshlet(meshletDraw.meshletIndex);
+    uint corner = meshletTriangleCorner(meshlet, uint(gl_VertexIndex) / 3, uint(gl_VertexIndex) % 3);
+    VertexAttributes vertex = loadVertex(meshletVertex(meshlet, corner));
+    vec3 position = vertex.position + loadInstance(meshletDraw.instanceIndex).offset.xyz;
+
+    gl_Position = frameData().viewProj * vec4(position, 1);
+    worldPosition = position;
+    worldNormal = vertex.normal;
+}
@@ -0,0 +1,19 @@
+// Octahedral unit vector encoding: the vector is projected onto the octahedron |x| + |y| + |z| = 1 whose lower half
+// is folded over the upper one, which maps it into the -1..1 square. Used by the quantized vertices and the G-buffer.
+
+vec3 octahedralDecode(vec2 encoded) {
+    vec3 normal = vec3(encoded, 1 - abs(encoded.x) - abs(encoded.y));
+    float fold = max(-normal.z, 0);
+    normal.x += normal.x >= 0 ? -fold : fold;
+    normal.y += normal.y >= 0 ? -fold : fold;
+    return normalize(normal);
+}
+
+vec2 octahedralEncode(vec3 normal) {
+    normal /= abs(normal.x) + abs(normal.y) + abs(normal.z);
+    if (normal.z < 0) {
+        vec2 signs = vec2(normal.x >= 0 ? 1.0 : -1.0, normal.y >= 0 ? 1.0 : -1.0);
+        return (1.0 - abs(normal.yx)) * signs;
+    }
+    return normal.xy;
+}
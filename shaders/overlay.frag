@@ -0,0 +1,21 @@
+#version 450
+
+// Dear ImGui's vertex color times its font atlas or another bindless texture, see src/overlay.hpp.
+
+#include "bindless.glsl"
+
+layout(push_constant) uniform OverlayConstants {
+    vec2 scale;
+    vec2 translate;
+    uint textureIndex;
+    uint samplerIndex;
+} overlay;
+
+layout(location = 0) in vec2 inUv;
+layout(location = 1) in vec4 inColor;
+
+layout(location = 0) out vec4 outColor;
+
+void main() {
+    outColor = inColor * sampleBindless(overlay.textureIndex, overlay.samplerIndex, inUv);
+}
@@ -0,0 +1,23 @@
+#version 450
+
+// Dear ImGui vertices in pixels, mapped to clip space, see src/overlay.hpp.
+
+layout(push_constant) uniform OverlayConstants {
+    vec2 scale;
+    vec2 translate;
+    uint textureIndex;
+    uint samplerIndex;
+} overlay;
+
+layout(location = 0) in vec2 inPosition;
+layout(location = 1) in vec2 inUv;
+layout(location = 2) in vec4 inColor;
+
+layout(location = 0) out vec2 outUv;
+layout(location = 1) out vec4 outColor;
+
+void main() {
+    outUv = inUv;
+    outColor = inColor;
+    gl_Position = vec4(inPosition * overlay.scale + overlay.translate, 0, 1);
+}
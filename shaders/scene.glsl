@@ -0,0 +1,126 @@
+// Push constants, buffers and helpers shared by the mesh pipelines, mirrors src/sceneData.hpp.
+// Every buffer is reached through the bindless set, the indices come in the DrawConstants push constants.
+
+#include "bindless.glsl"
+#include "octahedral.glsl"
+#include "sceneTypes.glsl"
+
+// MeshVertexFormat of the drawn mesh, decoding the other format is compiled out of the pipeline
+layout(constant_id = 0) const uint vertexFormat = 0;
+
+const uint VertexFormatFloat = 0;
+const uint VertexFormatQuantized = 1;
+
+layout(push_constant) uniform DrawConstants {
+    uint frameDataIndex;
+    uint vertexBufferIndex;
+    uint meshletBufferIndex;
+    uint meshletVertexBufferIndex;
+    uint meshletTriangleBufferIndex;
+    uint meshletCount;
+    uint drawBufferIndex;
+    uint instanceBufferIndex;
+    uint instanceCount;
+    uint instanceListIndex; // NoInstanceList or an instance list of the occlusion culling pass
+    uint lightBufferIndex;
+    uint clusterBufferIndex;
+    // maps quantized positions from 0..1 to the mesh bounds
+    vec4 positionOffset;
+    vec4 positionScale;
+} draw;
+
+BINDLESS_STORAGE_BUFFER(Frames, { FrameData frame; });
+BINDLESS_STORAGE_BUFFER(Instances, { Instance instances[]; });
+BINDLESS_STORAGE_BUFFER(InstanceLists, {
+    uint drawCount;
+    uint groupCountX;
+    uint groupCountY;
+    uint groupCountZ;
+    DrawIndexedCommand draws[];
+});
+BINDLESS_STORAGE_BUFFER(Vertices, { Vertex vertices[]; });
+BINDLESS_STORAGE_BUFFER(QuantizedVertices, { QuantizedVertex vertices[]; });
+BINDLESS_STORAGE_BUFFER(Meshlets, { Meshlet meshlets[]; });
+BINDLESS_STORAGE_BUFFER(MeshletVertices, { uint meshletVertices[]; });
+BINDLESS_STORAGE_BUFFER(MeshletTriangles, { uint meshletTriangles[]; });
+
+FrameData frameData() {
+    return bindlessFrames[draw.frameDataIndex].frame;
+}
+
+Instance loadInstance(uint index) {
+    return bindlessInstances[draw.instanceBufferIndex].instances[index];
+}
+
+const uint NoInstanceList = 0xffffffffu;
+
+// Instance handled by row y of a dispatch over instances. Without an instance list every instance has its own row,
+// with one only the instances the occlusion culling pass put into it, see shaders/occlusionCull.comp.
+uint instanceIndexAt(uint row) {
+    if (draw.instanceListIndex == NoInstanceList) {
+        return row;
+    }
+    return bindlessInstanceLists[draw.instanceListIndex].draws[row].firstInstance;
+}
+
+vec3 decodePosition(vec3 quantized) {
+    return draw.positionOffset.xyz + quantized * draw.positionScale.xyz;
+}
+
+VertexAttributes loadVertex(uint index) {
+    VertexAttributes attributes;
+
+    if (vertexFormat == VertexFormatQuantized) {
+        QuantizedVertex vertex = bindlessQuantizedVertices[draw.vertexBufferIndex].vertices[index];
+        attributes.position = decodePosition(vec3(unpackUnorm2x16(vertex.position[0]), unpackUnorm2x16(vertex.position[1]).x));
+        attributes.normal = octahedralDecode(unpackSnorm2x16(vertex.normal));
+        attributes.uv = unpackHalf2x16(vertex.uv);
+    } else {
+        Vertex vertex = bindlessVertices[draw.vertexBufferIndex].vertices[index];
+        attributes.position = vec3(vertex.position[0], vertex.position[1], vertex.position[2]);
+        attributes.normal = normalize(vec3(vertex.normal[0], vertex.normal[1], vertex.normal[2]));
+        attributes.uv = vec2(vertex.uv[0], vertex.uv[1]);
+    }
+
+    return attributes;
+}
+
+Meshlet loadMeshlet(uint index) {
+    return bindlessMeshlets[draw.meshletBufferIndex].meshlets[index];
+}
+
+// mesh vertex index of one of the meshlet's vertices
+uint meshletVertex(Meshlet meshlet, uint localIndex) {
+    return bindlessMeshletVertices[draw.meshletVertexBufferIndex].meshletVertices[meshlet.vertexOffset + localIndex];
+}
+
+// local vertex index of a triangle corner, the triangles are packed as bytes
+uint meshletTriangleCorner(Meshlet meshlet, uint triangle, uint corner) {
+    uint byteOffset = meshlet.triangleOffset + triangle * 3 + corner;
+    uint word = bindlessMeshletTriangles[draw.meshletTriangleBufferIndex].meshletTriangles[byteOffset / 4];
+    return (word >> ((byteOffset % 4) * 8)) & 0xff;
+}
+
+// Frustum test of the bounding sphere and backface test of the normal cone, the meshlet is culled when the camera
+// sees all of its triangles from behind. offset is the translation of the instance the meshlet belongs to.
+bool meshletVisible(Meshlet meshlet, vec3 offset) {
+    FrameData frame = frameData();
+    vec3 center = meshlet.center + offset;
+
+    for (int i = 0; i < 6; i++) {
+        if (dot(frame.frustumPlanes[i], vec4(center, 1)) < -meshlet.radius) {
+            return false;
+        }
+    }
+
+    vec3 toCenter = center - frame.cameraPosition.xyz;
+    return dot(toCenter, meshlet.coneAxis) < meshlet.coneCutoff * length(toCenter) + meshlet.radius;
+}
+
+// meshlets handled by one task shader workgroup
+const uint TaskGroupSize = 32;
+
+struct TaskPayload {
+    uint instanceIndex;
+    uint meshletIndices[TaskGroupSize];
+};
@@ -0,0 +1,85 @@
+// Structures shared by the scene shaders, mirrors src/sceneData.hpp and the cooked layout in src/meshFormat.hpp.
+// Kept apart from scene.glsl for shaders with their own push constants.
+
+struct Vertex {
+    float position[3];
+    float normal[3];
+    float uv[2];
+};
+
+// see QuantizedMeshVertex: unorm16 position, snorm16 octahedral normal and half float uv, two components per uint
+struct QuantizedVertex {
+    uint position[2];
+    uint normal;
+    uint uv;
+};
+
+struct VertexAttributes {
+    vec3 position;
+    vec3 normal;
+    vec2 uv;
+};
+
+struct Meshlet {
+    uint vertexOffset;
+    uint triangleOffset;
+    uint vertexCount;
+    uint triangleCount;
+    vec3 center;
+    float radius;
+    vec3 coneAxis;
+    float coneCutoff;
+};
+
+struct Instance {
+    vec4 offset;
+    uint indexOffset;
+    uint indexCount;
+    uint meshletOffset;
+    uint meshletCount;
+};
+
+// indirect draw of one meshlet, firstInstance is the slot of the draw itself, see meshletCull.comp
+struct MeshletDraw {
+    uint vertexCount;
+    uint instanceCount;
+    uint firstVertex;
+    uint firstInstance;
+    uint meshletIndex;
+    uint instanceIndex;
+    uvec2 padding;
+};
+
+// VkDrawIndexedIndirectCommand
+struct DrawIndexedCommand {
+    uint indexCount;
+    uint instanceCount;
+    uint firstIndex;
+    int vertexOffset;
+    uint firstInstance;
+};
+
+struct FrameData {
+    mat4 viewProj;
+    vec4 frustumPlanes[6];
+    vec4 cameraPosition;
+    mat4 view;
+    vec4 projection;  // [0][0] and [1][1] of the projection matrix, near and far plane distance
+    vec4 clusterGrid; // tile size in pixels, scale and bias from the log of the view depth to the depth slice
+    vec4 viewport;
+    mat4 inverseViewProj;
+};
+
+const uint LightTypePoint = 0;
+const uint LightTypeSpot = 1;
+
+struct Light {
+    vec3 position;
+    float range;
+    vec3 color;
+    uint type;
+    vec3 direction;
+    float spotCosOuter;
+    float spotCosInner;
+    uint padding[3];
+};
@@ -1,9 +1,19 @@
 #version 450
 
-layout(location = 0) in vec3 fragColor;
+// Clustered forward shading: only the lights binned into the fragment's froxel by shaders/lightCull.comp are
+// evaluated, so the cost per fragment is bounded by MaxLightsPerCluster however many lights the scene has.
+
+#include "scene.glsl"
+#include "shading.glsl"
+
+layout(location = 0) in vec3 worldPosition;
+layout(location = 1) in vec3 worldNormal;
 
 layout(location = 0) out vec4 outColor;
 
 void main() {
-    outColor = vec4(fragColor, 1);
-}
\ No newline at end of file
+    vec3 normal = normalize(worldNormal);
+    vec3 color = shadeSurface(frameData(), draw.lightBufferIndex, draw.clusterBufferIndex, gl_FragCoord.xy,
+                              worldPosition, normal, surfaceAlbedo(normal));
+    outColor = vec4(color, 1);
+}
@@ -1,20 +1,28 @@
 #version 450
 
-layout(location = 0) out vec3 fragColor;
+#include "scene.glsl"
 
-vec2 positions[3] = vec2[](
-    vec2(0.0, -0.5),
-    vec2(0.5, 0.5),
-    vec2(-0.5, 0.5)
-);
+// Float vertices come in as R32G32B32 floats, quantized ones as R16G16B16A16 unorm positions, R16G16 snorm
+// octahedral normals and R16G16 half float uvs, see the vertex input state in createGraphicsPipeline.
+layout(location = 0) in vec4 inPosition;
+layout(location = 1) in vec4 inNormal;
+layout(location = 2) in vec2 inUV;
 
-vec3 colors[3] = vec3[](
-    vec3(1, 0, 0),
-    vec3(0, 1, 0),
-    vec3(0, 0, 1)
-);
+layout(location = 0) out vec3 worldPosition;
+layout(location = 1) out vec3 worldNormal;
 
 void main() {
-    gl_Position = vec4(positions[gl_VertexIndex], 0, 1);
-    fragColor = colors[gl_VertexIndex];
+    vec3 position = inPosition.xyz;
+    vec3 normal = inNormal.xyz;
+    if (vertexFormat == VertexFormatQuantized) {
+        position = decodePosition(position);
+        normal = octahedralDecode(inNormal.xy);
+    }
+
+    // one indexed draw per instance, firstInstance is the instance index
+    position += loadInstance(uint(gl_InstanceIndex)).offset.xyz;
+
+    gl_Position = frameData().viewProj * vec4(position, 1);
+    worldPosition = position;
+    worldNormal = normal;
 }
@@ -0,0 +1,30 @@
+// Clustered shading of a surface point, shared by the forward and the deferred lighting fragment shaders.
+// Needs bindless.glsl and sceneTypes.glsl.
+
+#include "lighting.glsl"
+
+BINDLESS_STORAGE_BUFFER(Lights, { Light lights[]; });
+BINDLESS_STORAGE_BUFFER(Clusters, { uint clusters[]; });
+
+// a hint of the normal keeps the shape readable where no light reaches
+vec3 surfaceAlbedo(vec3 normal) {
+    return mix(vec3(0.8), normal * 0.5 + 0.5, 0.25);
+}
+
+// Evaluates the lights binned into the froxel of the fragment at fragCoord, at most MaxLightsPerCluster of them.
+vec3 shadeSurface(FrameData frame, uint lightBufferIndex, uint clusterBufferIndex, vec2 fragCoord, vec3 position,
+                  vec3 normal, vec3 albedo) {
+    vec3 toCamera = normalize(frame.cameraPosition.xyz - position);
+    vec3 color = albedo * (0.03 + 0.02 * normal.y);
+
+    float viewDepth = -(frame.view * vec4(position, 1)).z;
+    uint base = clusterIndexAt(frame, fragCoord, viewDepth) * ClusterStride;
+    uint count = bindlessClusters[clusterBufferIndex].clusters[base];
+
+    for (uint i = 0; i < count; i++) {
+        uint lightIndex = bindlessClusters[clusterBufferIndex].clusters[base + 1 + i];
+        color += shadeLight(bindlessLights[lightBufferIndex].lights[lightIndex], position, normal, toCamera, albedo);
+    }
+
+    return color;
+}
@@ -0,0 +1,20 @@
+#version 450
+
+// Upscales the part of the scene color target the frame was rendered into onto the whole output with bilinear
+// filtering, see src/dynamicResolution.hpp.
+
+#include "bindless.glsl"
+
+layout(push_constant) uniform UpscaleConstants {
+    uint textureIndex;
+    uint samplerIndex;
+    vec2 uvPerPixel; // from output pixels to texture coordinates of the rendered part
+    vec2 uvMax;      // half a texel inside the rendered part, so nothing outside of it is filtered in
+} upscale;
+
+layout(location = 0) out vec4 outColor;
+
+void main() {
+    vec2 uv = min(gl_FragCoord.xy * upscale.uvPerPixel, upscale.uvMax);
+    outColor = texture(sampler2D(bindlessTextures[upscale.textureIndex], bindlessSamplers[upscale.samplerIndex]), uv);
+}
@@ -0,0 +1,286 @@
+#include "bindless.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <stdexcept>
+
+bool BindlessDescriptorSet::checkSupport(vk::PhysicalDevice physDevice) {
+    auto features = physDevice.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceDescriptorIndexingFeatures>();
+    auto &indexing = features.get<vk::PhysicalDeviceDescriptorIndexingFeatures>();
+
+    return indexing.runtimeDescriptorArray &&
+           indexing.descriptorBindingPartiallyBound &&
+           indexing.descriptorBindingUpdateUnusedWhilePending &&
+           indexing.descriptorBindingSampledImageUpdateAfterBind &&
+           indexing.descriptorBindingStorageBufferUpdateAfterBind &&
+           indexing.shaderSampledImageArrayNonUniformIndexing &&
+           indexing.shaderStorageBufferArrayNonUniformIndexing;
+}
+
+vk::PhysicalDeviceDescriptorIndexingFeatures BindlessDescriptorSet::requiredFeatures() {
+    return vk::PhysicalDeviceDescriptorIndexingFeatures{
+            .shaderSampledImageArrayNonUniformIndexing = VK_TRUE,
+            .shaderStorageBufferArrayNonUniformIndexing = VK_TRUE,
+            .descriptorBindingSampledImageUpdateAfterBind = VK_TRUE,
+            .descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE,
+            .descriptorBindingUpdateUnusedWhilePending = VK_TRUE,
+            .descriptorBindingPartiallyBound = VK_TRUE,
+            .runtimeDescriptorArray = VK_TRUE,
+    };
+}
+
+void BindlessDescriptorSet::create(vk::PhysicalDevice physDevice, vk::Device logicalDevice, MemoryAllocator &memoryAllocator,
+                                   const vk::DispatchLoaderDynamic &dynamicDispatcher, bool useDescriptorBuffer) {
+    device = logicalDevice;
+    allocator = &memoryAllocator;
+    dispatcher = &dynamicDispatcher;
+    descriptorBufferMode = useDescriptorBuffer;
+
+    auto properties = physDevice.getProperties2<vk::PhysicalDeviceProperties2, vk::PhysicalDeviceDescriptorIndexingProperties>();
+    auto &limits = properties.get<vk::PhysicalDeviceDescriptorIndexingProperties>();
+
+    sampledImages.capacity = std::min({MaxSampledImages,
+                                       limits.maxDescriptorSetUpdateAfterBindSampledImages,
+                                       limits.maxPerStageDescriptorUpdateAfterBindSampledImages});
+    samplers.capacity = std::min({MaxSamplers,
+                                  limits.maxDescriptorSetUpdateAfterBindSamplers,
+                                  limits.maxPerStageDescriptorUpdateAfterBindSamplers});
+    storageBuffers.capacity = std::min({MaxStorageBuffers,
+                                        limits.maxDescriptorSetUpdateAfterBindStorageBuffers,
+                                        limits.maxPerStageDescriptorUpdateAfterBindStorageBuffers});
+
+    std::array<vk::DescriptorSetLayoutBinding, 3> bindings = {
+        vk::DescriptorSetLayoutBinding{
+            .binding = SampledImageBinding,
+            .descriptorType = vk::DescriptorType::eSampledImage,
+            .descriptorCount = sampledImages.capacity,
+            .stageFlags = vk::ShaderStageFlagBits::eAll,
+        },
+        vk::DescriptorSetLayoutBinding{
+            .binding = SamplerBinding,
+            .descriptorType = vk::DescriptorType::eSampler,
+            .descriptorCount = samplers.capacity,
+            .stageFlags = vk::ShaderStageFlagBits::eAll,
+        },
+        vk::DescriptorSetLayoutBinding{
+            .binding = StorageBufferBinding,
+            .descriptorType = vk::DescriptorType::eStorageBuffer,
+            .descriptorCount = storageBuffers.capacity,
+            .stageFlags = vk::ShaderStageFlagBits::eAll,
+        },
+    };
+
+    // descriptor buffers are plain memory, update-after-bind is implied and may not be requested explicitly
+    vk::DescriptorBindingFlags bindingFlags = vk::DescriptorBindingFlagBits::ePartiallyBound;
+    vk::DescriptorSetLayoutCreateFlags layoutFlags = vk::DescriptorSetLayoutCreateFlagBits::eDescriptorBufferEXT;
+    if (!descriptorBufferMode) {
+        bindingFlags |= vk::DescriptorBindingFlagBits::eUpdateAfterBind | vk::DescriptorBindingFlagBits::eUpdateUnusedWhilePending;
+        layoutFlags = vk::DescriptorSetLayoutCreateFlagBits::eUpdateAfterBindPool;
+    }
+    std::array<vk::DescriptorBindingFlags, 3> flags = {bindingFlags, bindingFlags, bindingFlags};
+
+    vk::DescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo{
+            .bindingCount = static_cast<uint32_t>(flags.size()),
+            .pBindingFlags = flags.data(),
+    };
+
+    setLayout = device.createDescriptorSetLayout({
+            .pNext = &bindingFlagsInfo,
+            .flags = layoutFlags,
+            .bindingCount = static_cast<uint32_t>(bindings.size()),
+            .pBindings = bindings.data(),
+    });
+
+    if (descriptorBufferMode) {
+        auto bufferProperties = physDevice.getProperties2<vk::PhysicalDeviceProperties2, vk::PhysicalDeviceDescriptorBufferPropertiesEXT>();
+        descriptorBufferProperties = bufferProperties.get<vk::PhysicalDeviceDescriptorBufferPropertiesEXT>();
+        descriptorBufferProperties.pNext = nullptr;
+
+        for (uint32_t binding = 0; binding < 3; binding++) {
+            bindingOffsets[binding] = device.getDescriptorSetLayoutBindingOffsetEXT(setLayout, binding, *dispatcher);
+        }
+
+        descriptorBuffer = allocator->createBuffer(
+                device.getDescriptorSetLayoutSizeEXT(setLayout, *dispatcher),
+                vk::BufferUsageFlagBits::eResourceDescriptorBufferEXT |
+                vk::BufferUsageFlagBits::eSamplerDescriptorBufferEXT |
+                vk::BufferUsageFlagBits::eShaderDeviceAddress,
+                vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+                vk::MemoryPropertyFlagBits::eDeviceLocal);
+        return;
+    }
+
+    std::array<vk::DescriptorPoolSize, 3> poolSizes = {
+        vk::DescriptorPoolSize{.type = vk::DescriptorType::eSampledImage, .descriptorCount = sampledImages.capacity},
+        vk::DescriptorPoolSize{.type = vk::DescriptorType::eSampler, .descriptorCount = samplers.capacity},
+        vk::DescriptorPoolSize{.type = vk::DescriptorType::eStorageBuffer, .descriptorCount = storageBuffers.capacity},
+    };
+
+    pool = device.createDescriptorPool({
+            .flags = vk::DescriptorPoolCreateFlagBits::eUpdateAfterBind,
+            .maxSets = 1,
+            .poolSizeCount = static_cast<uint32_t>(poolSizes.size()),
+            .pPoolSizes = poolSizes.data(),
+    });
+
+    descriptorSet = device.allocateDescriptorSets({
+            .descriptorPool = pool,
+            .descriptorSetCount = 1,
+            .pSetLayouts = &setLayout,
+    }).front();
+}
+
+void BindlessDescriptorSet::destroy() {
+    if (descriptorBufferMode) {
+        allocator->destroyBuffer(descriptorBuffer);
+    } else {
+        device.destroy(pool);
+    }
+    device.destroy(setLayout);
+
+    sampledImages = {};
+    samplers = {};
+    storageBuffers = {};
+}
+
+uint32_t BindlessDescriptorSet::addSampledImage(vk::ImageView imageView, vk::ImageLayout layout) {
+    auto index = sampledImages.acquire();
+    updateSampledImage(index, imageView, layout);
+    return index;
+}
+
+void BindlessDescriptorSet::updateSampledImage(uint32_t index, vk::ImageView imageView, vk::ImageLayout layout) {
+    vk::DescriptorImageInfo imageInfo{
+            .imageView = imageView,
+            .imageLayout = layout,
+    };
+
+    if (descriptorBufferMode) {
+        writeDescriptorBuffer(SampledImageBinding, index, {
+                .type = vk::DescriptorType::eSampledImage,
+                .data = {.pSampledImage = &imageInfo},
+        }, descriptorBufferProperties.sampledImageDescriptorSize);
+        return;
+    }
+
+    device.updateDescriptorSets(vk::WriteDescriptorSet{
+            .dstSet = descriptorSet,
+            .dstBinding = SampledImageBinding,
+            .dstArrayElement = index,
+            .descriptorCount = 1,
+            .descriptorType = vk::DescriptorType::eSampledImage,
+            .pImageInfo = &imageInfo,
+    }, {});
+}
+
+void BindlessDescriptorSet::removeSampledImage(uint32_t index) {
+    sampledImages.release(index);
+}
+
+uint32_t BindlessDescriptorSet::addSampler(vk::Sampler sampler) {
+    auto index = samplers.acquire();
+
+    if (descriptorBufferMode) {
+        writeDescriptorBuffer(SamplerBinding, index, {
+                .type = vk::DescriptorType::eSampler,
+                .data = {.pSampler = &sampler},
+        }, descriptorBufferProperties.samplerDescriptorSize);
+        return index;
+    }
+
+    vk::DescriptorImageInfo imageInfo{
+            .sampler = sampler,
+    };
+
+    device.updateDescriptorSets(vk::WriteDescriptorSet{
+            .dstSet = descriptorSet,
+            .dstBinding = SamplerBinding,
+            .dstArrayElement = index,
+            .descriptorCount = 1,
+            .descriptorType = vk::DescriptorType::eSampler,
+            .pImageInfo = &imageInfo,
+    }, {});
+
+    return index;
+}
+
+void BindlessDescriptorSet::removeSampler(uint32_t index) {
+    samplers.release(index);
+}
+
+uint32_t BindlessDescriptorSet::addStorageBuffer(const Buffer &buffer, vk::DeviceSize offset, vk::DeviceSize range) {
+    auto index = storageBuffers.acquire();
+    updateStorageBuffer(index, buffer, offset, range);
+    return index;
+}
+
+void BindlessDescriptorSet::updateStorageBuffer(uint32_t index, const Buffer &buffer, vk::DeviceSize offset, vk::DeviceSize range) {
+    if (range == VK_WHOLE_SIZE) {
+        range = buffer.size - offset;
+    }
+
+    if (descriptorBufferMode) {
+        vk::DescriptorAddressInfoEXT addressInfo{
+                .address = buffer.address + offset,
+                .range = range,
+        };
+
+        writeDescriptorBuffer(StorageBufferBinding, index, {
+                .type = vk::DescriptorType::eStorageBuffer,
+                .data = {.pStorageBuffer = &addressInfo},
+        }, descriptorBufferProperties.storageBufferDescriptorSize);
+        return;
+    }
+
+    vk::DescriptorBufferInfo bufferInfo{
+            .buffer = buffer.buffer,
+            .offset = offset,
+            .range = range,
+    };
+
+    device.updateDescriptorSets(vk::WriteDescriptorSet{
+            .dstSet = descriptorSet,
+            .dstBinding = StorageBufferBinding,
+            .dstArrayElement = index,
+            .descriptorCount = 1,
+            .descriptorType = vk::DescriptorType::eStorageBuffer,
+            .pBufferInfo = &bufferInfo,
+    }, {});
+}
+
+void BindlessDescriptorSet::removeStorageBuffer(uint32_t index) {
+    storageBuffers.release(index);
+}
+
+vk::DescriptorBufferBindingInfoEXT BindlessDescriptorSet::descriptorBufferBinding() const {
+    return vk::DescriptorBufferBindingInfoEXT{
+            .address = descriptorBuffer.address,
+            .usage = vk::BufferUsageFlagBits::eResourceDescriptorBufferEXT |
+                     vk::BufferUsageFlagBits::eSamplerDescriptorBufferEXT,
+    };
+}
+
+void BindlessDescriptorSet::writeDescriptorBuffer(uint32_t binding, uint32_t index, const vk::DescriptorGetInfoEXT &getInfo,
+                                                  size_t descriptorSize) {
+    auto destination = static_cast<std::byte *>(descriptorBuffer.allocation.mapped) + bindingOffsets[binding] + index * descriptorSize;
+    device.getDescriptorEXT(getInfo, descriptorSize, destination, *dispatcher);
+}
+
+uint32_t BindlessDescriptorSet::IndexAllocator::acquire() {
+    if (!freeList.empty()) {
+        auto index = freeList.back();
+        freeList.pop_back();
+        return index;
+    }
+
+    if (next >= capacity) {
+        throw std::runtime_error("bindless descriptor array is full");
+    }
+
+    return next++;
+}
+
+void BindlessDescriptorSet::IndexAllocator::release(uint32_t index) {
+    freeList.push_back(index);
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "memory.hpp"
+
+#define VULKAN_HPP_NO_CONSTRUCTORS
+#include <vulkan/vulkan.hpp>
+
+#include <cstdint>
+#include <vector>
+
+// One global descriptor set holding every sampled image, sampler and storage buffer the renderer knows about.
+// Resources are registered once and get a stable index into the matching array, shaders index the arrays
+// directly (see shaders/bindless.glsl), so the set is bound once per command buffer instead of per draw.
+// With descriptor buffers enabled the set lives in a mapped buffer instead of a descriptor pool and the
+// descriptors are written straight into it.
+class BindlessDescriptorSet {
+public:
+    static constexpr uint32_t SampledImageBinding = 0;
+    static constexpr uint32_t SamplerBinding = 1;
+    static constexpr uint32_t StorageBufferBinding = 2;
+
+    static constexpr uint32_t MaxSampledImages = 16384;
+    static constexpr uint32_t MaxSamplers = 256;
+    static constexpr uint32_t MaxStorageBuffers = 16384;
+
+    static bool checkSupport(vk::PhysicalDevice physDevice);
+    static vk::PhysicalDeviceDescriptorIndexingFeatures requiredFeatures();
+
+    void create(vk::PhysicalDevice physDevice, vk::Device device, MemoryAllocator &allocator,
+                const vk::DispatchLoaderDynamic &dispatcher, bool useDescriptorBuffer);
+    void destroy();
+
+    uint32_t addSampledImage(vk::ImageView imageView, vk::ImageLayout layout = vk::ImageLayout::eShaderReadOnlyOptimal);
+    void updateSampledImage(uint32_t index, vk::ImageView imageView, vk::ImageLayout layout = vk::ImageLayout::eShaderReadOnlyOptimal);
+    void removeSampledImage(uint32_t index);
+
+    uint32_t addSampler(vk::Sampler sampler);
+    void removeSampler(uint32_t index);
+
+    uint32_t addStorageBuffer(const Buffer &buffer, vk::DeviceSize offset = 0, vk::DeviceSize range = VK_WHOLE_SIZE);
+    void updateStorageBuffer(uint32_t index, const Buffer &buffer, vk::DeviceSize offset = 0, vk::DeviceSize range = VK_WHOLE_SIZE);
+    void removeStorageBuffer(uint32_t index);
+
+    [[nodiscard]] vk::DescriptorSetLayout layout() const { return setLayout; }
+    [[nodiscard]] vk::DescriptorSet set() const { return descriptorSet; }
+    [[nodiscard]] vk::DescriptorBufferBindingInfoEXT descriptorBufferBinding() const;
+
+private:
+    // Hands out array slots. Released slots are reused before the high-water mark grows, so the arrays stay dense.
+    // A slot must only be released once no frame in flight still references it.
+    struct IndexAllocator {
+        uint32_t capacity = 0;
+        uint32_t next = 0;
+        std::vector<uint32_t> freeList;
+
+        uint32_t acquire();
+        void release(uint32_t index);
+    };
+
+    void writeDescriptorBuffer(uint32_t binding, uint32_t index, const vk::DescriptorGetInfoEXT &getInfo, size_t descriptorSize);
+
+    vk::Device device;
+    MemoryAllocator *allocator = nullptr;
+    const vk::DispatchLoaderDynamic *dispatcher = nullptr;
+
+    vk::DescriptorSetLayout setLayout;
+    vk::DescriptorPool pool;
+    vk::DescriptorSet descriptorSet;
+
+    bool descriptorBufferMode = false;
+    vk::PhysicalDeviceDescriptorBufferPropertiesEXT descriptorBufferProperties;
+    Buffer descriptorBuffer;
+    vk::DeviceSize bindingOffsets[3] = {};
+
+    IndexAllocator sampledImages;
+    IndexAllocator samplers;
+    IndexAllocator storageBuffers;
+};
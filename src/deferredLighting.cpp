@@ -0,0 +1,489 @@
+#include "deferredLighting.hpp"
+#include "deferredLightingShader.h"
+#include "deferredLightingLocalReadShader.h"
+#include "fullscreenVertexShader.h"
+
+#include <cstring>
+
+bool DeferredLighting::checkLocalReadSupport(vk::PhysicalDevice physDevice) {
+    bool extensionFound = false;
+    for (const auto &extension : physDevice.enumerateDeviceExtensionProperties()) {
+        if (std::strcmp(extension.extensionName, localReadExtension()) == 0) {
+            extensionFound = true;
+            break;
+        }
+    }
+
+    if (!extensionFound) {
+        return false;
+    }
+
+    auto features = physDevice.getFeatures2<vk::PhysicalDeviceFeatures2,
+                                            vk::PhysicalDeviceDynamicRenderingLocalReadFeaturesKHR>();
+    return features.get<vk::PhysicalDeviceDynamicRenderingLocalReadFeaturesKHR>().dynamicRenderingLocalRead;
+}
+
+const char *DeferredLighting::localReadExtension() {
+    return VK_KHR_DYNAMIC_RENDERING_LOCAL_READ_EXTENSION_NAME;
+}
+
+vk::ImageUsageFlags DeferredLighting::depthUsage(bool localRead) {
+    return localRead ? vk::ImageUsageFlagBits::eInputAttachment : vk::ImageUsageFlagBits::eSampled;
+}
+
+void DeferredLighting::create(vk::Device logicalDevice, MemoryAllocator &memoryAllocator, BindlessDescriptorSet &bindlessSet,
+                              const ResourceBinder &resourceBinder, const vk::DispatchLoaderDynamic &dynamicDispatcher,
+                              bool localRead, vk::Format outputFormat, vk::Format depthFormat, vk::Extent2D extent,
+                              vk::Image depthImage, vk::ImageView depthImageView) {
+    device = logicalDevice;
+    allocator = &memoryAllocator;
+    bindless = &bindlessSet;
+    binder = &resourceBinder;
+    dispatcher = &dynamicDispatcher;
+    useLocalRead = localRead;
+    outputImageFormat = outputFormat;
+
+    if (useLocalRead) {
+        std::array<vk::DescriptorSetLayoutBinding, 3> bindings;
+        for (uint32_t i = 0; i < bindings.size(); i++) {
+            bindings[i] = vk::DescriptorSetLayoutBinding{
+                    .binding = i,
+                    .descriptorType = vk::DescriptorType::eInputAttachment,
+                    .descriptorCount = 1,
+                    .stageFlags = vk::ShaderStageFlagBits::eFragment,
+            };
+        }
+        inputSetLayout = device.createDescriptorSetLayout({
+                .bindingCount = static_cast<uint32_t>(bindings.size()),
+                .pBindings = bindings.data(),
+        });
+    } else {
+        sampler = device.createSampler({
+                .magFilter = vk::Filter::eNearest,
+                .minFilter = vk::Filter::eNearest,
+                .mipmapMode = vk::SamplerMipmapMode::eNearest,
+                .addressModeU = vk::SamplerAddressMode::eClampToEdge,
+                .addressModeV = vk::SamplerAddressMode::eClampToEdge,
+                .addressModeW = vk::SamplerAddressMode::eClampToEdge,
+        });
+        samplerIndex = bindless->addSampler(sampler);
+    }
+
+    createPipeline(outputFormat, depthFormat);
+    createTargets(extent, depthImage, depthImageView);
+}
+
+void DeferredLighting::destroy() {
+    destroyTargets();
+
+    device.destroy(pipeline);
+    device.destroy(pipelineLayout);
+
+    if (useLocalRead) {
+        device.destroy(inputSetLayout);
+    } else {
+        bindless->removeSampler(samplerIndex);
+        device.destroy(sampler);
+    }
+}
+
+void DeferredLighting::resize(vk::Extent2D extent, vk::Image depthImage, vk::ImageView depthImageView,
+                              DeletionQueue &deletionQueue) {
+    if (useLocalRead) {
+        deletionQueue.enqueue(inputPool);
+    } else {
+        deletionQueue.enqueue([bindlessSet = bindless, indices = std::array{albedoTextureIndex, normalTextureIndex,
+                                                                           depthTextureIndex}] {
+            for (auto index : indices) {
+                bindlessSet->removeSampledImage(index);
+            }
+        });
+    }
+    deletionQueue.enqueue(albedoView);
+    deletionQueue.enqueue(albedo);
+    deletionQueue.enqueue(normalView);
+    deletionQueue.enqueue(normal);
+    createTargets(extent, depthImage, depthImageView);
+}
+
+std::array<vk::Format, DeferredLighting::AttachmentCount> DeferredLighting::colorFormats() const {
+    return {useLocalRead ? outputImageFormat : vk::Format::eUndefined, AlbedoFormat, NormalFormat};
+}
+
+vk::ImageLayout DeferredLighting::colorLayout() const {
+    return useLocalRead ? vk::ImageLayout::eRenderingLocalReadKHR : vk::ImageLayout::eColorAttachmentOptimal;
+}
+
+vk::ImageLayout DeferredLighting::depthLayout() const {
+    return useLocalRead ? vk::ImageLayout::eRenderingLocalReadKHR : vk::ImageLayout::eDepthStencilAttachmentOptimal;
+}
+
+void DeferredLighting::createPipeline(vk::Format outputFormat, vk::Format depthFormat) {
+    std::array<vk::DescriptorSetLayout, 2> setLayouts = {bindless->layout(), inputSetLayout};
+    vk::PushConstantRange pushConstantRange{
+            .stageFlags = vk::ShaderStageFlagBits::eFragment,
+            .offset = 0,
+            .size = sizeof(PushConstants),
+    };
+    pipelineLayout = device.createPipelineLayout({
+            .setLayoutCount = useLocalRead ? 2u : 1u,
+            .pSetLayouts = setLayouts.data(),
+            .pushConstantRangeCount = 1,
+            .pPushConstantRanges = &pushConstantRange,
+    });
+
+    auto vertexModule = device.createShaderModule({
+            .codeSize = fullscreen_vert_spv_len,
+            .pCode = reinterpret_cast<const uint32_t *>(fullscreen_vert_spv),
+    });
+    auto fragmentModule = device.createShaderModule({
+            .codeSize = useLocalRead ? deferred_lighting_local_read_spv_len : deferred_lighting_spv_len,
+            .pCode = reinterpret_cast<const uint32_t *>(useLocalRead ? deferred_lighting_local_read_spv
+                                                                     : deferred_lighting_spv),
+    });
+
+    std::array<vk::PipelineShaderStageCreateInfo, 2> stages = {
+        vk::PipelineShaderStageCreateInfo{
+            .stage = vk::ShaderStageFlagBits::eVertex,
+            .module = vertexModule,
+            .pName = "main",
+        },
+        vk::PipelineShaderStageCreateInfo{
+            .stage = vk::ShaderStageFlagBits::eFragment,
+            .module = fragmentModule,
+            .pName = "main",
+        },
+    };
+
+    vk::PipelineVertexInputStateCreateInfo vertexInput{};
+    vk::PipelineInputAssemblyStateCreateInfo inputAssembly{
+            .topology = vk::PrimitiveTopology::eTriangleList,
+    };
+    vk::PipelineViewportStateCreateInfo viewportState{
+            .viewportCount = 1,
+            .scissorCount = 1,
+    };
+    vk::PipelineRasterizationStateCreateInfo rasterizer{
+            .polygonMode = vk::PolygonMode::eFill,
+            .cullMode = vk::CullModeFlagBits::eNone,
+            .frontFace = vk::FrontFace::eCounterClockwise,
+            .lineWidth = 1.0f,
+    };
+    vk::PipelineMultisampleStateCreateInfo multisampling{
+            .rasterizationSamples = vk::SampleCountFlagBits::e1,
+    };
+    vk::PipelineDepthStencilStateCreateInfo depthStencil{
+            .depthTestEnable = VK_FALSE,
+            .depthWriteEnable = VK_FALSE,
+    };
+
+    // only the output is written, the G-buffer attachments of the local read pass are masked
+    std::array<vk::PipelineColorBlendAttachmentState, AttachmentCount> blendAttachments = {};
+    blendAttachments[0].colorWriteMask = vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG |
+                                         vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA;
+    vk::PipelineColorBlendStateCreateInfo colorBlending{
+            .attachmentCount = useLocalRead ? AttachmentCount : 1u,
+            .pAttachments = blendAttachments.data(),
+    };
+
+    std::array<vk::DynamicState, 2> dynamicStates = {vk::DynamicState::eViewport, vk::DynamicState::eScissor};
+    vk::PipelineDynamicStateCreateInfo dynamicState{
+            .dynamicStateCount = static_cast<uint32_t>(dynamicStates.size()),
+            .pDynamicStates = dynamicStates.data(),
+    };
+
+    // the G-buffer attachments are read as input attachments 0 and 1, the depth as 2, see recordLighting
+    std::array<uint32_t, AttachmentCount> inputIndices = {VK_ATTACHMENT_UNUSED, 0, 1};
+    uint32_t depthInputIndex = 2;
+    vk::RenderingInputAttachmentIndexInfoKHR inputAttachmentInfo{
+            .colorAttachmentCount = AttachmentCount,
+            .pColorAttachmentInputIndices = inputIndices.data(),
+            .pDepthInputAttachmentIndex = &depthInputIndex,
+    };
+
+    auto formats = colorFormats();
+    vk::PipelineRenderingCreateInfo renderingInfo{
+            .colorAttachmentCount = useLocalRead ? AttachmentCount : 1u,
+            .pColorAttachmentFormats = useLocalRead ? formats.data() : &outputFormat,
+            .depthAttachmentFormat = useLocalRead ? depthFormat : vk::Format::eUndefined,
+    };
+    if (useLocalRead) {
+        renderingInfo.pNext = &inputAttachmentInfo;
+    }
+
+    pipeline = device.createGraphicsPipeline(nullptr, {
+            .pNext = &renderingInfo,
+            .flags = binder->pipelineCreateFlags(),
+            .stageCount = static_cast<uint32_t>(stages.size()),
+            .pStages = stages.data(),
+            .pVertexInputState = &vertexInput,
+            .pInputAssemblyState = &inputAssembly,
+            .pViewportState = &viewportState,
+            .pRasterizationState = &rasterizer,
+            .pMultisampleState = &multisampling,
+            .pDepthStencilState = &depthStencil,
+            .pColorBlendState = &colorBlending,
+            .pDynamicState = &dynamicState,
+            .layout = pipelineLayout,
+    }).value;
+
+    device.destroyShaderModule(vertexModule);
+    device.destroyShaderModule(fragmentModule);
+}
+
+void DeferredLighting::createTargets(vk::Extent2D extent, vk::Image depthImage, vk::ImageView depthImageView) {
+    depth = depthImage;
+    depthView = depthImageView;
+
+    // local read keeps the G-buffer in the rendering, the fallback samples it in the lighting pass
+    vk::ImageUsageFlags usage = vk::ImageUsageFlagBits::eColorAttachment;
+    usage |= useLocalRead ? vk::ImageUsageFlagBits::eInputAttachment : vk::ImageUsageFlagBits::eSampled;
+
+    auto createTarget = [&](vk::Format format, Image &image, vk::ImageView &view) {
+        image = allocator->createImage({
+                .imageType = vk::ImageType::e2D,
+                .format = format,
+                .extent = {
+                        .width = extent.width,
+                        .height = extent.height,
+                        .depth = 1,
+                },
+                .mipLevels = 1,
+                .arrayLayers = 1,
+                .samples = vk::SampleCountFlagBits::e1,
+                .tiling = vk::ImageTiling::eOptimal,
+                .usage = usage,
+                .sharingMode = vk::SharingMode::eExclusive,
+                .initialLayout = vk::ImageLayout::eUndefined,
+        }, vk::MemoryPropertyFlagBits::eDeviceLocal);
+
+        view = device.createImageView({
+                .image = image.image,
+                .viewType = vk::ImageViewType::e2D,
+                .format = format,
+                .subresourceRange = {
+                        .aspectMask = vk::ImageAspectFlagBits::eColor,
+                        .baseMipLevel = 0,
+                        .levelCount = 1,
+                        .baseArrayLayer = 0,
+                        .layerCount = 1,
+                },
+        });
+    };
+    createTarget(AlbedoFormat, albedo, albedoView);
+    createTarget(NormalFormat, normal, normalView);
+
+    if (!useLocalRead) {
+        albedoTextureIndex = bindless->addSampledImage(albedoView);
+        normalTextureIndex = bindless->addSampledImage(normalView);
+        depthTextureIndex = bindless->addSampledImage(depthView, vk::ImageLayout::eDepthStencilReadOnlyOptimal);
+        return;
+    }
+
+    vk::DescriptorPoolSize poolSize{
+            .type = vk::DescriptorType::eInputAttachment,
+            .descriptorCount = 3,
+    };
+    inputPool = device.createDescriptorPool({
+            .maxSets = 1,
+            .poolSizeCount = 1,
+            .pPoolSizes = &poolSize,
+    });
+    inputSet = device.allocateDescriptorSets({
+            .descriptorPool = inputPool,
+            .descriptorSetCount = 1,
+            .pSetLayouts = &inputSetLayout,
+    }).front();
+
+    std::array<vk::DescriptorImageInfo, 3> imageInfos = {
+        vk::DescriptorImageInfo{.imageView = albedoView, .imageLayout = vk::ImageLayout::eRenderingLocalReadKHR},
+        vk::DescriptorImageInfo{.imageView = normalView, .imageLayout = vk::ImageLayout::eRenderingLocalReadKHR},
+        vk::DescriptorImageInfo{.imageView = depthView, .imageLayout = vk::ImageLayout::eRenderingLocalReadKHR},
+    };
+    std::array<vk::WriteDescriptorSet, 3> writes;
+    for (uint32_t i = 0; i < writes.size(); i++) {
+        writes[i] = vk::WriteDescriptorSet{
+                .dstSet = inputSet,
+                .dstBinding = i,
+                .descriptorCount = 1,
+                .descriptorType = vk::DescriptorType::eInputAttachment,
+                .pImageInfo = &imageInfos[i],
+        };
+    }
+    device.updateDescriptorSets(writes, {});
+}
+
+void DeferredLighting::destroyTargets() {
+    if (useLocalRead) {
+        device.destroy(inputPool);
+    } else {
+        bindless->removeSampledImage(albedoTextureIndex);
+        bindless->removeSampledImage(normalTextureIndex);
+        bindless->removeSampledImage(depthTextureIndex);
+    }
+
+    device.destroy(albedoView);
+    allocator->destroyImage(albedo);
+    device.destroy(normalView);
+    allocator->destroyImage(normal);
+}
+
+void DeferredLighting::beginFrame(vk::CommandBuffer cmdBuffer) {
+    auto barrier = [](vk::Image image, vk::ImageAspectFlags aspect, vk::AccessFlags access, vk::ImageLayout layout) {
+        return vk::ImageMemoryBarrier{
+                .srcAccessMask = access,
+                .dstAccessMask = access,
+                .oldLayout = vk::ImageLayout::eUndefined,
+                .newLayout = layout,
+                .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .image = image,
+                .subresourceRange = {
+                        .aspectMask = aspect,
+                        .baseMipLevel = 0,
+                        .levelCount = 1,
+                        .baseArrayLayer = 0,
+                        .layerCount = 1,
+                },
+        };
+    };
+
+    // the targets are shared by all frames in flight, the previous frame's lighting has to be done reading them
+    auto colorAccess = vk::AccessFlagBits::eColorAttachmentRead | vk::AccessFlagBits::eColorAttachmentWrite;
+    auto depthAccess = vk::AccessFlagBits::eDepthStencilAttachmentRead | vk::AccessFlagBits::eDepthStencilAttachmentWrite;
+    std::array<vk::ImageMemoryBarrier, 3> barriers = {
+        barrier(albedo.image, vk::ImageAspectFlagBits::eColor, colorAccess, colorLayout()),
+        barrier(normal.image, vk::ImageAspectFlagBits::eColor, colorAccess, colorLayout()),
+        barrier(depth, vk::ImageAspectFlagBits::eDepth, depthAccess, depthLayout()),
+    };
+
+    auto stages = vk::PipelineStageFlagBits::eColorAttachmentOutput | vk::PipelineStageFlagBits::eEarlyFragmentTests |
+                  vk::PipelineStageFlagBits::eLateFragmentTests;
+    cmdBuffer.pipelineBarrier(stages | vk::PipelineStageFlagBits::eFragmentShader, stages, {},
+                              0, nullptr, 0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data());
+}
+
+void DeferredLighting::gbufferAttachments(std::span<vk::RenderingAttachmentInfo, AttachmentCount> attachments,
+                                          vk::AttachmentLoadOp loadOp, bool lastPass) const {
+    auto storeOp = lastPass && useLocalRead ? vk::AttachmentStoreOp::eDontCare : vk::AttachmentStoreOp::eStore;
+
+    for (auto [index, view] : {std::pair{1u, albedoView}, std::pair{2u, normalView}}) {
+        attachments[index] = vk::RenderingAttachmentInfo{
+                .imageView = view,
+                .imageLayout = colorLayout(),
+                .loadOp = loadOp,
+                .storeOp = storeOp,
+                .clearValue = vk::ClearValue{
+                        .color = vk::ClearColorValue{
+                                .float32 = std::array<float, 4>{0.0f, 0.0f, 0.0f, 0.0f}
+                        }
+                }
+        };
+    }
+}
+
+void DeferredLighting::recordLighting(vk::CommandBuffer cmdBuffer, uint32_t frameDataIndex, uint32_t lightBufferIndex,
+                                      uint32_t clusterBufferIndex, vk::ImageView output, vk::Extent2D renderExtent) {
+    PushConstants pushConstants{
+            .frameDataIndex = frameDataIndex,
+            .lightBufferIndex = lightBufferIndex,
+            .clusterBufferIndex = clusterBufferIndex,
+            .albedoTextureIndex = albedoTextureIndex,
+            .normalTextureIndex = normalTextureIndex,
+            .depthTextureIndex = depthTextureIndex,
+            .samplerIndex = samplerIndex,
+    };
+
+    if (useLocalRead) {
+        // the geometry written so far becomes readable at the same pixel without leaving the rendering
+        vk::MemoryBarrier localBarrier{
+                .srcAccessMask = vk::AccessFlagBits::eColorAttachmentWrite | vk::AccessFlagBits::eDepthStencilAttachmentWrite,
+                .dstAccessMask = vk::AccessFlagBits::eInputAttachmentRead,
+        };
+        cmdBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eColorAttachmentOutput |
+                                  vk::PipelineStageFlagBits::eEarlyFragmentTests |
+                                  vk::PipelineStageFlagBits::eLateFragmentTests,
+                                  vk::PipelineStageFlagBits::eFragmentShader, vk::DependencyFlagBits::eByRegion,
+                                  1, &localBarrier, 0, nullptr, 0, nullptr);
+
+        std::array<uint32_t, AttachmentCount> inputIndices = {VK_ATTACHMENT_UNUSED, 0, 1};
+        uint32_t depthInputIndex = 2;
+        cmdBuffer.setRenderingInputAttachmentIndicesKHR(vk::RenderingInputAttachmentIndexInfoKHR{
+                .colorAttachmentCount = AttachmentCount,
+                .pColorAttachmentInputIndices = inputIndices.data(),
+                .pDepthInputAttachmentIndex = &depthInputIndex,
+        }, *dispatcher);
+
+        cmdBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline);
+        binder->bindGlobal(cmdBuffer, vk::PipelineBindPoint::eGraphics, pipelineLayout);
+        cmdBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipelineLayout, 1, inputSet, {});
+        cmdBuffer.pushConstants(pipelineLayout, vk::ShaderStageFlagBits::eFragment, 0, sizeof(pushConstants), &pushConstants);
+        cmdBuffer.draw(3, 1, 0, 0);
+        return;
+    }
+
+    auto barrier = [](vk::Image image, vk::ImageAspectFlags aspect, vk::AccessFlags srcAccess, vk::ImageLayout oldLayout,
+                      vk::ImageLayout newLayout) {
+        return vk::ImageMemoryBarrier{
+                .srcAccessMask = srcAccess,
+                .dstAccessMask = vk::AccessFlagBits::eShaderRead,
+                .oldLayout = oldLayout,
+                .newLayout = newLayout,
+                .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .image = image,
+                .subresourceRange = {
+                        .aspectMask = aspect,
+                        .baseMipLevel = 0,
+                        .levelCount = 1,
+                        .baseArrayLayer = 0,
+                        .layerCount = 1,
+                },
+        };
+    };
+    std::array<vk::ImageMemoryBarrier, 3> barriers = {
+        barrier(albedo.image, vk::ImageAspectFlagBits::eColor, vk::AccessFlagBits::eColorAttachmentWrite,
+                vk::ImageLayout::eColorAttachmentOptimal, vk::ImageLayout::eShaderReadOnlyOptimal),
+        barrier(normal.image, vk::ImageAspectFlagBits::eColor, vk::AccessFlagBits::eColorAttachmentWrite,
+                vk::ImageLayout::eColorAttachmentOptimal, vk::ImageLayout::eShaderReadOnlyOptimal),
+        barrier(depth, vk::ImageAspectFlagBits::eDepth, vk::AccessFlagBits::eDepthStencilAttachmentWrite,
+                vk::ImageLayout::eDepthStencilAttachmentOptimal, vk::ImageLayout::eDepthStencilReadOnlyOptimal),
+    };
+    cmdBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eColorAttachmentOutput |
+                              vk::PipelineStageFlagBits::eLateFragmentTests,
+                              vk::PipelineStageFlagBits::eFragmentShader, {},
+                              0, nullptr, 0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data());
+
+    // every pixel is written, the output's previous contents don't matter
+    vk::RenderingAttachmentInfo outputAttachment{
+            .imageView = output,
+            .imageLayout = vk::ImageLayout::eColorAttachmentOptimal,
+            .loadOp = vk::AttachmentLoadOp::eDontCare,
+            .storeOp = vk::AttachmentStoreOp::eStore,
+    };
+    cmdBuffer.beginRendering({
+            .renderArea = {
+                    .extent = renderExtent,
+            },
+            .layerCount = 1,
+            .colorAttachmentCount = 1,
+            .pColorAttachments = &outputAttachment,
+    });
+
+    vk::Viewport viewport{
+            .width = static_cast<float>(renderExtent.width),
+            .height = static_cast<float>(renderExtent.height),
+            .minDepth = 0.0f,
+            .maxDepth = 1.0f,
+    };
+    vk::Rect2D scissor{.extent = renderExtent};
+    cmdBuffer.setViewport(0, viewport);
+    cmdBuffer.setScissor(0, scissor);
+
+    cmdBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline);
+    binder->bindGlobal(cmdBuffer, vk::PipelineBindPoint::eGraphics, pipelineLayout);
+    cmdBuffer.pushConstants(pipelineLayout, vk::ShaderStageFlagBits::eFragment, 0, sizeof(pushConstants), &pushConstants);
+    cmdBuffer.draw(3, 1, 0, 0);
+
+    cmdBuffer.endRendering();
+}
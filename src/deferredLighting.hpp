@@ -0,0 +1,110 @@
+#pragma once
+
+#include "bindless.hpp"
+#include "deletionQueue.hpp"
+#include "memory.hpp"
+#include "resourceBinding.hpp"
+
+#define VULKAN_HPP_NO_CONSTRUCTORS
+#include <vulkan/vulkan.hpp>
+
+#include <array>
+#include <cstdint>
+#include <span>
+
+// Deferred shading on top of the clustered lights. The geometry pass renders into color attachment 1 (albedo, RGBA8)
+// and 2 (octahedral normal, RG16 snorm) next to the depth buffer, and a fullscreen lighting pass
+// (shaders/deferredLighting*.frag) shades every pixel with the lights of its froxel.
+// With VK_KHR_dynamic_rendering_local_read the lighting is drawn inside the geometry pass's rendering, into color
+// attachment 0, and reads the G-buffer as input attachments, which lets tile based GPUs keep it in tile memory.
+// Otherwise the lighting renders into the output in a pass of its own and samples the G-buffer through the bindless
+// set, attachment 0 of the geometry pass is then left unused.
+class DeferredLighting {
+public:
+    static constexpr vk::Format AlbedoFormat = vk::Format::eR8G8B8A8Unorm;
+    static constexpr vk::Format NormalFormat = vk::Format::eR16G16Snorm;
+    static constexpr uint32_t AttachmentCount = 3;
+
+    // The input attachments are bound with a descriptor set of their own, which pipelines using descriptor buffers
+    // can't mix with the bindless buffer, so local read needs one of the other binding modes.
+    static bool checkLocalReadSupport(vk::PhysicalDevice physDevice);
+    static const char *localReadExtension();
+    // usage the depth image needs for the lighting pass to read it
+    static vk::ImageUsageFlags depthUsage(bool localRead);
+
+    void create(vk::Device device, MemoryAllocator &allocator, BindlessDescriptorSet &bindless,
+                const ResourceBinder &resourceBinder, const vk::DispatchLoaderDynamic &dispatcher, bool localRead,
+                vk::Format outputFormat, vk::Format depthFormat, vk::Extent2D extent, vk::Image depthImage,
+                vk::ImageView depthView);
+    void destroy();
+
+    // Recreates the G-buffer for a new swap chain and depth buffer, the old one is destroyed through deletionQueue once
+    // the frames in flight are done with it.
+    void resize(vk::Extent2D extent, vk::Image depthImage, vk::ImageView depthView, DeletionQueue &deletionQueue);
+
+    [[nodiscard]] bool localRead() const { return useLocalRead; }
+    // color formats of the geometry pipelines, the output's is undefined when it isn't attached
+    [[nodiscard]] std::array<vk::Format, AttachmentCount> colorFormats() const;
+    // layout of the depth buffer during the geometry pass
+    [[nodiscard]] vk::ImageLayout depthLayout() const;
+
+    // Discards the G-buffer and depth contents of the previous frame and prepares them for the geometry pass.
+    void beginFrame(vk::CommandBuffer cmdBuffer);
+    // Fills attachments 1 and 2 of a geometry pass. The G-buffer is stored unless it is the last geometry pass and the
+    // lighting reads it in place.
+    void gbufferAttachments(std::span<vk::RenderingAttachmentInfo, AttachmentCount> attachments,
+                            vk::AttachmentLoadOp loadOp, bool lastPass) const;
+
+    // Shades the top left renderExtent of the G-buffer into output. With local read it has to be recorded inside the
+    // last geometry pass's rendering, with output as its color attachment 0, otherwise after that rendering ended.
+    void recordLighting(vk::CommandBuffer cmdBuffer, uint32_t frameDataIndex, uint32_t lightBufferIndex,
+                        uint32_t clusterBufferIndex, vk::ImageView output, vk::Extent2D renderExtent);
+
+private:
+    struct PushConstants {
+        uint32_t frameDataIndex;
+        uint32_t lightBufferIndex;
+        uint32_t clusterBufferIndex;
+        uint32_t albedoTextureIndex;
+        uint32_t normalTextureIndex;
+        uint32_t depthTextureIndex;
+        uint32_t samplerIndex;
+    };
+
+    [[nodiscard]] vk::ImageLayout colorLayout() const;
+
+    void createPipeline(vk::Format outputFormat, vk::Format depthFormat);
+    void createTargets(vk::Extent2D extent, vk::Image depthImage, vk::ImageView depthView);
+    void destroyTargets();
+
+    vk::Device device;
+    MemoryAllocator *allocator = nullptr;
+    BindlessDescriptorSet *bindless = nullptr;
+    const ResourceBinder *binder = nullptr;
+    const vk::DispatchLoaderDynamic *dispatcher = nullptr;
+    bool useLocalRead = false;
+    vk::Format outputImageFormat = vk::Format::eUndefined;
+
+    vk::PipelineLayout pipelineLayout;
+    vk::Pipeline pipeline;
+
+    // local read only, the G-buffer and depth as input attachments, in a pool per G-buffer since frames in flight may
+    // still use the set of the previous one
+    vk::DescriptorSetLayout inputSetLayout;
+    vk::DescriptorPool inputPool;
+    vk::DescriptorSet inputSet;
+
+    // sampled fallback only
+    vk::Sampler sampler;
+    uint32_t samplerIndex = 0;
+    uint32_t albedoTextureIndex = 0;
+    uint32_t normalTextureIndex = 0;
+    uint32_t depthTextureIndex = 0;
+
+    Image albedo;
+    vk::ImageView albedoView;
+    Image normal;
+    vk::ImageView normalView;
+    vk::Image depth;
+    vk::ImageView depthView;
+};
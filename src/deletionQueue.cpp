@@ -0,0 +1,96 @@
+#include "deletionQueue.hpp"
+
+#include <utility>
+#include <vector>
+
+vk::PhysicalDeviceTimelineSemaphoreFeatures DeletionQueue::requiredFeatures() {
+    return vk::PhysicalDeviceTimelineSemaphoreFeatures{
+            .timelineSemaphore = VK_TRUE,
+    };
+}
+
+void DeletionQueue::create(vk::Device logicalDevice, MemoryAllocator &memoryAllocator) {
+    device = logicalDevice;
+    allocator = &memoryAllocator;
+    nextValue = 1;
+
+    vk::SemaphoreTypeCreateInfo typeInfo{
+            .semaphoreType = vk::SemaphoreType::eTimeline,
+            .initialValue = 0,
+    };
+    semaphore = device.createSemaphore({
+            .pNext = &typeInfo,
+    });
+}
+
+void DeletionQueue::destroy() {
+    std::deque<Entry> remaining;
+    {
+        std::lock_guard lock(mutex);
+        remaining.swap(entries);
+    }
+    for (auto &entry : remaining) {
+        entry.destroy();
+    }
+
+    device.destroy(semaphore);
+    semaphore = nullptr;
+}
+
+void DeletionQueue::enqueue(Buffer buffer) {
+    enqueue([this, buffer]() mutable { allocator->destroyBuffer(buffer); });
+}
+
+void DeletionQueue::enqueue(Image image) {
+    enqueue([this, image]() mutable { allocator->destroyImage(image); });
+}
+
+void DeletionQueue::enqueue(vk::ImageView imageView) {
+    enqueue([this, imageView] { device.destroy(imageView); });
+}
+
+void DeletionQueue::enqueue(vk::Sampler sampler) {
+    enqueue([this, sampler] { device.destroy(sampler); });
+}
+
+void DeletionQueue::enqueue(vk::Pipeline pipeline) {
+    enqueue([this, pipeline] { device.destroy(pipeline); });
+}
+
+void DeletionQueue::enqueue(vk::PipelineLayout pipelineLayout) {
+    enqueue([this, pipelineLayout] { device.destroy(pipelineLayout); });
+}
+
+void DeletionQueue::enqueue(vk::DescriptorPool descriptorPool) {
+    enqueue([this, descriptorPool] { device.destroy(descriptorPool); });
+}
+
+void DeletionQueue::enqueue(std::function<void()> destroyFunction) {
+    std::lock_guard lock(mutex);
+    entries.push_back(Entry{
+            .value = pendingValue(),
+            .destroy = std::move(destroyFunction),
+    });
+}
+
+void DeletionQueue::collect() {
+    auto completed = device.getSemaphoreCounterValue(semaphore);
+
+    // destroyed outside of the lock, destroying may enqueue again
+    std::vector<std::function<void()>> ready;
+    {
+        std::lock_guard lock(mutex);
+        while (!entries.empty() && entries.front().value <= completed) {
+            ready.push_back(std::move(entries.front().destroy));
+            entries.pop_front();
+        }
+    }
+    for (auto &destroyFunction : ready) {
+        destroyFunction();
+    }
+}
+
+size_t DeletionQueue::size() const {
+    std::lock_guard lock(mutex);
+    return entries.size();
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "memory.hpp"
+
+#define VULKAN_HPP_NO_CONSTRUCTORS
+#include <vulkan/vulkan.hpp>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+
+// Destroys Vulkan objects once the GPU is done with them, so resources can be replaced at runtime without waiting for
+// the device. Every frame's submit signals a timeline semaphore with the queue's pending value, objects enqueued while
+// that value is pending are destroyed by the first collect() that finds the semaphore past it. That is one frame later
+// than strictly necessary for objects the frame being recorded no longer uses, in exchange nobody has to know which
+// frames used what. Objects may be enqueued from any thread, submits and collect() belong to the render thread.
+class DeletionQueue {
+public:
+    static vk::PhysicalDeviceTimelineSemaphoreFeatures requiredFeatures();
+
+    void create(vk::Device device, MemoryAllocator &allocator);
+    // Destroys everything still queued, the device has to be idle.
+    void destroy();
+
+    // The frame submit signals timeline() with pendingValue(), and calls advance() once it is submitted.
+    [[nodiscard]] vk::Semaphore timeline() const { return semaphore; }
+    [[nodiscard]] uint64_t pendingValue() const { return nextValue.load(std::memory_order_acquire); }
+    void advance() { nextValue.fetch_add(1, std::memory_order_acq_rel); }
+
+    void enqueue(Buffer buffer);
+    void enqueue(Image image);
+    void enqueue(vk::ImageView imageView);
+    void enqueue(vk::Sampler sampler);
+    void enqueue(vk::Pipeline pipeline);
+    void enqueue(vk::PipelineLayout pipelineLayout);
+    void enqueue(vk::DescriptorPool descriptorPool);
+    // anything else, like releasing a bindless index
+    void enqueue(std::function<void()> destroyFunction);
+
+    // Destroys what the GPU has finished with, once per frame.
+    void collect();
+
+    [[nodiscard]] size_t size() const;
+
+private:
+    struct Entry {
+        uint64_t value;
+        std::function<void()> destroy;
+    };
+
+    vk::Device device;
+    MemoryAllocator *allocator = nullptr;
+    vk::Semaphore semaphore;
+    // the timeline starts at 0, so the first frame signals 1
+    std::atomic<uint64_t> nextValue = 1;
+
+    mutable std::mutex mutex;
+    std::deque<Entry> entries;
+};
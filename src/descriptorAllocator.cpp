@@ -0,0 +1,114 @@
+#include "descriptorAllocator.hpp"
+
+#include <array>
+#include <stdexcept>
+
+namespace {
+
+struct PoolSizeRatio {
+    vk::DescriptorType type;
+    float ratio;
+};
+
+// Average number of descriptors of each type per set, scaled by SetsPerPool for every pool.
+constexpr std::array<PoolSizeRatio, 6> poolSizeRatios = {
+    PoolSizeRatio{vk::DescriptorType::eUniformBuffer, 2.0f},
+    PoolSizeRatio{vk::DescriptorType::eStorageBuffer, 2.0f},
+    PoolSizeRatio{vk::DescriptorType::eCombinedImageSampler, 2.0f},
+    PoolSizeRatio{vk::DescriptorType::eSampledImage, 2.0f},
+    PoolSizeRatio{vk::DescriptorType::eStorageImage, 4.0f},
+    PoolSizeRatio{vk::DescriptorType::eSampler, 1.0f},
+};
+
+}
+
+void DescriptorAllocator::create(vk::Device logicalDevice, uint32_t frameCount) {
+    device = logicalDevice;
+    frames.resize(frameCount);
+    currentFrame = 0;
+}
+
+void DescriptorAllocator::destroy() {
+    for (auto &frame : frames) {
+        for (const auto &pool : frame.usedPools) {
+            device.destroy(pool);
+        }
+        if (frame.currentPool) {
+            device.destroy(frame.currentPool);
+        }
+    }
+    frames.clear();
+
+    for (const auto &pool : freePools) {
+        device.destroy(pool);
+    }
+    freePools.clear();
+}
+
+void DescriptorAllocator::beginFrame(uint32_t frameIndex) {
+    currentFrame = frameIndex;
+    auto &frame = frames[frameIndex];
+
+    // keep the current pool around, it is the one most likely to be large enough for this frame as well
+    if (frame.currentPool) {
+        device.resetDescriptorPool(frame.currentPool);
+    }
+
+    for (const auto &pool : frame.usedPools) {
+        device.resetDescriptorPool(pool);
+        freePools.push_back(pool);
+    }
+    frame.usedPools.clear();
+}
+
+vk::DescriptorSet DescriptorAllocator::allocate(vk::DescriptorSetLayout layout) {
+    auto &frame = frames[currentFrame];
+    if (!frame.currentPool) {
+        frame.currentPool = acquirePool();
+    }
+
+    vk::DescriptorSetAllocateInfo allocInfo{
+            .descriptorPool = frame.currentPool,
+            .descriptorSetCount = 1,
+            .pSetLayouts = &layout,
+    };
+
+    vk::DescriptorSet descriptorSet;
+    auto result = device.allocateDescriptorSets(&allocInfo, &descriptorSet);
+
+    if (result == vk::Result::eErrorOutOfPoolMemory || result == vk::Result::eErrorFragmentedPool) {
+        frame.usedPools.push_back(frame.currentPool);
+        frame.currentPool = acquirePool();
+
+        allocInfo.descriptorPool = frame.currentPool;
+        result = device.allocateDescriptorSets(&allocInfo, &descriptorSet);
+    }
+
+    if (result != vk::Result::eSuccess) {
+        throw std::runtime_error("could not allocate descriptor set");
+    }
+
+    return descriptorSet;
+}
+
+vk::DescriptorPool DescriptorAllocator::acquirePool() {
+    if (!freePools.empty()) {
+        auto pool = freePools.back();
+        freePools.pop_back();
+        return pool;
+    }
+
+    std::array<vk::DescriptorPoolSize, poolSizeRatios.size()> poolSizes;
+    for (size_t i = 0; i < poolSizeRatios.size(); i++) {
+        poolSizes[i] = vk::DescriptorPoolSize{
+                .type = poolSizeRatios[i].type,
+                .descriptorCount = static_cast<uint32_t>(poolSizeRatios[i].ratio * SetsPerPool),
+        };
+    }
+
+    return device.createDescriptorPool({
+            .maxSets = SetsPerPool,
+            .poolSizeCount = static_cast<uint32_t>(poolSizes.size()),
+            .pPoolSizes = poolSizes.data(),
+    });
+}
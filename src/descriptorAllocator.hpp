@@ -0,0 +1,37 @@
+#pragma once
+
+#define VULKAN_HPP_NO_CONSTRUCTORS
+#include <vulkan/vulkan.hpp>
+
+#include <cstdint>
+#include <vector>
+
+// Hands out transient descriptor sets that live for a single frame in flight.
+// Every frame owns a list of pools: sets are carved linearly out of the current pool, a fresh pool is taken when it
+// runs dry, and all of the frame's pools are reset in bulk once its fence has signalled, so allocation is a
+// pointer bump and there is no per-set free or destroy.
+class DescriptorAllocator {
+public:
+    void create(vk::Device device, uint32_t frameCount);
+    void destroy();
+
+    // Must only be called after the fence of the frame that last used frameIndex has been waited on.
+    void beginFrame(uint32_t frameIndex);
+
+    vk::DescriptorSet allocate(vk::DescriptorSetLayout layout);
+
+private:
+    static constexpr uint32_t SetsPerPool = 1024;
+
+    struct FramePools {
+        std::vector<vk::DescriptorPool> usedPools;
+        vk::DescriptorPool currentPool;
+    };
+
+    vk::DescriptorPool acquirePool();
+
+    vk::Device device;
+    std::vector<FramePools> frames;
+    std::vector<vk::DescriptorPool> freePools;
+    uint32_t currentFrame = 0;
+};
@@ -0,0 +1,321 @@
+#include "downsampler.hpp"
+#include "downsampleShader.h"
+
+#include <algorithm>
+#include <array>
+#include <stdexcept>
+
+bool MipDownsampler::checkSupport(vk::PhysicalDevice physDevice) {
+    auto features = physDevice.getFeatures();
+
+    return features.shaderStorageImageReadWithoutFormat &&
+           features.shaderStorageImageWriteWithoutFormat &&
+           features.shaderStorageImageArrayDynamicIndexing;
+}
+
+void MipDownsampler::enableRequiredFeatures(vk::PhysicalDeviceFeatures &features) {
+    features.shaderStorageImageReadWithoutFormat = VK_TRUE;
+    features.shaderStorageImageWriteWithoutFormat = VK_TRUE;
+    features.shaderStorageImageArrayDynamicIndexing = VK_TRUE;
+}
+
+vk::Format MipDownsampler::storageFormat(vk::Format format) {
+    switch (format) {
+    case vk::Format::eR8G8B8A8Srgb:
+        return vk::Format::eR8G8B8A8Unorm;
+    case vk::Format::eB8G8R8A8Srgb:
+        return vk::Format::eB8G8R8A8Unorm;
+    default:
+        return format;
+    }
+}
+
+bool MipDownsampler::canGenerateMips(vk::Format format) {
+    // storage support for these is required by the specification
+    auto storage = storageFormat(format);
+    return storage == vk::Format::eR8G8B8A8Unorm || storage == vk::Format::eR16G16B16A16Sfloat ||
+           storage == vk::Format::eR32Sfloat || storage == vk::Format::eR32G32B32A32Sfloat;
+}
+
+void MipDownsampler::create(vk::Device logicalDevice, MemoryAllocator &memoryAllocator, DescriptorAllocator &frameDescriptorAllocator) {
+    device = logicalDevice;
+    allocator = &memoryAllocator;
+    descriptorAllocator = &frameDescriptorAllocator;
+
+    std::array<vk::DescriptorSetLayoutBinding, 3> bindings = {
+        vk::DescriptorSetLayoutBinding{
+            .binding = 0,
+            .descriptorType = vk::DescriptorType::eCombinedImageSampler,
+            .descriptorCount = 1,
+            .stageFlags = vk::ShaderStageFlagBits::eCompute,
+        },
+        vk::DescriptorSetLayoutBinding{
+            .binding = 1,
+            .descriptorType = vk::DescriptorType::eStorageImage,
+            .descriptorCount = MaxLevels,
+            .stageFlags = vk::ShaderStageFlagBits::eCompute,
+        },
+        vk::DescriptorSetLayoutBinding{
+            .binding = 2,
+            .descriptorType = vk::DescriptorType::eStorageBuffer,
+            .descriptorCount = 1,
+            .stageFlags = vk::ShaderStageFlagBits::eCompute,
+        },
+    };
+
+    setLayout = device.createDescriptorSetLayout({
+            .bindingCount = static_cast<uint32_t>(bindings.size()),
+            .pBindings = bindings.data(),
+    });
+
+    vk::PushConstantRange pushConstantRange{
+            .stageFlags = vk::ShaderStageFlagBits::eCompute,
+            .offset = 0,
+            .size = sizeof(PushConstants),
+    };
+
+    pipelineLayout = device.createPipelineLayout({
+            .setLayoutCount = 1,
+            .pSetLayouts = &setLayout,
+            .pushConstantRangeCount = 1,
+            .pPushConstantRanges = &pushConstantRange,
+    });
+
+    auto shaderModule = device.createShaderModule({
+            .codeSize = downsample_spv_len,
+            .pCode = reinterpret_cast<const uint32_t *>(downsample_spv),
+    });
+
+    pipeline = device.createComputePipeline(nullptr, {
+            .stage = {
+                    .stage = vk::ShaderStageFlagBits::eCompute,
+                    .module = shaderModule,
+                    .pName = "main",
+            },
+            .layout = pipelineLayout,
+    }).value;
+
+    device.destroyShaderModule(shaderModule);
+
+    sampler = device.createSampler({
+            .magFilter = vk::Filter::eNearest,
+            .minFilter = vk::Filter::eNearest,
+            .mipmapMode = vk::SamplerMipmapMode::eNearest,
+            .addressModeU = vk::SamplerAddressMode::eClampToEdge,
+            .addressModeV = vk::SamplerAddressMode::eClampToEdge,
+            .addressModeW = vk::SamplerAddressMode::eClampToEdge,
+    });
+
+    counterBuffer = allocator->createBuffer(sizeof(uint32_t),
+                                            vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst,
+                                            vk::MemoryPropertyFlagBits::eDeviceLocal);
+    counterInitialized = false;
+}
+
+void MipDownsampler::destroy() {
+    allocator->destroyBuffer(counterBuffer);
+    device.destroy(sampler);
+    device.destroy(pipeline);
+    device.destroy(pipelineLayout);
+    device.destroy(setLayout);
+}
+
+MipChainViews MipDownsampler::createViews(vk::Image image, vk::Format format, uint32_t mipLevels) const {
+    MipChainViews views{
+            .encodeSrgb = storageFormat(format) != format,
+    };
+
+    // the first level is only ever sampled and decodes sRGB on its own, the sRGB format has no storage support
+    vk::ImageViewUsageCreateInfo sampledUsage{
+            .usage = vk::ImageUsageFlagBits::eSampled,
+    };
+    for (uint32_t level = 0; level < mipLevels; level++) {
+        views.levels.push_back(device.createImageView({
+                .pNext = level == 0 && views.encodeSrgb ? &sampledUsage : nullptr,
+                .image = image,
+                .viewType = vk::ImageViewType::e2D,
+                .format = level == 0 ? format : storageFormat(format),
+                .subresourceRange = {
+                        .aspectMask = vk::ImageAspectFlagBits::eColor,
+                        .baseMipLevel = level,
+                        .levelCount = 1,
+                        .baseArrayLayer = 0,
+                        .layerCount = 1,
+                },
+        }));
+    }
+
+    return views;
+}
+
+void MipDownsampler::destroyViews(MipChainViews &views) const {
+    for (const auto &view : views.levels) {
+        device.destroy(view);
+    }
+    views.levels.clear();
+}
+
+void MipDownsampler::record(vk::CommandBuffer cmdBuffer, vk::ImageView source, vk::ImageLayout sourceLayout,
+                            vk::Extent2D sourceExtent, std::span<const vk::ImageView> destinationLevels, DownsampleFilter filter,
+                            bool encodeSrgb) {
+    if (destinationLevels.empty()) {
+        return;
+    }
+
+    if (destinationLevels.size() > MaxLevels || (destinationLevels.size() > WorkGroupLevels &&
+                                                 std::max(sourceExtent.width, sourceExtent.height) > MaxSourceExtent)) {
+        throw std::runtime_error("mip chain too large for the single pass downsampler");
+    }
+
+    auto descriptorSet = descriptorAllocator->allocate(setLayout);
+
+    vk::DescriptorImageInfo sourceInfo{
+            .sampler = sampler,
+            .imageView = source,
+            .imageLayout = sourceLayout,
+    };
+
+    // unused slots repeat the last level, the shader never writes them
+    std::array<vk::DescriptorImageInfo, MaxLevels> destinationInfos;
+    for (size_t i = 0; i < MaxLevels; i++) {
+        destinationInfos[i] = vk::DescriptorImageInfo{
+                .imageView = destinationLevels[std::min(i, destinationLevels.size() - 1)],
+                .imageLayout = vk::ImageLayout::eGeneral,
+        };
+    }
+
+    vk::DescriptorBufferInfo counterInfo{
+            .buffer = counterBuffer.buffer,
+            .offset = 0,
+            .range = VK_WHOLE_SIZE,
+    };
+
+    std::array<vk::WriteDescriptorSet, 3> writes = {
+        vk::WriteDescriptorSet{
+            .dstSet = descriptorSet,
+            .dstBinding = 0,
+            .descriptorCount = 1,
+            .descriptorType = vk::DescriptorType::eCombinedImageSampler,
+            .pImageInfo = &sourceInfo,
+        },
+        vk::WriteDescriptorSet{
+            .dstSet = descriptorSet,
+            .dstBinding = 1,
+            .descriptorCount = MaxLevels,
+            .descriptorType = vk::DescriptorType::eStorageImage,
+            .pImageInfo = destinationInfos.data(),
+        },
+        vk::WriteDescriptorSet{
+            .dstSet = descriptorSet,
+            .dstBinding = 2,
+            .descriptorCount = 1,
+            .descriptorType = vk::DescriptorType::eStorageBuffer,
+            .pBufferInfo = &counterInfo,
+        },
+    };
+    device.updateDescriptorSets(writes, {});
+
+    // the last workgroup resets the counter, so consecutive dispatches only need to be ordered
+    vk::BufferMemoryBarrier counterBarrier{
+            .srcAccessMask = vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite,
+            .dstAccessMask = vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .buffer = counterBuffer.buffer,
+            .offset = 0,
+            .size = VK_WHOLE_SIZE,
+    };
+    vk::PipelineStageFlags counterSrcStage = vk::PipelineStageFlagBits::eComputeShader;
+
+    if (!counterInitialized) {
+        cmdBuffer.fillBuffer(counterBuffer.buffer, 0, VK_WHOLE_SIZE, 0);
+        counterBarrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+        counterSrcStage = vk::PipelineStageFlagBits::eTransfer;
+        counterInitialized = true;
+    }
+
+    cmdBuffer.pipelineBarrier(counterSrcStage, vk::PipelineStageFlagBits::eComputeShader, {},
+                              0, nullptr, 1, &counterBarrier, 0, nullptr);
+
+    auto levelZeroWidth = std::max(1u, sourceExtent.width >> 1);
+    auto levelZeroHeight = std::max(1u, sourceExtent.height >> 1);
+    auto groupsX = (levelZeroWidth + 31) / 32;
+    auto groupsY = (levelZeroHeight + 31) / 32;
+
+    PushConstants pushConstants{
+            .sourceWidth = sourceExtent.width,
+            .sourceHeight = sourceExtent.height,
+            .levelCount = static_cast<uint32_t>(destinationLevels.size()),
+            .workGroupCount = groupsX * groupsY,
+            .filterMode = static_cast<uint32_t>(filter),
+            .encodeSrgb = encodeSrgb ? 1u : 0u,
+    };
+
+    cmdBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, pipeline);
+    cmdBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, pipelineLayout, 0, descriptorSet, {});
+    cmdBuffer.pushConstants<PushConstants>(pipelineLayout, vk::ShaderStageFlagBits::eCompute, 0, pushConstants);
+    cmdBuffer.dispatch(groupsX, groupsY, 1);
+}
+
+void MipDownsampler::generateMips(vk::CommandBuffer cmdBuffer, vk::Image image, const MipChainViews &views, vk::Extent2D extent,
+                                  vk::ImageLayout levelZeroLayout, vk::PipelineStageFlags srcStage, vk::AccessFlags srcAccess,
+                                  DownsampleFilter filter) {
+    auto levelCount = static_cast<uint32_t>(views.levels.size());
+    if (levelCount < 2) {
+        return;
+    }
+
+    auto subresource = [](uint32_t baseLevel, uint32_t count) {
+        return vk::ImageSubresourceRange{
+                .aspectMask = vk::ImageAspectFlagBits::eColor,
+                .baseMipLevel = baseLevel,
+                .levelCount = count,
+                .baseArrayLayer = 0,
+                .layerCount = 1,
+        };
+    };
+
+    std::array<vk::ImageMemoryBarrier, 2> before = {
+        vk::ImageMemoryBarrier{
+            .srcAccessMask = srcAccess,
+            .dstAccessMask = vk::AccessFlagBits::eShaderRead,
+            .oldLayout = levelZeroLayout,
+            .newLayout = vk::ImageLayout::eShaderReadOnlyOptimal,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .image = image,
+            .subresourceRange = subresource(0, 1),
+        },
+        vk::ImageMemoryBarrier{
+            .srcAccessMask = {},
+            .dstAccessMask = vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite,
+            .oldLayout = vk::ImageLayout::eUndefined,
+            .newLayout = vk::ImageLayout::eGeneral,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .image = image,
+            .subresourceRange = subresource(1, levelCount - 1),
+        },
+    };
+
+    cmdBuffer.pipelineBarrier(srcStage | vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eComputeShader, {},
+                              0, nullptr, 0, nullptr, static_cast<uint32_t>(before.size()), before.data());
+
+    record(cmdBuffer, views.levels[0], vk::ImageLayout::eShaderReadOnlyOptimal, extent,
+           std::span(views.levels).subspan(1), filter, views.encodeSrgb);
+
+    vk::ImageMemoryBarrier after{
+            .srcAccessMask = vk::AccessFlagBits::eShaderWrite,
+            .dstAccessMask = vk::AccessFlagBits::eShaderRead,
+            .oldLayout = vk::ImageLayout::eGeneral,
+            .newLayout = vk::ImageLayout::eShaderReadOnlyOptimal,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .image = image,
+            .subresourceRange = subresource(1, levelCount - 1),
+    };
+
+    cmdBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader,
+                              vk::PipelineStageFlagBits::eFragmentShader | vk::PipelineStageFlagBits::eComputeShader, {},
+                              0, nullptr, 0, nullptr, 1, &after);
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "descriptorAllocator.hpp"
+#include "memory.hpp"
+
+#define VULKAN_HPP_NO_CONSTRUCTORS
+#include <vulkan/vulkan.hpp>
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+enum class DownsampleFilter : uint32_t {
+    Box = 0,
+    Kaiser = 1,
+    Min = 2,
+    Max = 3,
+};
+
+// One view per level of an image, created once and reused every time its mip chain is rebuilt.
+// Storage images can't be sRGB, so the levels below the first of an sRGB image are viewed with the UNORM format
+// and the shader encodes what it writes.
+struct MipChainViews {
+    std::vector<vk::ImageView> levels;
+    bool encodeSrgb = false;
+};
+
+// Builds mip chains with a single compute dispatch (shaders/downsample.comp) instead of a blit and a barrier per level.
+// Works for uploaded textures as well as render targets that are reduced every frame, e.g. a min/max depth pyramid.
+class MipDownsampler {
+public:
+    static constexpr uint32_t MaxLevels = 12;
+    // Every workgroup reduces its block of the source to this many levels on its own, only the levels below need the
+    // last workgroup and limit the source extent.
+    static constexpr uint32_t WorkGroupLevels = 6;
+    static constexpr uint32_t MaxSourceExtent = 4096;
+
+    static bool checkSupport(vk::PhysicalDevice physDevice);
+    static void enableRequiredFeatures(vk::PhysicalDeviceFeatures &features);
+    // The format the levels are written through. When it differs from the image's format the image needs the
+    // mutable format and extended usage flags, and views with the image's format must leave out the storage usage.
+    static vk::Format storageFormat(vk::Format format);
+    // Whether generateMips() works for every image of format, i.e. its storage format is supported everywhere.
+    static bool canGenerateMips(vk::Format format);
+
+    void create(vk::Device device, MemoryAllocator &allocator, DescriptorAllocator &descriptorAllocator);
+    void destroy();
+
+    MipChainViews createViews(vk::Image image, vk::Format format, uint32_t mipLevels) const;
+    void destroyViews(MipChainViews &views) const;
+
+    // Reduces source into destinationLevels, each level half the size of the one before. The source has to be in
+    // sourceLayout and readable by the compute stage, the destinations in the general layout. sourceExtent may be
+    // larger than the source, e.g. a power of two, the texels past its edge then repeat the edge. Sources larger than
+    // MaxSourceExtent are reduced by at most WorkGroupLevels levels per call.
+    void record(vk::CommandBuffer cmdBuffer, vk::ImageView source, vk::ImageLayout sourceLayout, vk::Extent2D sourceExtent,
+                std::span<const vk::ImageView> destinationLevels, DownsampleFilter filter, bool encodeSrgb = false);
+
+    // Rebuilds levels 1 and up of a color image from level 0, which is expected in levelZeroLayout and written by
+    // srcStage/srcAccess. Leaves all levels in the shader read only layout.
+    void generateMips(vk::CommandBuffer cmdBuffer, vk::Image image, const MipChainViews &views, vk::Extent2D extent,
+                      vk::ImageLayout levelZeroLayout, vk::PipelineStageFlags srcStage, vk::AccessFlags srcAccess,
+                      DownsampleFilter filter);
+
+private:
+    struct PushConstants {
+        uint32_t sourceWidth;
+        uint32_t sourceHeight;
+        uint32_t levelCount;
+        uint32_t workGroupCount;
+        uint32_t filterMode;
+        uint32_t encodeSrgb;
+    };
+
+    vk::Device device;
+    MemoryAllocator *allocator = nullptr;
+    DescriptorAllocator *descriptorAllocator = nullptr;
+
+    vk::DescriptorSetLayout setLayout;
+    vk::PipelineLayout pipelineLayout;
+    vk::Pipeline pipeline;
+    vk::Sampler sampler;
+    Buffer counterBuffer;
+    bool counterInitialized = false;
+};
@@ -0,0 +1,312 @@
+#include "dynamicResolution.hpp"
+#include "fullscreenVertexShader.h"
+#include "upscaleShader.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+// weight of a new measurement in the smoothed GPU time
+static constexpr double SmoothingFactor = 0.2;
+// the scale is lowered above the target and raised below this fraction of it, in between it stays
+static constexpr double RaiseThreshold = 0.85;
+// the scale aims for this fraction of the target to keep some headroom
+static constexpr double Headroom = 0.92;
+// largest change of the scale per step, raising is slower than lowering to avoid oscillation
+static constexpr float MaxDecrease = 0.1f;
+static constexpr float MaxIncrease = 0.05f;
+// frames a change needs to show up in the measurements, the GPU timer lags the frames in flight behind
+static constexpr uint32_t SettleFrames = 4;
+
+void DynamicResolution::create(vk::Device logicalDevice, MemoryAllocator &memoryAllocator, BindlessDescriptorSet &bindlessSet,
+                               const ResourceBinder &resourceBinder, vk::Format format, vk::Extent2D maxExtent,
+                               double targetMilliseconds) {
+    device = logicalDevice;
+    allocator = &memoryAllocator;
+    bindless = &bindlessSet;
+    binder = &resourceBinder;
+    colorFormat = format;
+    target = targetMilliseconds;
+    filteredMilliseconds = targetMilliseconds;
+
+    sampler = device.createSampler({
+            .magFilter = vk::Filter::eLinear,
+            .minFilter = vk::Filter::eLinear,
+            .mipmapMode = vk::SamplerMipmapMode::eNearest,
+            .addressModeU = vk::SamplerAddressMode::eClampToEdge,
+            .addressModeV = vk::SamplerAddressMode::eClampToEdge,
+            .addressModeW = vk::SamplerAddressMode::eClampToEdge,
+    });
+    samplerIndex = bindless->addSampler(sampler);
+
+    createPipeline(format);
+    createTarget(maxExtent);
+}
+
+void DynamicResolution::destroy() {
+    destroyTarget();
+
+    bindless->removeSampler(samplerIndex);
+    device.destroy(sampler);
+    device.destroy(pipeline);
+    device.destroy(pipelineLayout);
+}
+
+void DynamicResolution::resize(vk::Extent2D maxExtent, DeletionQueue &deletionQueue) {
+    deletionQueue.enqueue([bindlessSet = bindless, index = sceneColorIndex] { bindlessSet->removeSampledImage(index); });
+    deletionQueue.enqueue(sceneColorView);
+    deletionQueue.enqueue(sceneColor);
+    createTarget(maxExtent);
+}
+
+void DynamicResolution::update(double gpuMilliseconds) {
+    filteredMilliseconds += (gpuMilliseconds - filteredMilliseconds) * SmoothingFactor;
+
+    if (settleFrames > 0) {
+        settleFrames--;
+        return;
+    }
+
+    bool overBudget = filteredMilliseconds > target;
+    bool underBudget = filteredMilliseconds < target * RaiseThreshold;
+    if (!overBudget && !underBudget) {
+        return;
+    }
+
+    // the GPU time is dominated by per pixel work, which grows with the square of the scale
+    auto ideal = currentScale * static_cast<float>(std::sqrt(target * Headroom / std::max(filteredMilliseconds, 1e-3)));
+    auto scale = std::clamp(ideal, currentScale - MaxDecrease, currentScale + MaxIncrease);
+    scale = std::clamp(scale, MinScale, MaxScale);
+
+    if (scale != currentScale) {
+        currentScale = scale;
+        settleFrames = SettleFrames;
+    }
+}
+
+vk::Extent2D DynamicResolution::renderExtent() const {
+    return {
+            .width = std::clamp(static_cast<uint32_t>(std::lround(targetExtent.width * currentScale)), 1u, targetExtent.width),
+            .height = std::clamp(static_cast<uint32_t>(std::lround(targetExtent.height * currentScale)), 1u, targetExtent.height),
+    };
+}
+
+void DynamicResolution::createPipeline(vk::Format format) {
+    auto setLayout = bindless->layout();
+    vk::PushConstantRange pushConstantRange{
+            .stageFlags = vk::ShaderStageFlagBits::eFragment,
+            .offset = 0,
+            .size = sizeof(PushConstants),
+    };
+    pipelineLayout = device.createPipelineLayout({
+            .setLayoutCount = 1,
+            .pSetLayouts = &setLayout,
+            .pushConstantRangeCount = 1,
+            .pPushConstantRanges = &pushConstantRange,
+    });
+
+    auto vertexModule = device.createShaderModule({
+            .codeSize = fullscreen_vert_spv_len,
+            .pCode = reinterpret_cast<const uint32_t *>(fullscreen_vert_spv),
+    });
+    auto fragmentModule = device.createShaderModule({
+            .codeSize = upscale_spv_len,
+            .pCode = reinterpret_cast<const uint32_t *>(upscale_spv),
+    });
+
+    std::array<vk::PipelineShaderStageCreateInfo, 2> stages = {
+        vk::PipelineShaderStageCreateInfo{
+            .stage = vk::ShaderStageFlagBits::eVertex,
+            .module = vertexModule,
+            .pName = "main",
+        },
+        vk::PipelineShaderStageCreateInfo{
+            .stage = vk::ShaderStageFlagBits::eFragment,
+            .module = fragmentModule,
+            .pName = "main",
+        },
+    };
+
+    vk::PipelineVertexInputStateCreateInfo vertexInput{};
+    vk::PipelineInputAssemblyStateCreateInfo inputAssembly{
+            .topology = vk::PrimitiveTopology::eTriangleList,
+    };
+    vk::PipelineViewportStateCreateInfo viewportState{
+            .viewportCount = 1,
+            .scissorCount = 1,
+    };
+    vk::PipelineRasterizationStateCreateInfo rasterizer{
+            .polygonMode = vk::PolygonMode::eFill,
+            .cullMode = vk::CullModeFlagBits::eNone,
+            .frontFace = vk::FrontFace::eCounterClockwise,
+            .lineWidth = 1.0f,
+    };
+    vk::PipelineMultisampleStateCreateInfo multisampling{
+            .rasterizationSamples = vk::SampleCountFlagBits::e1,
+    };
+    vk::PipelineColorBlendAttachmentState blendAttachment{
+            .colorWriteMask = vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG |
+                              vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA,
+    };
+    vk::PipelineColorBlendStateCreateInfo colorBlending{
+            .attachmentCount = 1,
+            .pAttachments = &blendAttachment,
+    };
+
+    std::array<vk::DynamicState, 2> dynamicStates = {vk::DynamicState::eViewport, vk::DynamicState::eScissor};
+    vk::PipelineDynamicStateCreateInfo dynamicState{
+            .dynamicStateCount = static_cast<uint32_t>(dynamicStates.size()),
+            .pDynamicStates = dynamicStates.data(),
+    };
+
+    vk::PipelineRenderingCreateInfo renderingInfo{
+            .colorAttachmentCount = 1,
+            .pColorAttachmentFormats = &format,
+    };
+
+    pipeline = device.createGraphicsPipeline(nullptr, {
+            .pNext = &renderingInfo,
+            .flags = binder->pipelineCreateFlags(),
+            .stageCount = static_cast<uint32_t>(stages.size()),
+            .pStages = stages.data(),
+            .pVertexInputState = &vertexInput,
+            .pInputAssemblyState = &inputAssembly,
+            .pViewportState = &viewportState,
+            .pRasterizationState = &rasterizer,
+            .pMultisampleState = &multisampling,
+            .pColorBlendState = &colorBlending,
+            .pDynamicState = &dynamicState,
+            .layout = pipelineLayout,
+    }).value;
+
+    device.destroyShaderModule(vertexModule);
+    device.destroyShaderModule(fragmentModule);
+}
+
+void DynamicResolution::createTarget(vk::Extent2D extent) {
+    targetExtent = extent;
+
+    sceneColor = allocator->createImage({
+            .imageType = vk::ImageType::e2D,
+            .format = colorFormat,
+            .extent = {
+                    .width = extent.width,
+                    .height = extent.height,
+                    .depth = 1,
+            },
+            .mipLevels = 1,
+            .arrayLayers = 1,
+            .samples = vk::SampleCountFlagBits::e1,
+            .tiling = vk::ImageTiling::eOptimal,
+            .usage = vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eSampled,
+            .sharingMode = vk::SharingMode::eExclusive,
+            .initialLayout = vk::ImageLayout::eUndefined,
+    }, vk::MemoryPropertyFlagBits::eDeviceLocal);
+
+    sceneColorView = device.createImageView({
+            .image = sceneColor.image,
+            .viewType = vk::ImageViewType::e2D,
+            .format = colorFormat,
+            .subresourceRange = {
+                    .aspectMask = vk::ImageAspectFlagBits::eColor,
+                    .baseMipLevel = 0,
+                    .levelCount = 1,
+                    .baseArrayLayer = 0,
+                    .layerCount = 1,
+            },
+    });
+    sceneColorIndex = bindless->addSampledImage(sceneColorView);
+}
+
+void DynamicResolution::destroyTarget() {
+    bindless->removeSampledImage(sceneColorIndex);
+    device.destroy(sceneColorView);
+    allocator->destroyImage(sceneColor);
+}
+
+void DynamicResolution::beginFrame(vk::CommandBuffer cmdBuffer) {
+    // the target is shared by all frames in flight, the previous frame's upscale has to be done reading it
+    vk::ImageMemoryBarrier barrier{
+            .srcAccessMask = vk::AccessFlagBits::eShaderRead,
+            .dstAccessMask = vk::AccessFlagBits::eColorAttachmentRead | vk::AccessFlagBits::eColorAttachmentWrite,
+            .oldLayout = vk::ImageLayout::eUndefined,
+            .newLayout = vk::ImageLayout::eColorAttachmentOptimal,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .image = sceneColor.image,
+            .subresourceRange = {
+                    .aspectMask = vk::ImageAspectFlagBits::eColor,
+                    .baseMipLevel = 0,
+                    .levelCount = 1,
+                    .baseArrayLayer = 0,
+                    .layerCount = 1,
+            },
+    };
+    cmdBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eFragmentShader, vk::PipelineStageFlagBits::eColorAttachmentOutput,
+                              {}, 0, nullptr, 0, nullptr, 1, &barrier);
+}
+
+void DynamicResolution::recordUpscale(vk::CommandBuffer cmdBuffer, vk::ImageView output, vk::Extent2D outputExtent) {
+    vk::ImageMemoryBarrier barrier{
+            .srcAccessMask = vk::AccessFlagBits::eColorAttachmentWrite,
+            .dstAccessMask = vk::AccessFlagBits::eShaderRead,
+            .oldLayout = vk::ImageLayout::eColorAttachmentOptimal,
+            .newLayout = vk::ImageLayout::eShaderReadOnlyOptimal,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .image = sceneColor.image,
+            .subresourceRange = {
+                    .aspectMask = vk::ImageAspectFlagBits::eColor,
+                    .baseMipLevel = 0,
+                    .levelCount = 1,
+                    .baseArrayLayer = 0,
+                    .layerCount = 1,
+            },
+    };
+    cmdBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eColorAttachmentOutput, vk::PipelineStageFlagBits::eFragmentShader,
+                              {}, 0, nullptr, 0, nullptr, 1, &barrier);
+
+    // every output pixel is written
+    vk::RenderingAttachmentInfo outputAttachment{
+            .imageView = output,
+            .imageLayout = vk::ImageLayout::eColorAttachmentOptimal,
+            .loadOp = vk::AttachmentLoadOp::eDontCare,
+            .storeOp = vk::AttachmentStoreOp::eStore,
+    };
+    cmdBuffer.beginRendering({
+            .renderArea = {
+                    .extent = outputExtent,
+            },
+            .layerCount = 1,
+            .colorAttachmentCount = 1,
+            .pColorAttachments = &outputAttachment,
+    });
+
+    vk::Viewport viewport{
+            .width = static_cast<float>(outputExtent.width),
+            .height = static_cast<float>(outputExtent.height),
+            .minDepth = 0.0f,
+            .maxDepth = 1.0f,
+    };
+    vk::Rect2D scissor{.extent = outputExtent};
+    cmdBuffer.setViewport(0, viewport);
+    cmdBuffer.setScissor(0, scissor);
+
+    auto source = renderExtent();
+    auto width = static_cast<float>(targetExtent.width);
+    auto height = static_cast<float>(targetExtent.height);
+    PushConstants pushConstants{
+            .textureIndex = sceneColorIndex,
+            .samplerIndex = samplerIndex,
+            .uvPerPixel = {static_cast<float>(source.width) / (width * static_cast<float>(outputExtent.width)),
+                           static_cast<float>(source.height) / (height * static_cast<float>(outputExtent.height))},
+            .uvMax = {(static_cast<float>(source.width) - 0.5f) / width, (static_cast<float>(source.height) - 0.5f) / height},
+    };
+
+    cmdBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline);
+    binder->bindGlobal(cmdBuffer, vk::PipelineBindPoint::eGraphics, pipelineLayout);
+    cmdBuffer.pushConstants(pipelineLayout, vk::ShaderStageFlagBits::eFragment, 0, sizeof(pushConstants), &pushConstants);
+    cmdBuffer.draw(3, 1, 0, 0);
+
+    cmdBuffer.endRendering();
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "bindless.hpp"
+#include "deletionQueue.hpp"
+#include "memory.hpp"
+#include "resourceBinding.hpp"
+
+#define VULKAN_HPP_NO_CONSTRUCTORS
+#include <vulkan/vulkan.hpp>
+
+#include <cstdint>
+
+// Dynamic resolution scaling. The frame is rendered into the top left part of a scene color target that has the size of
+// the swap chain, with render area, viewport and scissor set to renderExtent(), and a fullscreen pass
+// (shaders/upscale.frag) scales that part up into the swap chain image. A controller adjusts the fraction of the swap
+// chain resolution from the measured GPU time to hold a frame time target. Only the render area changes with the
+// scale, so nothing is reallocated until the swap chain itself is recreated.
+class DynamicResolution {
+public:
+    static constexpr float MinScale = 0.5f;
+    static constexpr float MaxScale = 1.0f;
+
+    void create(vk::Device device, MemoryAllocator &allocator, BindlessDescriptorSet &bindless,
+                const ResourceBinder &resourceBinder, vk::Format format, vk::Extent2D maxExtent, double targetMilliseconds);
+    void destroy();
+
+    // Recreates the scene color target for a new swap chain extent, the old one is destroyed through deletionQueue once
+    // the frames in flight are done with it.
+    void resize(vk::Extent2D maxExtent, DeletionQueue &deletionQueue);
+
+    // Feeds the GPU time of a finished frame to the controller. The scale moves by bounded steps and only after the
+    // frames already in flight at the last change have been measured.
+    void update(double gpuMilliseconds);
+
+    [[nodiscard]] float scale() const { return currentScale; }
+    [[nodiscard]] vk::Extent2D renderExtent() const;
+    [[nodiscard]] vk::ImageView colorView() const { return sceneColorView; }
+
+    // Prepares the scene color target for rendering, its previous contents are discarded.
+    void beginFrame(vk::CommandBuffer cmdBuffer);
+    // Scales the rendered part of the scene color target up into output, has to be recorded outside of rendering.
+    void recordUpscale(vk::CommandBuffer cmdBuffer, vk::ImageView output, vk::Extent2D outputExtent);
+
+private:
+    struct PushConstants {
+        uint32_t textureIndex;
+        uint32_t samplerIndex;
+        float uvPerPixel[2];
+        float uvMax[2];
+    };
+
+    void createPipeline(vk::Format format);
+    void createTarget(vk::Extent2D extent);
+    void destroyTarget();
+
+    vk::Device device;
+    MemoryAllocator *allocator = nullptr;
+    BindlessDescriptorSet *bindless = nullptr;
+    const ResourceBinder *binder = nullptr;
+    vk::Format colorFormat = vk::Format::eUndefined;
+
+    vk::PipelineLayout pipelineLayout;
+    vk::Pipeline pipeline;
+    vk::Sampler sampler;
+    uint32_t samplerIndex = 0;
+
+    vk::Extent2D targetExtent;
+    Image sceneColor;
+    vk::ImageView sceneColorView;
+    uint32_t sceneColorIndex = 0;
+
+    double target = 0.0;
+    double filteredMilliseconds = 0.0;
+    float currentScale = MaxScale;
+    uint32_t settleFrames = 0;
+};
@@ -0,0 +1,153 @@
+#include "framePacing.hpp"
+
+#include <cstring>
+#include <thread>
+
+// the limiter spins for this long before the deadline instead of trusting the scheduler to wake it up in time
+static constexpr auto SpinMargin = std::chrono::microseconds(1500);
+// a present that takes longer than this to show up is given up on, e.g. while the window is minimized
+static constexpr uint64_t PresentWaitTimeout = 100'000'000;
+
+bool FramePacer::checkSupport(vk::PhysicalDevice physDevice) {
+    auto availableExtensions = physDevice.enumerateDeviceExtensionProperties();
+    for (auto required : requiredExtensions()) {
+        bool found = false;
+        for (const auto &extension : availableExtensions) {
+            if (std::strcmp(extension.extensionName, required) == 0) {
+                found = true;
+                break;
+            }
+        }
+        if (!found) {
+            return false;
+        }
+    }
+
+    auto features = physDevice.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDevicePresentIdFeaturesKHR,
+                                            vk::PhysicalDevicePresentWaitFeaturesKHR>();
+    return features.get<vk::PhysicalDevicePresentIdFeaturesKHR>().presentId &&
+           features.get<vk::PhysicalDevicePresentWaitFeaturesKHR>().presentWait;
+}
+
+std::array<const char *, 2> FramePacer::requiredExtensions() {
+    return {VK_KHR_PRESENT_ID_EXTENSION_NAME, VK_KHR_PRESENT_WAIT_EXTENSION_NAME};
+}
+
+void FramePacer::create(vk::Device logicalDevice, const vk::DispatchLoaderDynamic &dynamicDispatcher,
+                        bool enablePresentWait, bool enableLowLatency, double targetFrameRate) {
+    device = logicalDevice;
+    dispatcher = &dynamicDispatcher;
+    presentWait = enablePresentWait;
+    lowLatency = enableLowLatency;
+    if (targetFrameRate > 0.0) {
+        frameInterval = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / targetFrameRate));
+    }
+    nextFrameStart = Clock::now();
+}
+
+void FramePacer::resetSwapchain() {
+    submittedPresentId = 0;
+    displayedPresentId = 0;
+    lastDisplayTime.reset();
+}
+
+void FramePacer::waitForDisplay(vk::SwapchainKHR swapChain) {
+    if (!presentWait || submittedPresentId == 0) {
+        return;
+    }
+
+    frames++;
+    auto start = Clock::now();
+
+    try {
+        if (lowLatency && displayedPresentId < submittedPresentId) {
+            totalQueueDepth += submittedPresentId - displayedPresentId;
+            auto result = device.waitForPresentKHR(swapChain, submittedPresentId, PresentWaitTimeout, *dispatcher);
+            auto end = Clock::now();
+            totalWaitMilliseconds += std::chrono::duration<double, std::milli>(end - start).count();
+            if (result != vk::Result::eTimeout) {
+                markDisplayed(submittedPresentId, end);
+            }
+            return;
+        }
+
+        // Without blocking, every present that completed since the last frame is collected. Polling doesn't tell
+        // when they reached the screen, so they don't count towards the present interval.
+        while (displayedPresentId < submittedPresentId &&
+               device.waitForPresentKHR(swapChain, displayedPresentId + 1, 0, *dispatcher) != vk::Result::eTimeout) {
+            displayedPresentId++;
+            lastDisplayTime.reset();
+        }
+        totalQueueDepth += submittedPresentId - displayedPresentId;
+    } catch (vk::OutOfDateKHRError &) {
+        // the swap chain is recreated by the next frame, its presents will never complete
+        displayedPresentId = submittedPresentId;
+        lastDisplayTime.reset();
+    }
+}
+
+void FramePacer::markDisplayed(uint64_t id, Clock::time_point time) {
+    // the interval is only meaningful between consecutive presents
+    if (lastDisplayTime && id == displayedPresentId + 1 && time > *lastDisplayTime) {
+        totalIntervalMilliseconds += std::chrono::duration<double, std::milli>(time - *lastDisplayTime).count();
+        intervals++;
+    }
+    displayedPresentId = id;
+    lastDisplayTime = time;
+}
+
+void FramePacer::limitFrameRate() {
+    if (frameInterval == Clock::duration::zero()) {
+        return;
+    }
+
+    auto now = Clock::now();
+    if (now < nextFrameStart) {
+        if (nextFrameStart - now > SpinMargin) {
+            std::this_thread::sleep_for(nextFrameStart - now - SpinMargin);
+        }
+        while (Clock::now() < nextFrameStart) {
+        }
+    }
+
+    // a frame that ran late starts a new schedule instead of being followed by a burst of catch up frames
+    nextFrameStart += frameInterval;
+    now = Clock::now();
+    if (nextFrameStart < now) {
+        nextFrameStart = now + frameInterval;
+    }
+}
+
+void FramePacer::tagPresent(vk::PresentInfoKHR &presentInfo) {
+    if (!presentWait) {
+        return;
+    }
+
+    submittedPresentId++;
+    presentIdInfo = vk::PresentIdKHR{
+            .pNext = presentInfo.pNext,
+            .swapchainCount = presentInfo.swapchainCount,
+            .pPresentIds = &submittedPresentId,
+    };
+    presentInfo.pNext = &presentIdInfo;
+}
+
+double FramePacer::averagePresentInterval() const {
+    return intervals > 0 ? totalIntervalMilliseconds / intervals : 0.0;
+}
+
+double FramePacer::averageQueueDepth() const {
+    return frames > 0 ? static_cast<double>(totalQueueDepth) / frames : 0.0;
+}
+
+double FramePacer::averageWaitMilliseconds() const {
+    return frames > 0 ? totalWaitMilliseconds / frames : 0.0;
+}
+
+void FramePacer::resetStatistics() {
+    frames = 0;
+    totalQueueDepth = 0;
+    totalWaitMilliseconds = 0.0;
+    intervals = 0;
+    totalIntervalMilliseconds = 0.0;
+}
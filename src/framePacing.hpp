@@ -0,0 +1,71 @@
+#pragma once
+
+#define VULKAN_HPP_NO_CONSTRUCTORS
+#include <vulkan/vulkan.hpp>
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <optional>
+
+// Paces the main loop against the display. Presents are tagged with increasing ids (VK_KHR_present_id) and
+// VK_KHR_present_wait tells when they reached the screen. In low latency mode waitForDisplay() blocks until the
+// previous present is displayed, so input is sampled as late as possible and at most one frame waits in the
+// presentation queue, otherwise it only polls which presents are done to measure the queue. A frame limiter holds a
+// target frame rate by sleeping for most of the remaining time and spinning for the rest, which is more accurate
+// than the scheduler's sleep granularity.
+class FramePacer {
+public:
+    // the present id and present wait extensions and features
+    static bool checkSupport(vk::PhysicalDevice physDevice);
+    static std::array<const char *, 2> requiredExtensions();
+
+    // presentWait requires the features of checkSupport() to be enabled, targetFrameRate 0 disables the limiter
+    void create(vk::Device device, const vk::DispatchLoaderDynamic &dispatcher, bool presentWait, bool lowLatency,
+                double targetFrameRate);
+
+    [[nodiscard]] bool presentWaitEnabled() const { return presentWait; }
+
+    // Present ids only count up within one swap chain, call after the swap chain has been recreated.
+    void resetSwapchain();
+
+    // In low latency mode blocks until the last tagged present has been displayed.
+    void waitForDisplay(vk::SwapchainKHR swapChain);
+    // Sleeps and spins until the target frame interval since the last call has passed.
+    void limitFrameRate();
+
+    // Chains the next present id into presentInfo, which must be presented before the next call.
+    void tagPresent(vk::PresentInfoKHR &presentInfo);
+
+    // averages since the last resetStatistics()
+    [[nodiscard]] uint32_t statisticsFrames() const { return frames; }
+    // only measured in low latency mode, where the wait for each present returns once it is displayed
+    [[nodiscard]] uint32_t presentIntervals() const { return intervals; }
+    [[nodiscard]] double averagePresentInterval() const;
+    [[nodiscard]] double averageQueueDepth() const;
+    [[nodiscard]] double averageWaitMilliseconds() const;
+    void resetStatistics();
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    void markDisplayed(uint64_t id, Clock::time_point time);
+
+    vk::Device device;
+    const vk::DispatchLoaderDynamic *dispatcher = nullptr;
+    bool presentWait = false;
+    bool lowLatency = false;
+    Clock::duration frameInterval{};
+
+    vk::PresentIdKHR presentIdInfo;
+    uint64_t submittedPresentId = 0;
+    uint64_t displayedPresentId = 0;
+    std::optional<Clock::time_point> lastDisplayTime;
+    Clock::time_point nextFrameStart;
+
+    uint32_t frames = 0;
+    uint64_t totalQueueDepth = 0;
+    double totalWaitMilliseconds = 0.0;
+    uint32_t intervals = 0;
+    double totalIntervalMilliseconds = 0.0;
+};
@@ -0,0 +1,230 @@
+#include "gpuTimer.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#endif
+
+// the clocks drift apart by a few microseconds per second at most
+static constexpr auto CalibrationInterval = std::chrono::seconds(1);
+// a calibration call that got preempted reports a large deviation, the best of a few is kept
+static constexpr uint32_t CalibrationAttempts = 3;
+
+// The host time domain steady_clock reads: QueryPerformanceCounter on Windows and CLOCK_MONOTONIC elsewhere.
+#ifdef _WIN32
+static constexpr auto HostTimeDomain = vk::TimeDomainEXT::eQueryPerformanceCounter;
+
+static int64_t hostTimestampNanoseconds(uint64_t ticks) {
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    // split like steady_clock does, so the product doesn't overflow
+    auto perSecond = static_cast<uint64_t>(frequency.QuadPart);
+    return static_cast<int64_t>(ticks / perSecond * 1000000000ull + ticks % perSecond * 1000000000ull / perSecond);
+}
+#else
+static constexpr auto HostTimeDomain = vk::TimeDomainEXT::eClockMonotonic;
+
+static int64_t hostTimestampNanoseconds(uint64_t ticks) {
+    return static_cast<int64_t>(ticks);
+}
+#endif
+
+bool GpuTimer::checkCalibrationSupport(vk::PhysicalDevice physDevice, const vk::DispatchLoaderDynamic &dispatcher) {
+    auto availableExtensions = physDevice.enumerateDeviceExtensionProperties();
+    bool found = std::any_of(availableExtensions.begin(), availableExtensions.end(),
+                             [](const vk::ExtensionProperties &extension) {
+                                 return std::strcmp(extension.extensionName, calibrationExtension()) == 0;
+                             });
+    if (!found) {
+        return false;
+    }
+
+    auto domains = physDevice.getCalibrateableTimeDomainsEXT(dispatcher);
+    return std::find(domains.begin(), domains.end(), vk::TimeDomainEXT::eDevice) != domains.end() &&
+           std::find(domains.begin(), domains.end(), HostTimeDomain) != domains.end();
+}
+
+const char *GpuTimer::calibrationExtension() {
+    return VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME;
+}
+
+void GpuTimer::create(vk::PhysicalDevice physDevice, vk::Device logicalDevice,
+                      const vk::DispatchLoaderDynamic &dynamicDispatcher, uint32_t queueFamily, uint32_t frameCount,
+                      bool calibration) {
+    device = logicalDevice;
+    dispatcher = &dynamicDispatcher;
+
+    validBits = physDevice.getQueueFamilyProperties()[queueFamily].timestampValidBits;
+    if (validBits == 0) {
+        return;
+    }
+
+    timestampMask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+    nanosecondsPerTick = physDevice.getProperties().limits.timestampPeriod;
+    pending.assign(frameCount, false);
+    recordedScopes.resize(frameCount);
+    openScopes.reserve(MaxScopes);
+    timestamps.resize(QueriesPerFrame);
+    latestScopes.reserve(MaxScopes);
+
+    queryPool = device.createQueryPool({
+            .queryType = vk::QueryType::eTimestamp,
+            .queryCount = QueriesPerFrame * frameCount,
+    });
+
+    calibrationEnabled = calibration;
+    if (calibrationEnabled) {
+        calibrate();
+    }
+}
+
+void GpuTimer::destroy() {
+    device.destroy(queryPool);
+    queryPool = nullptr;
+}
+
+void GpuTimer::calibrate() {
+    // both clocks are sampled by the same call, which reports how far apart the two samples may be
+    std::array<vk::CalibratedTimestampInfoEXT, 2> infos{{
+            {.timeDomain = vk::TimeDomainEXT::eDevice},
+            {.timeDomain = HostTimeDomain},
+    }};
+    lastCalibration = std::chrono::steady_clock::now();
+
+    std::optional<uint64_t> bestDeviation;
+    std::array<uint64_t, 2> bestTicks{};
+    for (uint32_t attempt = 0; attempt < CalibrationAttempts; attempt++) {
+        std::array<uint64_t, 2> ticks{};
+        uint64_t maxDeviation = 0;
+        auto result = device.getCalibratedTimestampsEXT(static_cast<uint32_t>(infos.size()), infos.data(), ticks.data(),
+                                                        &maxDeviation, *dispatcher);
+        if (result != vk::Result::eSuccess) {
+            break;
+        }
+        if (!bestDeviation || maxDeviation < *bestDeviation) {
+            bestDeviation = maxDeviation;
+            bestTicks = ticks;
+        }
+    }
+
+    if (!bestDeviation) {
+        return;
+    }
+    calibrationTicks = bestTicks[0];
+    calibrationNanoseconds = hostTimestampNanoseconds(bestTicks[1]);
+    calibrationDeviation = *bestDeviation;
+}
+
+int64_t GpuTimer::hostNanoseconds(uint64_t ticks) const {
+    // sign extended, the timestamp may have been taken before the calibration
+    auto difference = (ticks - calibrationTicks) & timestampMask;
+    auto signedDifference = static_cast<int64_t>(difference);
+    if (validBits < 64 && difference >= (1ull << (validBits - 1))) {
+        signedDifference -= static_cast<int64_t>(1ull << validBits);
+    }
+    return calibrationNanoseconds + static_cast<int64_t>(static_cast<double>(signedDifference) * nanosecondsPerTick);
+}
+
+void GpuTimer::beginFrame(uint32_t frameIndex) {
+    currentFrame = frameIndex;
+    latestMilliseconds.reset();
+    latestFrame.reset();
+    latestScopes.clear();
+    if (!queryPool || !pending[frameIndex]) {
+        return;
+    }
+    pending[frameIndex] = false;
+
+    if (calibrationEnabled && std::chrono::steady_clock::now() - lastCalibration >= CalibrationInterval) {
+        calibrate();
+    }
+
+    const auto &scopes = recordedScopes[frameIndex];
+    auto queryCount = static_cast<uint32_t>(2 + 2 * scopes.size());
+    auto result = device.getQueryPoolResults(queryPool, QueriesPerFrame * frameIndex, queryCount,
+                                             queryCount * sizeof(uint64_t), timestamps.data(), sizeof(uint64_t),
+                                             vk::QueryResultFlagBits::e64);
+    if (result != vk::Result::eSuccess) {
+        return;
+    }
+
+    auto makeScope = [this](const char *name, uint32_t query) {
+        auto ticks = (timestamps[query + 1] - timestamps[query]) & timestampMask;
+        return Scope{
+                .name = name,
+                .beginTicks = timestamps[query],
+                .endTicks = timestamps[query + 1],
+                .milliseconds = static_cast<double>(ticks) * nanosecondsPerTick / 1e6,
+        };
+    };
+
+    latestFrame = makeScope("frame", 0);
+    latestMilliseconds = latestFrame->milliseconds;
+    totalMilliseconds += *latestMilliseconds;
+    samples++;
+
+    for (const auto &scope : scopes) {
+        latestScopes.push_back(makeScope(scope.name, scope.query));
+    }
+}
+
+void GpuTimer::begin(vk::CommandBuffer cmdBuffer) {
+    if (!queryPool) {
+        return;
+    }
+
+    recordedScopes[currentFrame].clear();
+    openScopes.clear();
+    cmdBuffer.resetQueryPool(queryPool, QueriesPerFrame * currentFrame, QueriesPerFrame);
+    cmdBuffer.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, queryPool, QueriesPerFrame * currentFrame);
+}
+
+void GpuTimer::end(vk::CommandBuffer cmdBuffer) {
+    if (!queryPool) {
+        return;
+    }
+
+    cmdBuffer.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, queryPool, QueriesPerFrame * currentFrame + 1);
+    pending[currentFrame] = true;
+}
+
+void GpuTimer::beginScope(vk::CommandBuffer cmdBuffer, const char *name) {
+    if (!queryPool) {
+        return;
+    }
+
+    auto &scopes = recordedScopes[currentFrame];
+    if (scopes.size() == MaxScopes) {
+        // ends nothing, endScope() pops it again
+        openScopes.push_back(UINT32_MAX);
+        return;
+    }
+
+    auto query = static_cast<uint32_t>(2 + 2 * scopes.size());
+    scopes.push_back({name, query});
+    openScopes.push_back(query);
+    cmdBuffer.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, queryPool, QueriesPerFrame * currentFrame + query);
+}
+
+void GpuTimer::endScope(vk::CommandBuffer cmdBuffer) {
+    if (!queryPool || openScopes.empty()) {
+        return;
+    }
+
+    auto query = openScopes.back();
+    openScopes.pop_back();
+    if (query != UINT32_MAX) {
+        cmdBuffer.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, queryPool,
+                                 QueriesPerFrame * currentFrame + query + 1);
+    }
+}
+
+void GpuTimer::resetAverage() {
+    totalMilliseconds = 0.0;
+    samples = 0;
+}
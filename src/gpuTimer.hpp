@@ -0,0 +1,100 @@
+#pragma once
+
+#define VULKAN_HPP_NO_CONSTRUCTORS
+#include <vulkan/vulkan.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+// Measures how long the GPU spends on a span of every frame, and on named scopes within it, with pairs of timestamp
+// queries per frame in flight. Results are read back without waiting when the frame's queries are reused, so they lag
+// the frames in flight behind, and the frame spans are averaged until resetAverage(). Records nothing on queues
+// without timestamp support. With VK_EXT_calibrated_timestamps the timestamps can be converted to
+// std::chrono::steady_clock, so GPU work can be put on the same timeline as the CPU.
+class GpuTimer {
+public:
+    // scopes per frame, later ones aren't timed
+    static constexpr uint32_t MaxScopes = 16;
+
+    struct Scope {
+        const char *name;
+        uint64_t beginTicks;
+        uint64_t endTicks;
+        double milliseconds;
+    };
+
+    // VK_EXT_calibrated_timestamps with the device time domain and the host domain steady_clock reads,
+    // QueryPerformanceCounter on Windows and CLOCK_MONOTONIC elsewhere
+    static bool checkCalibrationSupport(vk::PhysicalDevice physDevice, const vk::DispatchLoaderDynamic &dispatcher);
+    static const char *calibrationExtension();
+
+    // calibration requires the extension of checkCalibrationSupport() to be enabled
+    void create(vk::PhysicalDevice physDevice, vk::Device device, const vk::DispatchLoaderDynamic &dispatcher,
+                uint32_t queueFamily, uint32_t frameCount, bool calibration);
+    void destroy();
+
+    // Must only be called after the fence of the frame that last used frameIndex has been waited on.
+    void beginFrame(uint32_t frameIndex);
+
+    // Both have to be recorded outside of rendering, in the same command buffer.
+    void begin(vk::CommandBuffer cmdBuffer);
+    void end(vk::CommandBuffer cmdBuffer);
+
+    // Scopes are recorded between begin() and end() and may nest, the names have to outlive the frame's readback.
+    void beginScope(vk::CommandBuffer cmdBuffer, const char *name);
+    void endScope(vk::CommandBuffer cmdBuffer);
+
+    [[nodiscard]] bool supported() const { return static_cast<bool>(queryPool); }
+    [[nodiscard]] uint32_t sampleCount() const { return samples; }
+    [[nodiscard]] double averageMilliseconds() const { return samples > 0 ? totalMilliseconds / samples : 0.0; }
+    // the measurement the last beginFrame() read back, if the frame was timed
+    [[nodiscard]] std::optional<double> frameMilliseconds() const { return latestMilliseconds; }
+    // the frame span and its scopes the last beginFrame() read back, in the order they began
+    [[nodiscard]] const std::optional<Scope> &frameScope() const { return latestFrame; }
+    [[nodiscard]] const std::vector<Scope> &scopes() const { return latestScopes; }
+    void resetAverage();
+
+    [[nodiscard]] bool calibrated() const { return calibrationDeviation.has_value(); }
+    // the steady_clock time of a timestamp in nanoseconds since its epoch, only meaningful when calibrated()
+    [[nodiscard]] int64_t hostNanoseconds(uint64_t ticks) const;
+
+private:
+    // the frame span's pair and one pair for every scope
+    static constexpr uint32_t QueriesPerFrame = 2 + 2 * MaxScopes;
+
+    struct RecordedScope {
+        const char *name;
+        // index of the first query of its pair within the frame's queries
+        uint32_t query;
+    };
+
+    void calibrate();
+
+    vk::Device device;
+    const vk::DispatchLoaderDynamic *dispatcher = nullptr;
+    vk::QueryPool queryPool;
+    double nanosecondsPerTick = 1.0;
+    uint64_t timestampMask = ~0ull;
+    uint32_t validBits = 64;
+    uint32_t currentFrame = 0;
+    std::vector<bool> pending;
+    std::vector<std::vector<RecordedScope>> recordedScopes;
+    std::vector<uint32_t> openScopes;
+    std::vector<uint64_t> timestamps;
+
+    bool calibrationEnabled = false;
+    // a timestamp and the steady_clock time it was taken at, renewed now and then so the clocks don't drift apart,
+    // and the maximum deviation between the two, empty until a calibration succeeded
+    uint64_t calibrationTicks = 0;
+    int64_t calibrationNanoseconds = 0;
+    std::optional<uint64_t> calibrationDeviation;
+    std::chrono::steady_clock::time_point lastCalibration;
+
+    double totalMilliseconds = 0.0;
+    uint32_t samples = 0;
+    std::optional<double> latestMilliseconds;
+    std::optional<Scope> latestFrame;
+    std::vector<Scope> latestScopes;
+};
@@ -0,0 +1,297 @@
+#include "jobSystem.hpp"
+#include "trace.hpp"
+
+#include <algorithm>
+#include <array>
+
+struct Job {
+    JobSystem::Function function;
+    JobCounter *counter;
+};
+
+namespace {
+
+// an idle worker looks for jobs this many times before it goes to sleep
+constexpr uint32_t SpinRounds = 64;
+
+// Chase-Lev deque with a fixed capacity, in the formulation for weak memory models by Lê et al. Only the owning worker
+// calls push() and pop(), any thread may call steal().
+class WorkStealingDeque {
+public:
+    static constexpr int64_t Capacity = 4096;
+
+    // Returns false when the deque is full.
+    bool push(Job *job) {
+        auto bottomIndex = bottom.load(std::memory_order_relaxed);
+        auto topIndex = top.load(std::memory_order_acquire);
+        if (bottomIndex - topIndex >= Capacity) {
+            return false;
+        }
+
+        slots[bottomIndex & (Capacity - 1)].store(job, std::memory_order_relaxed);
+        bottom.store(bottomIndex + 1, std::memory_order_release);
+        return true;
+    }
+
+    Job *pop() {
+        auto bottomIndex = bottom.load(std::memory_order_relaxed) - 1;
+        bottom.store(bottomIndex, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        auto topIndex = top.load(std::memory_order_relaxed);
+
+        if (topIndex > bottomIndex) {
+            bottom.store(bottomIndex + 1, std::memory_order_relaxed);
+            return nullptr;
+        }
+
+        auto job = slots[bottomIndex & (Capacity - 1)].load(std::memory_order_relaxed);
+        if (topIndex == bottomIndex) {
+            // the last job, a thief may be taking it at the same time
+            if (!top.compare_exchange_strong(topIndex, topIndex + 1, std::memory_order_seq_cst,
+                                             std::memory_order_relaxed)) {
+                job = nullptr;
+            }
+            bottom.store(bottomIndex + 1, std::memory_order_relaxed);
+        }
+        return job;
+    }
+
+    Job *steal() {
+        auto topIndex = top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        auto bottomIndex = bottom.load(std::memory_order_acquire);
+        if (topIndex >= bottomIndex) {
+            return nullptr;
+        }
+
+        auto job = slots[topIndex & (Capacity - 1)].load(std::memory_order_relaxed);
+        // lost against the owner or another thief
+        if (!top.compare_exchange_strong(topIndex, topIndex + 1, std::memory_order_seq_cst,
+                                         std::memory_order_relaxed)) {
+            return nullptr;
+        }
+        return job;
+    }
+
+private:
+    // the thieves' and the owner's end on separate cache lines
+    alignas(64) std::atomic<int64_t> top = 0;
+    alignas(64) std::atomic<int64_t> bottom = 0;
+    alignas(64) std::array<std::atomic<Job *>, Capacity> slots{};
+};
+
+// the job system the calling thread is a worker of, and its index there
+thread_local const JobSystem *currentSystem = nullptr;
+thread_local uint32_t currentWorker = 0;
+// where the calling thread starts looking for jobs to steal, rotated so the thieves spread over the workers
+thread_local uint32_t stealStart = 0;
+
+}
+
+struct JobSystem::Worker {
+    WorkStealingDeque deque;
+};
+
+// defined here where Worker is complete
+JobSystem::JobSystem() = default;
+
+JobSystem::~JobSystem() {
+    // a thread that is still joinable would terminate the program, e.g. when an exception skipped destroy()
+    if (!threads.empty()) {
+        destroy();
+    }
+}
+
+uint32_t JobSystem::defaultWorkerCount() {
+    return std::max(std::thread::hardware_concurrency(), 2u) - 1;
+}
+
+void JobSystem::create(uint32_t workerCount) {
+    running = true;
+    for (uint32_t i = 0; i < workerCount; i++) {
+        workers.push_back(std::make_unique<Worker>());
+    }
+    for (uint32_t i = 0; i < workerCount; i++) {
+        threads.emplace_back(&JobSystem::workerLoop, this, i);
+    }
+}
+
+void JobSystem::destroy() {
+    {
+        std::lock_guard lock(sleepMutex);
+        running = false;
+    }
+    sleepCondition.notify_all();
+
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    threads.clear();
+    workers.clear();
+}
+
+void JobSystem::run(Function function, JobCounter *counter, JobCounter *dependency) {
+    auto job = new Job{std::move(function), counter};
+    if (counter) {
+        counter->pending.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    if (dependency) {
+        // the job that finishes the dependency takes its dependents under the same lock
+        std::lock_guard lock(dependency->dependentsMutex);
+        if (!dependency->done()) {
+            dependency->dependents.push_back(job);
+            return;
+        }
+    }
+
+    enqueue(job);
+}
+
+void JobSystem::enqueue(Job *job) {
+    // counted before the job can be found, a worker that wakes up too early just looks again
+    queuedJobs.fetch_add(1, std::memory_order_seq_cst);
+
+    if (currentSystem != this || !workers[currentWorker]->deque.push(job)) {
+        std::lock_guard lock(sharedMutex);
+        sharedJobs.push_back(job);
+    }
+
+    // pairs with the sleeping worker's check of queuedJobs, at least one of the two sees the other's change
+    if (sleepingWorkers.load(std::memory_order_seq_cst) > 0) {
+        std::lock_guard lock(sleepMutex);
+        sleepCondition.notify_one();
+    }
+}
+
+Job *JobSystem::findJob() {
+    if (queuedJobs.load(std::memory_order_relaxed) == 0) {
+        return nullptr;
+    }
+
+    Job *job = nullptr;
+    bool isWorker = currentSystem == this;
+    if (isWorker) {
+        job = workers[currentWorker]->deque.pop();
+    }
+
+    if (!job) {
+        std::lock_guard lock(sharedMutex);
+        if (!sharedJobs.empty()) {
+            job = sharedJobs.front();
+            sharedJobs.pop_front();
+        }
+    }
+
+    for (uint32_t i = 0; !job && i < workers.size(); i++) {
+        auto victim = (stealStart + i) % workers.size();
+        if (!isWorker || victim != currentWorker) {
+            job = workers[victim]->deque.steal();
+        }
+    }
+    stealStart++;
+
+    if (job) {
+        queuedJobs.fetch_sub(1, std::memory_order_relaxed);
+    }
+    return job;
+}
+
+void JobSystem::execute(Job *job) {
+    {
+        TRACE_ZONE("job");
+        job->function();
+    }
+    if (job->counter) {
+        finish(*job->counter);
+    }
+    delete job;
+}
+
+void JobSystem::finish(JobCounter &counter) {
+    // all but the last job only count down
+    auto pending = counter.pending.load(std::memory_order_relaxed);
+    while (pending > 1) {
+        if (counter.pending.compare_exchange_weak(pending, pending - 1, std::memory_order_acq_rel,
+                                                  std::memory_order_relaxed)) {
+            return;
+        }
+    }
+
+    // The last one takes the dependents under the lock run() adds them under, and wait() takes the lock once more
+    // before it returns, so the counter outlives this.
+    std::vector<Job *> ready;
+    {
+        std::lock_guard lock(counter.dependentsMutex);
+        if (counter.pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            ready.swap(counter.dependents);
+        }
+    }
+    for (auto job : ready) {
+        enqueue(job);
+    }
+}
+
+void JobSystem::wait(JobCounter &counter) {
+    while (!counter.done()) {
+        if (auto job = findJob()) {
+            execute(job);
+        } else {
+            std::this_thread::yield();
+        }
+    }
+
+    std::lock_guard lock(counter.dependentsMutex);
+}
+
+void JobSystem::workerLoop(uint32_t index) {
+    currentSystem = this;
+    currentWorker = index;
+    stealStart = index + 1;
+    TRACE_THREAD_NAME("worker " + std::to_string(index));
+
+    uint32_t idleRounds = 0;
+    while (running.load(std::memory_order_acquire)) {
+        if (auto job = findJob()) {
+            execute(job);
+            idleRounds = 0;
+            continue;
+        }
+
+        if (++idleRounds < SpinRounds) {
+            std::this_thread::yield();
+            continue;
+        }
+        idleRounds = 0;
+
+        std::unique_lock lock(sleepMutex);
+        sleepingWorkers.fetch_add(1, std::memory_order_seq_cst);
+        sleepCondition.wait(lock, [this] {
+            return !running.load(std::memory_order_relaxed) || queuedJobs.load(std::memory_order_seq_cst) > 0;
+        });
+        sleepingWorkers.fetch_sub(1, std::memory_order_relaxed);
+    }
+}
+
+void JobSystem::parallelFor(uint32_t count, uint32_t minRange, const RangeFunction &body) {
+    if (count == 0) {
+        return;
+    }
+
+    JobCounter counter;
+    splitRange(0, count, std::max(minRange, 1u), body, counter);
+    wait(counter);
+}
+
+void JobSystem::splitRange(uint32_t begin, uint32_t end, uint32_t minRange, const RangeFunction &body,
+                           JobCounter &counter) {
+    // Lazy binary splitting: half of the range is handed out only while there may be idle workers to take it, with
+    // busy workers the rest is done here in one piece.
+    while (end - begin >= 2 * minRange && queuedJobs.load(std::memory_order_relaxed) < workers.size()) {
+        auto middle = begin + (end - begin) / 2;
+        run([=, this, &body, &counter] { splitRange(middle, end, minRange, body, counter); }, &counter);
+        end = middle;
+    }
+
+    body(begin, end);
+}
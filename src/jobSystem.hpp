@@ -0,0 +1,87 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct Job;
+
+// Counts the jobs that were started with it and haven't finished yet. Jobs can be made to wait for a counter, they
+// are only queued once it reaches zero.
+class JobCounter {
+public:
+    [[nodiscard]] bool done() const { return pending.load(std::memory_order_acquire) == 0; }
+
+private:
+    friend class JobSystem;
+
+    std::atomic<uint32_t> pending = 0;
+    // jobs waiting for the counter, queued by whichever job brings it to zero
+    std::mutex dependentsMutex;
+    std::vector<Job *> dependents;
+};
+
+// The thread pool everything parallel runs on. Every worker owns a Chase-Lev work stealing deque: it pushes and pops
+// its own jobs at the bottom, without locks and newest first for cache locality, while idle workers steal the oldest
+// jobs from the top of the others. Threads that aren't workers hand their jobs in through a shared queue and help
+// executing jobs while they wait for a counter, so waiting never blocks a thread that could make progress. Idle
+// workers spin briefly and then sleep until new jobs arrive. Jobs must not throw.
+class JobSystem {
+public:
+    using Function = std::function<void()>;
+    // called with the range [begin, end) of a parallelFor
+    using RangeFunction = std::function<void(uint32_t begin, uint32_t end)>;
+
+    // one worker for every hardware thread besides the calling one
+    static uint32_t defaultWorkerCount();
+
+    JobSystem();
+    ~JobSystem();
+
+    // Without workers the jobs only run while a thread waits for them.
+    void create(uint32_t workerCount);
+    // All jobs have to be done.
+    void destroy();
+
+    [[nodiscard]] uint32_t workerCount() const { return static_cast<uint32_t>(workers.size()); }
+
+    // Queues function. counter counts it until it has finished, and it only starts after dependency is done.
+    void run(Function function, JobCounter *counter = nullptr, JobCounter *dependency = nullptr);
+    // Executes jobs until counter is done.
+    void wait(JobCounter &counter);
+
+    // Calls body for subranges of [0, count) in parallel and returns once all of them are done. A range is split in
+    // half only while fewer jobs are queued than there are workers, so the chunks get as large as the load allows and
+    // never smaller than minRange.
+    void parallelFor(uint32_t count, uint32_t minRange, const RangeFunction &body);
+
+private:
+    struct Worker;
+
+    void workerLoop(uint32_t index);
+    void enqueue(Job *job);
+    Job *findJob();
+    void execute(Job *job);
+    void finish(JobCounter &counter);
+    void splitRange(uint32_t begin, uint32_t end, uint32_t minRange, const RangeFunction &body, JobCounter &counter);
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::vector<std::thread> threads;
+    std::atomic<bool> running = false;
+
+    // jobs from threads that aren't workers, and those that didn't fit into a full deque
+    std::mutex sharedMutex;
+    std::deque<Job *> sharedJobs;
+
+    // queued jobs that nobody has taken yet, sleeping workers wait for it to become non zero
+    std::atomic<uint32_t> queuedJobs = 0;
+    std::atomic<uint32_t> sleepingWorkers = 0;
+    std::mutex sleepMutex;
+    std::condition_variable sleepCondition;
+};
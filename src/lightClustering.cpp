@@ -0,0 +1,130 @@
+#include "lightClustering.hpp"
+#include "lightCullShader.h"
+
+#include <algorithm>
+#include <cmath>
+
+// invocations per workgroup of shaders/lightCull.comp
+static constexpr uint32_t LightCullGroupSize = 128;
+
+void LightClusterer::create(vk::Device logicalDevice, MemoryAllocator &memoryAllocator, BindlessDescriptorSet &bindlessSet,
+                            const ResourceBinder &resourceBinder, uint32_t frameCount, uint32_t maxLightCount) {
+    device = logicalDevice;
+    allocator = &memoryAllocator;
+    bindless = &bindlessSet;
+    binder = &resourceBinder;
+    maxLights = maxLightCount;
+
+    auto setLayout = bindless->layout();
+    vk::PushConstantRange pushConstantRange{
+            .stageFlags = vk::ShaderStageFlagBits::eCompute,
+            .offset = 0,
+            .size = sizeof(PushConstants),
+    };
+
+    pipelineLayout = device.createPipelineLayout({
+            .setLayoutCount = 1,
+            .pSetLayouts = &setLayout,
+            .pushConstantRangeCount = 1,
+            .pPushConstantRanges = &pushConstantRange,
+    });
+
+    auto shaderModule = device.createShaderModule({
+            .codeSize = light_cull_spv_len,
+            .pCode = reinterpret_cast<const uint32_t *>(light_cull_spv),
+    });
+
+    pipeline = device.createComputePipeline(nullptr, {
+            .flags = binder->pipelineCreateFlags(),
+            .stage = {
+                    .stage = vk::ShaderStageFlagBits::eCompute,
+                    .module = shaderModule,
+                    .pName = "main",
+            },
+            .layout = pipelineLayout,
+    }).value;
+
+    device.destroyShaderModule(shaderModule);
+
+    vk::BufferUsageFlags usage = vk::BufferUsageFlagBits::eStorageBuffer;
+    if (allocator->bufferDeviceAddress()) {
+        usage |= vk::BufferUsageFlagBits::eShaderDeviceAddress;
+    }
+
+    for (uint32_t frame = 0; frame < frameCount; frame++) {
+        lightBuffers.push_back(allocator->createBuffer(
+                vk::DeviceSize(std::max(maxLights, 1u)) * sizeof(LightData), usage,
+                vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+                vk::MemoryPropertyFlagBits::eDeviceLocal));
+        lightBufferIndices.push_back(bindless->addStorageBuffer(lightBuffers.back()));
+
+        // a count and the light indices per froxel
+        clusterBuffers.push_back(allocator->createBuffer(
+                vk::DeviceSize(ClusterCount) * (MaxLightsPerCluster + 1) * sizeof(uint32_t), usage,
+                vk::MemoryPropertyFlagBits::eDeviceLocal));
+        clusterBufferIndices.push_back(bindless->addStorageBuffer(clusterBuffers.back()));
+    }
+}
+
+void LightClusterer::destroy() {
+    for (size_t frame = 0; frame < lightBuffers.size(); frame++) {
+        bindless->removeStorageBuffer(lightBufferIndices[frame]);
+        allocator->destroyBuffer(lightBuffers[frame]);
+        bindless->removeStorageBuffer(clusterBufferIndices[frame]);
+        allocator->destroyBuffer(clusterBuffers[frame]);
+    }
+    lightBuffers.clear();
+    lightBufferIndices.clear();
+    clusterBuffers.clear();
+    clusterBufferIndices.clear();
+
+    device.destroy(pipeline);
+    device.destroy(pipelineLayout);
+}
+
+void LightClusterer::writeGridParameters(FrameData &frameData, vk::Extent2D viewport, float nearPlane, float farPlane) {
+    auto width = std::max(viewport.width, 1u);
+    auto height = std::max(viewport.height, 1u);
+
+    // slice = log(depth) * scale + bias puts slice 0 at the near and GridZ at the far plane
+    auto scale = static_cast<float>(GridZ) / std::log(farPlane / nearPlane);
+    frameData.clusterGrid[0] = static_cast<float>((width + GridX - 1) / GridX);
+    frameData.clusterGrid[1] = static_cast<float>((height + GridY - 1) / GridY);
+    frameData.clusterGrid[2] = scale;
+    frameData.clusterGrid[3] = -std::log(nearPlane) * scale;
+
+    frameData.viewport[0] = static_cast<float>(width);
+    frameData.viewport[1] = static_cast<float>(height);
+    frameData.viewport[2] = 0.0f;
+    frameData.viewport[3] = 0.0f;
+}
+
+std::span<LightData> LightClusterer::lights(uint32_t frameIndex) const {
+    return {static_cast<LightData *>(lightBuffers[frameIndex].allocation.mapped), maxLights};
+}
+
+void LightClusterer::record(vk::CommandBuffer cmdBuffer, uint32_t frameIndex, uint32_t frameDataIndex, uint32_t lightCount) {
+    PushConstants pushConstants{
+            .frameDataIndex = frameDataIndex,
+            .lightBufferIndex = lightBufferIndices[frameIndex],
+            .lightCount = std::min(lightCount, maxLights),
+            .clusterBufferIndex = clusterBufferIndices[frameIndex],
+    };
+
+    cmdBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, pipeline);
+    binder->bindGlobal(cmdBuffer, vk::PipelineBindPoint::eCompute, pipelineLayout);
+    cmdBuffer.pushConstants(pipelineLayout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(pushConstants), &pushConstants);
+    cmdBuffer.dispatch((ClusterCount + LightCullGroupSize - 1) / LightCullGroupSize, 1, 1);
+
+    vk::BufferMemoryBarrier clusterBarrier{
+            .srcAccessMask = vk::AccessFlagBits::eShaderWrite,
+            .dstAccessMask = vk::AccessFlagBits::eShaderRead,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .buffer = clusterBuffers[frameIndex].buffer,
+            .offset = 0,
+            .size = VK_WHOLE_SIZE,
+    };
+    cmdBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eFragmentShader, {},
+                              0, nullptr, 1, &clusterBarrier, 0, nullptr);
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "bindless.hpp"
+#include "memory.hpp"
+#include "resourceBinding.hpp"
+#include "sceneData.hpp"
+
+#define VULKAN_HPP_NO_CONSTRUCTORS
+#include <vulkan/vulkan.hpp>
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// Clustered forward lighting. The view frustum is divided into a grid of froxels, screen tiles split into depth
+// slices that get logarithmically deeper, and every frame a compute pass (shaders/lightCull.comp) bins the lights
+// into the froxels they touch. The fragment shader then only evaluates the lights of its own froxel, at most
+// MaxLightsPerCluster of them. The grid mirrors shaders/lighting.glsl.
+class LightClusterer {
+public:
+    static constexpr uint32_t GridX = 16;
+    static constexpr uint32_t GridY = 9;
+    static constexpr uint32_t GridZ = 24;
+    static constexpr uint32_t ClusterCount = GridX * GridY * GridZ;
+    static constexpr uint32_t MaxLightsPerCluster = 255;
+
+    void create(vk::Device device, MemoryAllocator &allocator, BindlessDescriptorSet &bindless,
+                const ResourceBinder &resourceBinder, uint32_t frameCount, uint32_t maxLights);
+    void destroy();
+
+    // Fills the grid fields of frameData for a viewport and the projection's near and far plane distances.
+    static void writeGridParameters(FrameData &frameData, vk::Extent2D viewport, float nearPlane, float farPlane);
+
+    // The frame's light buffer, persistently mapped. Must only be written after the frame's fence has been waited on.
+    [[nodiscard]] std::span<LightData> lights(uint32_t frameIndex) const;
+    [[nodiscard]] uint32_t maxLightCount() const { return maxLights; }
+    [[nodiscard]] uint32_t lightBufferIndex(uint32_t frameIndex) const { return lightBufferIndices[frameIndex]; }
+    [[nodiscard]] uint32_t clusterBufferIndex(uint32_t frameIndex) const { return clusterBufferIndices[frameIndex]; }
+
+    // Bins the first lightCount lights of the frame's light buffer. Has to be recorded outside of rendering, leaves the
+    // cluster buffer ready for the fragment shader.
+    void record(vk::CommandBuffer cmdBuffer, uint32_t frameIndex, uint32_t frameDataIndex, uint32_t lightCount);
+
+private:
+    struct PushConstants {
+        uint32_t frameDataIndex;
+        uint32_t lightBufferIndex;
+        uint32_t lightCount;
+        uint32_t clusterBufferIndex;
+    };
+
+    vk::Device device;
+    MemoryAllocator *allocator = nullptr;
+    BindlessDescriptorSet *bindless = nullptr;
+    const ResourceBinder *binder = nullptr;
+    uint32_t maxLights = 0;
+
+    vk::PipelineLayout pipelineLayout;
+    vk::Pipeline pipeline;
+    std::vector<Buffer> lightBuffers; // host visible, one per frame
+    std::vector<uint32_t> lightBufferIndices;
+    std::vector<Buffer> clusterBuffers;
+    std::vector<uint32_t> clusterBufferIndices;
+};
@@ -0,0 +1,22 @@
+#include "lodSelection.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+float lodProjectionScale(float fieldOfView, uint32_t viewportHeight) {
+    return static_cast<float>(std::max(viewportHeight, 1u)) / (2.0f * std::tan(fieldOfView * 0.5f));
+}
+
+uint32_t selectLod(std::span<const MeshLod> lods, float distance, float projectionScale, float thresholdPixels) {
+    if (distance <= 0.0f) {
+        return 0;
+    }
+
+    // the errors grow with every level, so the search can stop at the first level that is good enough
+    for (auto level = static_cast<uint32_t>(lods.size()); level-- > 1;) {
+        if (lods[level].error * projectionScale / distance <= thresholdPixels) {
+            return level;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include "meshFormat.hpp"
+
+#include <cstdint>
+#include <span>
+
+// Screen space error based level of detail selection. An object space error e seen from distance d covers
+// e * projectionScale / d pixels, with projectionScale = viewportHeight / (2 * tan(fieldOfView / 2)).
+float lodProjectionScale(float fieldOfView, uint32_t viewportHeight);
+
+// Returns the coarsest of the levels (finest first, see MeshLod) whose error projects to at most thresholdPixels.
+// distance is the distance from the camera to the closest point of the instance's bounding sphere, the finest level
+// is used when the camera is inside it.
+uint32_t selectLod(std::span<const MeshLod> lods, float distance, float projectionScale, float thresholdPixels);
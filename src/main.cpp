@@ -1,18 +1,67 @@
 #include "fragmentShader.h"
+#include "gbufferFragmentShader.h"
+#include "meshShader.h"
+#include "meshletVertexShader.h"
+#include "taskShader.h"
 #include "vertexShader.h"
+#include "bindless.hpp"
+#include "deferredLighting.hpp"
+#include "deletionQueue.hpp"
+#include "descriptorAllocator.hpp"
+#include "downsampler.hpp"
+#include "dynamicResolution.hpp"
+#include "framePacing.hpp"
+#include "gpuTimer.hpp"
+#include "jobSystem.hpp"
+#include "lightClustering.hpp"
+#include "lodSelection.hpp"
+#include "memory.hpp"
+#include "meshLoader.hpp"
+#include "meshletCulling.hpp"
+#include "multisampling.hpp"
+#include "occlusionCulling.hpp"
+#include "overlay.hpp"
+#include "presentation.hpp"
+#include "resourceBinding.hpp"
+#include "sceneData.hpp"
+#include "spscQueue.hpp"
+#include "startupGraph.hpp"
+#include "textureStreaming.hpp"
+#include "trace.hpp"
+#include "uploadBatcher.hpp"
 
 #define VULKAN_HPP_NO_CONSTRUCTORS
 #include <vulkan/vulkan.hpp>
 #include <GLFW/glfw3.h>
 
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <imgui.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cfloat>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <exception>
 #include <limits>
 #include <optional>
+#include <random>
 #include <map>
 #include <memory>
 #include <iostream>
 #include <vector>
 #include <set>
 #include <fstream>
+#include <thread>
 
 const int MAX_FRAMES_IN_FLIGHT = 2;
 
@@ -25,12 +74,98 @@ static const std::vector<const char*> deviceExtensions = {
         VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME,
 };
 
+// taken during static initialization, as close to the process start as we get
+static const auto launchTime = std::chrono::steady_clock::now();
+
 #ifdef NDEBUG
 const bool enableValidationLayers = false;
 #else
 const bool enableValidationLayers = true;
 #endif
 
+// Per-draw descriptor set bound through the ResourceBinder: one uniform buffer with the draw's constants.
+static const std::array<vk::DescriptorSetLayoutBinding, 1> drawSetBindings = {
+    vk::DescriptorSetLayoutBinding{
+        .binding = 0,
+        .descriptorType = vk::DescriptorType::eUniformBuffer,
+        .descriptorCount = 1,
+        .stageFlags = vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment,
+    },
+};
+
+// Cooked image of the triangle that is drawn when no mesh is given on the command line.
+static std::vector<std::byte> builtinTriangle() {
+    static const MeshVertex vertices[] = {
+        {.position = {0.0f, 0.5f, 0.0f}, .normal = {0.0f, 0.0f, 1.0f}, .uv = {0.5f, 0.0f}},
+        {.position = {-0.5f, -0.5f, 0.0f}, .normal = {0.0f, 0.0f, 1.0f}, .uv = {0.0f, 1.0f}},
+        {.position = {0.5f, -0.5f, 0.0f}, .normal = {0.0f, 0.0f, 1.0f}, .uv = {1.0f, 1.0f}},
+    };
+    static const uint32_t indices[] = {0, 1, 2};
+    static const Meshlet meshlets[] = {{
+        .vertexOffset = 0,
+        .triangleOffset = 0,
+        .vertexCount = 3,
+        .triangleCount = 1,
+        .center = {0.0f, 0.0f, 0.0f},
+        .radius = 0.71f,
+        .coneAxis = {0.0f, 0.0f, 1.0f},
+        .coneCutoff = 0.0f,
+    }};
+    static const uint32_t meshletVertices[] = {0, 1, 2};
+    static const uint8_t meshletTriangles[] = {0, 1, 2, 0};
+    static const MeshLod lods[] = {{.indexOffset = 0, .indexCount = 3, .meshletOffset = 0, .meshletCount = 1}};
+
+    const std::pair<const void*, uint64_t> sections[MeshSectionCount] = {
+        {vertices, sizeof(vertices)},
+        {indices, sizeof(indices)},
+        {meshlets, sizeof(meshlets)},
+        {meshletVertices, sizeof(meshletVertices)},
+        {meshletTriangles, sizeof(meshletTriangles)},
+        {lods, sizeof(lods)},
+    };
+
+    MeshFileHeader header{
+        .magic = MeshFileMagic,
+        .version = MeshFileVersion,
+        .vertexCount = 3,
+        .indexCount = 3,
+        .meshletCount = 1,
+        .lodCount = 1,
+        .boundsMin = {-0.5f, -0.5f, 0.0f},
+        .boundsMax = {0.5f, 0.5f, 0.0f},
+    };
+
+    std::vector<std::byte> image((MeshSectionCount + 1) * MeshSectionAlignment);
+    for (uint32_t section = 0; section < MeshSectionCount; section++) {
+        header.sections[section] = {.offset = (section + 1) * MeshSectionAlignment, .size = sections[section].second};
+        std::memcpy(image.data() + header.sections[section].offset, sections[section].first, sections[section].second);
+    }
+    std::memcpy(image.data(), &header, sizeof(header));
+
+    return image;
+}
+
+struct Options {
+    std::optional<BindingMode> bindingMode;
+    bool benchmarkBinding = false;
+    std::vector<std::string> texturePaths;
+    vk::DeviceSize textureBudget = 256ull * 1024 * 1024;
+    uint32_t memoryLimitPercent = 90; // soft limit of every heap, in percent of its budget
+    std::optional<std::string> meshPath;
+    std::optional<RenderPath> renderPath;
+    uint32_t instanceGrid = 1;
+    float lodThreshold = 1.0f;
+    bool occlusionCulling = true;
+    uint32_t lightCount = 1024;
+    bool deferredShading = false;
+    uint32_t msaaSamples = 1;
+    std::optional<double> frameTimeTarget; // milliseconds, enables dynamic resolution
+    bool lowLatency = false;
+    double frameRateLimit = 0.0;
+    PresentPolicy presentPolicy = PresentPolicy::TearFree;
+    std::optional<std::string> tracePath;
+};
+
 struct QueueFamilyIndices {
     std::optional<uint32_t> graphicsQueue;
     std::optional<uint32_t> presentQueue;
@@ -40,6 +175,18 @@ struct QueueFamilyIndices {
     }
 };
 
+// Input and window changes handed from the GLFW thread to the render thread.
+struct WindowEvent {
+    enum class Type {
+        Key,
+        Resize,
+    };
+
+    Type type;
+    int key = 0;
+    vk::Extent2D framebufferExtent;
+};
+
 struct SwapChainSupportDetails {
     vk::SurfaceCapabilitiesKHR capabilities;
     std::vector<vk::SurfaceFormatKHR> formats;
@@ -48,85 +195,281 @@ struct SwapChainSupportDetails {
 
 class Graphics {
 public:
-    Graphics();
+    explicit Graphics(const Options& options);
     ~Graphics();
 
     void runMainLoop();    
+    void benchmarkBindingModes();
 
 private:
     void createVulkanInstance();
     static bool checkValidationSupport();
     void pickPhysicalDevice();
     void createDevice();
+    void createMemoryAllocator();
+    void createDeletionQueue();
+    void createUploadBatcher();
     void createSurface();
-    void createSwapChain();
+    void createPresenter();
+    void createSwapChain(vk::SwapchainKHR oldSwapChain = nullptr);
     void createImageViews();
+    void createDepthResources();
+    void createMultisampleTargets();
+    void createBindlessDescriptorSet();
+    void createDescriptorAllocator();
+    void createResourceBinder();
+    void createTextureStreamer();
+    void createMipDownsampler();
+    void createMesh();
+    void createFrameData();
+    void createMeshletCuller();
+    void createOcclusionCuller();
+    void createLights();
+    void createDeferredLighting();
+    void createDynamicResolution();
+    void createOverlay();
     void createGraphicsPipeline();
     void createCommandPool();
     void createCommandBuffers();
     void createSyncObjects();
+    void createFramePacer();
+    void createGpuTimer();
     void recordCommandBuffer(vk::CommandBuffer cmdBuffer, uint32_t imageIndex);
+    void recordOcclusionCulling(vk::CommandBuffer cmdBuffer, const DrawConstants &constants, OcclusionPhase phase);
+    void recordMeshPass(vk::CommandBuffer cmdBuffer, uint32_t imageIndex, const DrawConstants &constants,
+                        vk::AttachmentLoadOp loadOp, std::optional<OcclusionPhase> occlusionPhase);
+    void recordOverlay(vk::CommandBuffer cmdBuffer, uint32_t imageIndex);
+    void buildOverlay();
     void drawFrame();
     void recreateSwapChain();
     void cleanupSwapChain();
     void cleanup();
 
+    void renderLoop();
+    void postWindowEvent(const WindowEvent &event);
+    void flushOverflowEvents();
+    void processWindowEvents();
+    static void keyCallback(GLFWwindow *window, int key, int scancode, int action, int mods);
+    static void framebufferSizeCallback(GLFWwindow *window, int width, int height);
+    void cycleSampleCount();
+    void applySampleCount();
+    void cyclePresentPolicy();
+    void applyPresentPolicy();
+
     static void cmdTransitionImageLayout(vk::CommandBuffer cmdBuffer, vk::Image image, vk::ImageLayout oldLayout, vk::ImageLayout newLayout);
+    void updateFrameData();
+    void reportGpuTime();
+    void traceGpuScopes();
+    void recordFrameTimes();
 
     unsigned physicalDeviceRating(vk::PhysicalDevice);
     QueueFamilyIndices findQueueFamilies(vk::PhysicalDevice);
     static bool checkDeviceExtensionSupport(vk::PhysicalDevice);
+    static bool checkMeshShaderSupport(vk::PhysicalDevice);
+    BindingMode chooseBindingMode() const;
+    RenderPath chooseRenderPath() const;
+    bool renderPathSupported(RenderPath path) const;
     SwapChainSupportDetails querySwapChainSupport(vk::PhysicalDevice);
     static vk::SurfaceFormatKHR chooseSwapSurfaceFormat(const std::vector<vk::SurfaceFormatKHR>& availableFormats);
-    static vk::PresentModeKHR chooseSwapPresentMode(const std::vector<vk::PresentModeKHR> &availablePresentModes);
     vk::Extent2D chooseSwapExtent(const vk::SurfaceCapabilitiesKHR& capabilities);
+    vk::Format chooseDepthFormat() const;
 
+    Options options;
     GLFWwindow* window;
+    JobSystem jobSystem;
+    // written by the GLFW thread, read by the render thread
+    SpscQueue<WindowEvent, 256> windowEvents;
+    // events that didn't fit into the queue, only touched by the GLFW thread
+    std::deque<WindowEvent> overflowEvents;
+    std::atomic<bool> renderThreadRunning = false;
+    std::exception_ptr renderThreadError;
+    // the render thread's view of the window, updated from the events
+    vk::Extent2D framebufferExtent;
+    bool framebufferResized = false;
+    bool firstFramePresented = false;
 
     vk::Instance instance;
+    vk::DispatchLoaderDynamic dispatcher;
     vk::PhysicalDevice physicalDevice;
     vk::Device device;
+    MemoryAllocator memoryAllocator;
+    DeletionQueue deletionQueue;
+    UploadBatcher uploadBatcher;
+    std::vector<BindingMode> supportedBindingModes;
+    BindingMode bindingMode = BindingMode::DescriptorSet;
+    std::vector<RenderPath> supportedRenderPaths;
+    RenderPath renderPath = RenderPath::Vertex;
     vk::Queue graphicsQueue;
     vk::Queue presentQueue;
     vk::SurfaceKHR surface;
+    bool surfaceMaintenanceSupported = false;
+    bool swapchainMaintenanceSupported = false;
+    Presenter presenter;
+    PresentPolicy presentPolicy = PresentPolicy::TearFree;
+    PresentPolicy requestedPresentPolicy = PresentPolicy::TearFree;
     vk::SwapchainKHR swapChain;
     std::vector<vk::Image> swapChainImages;
     std::vector<vk::ImageView> swapChainImageViews;
     vk::Format swapChainImageFormat;
     vk::Extent2D swapChainExtent;
+    // the part of the render targets the current frame renders to, smaller than the swap chain with dynamic resolution
+    vk::Extent2D renderExtent;
+    vk::Format depthFormat;
+    Image depthImage;
+    vk::ImageView depthImageView;
+    vk::SampleCountFlagBits sampleCount = vk::SampleCountFlagBits::e1;
+    // set by the M key, applied at the start of the next frame
+    vk::SampleCountFlagBits requestedSampleCount = vk::SampleCountFlagBits::e1;
+    MultisampleTargets multisampleTargets;
+    BindlessDescriptorSet bindlessDescriptorSet;
+    DescriptorAllocator frameDescriptorAllocator;
+    ResourceBinder resourceBinder;
+    vk::Sampler defaultSampler;
+    uint32_t defaultSamplerIndex = 0;
+    TextureStreamer textureStreamer;
+    MipDownsampler mipDownsampler;
+    std::vector<TextureHandle> textures;
+    MeshLoader meshLoader;
+    Mesh mesh;
+    std::array<uint32_t, MeshSectionCount> meshSectionIndices = {};
+    std::vector<Buffer> frameDataBuffers;
+    std::vector<uint32_t> frameDataIndices;
+    std::vector<glm::vec3> instanceOffsets;
+    std::vector<Buffer> instanceBuffers;
+    std::vector<uint32_t> instanceBufferIndices;
+    std::vector<uint32_t> instanceLods; // level selected for every instance in the current frame
+    std::vector<float> instanceFootprints; // diameter of every instance's bounding sphere on screen, in pixels
+    uint64_t selectedTriangles = 0;     // summed over the frames since the last report
+    uint64_t selectedFrames = 0;
+    MeshletCuller meshletCuller;
+    bool occlusionCulling = false;
+    OcclusionCuller occlusionCuller;
+    LightClusterer lightClusterer;
+    bool deferredShading = false;
+    bool deferredLocalRead = false;
+    DeferredLighting deferredLighting;
+    bool dynamicResolutionEnabled = false;
+    DynamicResolution dynamicResolution;
+    Overlay overlay;
+    bool overlayVisible = false;
+    // CPU frame intervals and GPU frame times in milliseconds, a ring the overlay plots
+    static constexpr uint32_t FrameTimeHistory = 120;
+    std::array<float, FrameTimeHistory> cpuFrameTimes = {};
+    std::array<float, FrameTimeHistory> gpuFrameTimes = {};
+    uint32_t frameTimeOffset = 0;
+    std::chrono::steady_clock::time_point lastFrameStart = std::chrono::steady_clock::now();
+    // what the last frame recorded, shown by the overlay
+    uint64_t frameTriangles = 0;
+    uint32_t recordedDraws = 0;
+    uint32_t recordedPipelineBinds = 0;
+    double overlayCpuMilliseconds = 0.0;
+    // upload rates over the last report interval
+    double uploadMegabytesPerSecond = 0.0;
+    double uploadSubmitsPerFrame = 0.0;
+    UploadBatcher::Statistics reportedUploads;
+    std::vector<LightData> lights;       // where every light starts
+    std::vector<glm::vec3> lightOrbits; // radius, angular velocity and phase of every light's circle around its start
+    std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+    vk::ShaderStageFlags drawConstantStages;
     vk::PipelineLayout pipelineLayout;
     vk::Pipeline graphicsPipeline;
+    vk::Pipeline meshletPipeline;
+    vk::Pipeline meshShaderPipeline;
     vk::CommandPool commandPool;
     std::vector<vk::CommandBuffer> commandBuffers;
     std::vector<vk::Semaphore> imageAvailableSemaphores;
     std::vector<vk::Semaphore> renderFinishedSemaphores;
     std::vector<vk::Fence> inFlightFences;
+    GpuTimer gpuTimer;
+    bool presentWaitSupported = false;
+    bool calibratedTimestampsSupported = false;
+    bool memoryBudgetSupported = false;
+    FramePacer framePacer;
+    std::chrono::steady_clock::time_point lastTimingReport = std::chrono::steady_clock::now();
     uint32_t currentFrame = 0;
 
 };
 
-Graphics::Graphics() {
+Graphics::Graphics(const Options& options) : options(options) {
+    if (options.tracePath) {
+#ifdef ENABLE_TRACING
+        Tracer::start(*options.tracePath);
+#else
+        std::cerr << "tracing is compiled out, configure with -DTRACING=ON to use --trace\n";
+#endif
+    }
+    TRACE_THREAD_NAME("main");
+
+    jobSystem.create(JobSystem::defaultWorkerCount());
     glfwInit();
 
     glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
     glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
     window = glfwCreateWindow(1024, 768, "vulkan test", nullptr, nullptr);
-
-    try {
-        createVulkanInstance();
-        createSurface();
-        pickPhysicalDevice();
-        createDevice();
+    glfwSetWindowUserPointer(window, this);
+    glfwSetKeyCallback(window, keyCallback);
+    glfwSetFramebufferSizeCallback(window, framebufferSizeCallback);
+
+    int width, height;
+    glfwGetFramebufferSize(window, &width, &height);
+    framebufferExtent = vk::Extent2D{static_cast<uint32_t>(width), static_cast<uint32_t>(height)};
+
+    // Initialization runs as a graph on the job system, steps that don't depend on each other run concurrently. The
+    // steps that register with the bindless set or submit to the graphics queue form one chain, neither of the two
+    // can be used from several threads at once. Steps that read occlusionCulling wait for the depth buffer, which
+    // turns it off without a depth pyramid format.
+    StartupGraph startup;
+    auto instanceStep = startup.add("instance", [this] { createVulkanInstance(); });
+    auto surfaceStep = startup.add("surface", [this] { createSurface(); }, {instanceStep});
+    auto physicalDeviceStep = startup.add("physical device", [this] { pickPhysicalDevice(); }, {surfaceStep});
+    auto deviceStep = startup.add("device", [this] { createDevice(); }, {physicalDeviceStep});
+    auto allocatorStep = startup.add("memory allocator", [this] { createMemoryAllocator(); }, {deviceStep});
+    startup.add("deletion queue", [this] { createDeletionQueue(); }, {allocatorStep});
+    auto uploadStep = startup.add("upload batcher", [this] { createUploadBatcher(); }, {allocatorStep});
+    auto presenterStep = startup.add("presenter", [this] { createPresenter(); }, {deviceStep});
+    auto swapChainStep = startup.add("swap chain", [this] {
         createSwapChain();
         createImageViews();
-        createGraphicsPipeline();
+    }, {presenterStep});
+    auto depthStep = startup.add("depth buffer", [this] { createDepthResources(); }, {swapChainStep, allocatorStep});
+    startup.add("multisample targets", [this] { createMultisampleTargets(); }, {depthStep});
+    auto bindlessStep = startup.add("bindless set", [this] { createBindlessDescriptorSet(); }, {allocatorStep});
+    auto descriptorStep = startup.add("descriptor allocator", [this] { createDescriptorAllocator(); }, {deviceStep});
+    auto binderStep = startup.add("resource binder", [this] { createResourceBinder(); },
+                                  {bindlessStep, descriptorStep});
+    auto downsamplerStep = startup.add("mip downsampler", [this] { createMipDownsampler(); },
+                                       {allocatorStep, descriptorStep});
+    auto texturesStep = startup.add("texture streamer", [this] { createTextureStreamer(); },
+                                    {binderStep, uploadStep, downsamplerStep});
+    auto meshStep = startup.add("mesh", [this] { createMesh(); }, {texturesStep});
+    auto lightingStep = startup.add("deferred lighting", [this] { createDeferredLighting(); },
+                                    {meshStep, depthStep});
+    auto frameDataStep = startup.add("frame data", [this] { createFrameData(); }, {lightingStep});
+    auto meshletStep = startup.add("meshlet culler", [this] { createMeshletCuller(); }, {frameDataStep});
+    auto occlusionStep = startup.add("occlusion culler", [this] { createOcclusionCuller(); },
+                                     {meshletStep, depthStep, downsamplerStep});
+    auto lightsStep = startup.add("lights", [this] { createLights(); }, {occlusionStep});
+    auto resolutionStep = startup.add("dynamic resolution", [this] { createDynamicResolution(); },
+                                      {lightsStep, swapChainStep});
+    startup.add("pipelines", [this] { createGraphicsPipeline(); }, {meshStep, lightingStep, binderStep, depthStep});
+    startup.add("command buffers", [this] {
         createCommandPool();
         createCommandBuffers();
+    }, {deviceStep});
+    startup.add("sync objects", [this] {
         createSyncObjects();
+        createFramePacer();
+    }, {deviceStep});
+    startup.add("overlay", [this] { createOverlay(); }, {resolutionStep});
+    startup.add("gpu timer", [this] { createGpuTimer(); }, {resolutionStep});
+
+    try {
+        startup.run(jobSystem);
     } catch (std::exception const &e) {
         std::cerr << "something went wrong while initializing vulkan\n"
             << e.what() << std::endl; 
     }
+    startup.report(std::cout);
 }
 
 #pragma clang diagnostic push
@@ -145,12 +488,21 @@ void Graphics::createVulkanInstance() {
     };
 
     uint32_t count;
-    auto extensions = glfwGetRequiredInstanceExtensions(&count);
+    auto glfwExtensions = glfwGetRequiredInstanceExtensions(&count);
+    std::vector<const char*> extensions(glfwExtensions, glfwExtensions + count);
+
+    // the present mode compatibility queries of swapchain maintenance go through the surface maintenance extension
+    surfaceMaintenanceSupported = Presenter::checkInstanceSupport();
+    if (surfaceMaintenanceSupported) {
+        for (auto extension : Presenter::requiredInstanceExtensions()) {
+            extensions.push_back(extension);
+        }
+    }
 
     vk::InstanceCreateInfo createInfo {
         .pApplicationInfo = &appInfo,
-        .enabledExtensionCount = count,
-        .ppEnabledExtensionNames = extensions
+        .enabledExtensionCount = static_cast<uint32_t>(extensions.size()),
+        .ppEnabledExtensionNames = extensions.data()
     };
 
     if (enableValidationLayers) {
@@ -159,6 +511,7 @@ void Graphics::createVulkanInstance() {
     }
 
     instance = vk::createInstance(createInfo);
+    dispatcher.init(instance, vkGetInstanceProcAddr);
 }
 #pragma clang diagnostic pop
 
@@ -215,6 +568,10 @@ unsigned Graphics::physicalDeviceRating(vk::PhysicalDevice physDevice) {
         score = 0;
     }
 
+    if (!BindlessDescriptorSet::checkSupport(physDevice) || !MipDownsampler::checkSupport(physDevice)) {
+        score = 0;
+    }
+
     if (extensionsSupported) {
         auto swapChainSupport = querySwapChainSupport(physDevice);
         if (swapChainSupport.formats.empty() || swapChainSupport.presentModes.empty()) {
@@ -261,13 +618,95 @@ QueueFamilyIndices Graphics::findQueueFamilies(vk::PhysicalDevice physDevice) {
     return indices;
 }
 
+// The calling thread only pumps GLFW events and hands them to a render thread, so dragging the window or a burst of
+// events doesn't stall rendering and waiting for fences doesn't delay event handling. After initialization every
+// Vulkan call happens on the render thread.
 void Graphics::runMainLoop() {
-    while (!glfwWindowShouldClose(window)) {
-        glfwPollEvents();
-        drawFrame();
+    renderThreadRunning = true;
+    std::thread renderThread(&Graphics::renderLoop, this);
+
+    while (!glfwWindowShouldClose(window) && renderThreadRunning.load(std::memory_order_acquire)) {
+        // the timeout retries events that didn't fit into the queue
+        glfwWaitEventsTimeout(0.01);
+        flushOverflowEvents();
     }
 
-    device.waitIdle();
+    renderThreadRunning.store(false, std::memory_order_release);
+    renderThread.join();
+    if (renderThreadError) {
+        std::rethrow_exception(renderThreadError);
+    }
+}
+
+void Graphics::renderLoop() {
+    TRACE_THREAD_NAME("render");
+    try {
+        while (renderThreadRunning.load(std::memory_order_acquire)) {
+            {
+                TRACE_ZONE("frame pacing");
+                // in low latency mode a frame only starts once the previous one is on screen, and input is sampled
+                // after that
+                framePacer.waitForDisplay(swapChain);
+                if (options.lowLatency && !framePacer.presentWaitEnabled()) {
+                    auto previousFrame = (currentFrame + MAX_FRAMES_IN_FLIGHT - 1) % MAX_FRAMES_IN_FLIGHT;
+                    if (device.waitForFences(1, &inFlightFences[previousFrame], VK_TRUE, UINT64_MAX) !=
+                        vk::Result::eSuccess) {
+                        throw std::runtime_error("could not wait for fences");
+                    }
+                }
+                framePacer.limitFrameRate();
+            }
+
+            processWindowEvents();
+            if (framebufferExtent.width == 0 || framebufferExtent.height == 0) {
+                // minimized, there is nothing to present to until the window is restored
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                continue;
+            }
+            drawFrame();
+        }
+
+        device.waitIdle();
+    } catch (...) {
+        renderThreadError = std::current_exception();
+    }
+
+    // wakes the GLFW thread up in case the render thread stopped on its own
+    renderThreadRunning.store(false, std::memory_order_release);
+    glfwPostEmptyEvent();
+}
+
+void Graphics::postWindowEvent(const WindowEvent &event) {
+    // once an event had to wait, the later ones queue up behind it to keep their order
+    if (!overflowEvents.empty() || !windowEvents.push(event)) {
+        overflowEvents.push_back(event);
+    }
+}
+
+void Graphics::flushOverflowEvents() {
+    while (!overflowEvents.empty() && windowEvents.push(overflowEvents.front())) {
+        overflowEvents.pop_front();
+    }
+}
+
+void Graphics::processWindowEvents() {
+    while (auto event = windowEvents.pop()) {
+        switch (event->type) {
+            case WindowEvent::Type::Key:
+                if (event->key == GLFW_KEY_M) {
+                    cycleSampleCount();
+                } else if (event->key == GLFW_KEY_P) {
+                    cyclePresentPolicy();
+                } else if (event->key == GLFW_KEY_H) {
+                    overlayVisible = !overlayVisible;
+                }
+                break;
+            case WindowEvent::Type::Resize:
+                framebufferExtent = event->framebufferExtent;
+                framebufferResized = true;
+                break;
+        }
+    }
 }
 
 Graphics::~Graphics() {
@@ -290,26 +729,205 @@ void Graphics::createDevice() {
         });
     }
 
+    auto descriptorIndexingFeatures = BindlessDescriptorSet::requiredFeatures();
+
     vk::PhysicalDeviceDynamicRenderingFeatures dynamicRenderingFeature{
+        .pNext = &descriptorIndexingFeatures,
         .dynamicRendering = VK_TRUE
     };
 
+    // the frame submits signal the deletion queue's timeline
+    auto timelineSemaphoreFeature = DeletionQueue::requiredFeatures();
+    timelineSemaphoreFeature.pNext = &dynamicRenderingFeature;
+
     vk::PhysicalDeviceFeatures deviceFeatures{};
+    MipDownsampler::enableRequiredFeatures(deviceFeatures);
+
+    void* featureChain = &timelineSemaphoreFeature;
+    auto appendFeature = [&featureChain](auto& feature) {
+        feature.pNext = featureChain;
+        featureChain = &feature;
+    };
+
+    std::vector<const char*> enabledExtensions(deviceExtensions.begin(), deviceExtensions.end());
+
+    // every binding mode the device supports is enabled so they can be compared against each other
+    supportedBindingModes.clear();
+    for (auto mode : {BindingMode::DescriptorSet, BindingMode::PushDescriptor, BindingMode::DescriptorBuffer}) {
+        if (ResourceBinder::checkSupport(physicalDevice, mode)) {
+            supportedBindingModes.push_back(mode);
+            if (auto extension = ResourceBinder::requiredExtension(mode)) {
+                enabledExtensions.push_back(extension);
+            }
+        }
+    }
+
+    bool descriptorBufferSupported = std::find(supportedBindingModes.begin(), supportedBindingModes.end(),
+                                               BindingMode::DescriptorBuffer) != supportedBindingModes.end();
+
+    vk::PhysicalDeviceBufferDeviceAddressFeatures bufferDeviceAddressFeature{
+        .bufferDeviceAddress = VK_TRUE
+    };
+    vk::PhysicalDeviceDescriptorBufferFeaturesEXT descriptorBufferFeature{
+        .descriptorBuffer = VK_TRUE
+    };
+    if (descriptorBufferSupported) {
+        appendFeature(bufferDeviceAddressFeature);
+        appendFeature(descriptorBufferFeature);
+    }
+
+    // like the binding modes, every supported render path is enabled so they can be switched between
+    supportedRenderPaths = {RenderPath::Vertex};
+    if (MeshletCuller::checkSupport(physicalDevice)) {
+        supportedRenderPaths.push_back(RenderPath::ComputeIndirect);
+        MeshletCuller::enableRequiredFeatures(deviceFeatures);
+        enabledExtensions.push_back(MeshletCuller::requiredExtension());
+    }
+
+    vk::PhysicalDeviceMeshShaderFeaturesEXT meshShaderFeature{
+        .taskShader = VK_TRUE,
+        .meshShader = VK_TRUE,
+    };
+    if (checkMeshShaderSupport(physicalDevice)) {
+        supportedRenderPaths.push_back(RenderPath::MeshShader);
+        appendFeature(meshShaderFeature);
+        enabledExtensions.push_back(VK_EXT_MESH_SHADER_EXTENSION_NAME);
+    }
+
+    vk::PhysicalDeviceDynamicRenderingLocalReadFeaturesKHR localReadFeature{
+        .dynamicRenderingLocalRead = VK_TRUE,
+    };
+    bool localReadSupported = options.deferredShading && DeferredLighting::checkLocalReadSupport(physicalDevice);
+    if (localReadSupported) {
+        appendFeature(localReadFeature);
+        enabledExtensions.push_back(DeferredLighting::localReadExtension());
+    }
+
+    vk::PhysicalDevicePresentIdFeaturesKHR presentIdFeature{
+        .presentId = VK_TRUE,
+    };
+    vk::PhysicalDevicePresentWaitFeaturesKHR presentWaitFeature{
+        .presentWait = VK_TRUE,
+    };
+    // enabled whenever available so the presentation queue can be measured outside of low latency mode as well
+    presentWaitSupported = FramePacer::checkSupport(physicalDevice);
+    if (presentWaitSupported) {
+        appendFeature(presentIdFeature);
+        appendFeature(presentWaitFeature);
+        for (auto extension : FramePacer::requiredExtensions()) {
+            enabledExtensions.push_back(extension);
+        }
+    }
+
+    vk::PhysicalDeviceSwapchainMaintenance1FeaturesEXT swapchainMaintenanceFeature{
+        .swapchainMaintenance1 = VK_TRUE,
+    };
+    swapchainMaintenanceSupported = surfaceMaintenanceSupported && Presenter::checkSupport(physicalDevice);
+    if (swapchainMaintenanceSupported) {
+        appendFeature(swapchainMaintenanceFeature);
+        enabledExtensions.push_back(Presenter::requiredExtension());
+    }
+
+    // puts GPU scopes on the CPU timeline of traces
+    calibratedTimestampsSupported = GpuTimer::checkCalibrationSupport(physicalDevice, dispatcher);
+    if (calibratedTimestampsSupported) {
+        enabledExtensions.push_back(GpuTimer::calibrationExtension());
+    }
+
+    // lets the allocator see what other processes leave of video memory
+    memoryBudgetSupported = MemoryAllocator::checkBudgetSupport(physicalDevice);
+    if (memoryBudgetSupported) {
+        enabledExtensions.push_back(MemoryAllocator::budgetExtension());
+    }
 
     auto createInfo = vk::DeviceCreateInfo {
-        .pNext = &dynamicRenderingFeature,
+        .pNext = featureChain,
         .queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size()),
         .pQueueCreateInfos = queueCreateInfos.data(),
-        .enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size()),
-        .ppEnabledExtensionNames = deviceExtensions.data(),
+        .enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size()),
+        .ppEnabledExtensionNames = enabledExtensions.data(),
         .pEnabledFeatures = &deviceFeatures,
     };
 
     device = physicalDevice.createDevice(createInfo);
+    dispatcher.init(device);
+    bindingMode = chooseBindingMode();
+    renderPath = chooseRenderPath();
+    // the instance lists are drawn with drawIndexedIndirectCount, which comes with the compute path's features
+    occlusionCulling = options.occlusionCulling && renderPathSupported(RenderPath::ComputeIndirect);
+    // the input attachment set can't be bound next to descriptor buffers, the lighting samples the G-buffer instead
+    deferredShading = options.deferredShading;
+    deferredLocalRead = localReadSupported && bindingMode != BindingMode::DescriptorBuffer;
+    // a multisampled G-buffer would need per sample lighting, MSAA is a forward shading feature
+    if (deferredShading && options.msaaSamples > 1) {
+        std::cerr << "MSAA is not supported with deferred shading\n";
+    }
+    sampleCount = deferredShading ? vk::SampleCountFlagBits::e1
+                                  : MultisampleTargets::supportedSampleCount(physicalDevice, options.msaaSamples);
+    requestedSampleCount = sampleCount;
+
     graphicsQueue = device.getQueue(indices.graphicsQueue.value(), 0);
     presentQueue = device.getQueue(indices.presentQueue.value(), 0);
 }
 
+BindingMode Graphics::chooseBindingMode() const {
+    auto supported = [this](BindingMode mode) {
+        return std::find(supportedBindingModes.begin(), supportedBindingModes.end(), mode) != supportedBindingModes.end();
+    };
+
+    if (options.bindingMode) {
+        if (supported(*options.bindingMode)) {
+            return *options.bindingMode;
+        }
+        std::cerr << bindingModeName(*options.bindingMode) << " binding is not supported, falling back\n";
+    }
+
+    for (auto mode : {BindingMode::DescriptorBuffer, BindingMode::PushDescriptor}) {
+        if (supported(mode)) {
+            return mode;
+        }
+    }
+
+    return BindingMode::DescriptorSet;
+}
+
+bool Graphics::renderPathSupported(RenderPath path) const {
+    return std::find(supportedRenderPaths.begin(), supportedRenderPaths.end(), path) != supportedRenderPaths.end();
+}
+
+RenderPath Graphics::chooseRenderPath() const {
+    if (options.renderPath) {
+        if (renderPathSupported(*options.renderPath)) {
+            return *options.renderPath;
+        }
+        std::cerr << renderPathName(*options.renderPath) << " rendering is not supported, falling back\n";
+    }
+
+    for (auto path : {RenderPath::MeshShader, RenderPath::ComputeIndirect}) {
+        if (renderPathSupported(path)) {
+            return path;
+        }
+    }
+
+    return RenderPath::Vertex;
+}
+
+void Graphics::createMemoryAllocator() {
+    bool bufferDeviceAddress = std::find(supportedBindingModes.begin(), supportedBindingModes.end(),
+                                         BindingMode::DescriptorBuffer) != supportedBindingModes.end();
+    memoryAllocator.create(physicalDevice, device, bufferDeviceAddress, memoryBudgetSupported,
+                           options.memoryLimitPercent);
+}
+
+void Graphics::createDeletionQueue() {
+    deletionQueue.create(device, memoryAllocator);
+}
+
+void Graphics::createUploadBatcher() {
+    auto indices = findQueueFamilies(physicalDevice);
+    uploadBatcher.create(device, memoryAllocator, graphicsQueue, indices.graphicsQueue.value());
+}
+
 void Graphics::createSurface() {
     VkSurfaceKHR windowSurface;
     if (glfwCreateWindowSurface(instance, window, nullptr, &windowSurface) != VK_SUCCESS) {
@@ -329,6 +947,20 @@ bool Graphics::checkDeviceExtensionSupport(vk::PhysicalDevice physDevice) {
     return requiredExtensions.empty();
 }
 
+bool Graphics::checkMeshShaderSupport(vk::PhysicalDevice physDevice) {
+    auto availableExtensions = physDevice.enumerateDeviceExtensionProperties();
+    auto extensionSupported = std::any_of(availableExtensions.begin(), availableExtensions.end(), [](const auto& extension) {
+        return strcmp(extension.extensionName, VK_EXT_MESH_SHADER_EXTENSION_NAME) == 0;
+    });
+    if (!extensionSupported) {
+        return false;
+    }
+
+    auto features = physDevice.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceMeshShaderFeaturesEXT>();
+    auto meshShaderFeatures = features.get<vk::PhysicalDeviceMeshShaderFeaturesEXT>();
+    return meshShaderFeatures.taskShader && meshShaderFeatures.meshShader;
+}
+
 SwapChainSupportDetails Graphics::querySwapChainSupport(vk::PhysicalDevice physDevice) {
     SwapChainSupportDetails details;
 
@@ -350,27 +982,12 @@ vk::SurfaceFormatKHR Graphics::chooseSwapSurfaceFormat(const std::vector<vk::Sur
     return availableFormats[0];
 }
 
-vk::PresentModeKHR Graphics::chooseSwapPresentMode(const std::vector<vk::PresentModeKHR> &availablePresentModes) {
-    for (const auto& availablePresentMode : availablePresentModes) {
-        if (availablePresentMode == vk::PresentModeKHR::eMailbox) {
-            return availablePresentMode;
-        }
-    }
-
-    return vk::PresentModeKHR::eFifo;
-}
-
 vk::Extent2D Graphics::chooseSwapExtent(const vk::SurfaceCapabilitiesKHR &capabilities) {
     if (capabilities.currentExtent.width != std::numeric_limits<uint32_t>::max()) {
         return capabilities.currentExtent;
     } else {
-        int width, height;
-        glfwGetFramebufferSize(window, &width, &height);
-
-        vk::Extent2D actualExtent = {
-                static_cast<uint32_t>(width),
-                static_cast<uint32_t>(height)
-        };
+        // GLFW may only be asked from its own thread, the render thread goes by the last resize event
+        vk::Extent2D actualExtent = framebufferExtent;
 
         actualExtent.width  = std::clamp(actualExtent.width, capabilities.minImageExtent.width, capabilities.maxImageExtent.width);
         actualExtent.height  = std::clamp(actualExtent.height, capabilities.minImageExtent.height, capabilities.maxImageExtent.height);
@@ -379,11 +996,16 @@ vk::Extent2D Graphics::chooseSwapExtent(const vk::SurfaceCapabilitiesKHR &capabi
     }
 }
 
-void Graphics::createSwapChain() {
+void Graphics::createPresenter() {
+    presenter.create(physicalDevice, device, dispatcher, swapchainMaintenanceSupported, MAX_FRAMES_IN_FLIGHT);
+    presentPolicy = options.presentPolicy;
+    requestedPresentPolicy = presentPolicy;
+}
+
+void Graphics::createSwapChain(vk::SwapchainKHR oldSwapChain) {
     auto swapChainSupport = querySwapChainSupport(physicalDevice);
 
     auto surfaceFormat = chooseSwapSurfaceFormat(swapChainSupport.formats);
-    auto presentMode = chooseSwapPresentMode(swapChainSupport.presentModes);
     auto extent = chooseSwapExtent(swapChainSupport.capabilities);
 
     uint32_t imageCount = swapChainSupport.capabilities.minImageCount + 1;
@@ -402,10 +1024,10 @@ void Graphics::createSwapChain() {
         .imageUsage = vk::ImageUsageFlagBits::eColorAttachment,
         .preTransform = swapChainSupport.capabilities.currentTransform,
         .compositeAlpha = vk::CompositeAlphaFlagBitsKHR::eOpaque,
-        .presentMode = presentMode,
         .clipped = VK_TRUE,
-        .oldSwapchain = nullptr
+        .oldSwapchain = oldSwapChain
     };
+    presenter.prepareSwapchain(surface, swapChainSupport.presentModes, presentPolicy, createInfo);
 
     auto indices = findQueueFamilies(physicalDevice);
     uint32_t queueFamilyIndices[] = {indices.graphicsQueue.value(), indices.presentQueue.value()};
@@ -452,6 +1074,277 @@ void Graphics::createImageViews() {
     }
 }
 
+vk::Format Graphics::chooseDepthFormat() const {
+    // the spec guarantees depth attachment support for one of these
+    for (auto format : {vk::Format::eD32Sfloat, vk::Format::eX8D24UnormPack32}) {
+        auto properties = physicalDevice.getFormatProperties(format);
+        if (properties.optimalTilingFeatures & vk::FormatFeatureFlagBits::eDepthStencilAttachment) {
+            return format;
+        }
+    }
+
+    throw std::runtime_error("could not find a depth format");
+}
+
+void Graphics::createDepthResources() {
+    depthFormat = chooseDepthFormat();
+
+    vk::ImageUsageFlags depthUsage = vk::ImageUsageFlagBits::eDepthStencilAttachment;
+    if (occlusionCulling) {
+        // the occlusion culler reduces the depth buffer into its pyramid
+        auto properties = physicalDevice.getFormatProperties(depthFormat);
+        if (properties.optimalTilingFeatures & vk::FormatFeatureFlagBits::eSampledImage) {
+            depthUsage |= vk::ImageUsageFlagBits::eSampled;
+        } else {
+            std::cerr << "the depth format can not be sampled, occlusion culling is disabled\n";
+            occlusionCulling = false;
+        }
+    }
+    if (deferredShading) {
+        // the lighting pass reconstructs positions from the depth buffer
+        depthUsage |= DeferredLighting::depthUsage(deferredLocalRead);
+    }
+
+    depthImage = memoryAllocator.createImage({
+            .imageType = vk::ImageType::e2D,
+            .format = depthFormat,
+            .extent = {
+                    .width = swapChainExtent.width,
+                    .height = swapChainExtent.height,
+                    .depth = 1,
+            },
+            .mipLevels = 1,
+            .arrayLayers = 1,
+            .samples = vk::SampleCountFlagBits::e1,
+            .tiling = vk::ImageTiling::eOptimal,
+            .usage = depthUsage,
+            .sharingMode = vk::SharingMode::eExclusive,
+            .initialLayout = vk::ImageLayout::eUndefined,
+    }, vk::MemoryPropertyFlagBits::eDeviceLocal);
+
+    depthImageView = device.createImageView({
+            .image = depthImage.image,
+            .viewType = vk::ImageViewType::e2D,
+            .format = depthFormat,
+            .subresourceRange = {
+                    .aspectMask = vk::ImageAspectFlagBits::eDepth,
+                    .baseMipLevel = 0,
+                    .levelCount = 1,
+                    .baseArrayLayer = 0,
+                    .layerCount = 1,
+            },
+    });
+}
+
+void Graphics::createMultisampleTargets() {
+    if (sampleCount == vk::SampleCountFlagBits::e1) {
+        return;
+    }
+
+    // with occlusion culling the second pass loads what the first one stored, so the attachments can't stay transient
+    multisampleTargets.create(physicalDevice, device, memoryAllocator, sampleCount, swapChainImageFormat, depthFormat,
+                              swapChainExtent, !occlusionCulling);
+}
+
+void Graphics::createBindlessDescriptorSet() {
+    bindlessDescriptorSet.create(physicalDevice, device, memoryAllocator, dispatcher,
+                                 bindingMode == BindingMode::DescriptorBuffer);
+}
+
+void Graphics::createDescriptorAllocator() {
+    frameDescriptorAllocator.create(device, MAX_FRAMES_IN_FLIGHT);
+}
+
+void Graphics::createResourceBinder() {
+    resourceBinder.create(physicalDevice, device, memoryAllocator, frameDescriptorAllocator, dispatcher,
+                          bindingMode, drawSetBindings, &bindlessDescriptorSet, MAX_FRAMES_IN_FLIGHT);
+}
+
+void Graphics::createTextureStreamer() {
+    defaultSampler = device.createSampler({
+            .magFilter = vk::Filter::eLinear,
+            .minFilter = vk::Filter::eLinear,
+            .mipmapMode = vk::SamplerMipmapMode::eLinear,
+            .addressModeU = vk::SamplerAddressMode::eRepeat,
+            .addressModeV = vk::SamplerAddressMode::eRepeat,
+            .addressModeW = vk::SamplerAddressMode::eRepeat,
+            .maxLod = VK_LOD_CLAMP_NONE,
+    });
+    defaultSamplerIndex = bindlessDescriptorSet.addSampler(defaultSampler);
+
+    auto indices = findQueueFamilies(physicalDevice);
+    textureStreamer.create(device, memoryAllocator, bindlessDescriptorSet, uploadBatcher, mipDownsampler,
+                           graphicsQueue, indices.graphicsQueue.value(), options.textureBudget);
+
+    for (const auto& path : options.texturePaths) {
+        textures.push_back(textureStreamer.load(path));
+    }
+}
+
+void Graphics::createMipDownsampler() {
+    mipDownsampler.create(device, memoryAllocator, frameDescriptorAllocator);
+}
+
+void Graphics::createMesh() {
+    meshLoader.create(device, memoryAllocator, uploadBatcher);
+
+    if (options.meshPath) {
+        auto start = std::chrono::steady_clock::now();
+        mesh = meshLoader.load(*options.meshPath);
+        auto milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        std::cout << "loaded " << *options.meshPath << ": " << mesh.lods[0].indexCount / 3 << " triangles, "
+                  << mesh.buffer.size / (1024.0 * 1024.0) << " MB in " << milliseconds << " ms, "
+                  << mesh.sectionSize(MeshSectionVertices) / (1024.0 * 1024.0) << " MB of "
+                  << meshVertexFormatName(mesh.header.vertexFormat) << " vertices ("
+                  << mesh.header.vertexCount * meshVertexSize(MeshVertexFormatFloat) / (1024.0 * 1024.0)
+                  << " MB as float), " << mesh.lods.size() << " levels of detail\n";
+    } else {
+        auto triangle = builtinTriangle();
+        mesh = meshLoader.upload(triangle.data(), triangle.size(), "builtin triangle");
+    }
+
+    // every section is visible to the shaders, the meshlet paths pull all of their data from the bindless set
+    for (uint32_t section = 0; section < MeshSectionCount; section++) {
+        meshSectionIndices[section] = bindlessDescriptorSet.addStorageBuffer(
+                mesh.buffer, mesh.sectionOffset(static_cast<MeshSection>(section)),
+                mesh.sectionSize(static_cast<MeshSection>(section)));
+    }
+}
+
+void Graphics::createFrameData() {
+    vk::BufferUsageFlags usage = vk::BufferUsageFlagBits::eStorageBuffer;
+    if (memoryAllocator.bufferDeviceAddress()) {
+        usage |= vk::BufferUsageFlagBits::eShaderDeviceAddress;
+    }
+
+    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        frameDataBuffers.push_back(memoryAllocator.createBuffer(
+                sizeof(FrameData), usage,
+                vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+                vk::MemoryPropertyFlagBits::eDeviceLocal));
+        frameDataIndices.push_back(bindlessDescriptorSet.addStorageBuffer(frameDataBuffers.back()));
+    }
+
+    // the instances form a square grid in the xz plane with some space between the mesh bounds
+    auto extent = glm::make_vec3(mesh.header.boundsMax) - glm::make_vec3(mesh.header.boundsMin);
+    auto spacing = std::max(std::max(extent.x, extent.z), 0.001f) * 1.5f;
+    auto grid = options.instanceGrid;
+    for (uint32_t z = 0; z < grid; z++) {
+        for (uint32_t x = 0; x < grid; x++) {
+            instanceOffsets.emplace_back((static_cast<float>(x) - static_cast<float>(grid - 1) * 0.5f) * spacing, 0.0f,
+                                         (static_cast<float>(z) - static_cast<float>(grid - 1) * 0.5f) * spacing);
+        }
+    }
+    instanceLods.resize(instanceOffsets.size(), 0);
+    instanceFootprints.resize(instanceOffsets.size(), 0.0f);
+
+    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        instanceBuffers.push_back(memoryAllocator.createBuffer(
+                instanceOffsets.size() * sizeof(InstanceData), usage,
+                vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+                vk::MemoryPropertyFlagBits::eDeviceLocal));
+        instanceBufferIndices.push_back(bindlessDescriptorSet.addStorageBuffer(instanceBuffers.back()));
+    }
+}
+
+void Graphics::createMeshletCuller() {
+    if (!renderPathSupported(RenderPath::ComputeIndirect)) {
+        return;
+    }
+
+    // no instance draws more meshlets than the finest level has
+    meshletCuller.create(device, memoryAllocator, bindlessDescriptorSet, resourceBinder, MAX_FRAMES_IN_FLIGHT,
+                         mesh.lods[0].meshletCount * static_cast<uint32_t>(instanceOffsets.size()));
+}
+
+void Graphics::createOcclusionCuller() {
+    if (!occlusionCulling) {
+        return;
+    }
+
+    // the instance lists are read by the indirect commands of every path, by the meshlet culling pass and the task
+    // shader for the instance indices
+    vk::PipelineStageFlags consumerStages = vk::PipelineStageFlagBits::eVertexShader |
+                                            vk::PipelineStageFlagBits::eComputeShader;
+    if (renderPathSupported(RenderPath::MeshShader)) {
+        consumerStages |= vk::PipelineStageFlagBits::eTaskShaderEXT;
+    }
+
+    occlusionCuller.create(device, memoryAllocator, bindlessDescriptorSet, resourceBinder, mipDownsampler,
+                           MAX_FRAMES_IN_FLIGHT, static_cast<uint32_t>(instanceOffsets.size()), swapChainExtent,
+                           consumerStages);
+}
+
+void Graphics::createLights() {
+    lightClusterer.create(device, memoryAllocator, bindlessDescriptorSet, resourceBinder, MAX_FRAMES_IN_FLIGHT,
+                          options.lightCount);
+
+    // the lights are spread through the bounds of the instance grid, their ranges shrink as their number grows so
+    // that about the same number of them overlaps everywhere
+    auto boundsMin = glm::make_vec3(mesh.header.boundsMin) + instanceOffsets.front();
+    auto boundsMax = glm::make_vec3(mesh.header.boundsMax) + instanceOffsets.back();
+    auto extent = glm::max(boundsMax - boundsMin, glm::vec3(0.001f));
+    boundsMin -= extent * 0.1f;
+    boundsMax += extent * 0.1f;
+    auto range = glm::length(extent) * 0.75f / std::cbrt(static_cast<float>(std::max(options.lightCount, 1u)));
+
+    std::mt19937 random(1234);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    auto randomVector = [&]() {
+        auto x = unit(random);
+        auto y = unit(random);
+        auto z = unit(random);
+        return glm::vec3(x, y, z);
+    };
+
+    for (uint32_t i = 0; i < options.lightCount; i++) {
+        auto position = glm::mix(boundsMin, boundsMax, randomVector());
+        auto hue = unit(random) * 6.0f;
+        auto color = glm::clamp(glm::vec3(std::abs(hue - 3.0f) - 1.0f, 2.0f - std::abs(hue - 2.0f),
+                                          2.0f - std::abs(hue - 4.0f)), 0.0f, 1.0f) * 1.5f;
+        // every fourth light is a spot light pointing roughly downwards
+        auto direction = glm::normalize(glm::vec3(-1.0f, -4.0f, -1.0f) + randomVector() * 2.0f);
+
+        lights.push_back(LightData{
+                .position = {position.x, position.y, position.z},
+                .range = range * (0.5f + unit(random)),
+                .color = {color.r, color.g, color.b},
+                .type = i % 4 == 3 ? LightTypeSpot : LightTypePoint,
+                .direction = {direction.x, direction.y, direction.z},
+                .spotCosOuter = std::cos(glm::radians(40.0f)),
+                .spotCosInner = std::cos(glm::radians(30.0f)),
+        });
+        auto orbit = randomVector();
+        lightOrbits.emplace_back(range * 0.5f * orbit.x, 0.2f + orbit.y, orbit.z * glm::two_pi<float>());
+    }
+}
+
+void Graphics::createDeferredLighting() {
+    if (!deferredShading) {
+        return;
+    }
+
+    deferredLighting.create(device, memoryAllocator, bindlessDescriptorSet, resourceBinder, dispatcher, deferredLocalRead,
+                            swapChainImageFormat, depthFormat, swapChainExtent, depthImage.image, depthImageView);
+}
+
+void Graphics::createDynamicResolution() {
+    renderExtent = swapChainExtent;
+    dynamicResolutionEnabled = options.frameTimeTarget.has_value();
+    if (!dynamicResolutionEnabled) {
+        return;
+    }
+
+    dynamicResolution.create(device, memoryAllocator, bindlessDescriptorSet, resourceBinder, swapChainImageFormat,
+                             swapChainExtent, *options.frameTimeTarget);
+}
+
+void Graphics::createOverlay() {
+    overlay.create(device, memoryAllocator, bindlessDescriptorSet, resourceBinder, uploadBatcher,
+                   swapChainImageFormat, MAX_FRAMES_IN_FLIGHT);
+}
+
 void Graphics::createGraphicsPipeline() {
     auto vertexShaderCreateInfo = vk::ShaderModuleCreateInfo{
             .codeSize = vert_spv_len,
@@ -459,16 +1352,32 @@ void Graphics::createGraphicsPipeline() {
     };
     auto vertexShaderModule = device.createShaderModule(vertexShaderCreateInfo);
 
+    // the deferred path's geometry pipelines only fill the G-buffer
     auto fragmentShaderCreateInfo = vk::ShaderModuleCreateInfo{
-            .codeSize = frag_spv_len,
-            .pCode = reinterpret_cast<const uint32_t *>(frag_spv)
+            .codeSize = deferredShading ? gbuffer_frag_spv_len : frag_spv_len,
+            .pCode = reinterpret_cast<const uint32_t *>(deferredShading ? gbuffer_frag_spv : frag_spv)
     };
     auto fragmentShaderModule = device.createShaderModule(fragmentShaderCreateInfo);
 
+    // the vertex format is specialization constant 0 of every geometry stage, see shaders/scene.glsl
+    uint32_t vertexFormat = mesh.header.vertexFormat;
+    vk::SpecializationMapEntry vertexFormatEntry{
+            .constantID = 0,
+            .offset = 0,
+            .size = sizeof(vertexFormat),
+    };
+    vk::SpecializationInfo specializationInfo{
+            .mapEntryCount = 1,
+            .pMapEntries = &vertexFormatEntry,
+            .dataSize = sizeof(vertexFormat),
+            .pData = &vertexFormat,
+    };
+
     vk::PipelineShaderStageCreateInfo vertShaderStageInfo{
             .stage = vk::ShaderStageFlagBits::eVertex,
             .module = vertexShaderModule,
             .pName = "main",
+            .pSpecializationInfo = &specializationInfo,
     };
 
     vk::PipelineShaderStageCreateInfo fragmentShaderStageInfo{
@@ -479,9 +1388,48 @@ void Graphics::createGraphicsPipeline() {
 
     vk::PipelineShaderStageCreateInfo shaderStages[] = {vertShaderStageInfo, fragmentShaderStageInfo};
 
+    auto createShaderModule = [this](const unsigned char* code, unsigned int size) {
+        return device.createShaderModule({
+                .codeSize = size,
+                .pCode = reinterpret_cast<const uint32_t*>(code),
+        });
+    };
+
+    bool quantized = mesh.header.vertexFormat == MeshVertexFormatQuantized;
+
+    vk::VertexInputBindingDescription vertexBinding{
+            .binding = 0,
+            .stride = static_cast<uint32_t>(meshVertexSize(mesh.header.vertexFormat)),
+            .inputRate = vk::VertexInputRate::eVertex,
+    };
+
+    // quantized attributes are expanded by the fixed function vertex fetch, the shader only rescales and unfolds them
+    std::array<vk::VertexInputAttributeDescription, 3> vertexAttributes = {
+        vk::VertexInputAttributeDescription{
+            .location = 0,
+            .binding = 0,
+            .format = quantized ? vk::Format::eR16G16B16A16Unorm : vk::Format::eR32G32B32Sfloat,
+            .offset = quantized ? offsetof(QuantizedMeshVertex, position) : offsetof(MeshVertex, position),
+        },
+        vk::VertexInputAttributeDescription{
+            .location = 1,
+            .binding = 0,
+            .format = quantized ? vk::Format::eR16G16Snorm : vk::Format::eR32G32B32Sfloat,
+            .offset = quantized ? offsetof(QuantizedMeshVertex, normal) : offsetof(MeshVertex, normal),
+        },
+        vk::VertexInputAttributeDescription{
+            .location = 2,
+            .binding = 0,
+            .format = quantized ? vk::Format::eR16G16Sfloat : vk::Format::eR32G32Sfloat,
+            .offset = quantized ? offsetof(QuantizedMeshVertex, uv) : offsetof(MeshVertex, uv),
+        },
+    };
+
     vk::PipelineVertexInputStateCreateInfo vertexInputInfo{
-            .vertexBindingDescriptionCount = 0,
-            .vertexAttributeDescriptionCount = 0,
+            .vertexBindingDescriptionCount = 1,
+            .pVertexBindingDescriptions = &vertexBinding,
+            .vertexAttributeDescriptionCount = static_cast<uint32_t>(vertexAttributes.size()),
+            .pVertexAttributeDescriptions = vertexAttributes.data(),
     };
 
     vk::PipelineInputAssemblyStateCreateInfo inputAssembly{
@@ -499,33 +1447,69 @@ void Graphics::createGraphicsPipeline() {
         .rasterizerDiscardEnable = VK_FALSE,
         .polygonMode = vk::PolygonMode::eFill,
         .cullMode = vk::CullModeFlagBits::eBack,
-        .frontFace = vk::FrontFace::eClockwise,
+        .frontFace = vk::FrontFace::eCounterClockwise,
         .depthBiasEnable = VK_FALSE,
         .lineWidth = 1.0f,
     };
 
     vk::PipelineMultisampleStateCreateInfo multisampling{
-            .rasterizationSamples = vk::SampleCountFlagBits::e1,
+            .rasterizationSamples = sampleCount,
             .sampleShadingEnable = VK_FALSE,
     };
 
-    vk::PipelineColorBlendAttachmentState colorBlendAttachment{
+    vk::PipelineDepthStencilStateCreateInfo depthStencil{
+            .depthTestEnable = VK_TRUE,
+            .depthWriteEnable = VK_TRUE,
+            .depthCompareOp = vk::CompareOp::eLess,
+            .depthBoundsTestEnable = VK_FALSE,
+            .stencilTestEnable = VK_FALSE,
+    };
+
+    std::array<vk::PipelineColorBlendAttachmentState, DeferredLighting::AttachmentCount> colorBlendAttachments;
+    colorBlendAttachments.fill(vk::PipelineColorBlendAttachmentState{
             .blendEnable = VK_FALSE,
             .colorWriteMask = vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG |
                               vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA,
-    };
+    });
+    std::array<vk::Format, DeferredLighting::AttachmentCount> colorFormats = {swapChainImageFormat};
+    uint32_t colorAttachmentCount = 1;
+    if (deferredShading) {
+        // the output is attached but left to the lighting pass
+        colorBlendAttachments[0].colorWriteMask = {};
+        colorFormats = deferredLighting.colorFormats();
+        colorAttachmentCount = DeferredLighting::AttachmentCount;
+    }
 
     vk::PipelineColorBlendStateCreateInfo colorBlending{
             .logicOpEnable = VK_FALSE,
-            .attachmentCount = 1,
-            .pAttachments = &colorBlendAttachment,
+            .attachmentCount = colorAttachmentCount,
+            .pAttachments = colorBlendAttachments.data(),
     };
 
-    pipelineLayout = device.createPipelineLayout({.setLayoutCount = 0});
+    std::array<vk::DescriptorSetLayout, 2> setLayouts = {
+            bindlessDescriptorSet.layout(),
+            resourceBinder.drawSetLayout(),
+    };
+    drawConstantStages = vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment;
+    if (renderPathSupported(RenderPath::MeshShader)) {
+        drawConstantStages |= vk::ShaderStageFlagBits::eTaskEXT | vk::ShaderStageFlagBits::eMeshEXT;
+    }
+    vk::PushConstantRange pushConstantRange{
+            .stageFlags = drawConstantStages,
+            .offset = 0,
+            .size = sizeof(DrawConstants),
+    };
+    pipelineLayout = device.createPipelineLayout({
+            .setLayoutCount = static_cast<uint32_t>(setLayouts.size()),
+            .pSetLayouts = setLayouts.data(),
+            .pushConstantRangeCount = 1,
+            .pPushConstantRanges = &pushConstantRange,
+    });
 
     vk::PipelineRenderingCreateInfo pipelineRenderingCreateInfo{
-            .colorAttachmentCount = 1,
-            .pColorAttachmentFormats = &swapChainImageFormat,
+            .colorAttachmentCount = colorAttachmentCount,
+            .pColorAttachmentFormats = colorFormats.data(),
+            .depthAttachmentFormat = depthFormat,
     };
 
     std::vector<vk::DynamicState> dynamicStates = {
@@ -540,6 +1524,7 @@ void Graphics::createGraphicsPipeline() {
 
     vk::GraphicsPipelineCreateInfo pipelineInfo{
         .pNext = &pipelineRenderingCreateInfo,
+        .flags = resourceBinder.pipelineCreateFlags(),
         .stageCount = 2,
         .pStages = shaderStages,
         .pVertexInputState = &vertexInputInfo,
@@ -547,7 +1532,7 @@ void Graphics::createGraphicsPipeline() {
         .pViewportState = &viewportState,
         .pRasterizationState = &rasterizer,
         .pMultisampleState = &multisampling,
-        .pDepthStencilState = nullptr,
+        .pDepthStencilState = &depthStencil,
         .pColorBlendState = &colorBlending,
         .pDynamicState = &dynamicState,
         .layout = pipelineLayout,
@@ -557,6 +1542,59 @@ void Graphics::createGraphicsPipeline() {
 
     graphicsPipeline = device.createGraphicsPipeline(nullptr, pipelineInfo).value;
 
+    // the meshlet paths share all fixed function state, only the geometry stages and the vertex input differ
+    if (renderPathSupported(RenderPath::ComputeIndirect)) {
+        auto meshletVertexModule = createShaderModule(meshlet_vert_spv, meshlet_vert_spv_len);
+
+        vk::PipelineShaderStageCreateInfo meshletStages[] = {
+            vk::PipelineShaderStageCreateInfo{
+                .stage = vk::ShaderStageFlagBits::eVertex,
+                .module = meshletVertexModule,
+                .pName = "main",
+                .pSpecializationInfo = &specializationInfo,
+            },
+            fragmentShaderStageInfo,
+        };
+        vk::PipelineVertexInputStateCreateInfo noVertexInput{};
+
+        auto meshletPipelineInfo = pipelineInfo;
+        meshletPipelineInfo.pStages = meshletStages;
+        meshletPipelineInfo.pVertexInputState = &noVertexInput;
+        meshletPipeline = device.createGraphicsPipeline(nullptr, meshletPipelineInfo).value;
+
+        device.destroyShaderModule(meshletVertexModule);
+    }
+
+    if (renderPathSupported(RenderPath::MeshShader)) {
+        auto taskModule = createShaderModule(task_spv, task_spv_len);
+        auto meshModule = createShaderModule(mesh_spv, mesh_spv_len);
+
+        vk::PipelineShaderStageCreateInfo meshStages[] = {
+            vk::PipelineShaderStageCreateInfo{
+                .stage = vk::ShaderStageFlagBits::eTaskEXT,
+                .module = taskModule,
+                .pName = "main",
+            },
+            vk::PipelineShaderStageCreateInfo{
+                .stage = vk::ShaderStageFlagBits::eMeshEXT,
+                .module = meshModule,
+                .pName = "main",
+                .pSpecializationInfo = &specializationInfo,
+            },
+            fragmentShaderStageInfo,
+        };
+
+        auto meshPipelineInfo = pipelineInfo;
+        meshPipelineInfo.stageCount = 3;
+        meshPipelineInfo.pStages = meshStages;
+        meshPipelineInfo.pVertexInputState = nullptr;
+        meshPipelineInfo.pInputAssemblyState = nullptr;
+        meshShaderPipeline = device.createGraphicsPipeline(nullptr, meshPipelineInfo).value;
+
+        device.destroyShaderModule(taskModule);
+        device.destroyShaderModule(meshModule);
+    }
+
     device.destroyShaderModule(vertexShaderModule);
     device.destroyShaderModule(fragmentShaderModule);
 }
@@ -581,17 +1619,140 @@ void Graphics::createCommandBuffers() {
 }
 
 void Graphics::recordCommandBuffer(vk::CommandBuffer cmdBuffer, uint32_t imageIndex) {
+    TRACE_ZONE("recordCommandBuffer");
+    recordedDraws = 0;
+    recordedPipelineBinds = 0;
     vk::CommandBufferBeginInfo beginInfo{};
 
     cmdBuffer.begin(beginInfo);
 
     cmdTransitionImageLayout(cmdBuffer, swapChainImages[imageIndex], vk::ImageLayout::eUndefined,
         vk::ImageLayout::eColorAttachmentOptimal);
+    if (deferredShading) {
+        deferredLighting.beginFrame(cmdBuffer);
+    } else {
+        cmdTransitionImageLayout(cmdBuffer, depthImage.image, vk::ImageLayout::eUndefined,
+            vk::ImageLayout::eDepthStencilAttachmentOptimal);
+    }
+    if (sampleCount != vk::SampleCountFlagBits::e1) {
+        multisampleTargets.beginFrame(cmdBuffer);
+    }
+    if (dynamicResolutionEnabled) {
+        dynamicResolution.beginFrame(cmdBuffer);
+    }
+
+    DrawConstants constants{
+            .frameDataIndex = frameDataIndices[currentFrame],
+            .vertexBufferIndex = meshSectionIndices[MeshSectionVertices],
+            .meshletBufferIndex = meshSectionIndices[MeshSectionMeshlets],
+            .meshletVertexBufferIndex = meshSectionIndices[MeshSectionMeshletVertices],
+            .meshletTriangleBufferIndex = meshSectionIndices[MeshSectionMeshletTriangles],
+            .meshletCount = mesh.lods[0].meshletCount,
+            .instanceBufferIndex = instanceBufferIndices[currentFrame],
+            .instanceCount = static_cast<uint32_t>(instanceOffsets.size()),
+            .instanceListIndex = NoInstanceList,
+            .lightBufferIndex = lightClusterer.lightBufferIndex(currentFrame),
+            .clusterBufferIndex = lightClusterer.clusterBufferIndex(currentFrame),
+    };
+    if (renderPath == RenderPath::ComputeIndirect) {
+        constants.drawBufferIndex = meshletCuller.drawBufferIndex(currentFrame);
+    }
+    for (int axis = 0; axis < 3; axis++) {
+        constants.positionOffset[axis] = mesh.header.boundsMin[axis];
+        constants.positionScale[axis] = mesh.header.boundsMax[axis] - mesh.header.boundsMin[axis];
+    }
+
+    // everything from culling to the end of rendering is timed, see reportGpuTime
+    gpuTimer.begin(cmdBuffer);
 
-    vk::RenderingAttachmentInfo colorAttachmentInfo{
-            .imageView = swapChainImageViews[imageIndex],
+    gpuTimer.beginScope(cmdBuffer, "light culling");
+    lightClusterer.record(cmdBuffer, currentFrame, frameDataIndices[currentFrame], static_cast<uint32_t>(lights.size()));
+    gpuTimer.endScope(cmdBuffer);
+
+    if (!occlusionCulling) {
+        if (renderPath == RenderPath::ComputeIndirect) {
+            gpuTimer.beginScope(cmdBuffer, "meshlet culling");
+            meshletCuller.record(cmdBuffer, currentFrame, constants);
+            gpuTimer.endScope(cmdBuffer);
+        }
+        recordMeshPass(cmdBuffer, imageIndex, constants, vk::AttachmentLoadOp::eClear, std::nullopt);
+    } else {
+        // the instances visible in the previous frame are drawn first, the depth pyramid built from them decides
+        // which of the others have become visible and are drawn on top
+        recordOcclusionCulling(cmdBuffer, constants, OcclusionPhase::Visible);
+        recordMeshPass(cmdBuffer, imageIndex, constants, vk::AttachmentLoadOp::eClear, OcclusionPhase::Visible);
+
+        gpuTimer.beginScope(cmdBuffer, "depth pyramid");
+        occlusionCuller.buildDepthPyramid(cmdBuffer, depthImage.image, depthImageView,
+                                          deferredShading ? deferredLighting.depthLayout()
+                                                          : vk::ImageLayout::eDepthStencilAttachmentOptimal);
+        gpuTimer.endScope(cmdBuffer);
+        recordOcclusionCulling(cmdBuffer, constants, OcclusionPhase::Disoccluded);
+
+        vk::MemoryBarrier colorBarrier{
+                .srcAccessMask = vk::AccessFlagBits::eColorAttachmentWrite,
+                .dstAccessMask = vk::AccessFlagBits::eColorAttachmentRead | vk::AccessFlagBits::eColorAttachmentWrite,
+        };
+        cmdBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eColorAttachmentOutput,
+                                  vk::PipelineStageFlagBits::eColorAttachmentOutput, {},
+                                  1, &colorBarrier, 0, nullptr, 0, nullptr);
+        recordMeshPass(cmdBuffer, imageIndex, constants, vk::AttachmentLoadOp::eLoad, OcclusionPhase::Disoccluded);
+    }
+
+    if (dynamicResolutionEnabled) {
+        gpuTimer.beginScope(cmdBuffer, "upscale");
+        dynamicResolution.recordUpscale(cmdBuffer, swapChainImageViews[imageIndex], swapChainExtent);
+        gpuTimer.endScope(cmdBuffer);
+        recordedDraws++;
+        recordedPipelineBinds++;
+    }
+
+    if (overlayVisible) {
+        gpuTimer.beginScope(cmdBuffer, "overlay");
+        recordOverlay(cmdBuffer, imageIndex);
+        gpuTimer.endScope(cmdBuffer);
+    }
+
+    gpuTimer.end(cmdBuffer);
+
+    cmdTransitionImageLayout(cmdBuffer, swapChainImages[imageIndex], vk::ImageLayout::eColorAttachmentOptimal,
+                             vk::ImageLayout::ePresentSrcKHR);
+
+    cmdBuffer.end();
+}
+
+// Writes the instance list of an occlusion phase and, on the compute path, culls the meshlets of the listed instances.
+void Graphics::recordOcclusionCulling(vk::CommandBuffer cmdBuffer, const DrawConstants &constants, OcclusionPhase phase) {
+    gpuTimer.beginScope(cmdBuffer, phase == OcclusionPhase::Visible ? "culling visible" : "culling disoccluded");
+    // meshlets per workgroup of shaders/meshletCull.comp and shaders/meshlet.task
+    uint32_t meshletGroupSize = renderPath == RenderPath::MeshShader ? 32 : 64;
+    occlusionCuller.record(cmdBuffer, currentFrame, phase, constants, meshletGroupSize);
+
+    if (renderPath == RenderPath::ComputeIndirect) {
+        auto listConstants = constants;
+        listConstants.instanceListIndex = occlusionCuller.listBufferIndex(currentFrame, phase);
+        meshletCuller.recordIndirect(cmdBuffer, currentFrame, listConstants, occlusionCuller.listBuffer(currentFrame, phase),
+                                     OcclusionCuller::DispatchOffset);
+    }
+    gpuTimer.endScope(cmdBuffer);
+}
+
+// Draws the mesh instances, all of them or the ones in the instance list of an occlusion phase. The depth of the
+// Visible phase is kept for the depth pyramid and the Disoccluded pass. With deferred shading the instances go into
+// the G-buffer and the last pass is followed by the lighting.
+void Graphics::recordMeshPass(vk::CommandBuffer cmdBuffer, uint32_t imageIndex, const DrawConstants &constants,
+                              vk::AttachmentLoadOp loadOp, std::optional<OcclusionPhase> occlusionPhase) {
+    bool lastPass = occlusionPhase != OcclusionPhase::Visible;
+    gpuTimer.beginScope(cmdBuffer, !occlusionPhase ? "mesh pass"
+                                   : lastPass ? "mesh pass disoccluded" : "mesh pass visible");
+    // with dynamic resolution the scene goes into the upscaler's target instead of the swap chain image
+    auto sceneView = dynamicResolutionEnabled ? dynamicResolution.colorView() : swapChainImageViews[imageIndex];
+
+    std::array<vk::RenderingAttachmentInfo, DeferredLighting::AttachmentCount> colorAttachments;
+    colorAttachments[0] = vk::RenderingAttachmentInfo{
+            .imageView = sceneView,
             .imageLayout = vk::ImageLayout::eColorAttachmentOptimal,
-            .loadOp = vk::AttachmentLoadOp::eClear,
+            .loadOp = loadOp,
             .storeOp = vk::AttachmentStoreOp::eStore,
             .clearValue = vk::ClearValue {
                 .color = vk::ClearColorValue {
@@ -599,53 +1760,441 @@ void Graphics::recordCommandBuffer(vk::CommandBuffer cmdBuffer, uint32_t imageIn
                 }
             }
     };
+    uint32_t colorAttachmentCount = 1;
+
+    auto depthLayout = vk::ImageLayout::eDepthStencilAttachmentOptimal;
+    // the sampled lighting pass reads the depth after the rendering ended
+    bool storeDepth = occlusionPhase == OcclusionPhase::Visible || (deferredShading && !deferredLocalRead);
+
+    if (deferredShading) {
+        // every output pixel is written by the lighting, only its result is stored
+        colorAttachments[0].loadOp = vk::AttachmentLoadOp::eDontCare;
+        colorAttachments[0].storeOp = lastPass ? vk::AttachmentStoreOp::eStore : vk::AttachmentStoreOp::eDontCare;
+        if (!deferredLocalRead) {
+            colorAttachments[0].imageView = nullptr;
+        }
+        deferredLighting.gbufferAttachments(colorAttachments, loadOp, lastPass);
+        colorAttachmentCount = DeferredLighting::AttachmentCount;
+        depthLayout = deferredLighting.depthLayout();
+    }
+
+    vk::RenderingAttachmentInfo depthAttachmentInfo{
+            .imageView = depthImageView,
+            .imageLayout = depthLayout,
+            .loadOp = loadOp,
+            .storeOp = storeDepth ? vk::AttachmentStoreOp::eStore : vk::AttachmentStoreOp::eDontCare,
+            .clearValue = vk::ClearValue {
+                .depthStencil = vk::ClearDepthStencilValue {
+                    .depth = 1.0f,
+                }
+            }
+    };
+
+    if (sampleCount != vk::SampleCountFlagBits::e1) {
+        // the last pass resolves into the swap chain image, the Visible phase's depth is resolved for the pyramid
+        colorAttachments[0].storeOp = lastPass ? vk::AttachmentStoreOp::eDontCare : vk::AttachmentStoreOp::eStore;
+        multisampleTargets.attach(colorAttachments[0], depthAttachmentInfo, lastPass,
+                                  occlusionPhase == OcclusionPhase::Visible);
+    }
 
     vk::RenderingInfo renderingInfo{
             .renderArea = {
-                    .extent = swapChainExtent,
+                    .extent = renderExtent,
             },
             .layerCount = 1,
-            .colorAttachmentCount = 1,
-            .pColorAttachments = &colorAttachmentInfo,
+            .colorAttachmentCount = colorAttachmentCount,
+            .pColorAttachments = colorAttachments.data(),
+            .pDepthAttachment = &depthAttachmentInfo,
     };
 
     cmdBuffer.beginRendering(renderingInfo);
 
-    cmdBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, graphicsPipeline);
+    recordedPipelineBinds++;
+    switch (renderPath) {
+    case RenderPath::Vertex:
+        cmdBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, graphicsPipeline);
+        break;
+    case RenderPath::ComputeIndirect:
+        cmdBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, meshletPipeline);
+        break;
+    case RenderPath::MeshShader:
+        cmdBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, meshShaderPipeline);
+        break;
+    }
+    resourceBinder.bindGlobal(cmdBuffer, vk::PipelineBindPoint::eGraphics, pipelineLayout);
 
     std::array<vk::Viewport, 1> viewports = {
         vk::Viewport {
             .x = 0.0f,
             .y = 0.0f,
-            .width = static_cast<float>(swapChainExtent.width),
-            .height = static_cast<float>(swapChainExtent.height),
+            .width = static_cast<float>(renderExtent.width),
+            .height = static_cast<float>(renderExtent.height),
             .minDepth = 0.0f,
             .maxDepth = 1.0f,
         }
     };
 
     std::array<vk::Rect2D, 1> scissors;
-    scissors[0].extent = swapChainExtent;
+    scissors[0].extent = renderExtent;
 
     cmdBuffer.setViewport(0, viewports);
     cmdBuffer.setScissor(0, scissors);
 
-    cmdBuffer.draw(3, 1, 0, 0);
+    auto passConstants = constants;
+    if (occlusionPhase) {
+        passConstants.instanceListIndex = occlusionCuller.listBufferIndex(currentFrame, *occlusionPhase);
+    }
+    cmdBuffer.pushConstants(pipelineLayout, drawConstantStages, 0, sizeof(passConstants), &passConstants);
+
+    switch (renderPath) {
+    case RenderPath::Vertex:
+        cmdBuffer.bindVertexBuffers(0, mesh.buffer.buffer, mesh.sectionOffset(MeshSectionVertices));
+        cmdBuffer.bindIndexBuffer(mesh.buffer.buffer, mesh.sectionOffset(MeshSectionIndices), vk::IndexType::eUint32);
+        if (occlusionPhase) {
+            occlusionCuller.draw(cmdBuffer, currentFrame, *occlusionPhase);
+            recordedDraws++;
+            break;
+        }
+        // one draw per instance over the index range of its level, firstInstance passes the instance index
+        for (uint32_t instance = 0; instance < instanceLods.size(); instance++) {
+            const auto &lod = mesh.lods[instanceLods[instance]];
+            cmdBuffer.drawIndexed(lod.indexCount, 1, lod.indexOffset, 0, instance);
+        }
+        recordedDraws += static_cast<uint32_t>(instanceLods.size());
+        break;
+    case RenderPath::ComputeIndirect:
+        meshletCuller.draw(cmdBuffer, currentFrame);
+        recordedDraws++;
+        break;
+    case RenderPath::MeshShader:
+        if (occlusionPhase) {
+            occlusionCuller.drawMeshTasks(cmdBuffer, currentFrame, *occlusionPhase, dispatcher);
+        } else {
+            // one task shader workgroup culls TaskGroupSize meshlets of the instance given by the y coordinate, see
+            // shaders/meshlet.task
+            cmdBuffer.drawMeshTasksEXT((constants.meshletCount + 31) / 32, constants.instanceCount, 1, dispatcher);
+        }
+        recordedDraws++;
+        break;
+    }
+
+    if (deferredShading && lastPass && deferredLocalRead) {
+        deferredLighting.recordLighting(cmdBuffer, constants.frameDataIndex, constants.lightBufferIndex,
+                                        constants.clusterBufferIndex, sceneView, renderExtent);
+    }
 
     cmdBuffer.endRendering();
 
-    cmdTransitionImageLayout(cmdBuffer, swapChainImages[imageIndex], vk::ImageLayout::eColorAttachmentOptimal,
-                             vk::ImageLayout::ePresentSrcKHR);
+    if (deferredShading && lastPass && !deferredLocalRead) {
+        deferredLighting.recordLighting(cmdBuffer, constants.frameDataIndex, constants.lightBufferIndex,
+                                        constants.clusterBufferIndex, sceneView, renderExtent);
+    }
+    // the lighting is one fullscreen draw with a pipeline of its own
+    if (deferredShading && lastPass) {
+        recordedDraws++;
+        recordedPipelineBinds++;
+    }
+    gpuTimer.endScope(cmdBuffer);
+}
 
-    cmdBuffer.end();
+// Draws the performance overlay onto the finished swap chain image.
+void Graphics::recordOverlay(vk::CommandBuffer cmdBuffer, uint32_t imageIndex) {
+    auto start = std::chrono::steady_clock::now();
+
+    // the overlay blends over what the scene passes wrote to the image
+    vk::MemoryBarrier colorBarrier{
+            .srcAccessMask = vk::AccessFlagBits::eColorAttachmentWrite,
+            .dstAccessMask = vk::AccessFlagBits::eColorAttachmentRead | vk::AccessFlagBits::eColorAttachmentWrite,
+    };
+    cmdBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eColorAttachmentOutput,
+                              vk::PipelineStageFlagBits::eColorAttachmentOutput, {},
+                              1, &colorBarrier, 0, nullptr, 0, nullptr);
+
+    auto previousFrame = (frameTimeOffset + FrameTimeHistory - 1) % FrameTimeHistory;
+    overlay.beginFrame(currentFrame, swapChainExtent, cpuFrameTimes[previousFrame] / 1000.0f);
+    buildOverlay();
+    overlay.record(cmdBuffer, swapChainImageViews[imageIndex]);
+
+    // shown in the next frame, like the GPU time
+    overlayCpuMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void Graphics::buildOverlay() {
+    ImGui::SetNextWindowPos(ImVec2(10.0f, 10.0f));
+    ImGui::SetNextWindowBgAlpha(0.75f);
+    ImGui::Begin("performance", nullptr, ImGuiWindowFlags_NoDecoration | ImGuiWindowFlags_AlwaysAutoResize |
+                                         ImGuiWindowFlags_NoInputs | ImGuiWindowFlags_NoSavedSettings);
+
+    auto latest = (frameTimeOffset + FrameTimeHistory - 1) % FrameTimeHistory;
+    auto plotSize = ImVec2(260.0f, 48.0f);
+    ImGui::Text("CPU %.2f ms (%.0f fps)", cpuFrameTimes[latest], 1000.0f / std::max(cpuFrameTimes[latest], 0.001f));
+    ImGui::PlotLines("##cpu", cpuFrameTimes.data(), FrameTimeHistory, static_cast<int>(frameTimeOffset), nullptr, 0.0f,
+                     FLT_MAX, plotSize);
+    if (gpuTimer.supported()) {
+        ImGui::Text("GPU %.2f ms", gpuFrameTimes[latest]);
+        ImGui::PlotLines("##gpu", gpuFrameTimes.data(), FrameTimeHistory, static_cast<int>(frameTimeOffset), nullptr,
+                         0.0f, FLT_MAX, plotSize);
+    }
+
+    // the scopes of the frame read back last, they lag the frames in flight behind
+    double overlayGpuMilliseconds = 0.0;
+    if (!gpuTimer.scopes().empty() && ImGui::BeginTable("passes", 2, ImGuiTableFlags_SizingFixedFit)) {
+        for (const auto &scope : gpuTimer.scopes()) {
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(scope.name);
+            ImGui::TableNextColumn();
+            ImGui::Text("%7.3f ms", scope.milliseconds);
+            if (std::strcmp(scope.name, "overlay") == 0) {
+                overlayGpuMilliseconds = scope.milliseconds;
+            }
+        }
+        ImGui::EndTable();
+    }
+
+    ImGui::Separator();
+    const auto &memoryProperties = memoryAllocator.memoryProperties();
+    // usage against the budget, which with VK_EXT_memory_budget is what other processes leave over
+    for (uint32_t heap = 0; heap < memoryProperties.memoryHeapCount; heap++) {
+        auto budget = memoryAllocator.heapBudget(heap);
+        auto usage = static_cast<double>(budget.usage) / (1024.0 * 1024.0);
+        auto size = static_cast<double>(budget.budget) / (1024.0 * 1024.0);
+        auto headroom = static_cast<double>(memoryAllocator.headroom(heap)) / (1024.0 * 1024.0);
+        bool deviceLocal = static_cast<bool>(memoryProperties.memoryHeaps[heap].flags & vk::MemoryHeapFlagBits::eDeviceLocal);
+        char label[64];
+        std::snprintf(label, sizeof(label), "%.0f / %.0f MB", usage, size);
+        ImGui::ProgressBar(static_cast<float>(usage / std::max(size, 1.0)), ImVec2(plotSize.x, 0.0f), label);
+        ImGui::SameLine();
+        ImGui::Text("heap %u%s, %.0f MB headroom", heap, deviceLocal ? " (device)" : "", headroom);
+    }
+    if (memoryAllocator.overLimitAllocations() > 0) {
+        ImGui::Text("%llu allocations over the soft limit",
+                    static_cast<unsigned long long>(memoryAllocator.overLimitAllocations()));
+    }
+    if (!options.texturePaths.empty()) {
+        ImGui::Text("streamed textures %.0f MB", static_cast<double>(textureStreamer.residentBytes()) / (1024.0 * 1024.0));
+    }
+    ImGui::Text("uploads %.1f MB/s, %.2f submits per frame", uploadMegabytesPerSecond, uploadSubmitsPerFrame);
+
+    ImGui::Separator();
+    ImGui::Text("%u draws, %u pipeline binds", recordedDraws, recordedPipelineBinds);
+    ImGui::Text("%llu triangles in the selected LODs", static_cast<unsigned long long>(frameTriangles));
+    ImGui::Text("overlay: %.3f ms CPU, %.3f ms GPU, %u draws, %u vertices", overlayCpuMilliseconds,
+                overlayGpuMilliseconds, overlay.drawCount(), overlay.vertexCount());
+
+    ImGui::End();
+}
+
+// Swings the camera around the instance grid so that all instances stay in view, writes the current frame's camera,
+// culling and light cluster data, selects the level of detail of every instance from its projected error and moves
+// the lights.
+void Graphics::updateFrameData() {
+    TRACE_ZONE("updateFrameData");
+    auto boundsMin = glm::make_vec3(mesh.header.boundsMin);
+    auto boundsMax = glm::make_vec3(mesh.header.boundsMax);
+    auto meshCenter = (boundsMin + boundsMax) * 0.5f;
+    auto meshRadius = glm::length(boundsMax - boundsMin) * 0.5f;
+    auto center = meshCenter + (instanceOffsets.front() + instanceOffsets.back()) * 0.5f;
+    auto radius = std::max(glm::length(instanceOffsets.back() - instanceOffsets.front()) * 0.5f + meshRadius, 0.001f);
+
+    const float fieldOfView = glm::radians(60.0f);
+    auto distance = radius / std::sin(fieldOfView * 0.5f);
+    auto seconds = std::chrono::duration<float>(std::chrono::steady_clock::now() - startTime).count();
+    auto angle = std::sin(seconds * 0.5f) * glm::radians(60.0f);
+    auto eye = center + distance * glm::vec3(std::sin(angle), 0.0f, std::cos(angle));
+
+    auto aspect = static_cast<float>(swapChainExtent.width) / static_cast<float>(std::max(swapChainExtent.height, 1u));
+    auto nearPlane = distance * 0.01f;
+    auto farPlane = distance + radius * 2.0f;
+    auto projection = glm::perspective(fieldOfView, aspect, nearPlane, farPlane);
+    // Vulkan clip space has y pointing down
+    projection[1][1] *= -1.0f;
+
+    auto view = glm::lookAt(eye, center, glm::vec3(0.0f, 1.0f, 0.0f));
+    auto viewProj = projection * view;
+
+    FrameData frameData{};
+    std::memcpy(frameData.viewProj, glm::value_ptr(viewProj), sizeof(frameData.viewProj));
+    auto inverseViewProj = glm::inverse(viewProj);
+    std::memcpy(frameData.inverseViewProj, glm::value_ptr(inverseViewProj), sizeof(frameData.inverseViewProj));
+
+    // Gribb-Hartmann frustum planes for 0..1 clip space depth
+    auto row = [&viewProj](int i) {
+        return glm::vec4(viewProj[0][i], viewProj[1][i], viewProj[2][i], viewProj[3][i]);
+    };
+    glm::vec4 planes[6] = {
+            row(3) + row(0), row(3) - row(0),
+            row(3) + row(1), row(3) - row(1),
+            row(2), row(3) - row(2),
+    };
+    for (int i = 0; i < 6; i++) {
+        auto plane = planes[i] / glm::length(glm::vec3(planes[i]));
+        std::memcpy(frameData.frustumPlanes[i], glm::value_ptr(plane), sizeof(frameData.frustumPlanes[i]));
+    }
+
+    frameData.cameraPosition[0] = eye.x;
+    frameData.cameraPosition[1] = eye.y;
+    frameData.cameraPosition[2] = eye.z;
+    frameData.cameraPosition[3] = 1.0f;
+
+    std::memcpy(frameData.view, glm::value_ptr(view), sizeof(frameData.view));
+    frameData.projection[0] = projection[0][0];
+    frameData.projection[1] = projection[1][1];
+    frameData.projection[2] = nearPlane;
+    frameData.projection[3] = farPlane;
+    LightClusterer::writeGridParameters(frameData, renderExtent, nearPlane, farPlane);
+
+    std::memcpy(frameDataBuffers[currentFrame].allocation.mapped, &frameData, sizeof(frameData));
+
+    // the error is measured in rendered pixels, a lower resolution scale also selects coarser levels
+    auto projectionScale = lodProjectionScale(fieldOfView, renderExtent.height);
+    auto *instances = static_cast<InstanceData *>(instanceBuffers[currentFrame].allocation.mapped);
+    std::atomic<uint64_t> triangles = 0;
+    jobSystem.parallelFor(static_cast<uint32_t>(instanceOffsets.size()), 256, [&](uint32_t begin, uint32_t end) {
+        uint64_t rangeTriangles = 0;
+        for (auto i = begin; i < end; i++) {
+            auto offset = instanceOffsets[i];
+            auto distance = glm::length(meshCenter + offset - eye) - meshRadius;
+            instanceLods[i] = selectLod(mesh.lods, distance, projectionScale, options.lodThreshold);
+            instanceFootprints[i] = distance > 0.0f ? 2.0f * meshRadius * projectionScale / distance
+                                                    : std::numeric_limits<float>::max();
+
+            const auto &lod = mesh.lods[instanceLods[i]];
+            instances[i] = InstanceData{
+                    .offset = {offset.x, offset.y, offset.z, 0.0f},
+                    .indexOffset = lod.indexOffset,
+                    .indexCount = lod.indexCount,
+                    .meshletOffset = lod.meshletOffset,
+                    .meshletCount = lod.meshletCount,
+            };
+            rangeTriangles += lod.indexCount / 3;
+        }
+        triangles.fetch_add(rangeTriangles, std::memory_order_relaxed);
+    });
+    frameTriangles = triangles.load();
+    selectedTriangles += frameTriangles;
+    selectedFrames++;
+
+    // the streamed textures are spread over the instances round robin, each one asks for the level its closest
+    // instance needs, so residency follows the camera and textures far away give their finer levels back
+    if (!textures.empty()) {
+        for (size_t i = 0; i < instanceFootprints.size(); i++) {
+            auto texture = textures[i % textures.size()];
+            textureStreamer.requestLod(texture, textureStreamer.lodForFootprint(texture, instanceFootprints[i]));
+        }
+    }
+
+    // the lights circle around where they started
+    auto frameLights = lightClusterer.lights(currentFrame);
+    jobSystem.parallelFor(static_cast<uint32_t>(lights.size()), 256, [&](uint32_t begin, uint32_t end) {
+        for (auto i = begin; i < end; i++) {
+            auto light = lights[i];
+            auto orbit = lightOrbits[i];
+            auto lightAngle = orbit.z + seconds * orbit.y;
+            light.position[0] += std::cos(lightAngle) * orbit.x;
+            light.position[2] += std::sin(lightAngle) * orbit.x;
+            frameLights[i] = light;
+        }
+    });
+}
+
+// Prints the average GPU time of the mesh pass every few seconds, to compare render paths and vertex formats.
+void Graphics::reportGpuTime() {
+    auto now = std::chrono::steady_clock::now();
+    if (gpuTimer.sampleCount() == 0 || now - lastTimingReport < std::chrono::seconds(2)) {
+        return;
+    }
+
+    auto shading = deferredShading ? (deferredLocalRead ? "deferred local read" : "deferred sampled") : "forward";
+    std::cout << renderPathName(renderPath) << " path, " << shading << " shading, "
+              << static_cast<uint32_t>(sampleCount) << "x MSAA, " << renderExtent.width << "x" << renderExtent.height
+              << " pixels, " << meshVertexFormatName(mesh.header.vertexFormat) << " vertices: "
+              << gpuTimer.averageMilliseconds() << " ms GPU time over " << gpuTimer.sampleCount() << " frames, "
+              << selectedTriangles / std::max<uint64_t>(selectedFrames, 1) << " of "
+              << mesh.lods[0].indexCount / 3 * instanceOffsets.size() << " triangles in the selected LODs\n";
+    if (occlusionCulling && occlusionCuller.statisticsFrames() > 0) {
+        const auto &statistics = occlusionCuller.statistics();
+        auto frames = occlusionCuller.statisticsFrames();
+        std::cout << "occlusion culling per frame: " << statistics.firstPhaseInstances / frames << " instances drawn first, "
+                  << statistics.secondPhaseInstances / frames << " disoccluded, " << statistics.occlusionCulled / frames
+                  << " occluded, " << statistics.frustumCulled / frames << " outside the frustum\n";
+        occlusionCuller.resetStatistics();
+    }
+    if (framePacer.statisticsFrames() > 0) {
+        std::cout << "presentation: ";
+        if (framePacer.presentIntervals() > 0) {
+            std::cout << framePacer.averagePresentInterval() << " ms between presents, ";
+        }
+        std::cout << framePacer.averageQueueDepth() << " presents queued and "
+                  << framePacer.averageWaitMilliseconds() << " ms waited for the display per frame\n";
+        framePacer.resetStatistics();
+    }
+    auto uploads = uploadBatcher.statistics();
+    auto seconds = std::chrono::duration<double>(now - lastTimingReport).count();
+    auto frames = std::max<uint64_t>(selectedFrames, 1);
+    uploadMegabytesPerSecond = static_cast<double>(uploads.bytes - reportedUploads.bytes) / (1024.0 * 1024.0) / seconds;
+    uploadSubmitsPerFrame = static_cast<double>(uploads.submits - reportedUploads.submits) / static_cast<double>(frames);
+    std::cout << "uploads: " << uploadMegabytesPerSecond << " MB/s, " << uploadSubmitsPerFrame << " submits per frame, "
+              << uploads.requests - reportedUploads.requests << " requests in "
+              << uploads.copies - reportedUploads.copies << " copies\n";
+    reportedUploads = uploads;
+
+    gpuTimer.resetAverage();
+    selectedTriangles = 0;
+    selectedFrames = 0;
+    lastTimingReport = now;
+}
+
+// Puts the GPU scopes read back for the current frame slot onto the trace's GPU track.
+void Graphics::traceGpuScopes() {
+#ifdef ENABLE_TRACING
+    if (!gpuTimer.calibrated()) {
+        return;
+    }
+    if (const auto &frame = gpuTimer.frameScope()) {
+        TRACE_GPU_ZONE("gpu frame", gpuTimer.hostNanoseconds(frame->beginTicks),
+                       gpuTimer.hostNanoseconds(frame->endTicks));
+    }
+    for (const auto &scope : gpuTimer.scopes()) {
+        TRACE_GPU_ZONE(scope.name, gpuTimer.hostNanoseconds(scope.beginTicks), gpuTimer.hostNanoseconds(scope.endTicks));
+    }
+#endif
+}
+
+// Appends the time since the previous frame and the GPU time read back for this frame slot to the overlay's graphs.
+void Graphics::recordFrameTimes() {
+    auto now = std::chrono::steady_clock::now();
+    auto previous = (frameTimeOffset + FrameTimeHistory - 1) % FrameTimeHistory;
+    cpuFrameTimes[frameTimeOffset] = std::chrono::duration<float, std::milli>(now - lastFrameStart).count();
+    gpuFrameTimes[frameTimeOffset] = static_cast<float>(
+            gpuTimer.frameMilliseconds().value_or(gpuFrameTimes[previous]));
+    frameTimeOffset = (frameTimeOffset + 1) % FrameTimeHistory;
+    lastFrameStart = now;
 }
 
 void Graphics::drawFrame() {
-    if (device.waitForFences(1, &inFlightFences[currentFrame], VK_TRUE, UINT64_MAX) != vk::Result::eSuccess) {
-        throw std::runtime_error("could not wait for fences");
+    TRACE_ZONE("drawFrame");
+    {
+        TRACE_ZONE("wait for frame fence");
+        if (device.waitForFences(1, &inFlightFences[currentFrame], VK_TRUE, UINT64_MAX) != vk::Result::eSuccess) {
+            throw std::runtime_error("could not wait for fences");
+        }
+        presenter.beginFrame(currentFrame);
     }
+    deletionQueue.collect();
     
-    auto result = device.acquireNextImageKHR(swapChain, UINT64_MAX, imageAvailableSemaphores[currentFrame], VK_NULL_HANDLE);
+    if (requestedSampleCount != sampleCount) {
+        applySampleCount();
+    }
+    if (requestedPresentPolicy != presentPolicy) {
+        applyPresentPolicy();
+    }
+
+    auto result = [this] {
+        TRACE_ZONE("acquire image");
+        return device.acquireNextImageKHR(swapChain, UINT64_MAX, imageAvailableSemaphores[currentFrame],
+                                          VK_NULL_HANDLE);
+    }();
 
     uint32_t imageIndex = 0;
     switch (result.result) {
@@ -664,36 +2213,78 @@ void Graphics::drawFrame() {
         throw std::runtime_error("could not reset fences");
     }
 
+    frameDescriptorAllocator.beginFrame(currentFrame);
+    resourceBinder.beginFrame(currentFrame);
+    gpuTimer.beginFrame(currentFrame);
+    if (occlusionCulling) {
+        occlusionCuller.beginFrame(currentFrame);
+    }
+    reportGpuTime();
+    traceGpuScopes();
+    recordFrameTimes();
+    // before the texture streamer, which evicts when its heap is over the soft limit
+    memoryAllocator.updateBudget();
+    // submits the uploads staged since the last frame ahead of the streamer's rebuilds and the frame itself
+    uploadBatcher.flush();
+    textureStreamer.update();
+
+    if (dynamicResolutionEnabled) {
+        if (auto milliseconds = gpuTimer.frameMilliseconds()) {
+            dynamicResolution.update(*milliseconds);
+        }
+        renderExtent = dynamicResolution.renderExtent();
+    } else {
+        renderExtent = swapChainExtent;
+    }
+    if (occlusionCulling) {
+        occlusionCuller.setRenderExtent(renderExtent);
+    }
+    updateFrameData();
+
     commandBuffers[currentFrame].reset();
     recordCommandBuffer(commandBuffers[currentFrame], imageIndex);
 
     vk::Semaphore waitSemaphores[] = {imageAvailableSemaphores[currentFrame]};
     vk::PipelineStageFlags waitStages[] = {vk::PipelineStageFlagBits::eColorAttachmentOutput};
-    vk::Semaphore signalSemaphores[] = {renderFinishedSemaphores[currentFrame]};
+    vk::Semaphore signalSemaphores[] = {renderFinishedSemaphores[currentFrame], deletionQueue.timeline()};
+    // the binary semaphore's value is ignored
+    uint64_t signalValues[] = {0, deletionQueue.pendingValue()};
+    vk::TimelineSemaphoreSubmitInfo timelineInfo{
+        .signalSemaphoreValueCount = 2,
+        .pSignalSemaphoreValues = signalValues,
+    };
     vk::SubmitInfo submitInfo {
+        .pNext = &timelineInfo,
         .waitSemaphoreCount = 1,
         .pWaitSemaphores = waitSemaphores,
         .pWaitDstStageMask = waitStages,
         .commandBufferCount = 1,
         .pCommandBuffers = &commandBuffers[currentFrame],
-        .signalSemaphoreCount = 1,
+        .signalSemaphoreCount = 2,
         .pSignalSemaphores = signalSemaphores
     };
 
-    if (graphicsQueue.submit(1, &submitInfo, inFlightFences[currentFrame]) != vk::Result::eSuccess) {
-        throw std::runtime_error("could not submit to queue");
+    {
+        TRACE_ZONE("submit");
+        if (graphicsQueue.submit(1, &submitInfo, inFlightFences[currentFrame]) != vk::Result::eSuccess) {
+            throw std::runtime_error("could not submit to queue");
+        }
     }
+    deletionQueue.advance();
 
     vk::SwapchainKHR swapChains[] = {swapChain};
     vk::PresentInfoKHR presentInfo{
         .waitSemaphoreCount = 1,
-        .pWaitSemaphores     = signalSemaphores,
+        .pWaitSemaphores     = &renderFinishedSemaphores[currentFrame],
         .swapchainCount = 1,
         .pSwapchains = swapChains,
         .pImageIndices = &imageIndex,
     };
+    framePacer.tagPresent(presentInfo);
+    presenter.tagPresent(presentInfo, currentFrame);
 
     try {
+        TRACE_ZONE("present");
         auto presentResult = presentQueue.presentKHR(presentInfo);
         switch (presentResult) {
         case vk::Result::eSuboptimalKHR:
@@ -708,30 +2299,163 @@ void Graphics::drawFrame() {
     catch (std::runtime_error&) {
         recreateSwapChain();
     }
+    if (!firstFramePresented) {
+        // the present is queued here, it reaches the display at the next refresh at the earliest
+        firstFramePresented = true;
+        std::cout << "first frame presented "
+                  << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - launchTime).count()
+                  << " ms after launch\n";
+    }
+    // not every platform reports the swap chain as out of date after a resize
+    if (framebufferResized) {
+        recreateSwapChain();
+    }
 
     currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
 }
 
+void Graphics::keyCallback(GLFWwindow *window, int key, int, int action, int) {
+    auto graphics = static_cast<Graphics *>(glfwGetWindowUserPointer(window));
+    if (action == GLFW_PRESS) {
+        graphics->postWindowEvent({
+            .type = WindowEvent::Type::Key,
+            .key = key,
+        });
+    }
+}
+
+void Graphics::framebufferSizeCallback(GLFWwindow *window, int width, int height) {
+    auto graphics = static_cast<Graphics *>(glfwGetWindowUserPointer(window));
+    graphics->postWindowEvent({
+        .type = WindowEvent::Type::Resize,
+        .framebufferExtent = vk::Extent2D{static_cast<uint32_t>(width), static_cast<uint32_t>(height)},
+    });
+}
+
+// Doubles the sample count up to the highest one the device supports, then starts over without multisampling.
+void Graphics::cycleSampleCount() {
+    if (deferredShading) {
+        std::cerr << "MSAA is not supported with deferred shading\n";
+        return;
+    }
+
+    auto next = static_cast<uint32_t>(requestedSampleCount) * 2;
+    auto supported = MultisampleTargets::supportedSampleCount(physicalDevice, next);
+    requestedSampleCount = static_cast<uint32_t>(supported) == next ? supported : vk::SampleCountFlagBits::e1;
+}
+
+// The sample count is baked into the pipelines, so they are recreated together with the multisampled attachments. The
+// old ones go to the deletion queue, frames in flight still use them.
+void Graphics::applySampleCount() {
+    if (sampleCount != vk::SampleCountFlagBits::e1) {
+        multisampleTargets.destroy(deletionQueue);
+    }
+    deletionQueue.enqueue(meshShaderPipeline);
+    deletionQueue.enqueue(meshletPipeline);
+    deletionQueue.enqueue(graphicsPipeline);
+    deletionQueue.enqueue(pipelineLayout);
+
+    sampleCount = requestedSampleCount;
+    createMultisampleTargets();
+    createGraphicsPipeline();
+
+    gpuTimer.resetAverage();
+    std::cout << "MSAA " << static_cast<uint32_t>(sampleCount) << "x\n";
+}
+
+void Graphics::cyclePresentPolicy() {
+    switch (requestedPresentPolicy) {
+        case PresentPolicy::Latency:
+            requestedPresentPolicy = PresentPolicy::Throughput;
+            break;
+        case PresentPolicy::Throughput:
+            requestedPresentPolicy = PresentPolicy::Power;
+            break;
+        case PresentPolicy::Power:
+            requestedPresentPolicy = PresentPolicy::TearFree;
+            break;
+        case PresentPolicy::TearFree:
+            requestedPresentPolicy = PresentPolicy::Latency;
+            break;
+    }
+}
+
+// Modes the swap chain was created with are switched on the next present. Any other mode gets a new swap chain created
+// from the current one, only its views are replaced and nothing waits for the device.
+void Graphics::applyPresentPolicy() {
+    presentPolicy = requestedPresentPolicy;
+    if (!presenter.switchPolicy(presentPolicy, querySwapChainSupport(physicalDevice).presentModes)) {
+        auto oldSwapChain = swapChain;
+        auto oldImageViews = std::move(swapChainImageViews);
+        auto oldExtent = swapChainExtent;
+        swapChainImageViews.clear();
+
+        createSwapChain(oldSwapChain);
+        createImageViews();
+        presenter.retire(oldSwapChain, std::move(oldImageViews));
+        framePacer.resetSwapchain();
+
+        // a resize that happened at the same time needs the full recreation after all
+        if (swapChainExtent != oldExtent) {
+            recreateSwapChain();
+        }
+    }
+
+    std::cout << presentPolicyName(presentPolicy) << " present policy, "
+              << vk::to_string(presenter.presentMode()) << " present mode\n";
+}
+
+// The new swap chain is created from the old one, which the presenter destroys once its presents are done, and the
+// size dependent targets the frames in flight still use go to the deletion queue, so nothing waits for the device.
 void Graphics::recreateSwapChain() {
-    cleanupSwapChain();
+    framebufferResized = false;
 
-    createSwapChain();
+    auto oldSwapChain = swapChain;
+    auto oldImageViews = std::move(swapChainImageViews);
+    swapChainImageViews.clear();
+    deletionQueue.enqueue(depthImageView);
+    deletionQueue.enqueue(depthImage);
+
+    createSwapChain(oldSwapChain);
+    presenter.retire(oldSwapChain, std::move(oldImageViews));
+    framePacer.resetSwapchain();
     createImageViews();
+    createDepthResources();
+    if (occlusionCulling) {
+        occlusionCuller.resize(swapChainExtent, deletionQueue);
+    }
+    if (deferredShading) {
+        deferredLighting.resize(swapChainExtent, depthImage.image, depthImageView, deletionQueue);
+    }
+    if (sampleCount != vk::SampleCountFlagBits::e1) {
+        multisampleTargets.resize(swapChainExtent, deletionQueue);
+    }
+    if (dynamicResolutionEnabled) {
+        dynamicResolution.resize(swapChainExtent, deletionQueue);
+    }
 }
 
 void Graphics::cleanupSwapChain() {
     device.waitIdle();
+    presenter.waitForPresents();
 
     for (const auto& imageView : swapChainImageViews) {
         device.destroy(imageView);
     }
     swapChainImageViews.clear();
 
+    device.destroy(depthImageView);
+    memoryAllocator.destroyImage(depthImage);
+
     device.destroy(swapChain);
 }
 
 void Graphics::cleanup() {
     cleanupSwapChain();
+    deletionQueue.destroy();
+    if (sampleCount != vk::SampleCountFlagBits::e1) {
+        multisampleTargets.destroy();
+    }
 
     for (auto& semaphore : imageAvailableSemaphores) {
         device.destroy(semaphore);
@@ -748,10 +2472,49 @@ void Graphics::cleanup() {
     }
     inFlightFences.clear();
 
+    gpuTimer.destroy();
+    presenter.destroy();
     device.destroy(commandPool);
 
+    device.destroy(meshShaderPipeline);
+    device.destroy(meshletPipeline);
     device.destroy(graphicsPipeline);
     device.destroy(pipelineLayout);
+    if (renderPathSupported(RenderPath::ComputeIndirect)) {
+        meshletCuller.destroy();
+    }
+    if (occlusionCulling) {
+        occlusionCuller.destroy();
+    }
+    if (deferredShading) {
+        deferredLighting.destroy();
+    }
+    if (dynamicResolutionEnabled) {
+        dynamicResolution.destroy();
+    }
+    overlay.destroy();
+    lightClusterer.destroy();
+    for (size_t i = 0; i < frameDataBuffers.size(); i++) {
+        bindlessDescriptorSet.removeStorageBuffer(frameDataIndices[i]);
+        memoryAllocator.destroyBuffer(frameDataBuffers[i]);
+    }
+    for (size_t i = 0; i < instanceBuffers.size(); i++) {
+        bindlessDescriptorSet.removeStorageBuffer(instanceBufferIndices[i]);
+        memoryAllocator.destroyBuffer(instanceBuffers[i]);
+    }
+    for (auto index : meshSectionIndices) {
+        bindlessDescriptorSet.removeStorageBuffer(index);
+    }
+    meshLoader.destroyMesh(mesh);
+    meshLoader.destroy();
+    mipDownsampler.destroy();
+    textureStreamer.destroy();
+    device.destroy(defaultSampler);
+    resourceBinder.destroy();
+    frameDescriptorAllocator.destroy();
+    bindlessDescriptorSet.destroy();
+    uploadBatcher.destroy();
+    memoryAllocator.destroy();
 
     vkDestroySurfaceKHR(instance, surface, nullptr);
     device.destroy();
@@ -759,6 +2522,11 @@ void Graphics::cleanup() {
 
     glfwDestroyWindow(window);
     glfwTerminate();
+    jobSystem.destroy();
+
+#ifdef ENABLE_TRACING
+    Tracer::stop();
+#endif
 }
 
 void Graphics::createSyncObjects() {
@@ -771,8 +2539,94 @@ void Graphics::createSyncObjects() {
     }
 }
 
+void Graphics::createFramePacer() {
+    if (options.lowLatency && !presentWaitSupported) {
+        std::cerr << "present wait is not supported, low latency mode waits for the previous frame's GPU work instead\n";
+    }
+    framePacer.create(device, dispatcher, presentWaitSupported, options.lowLatency, options.frameRateLimit);
+}
+
+void Graphics::createGpuTimer() {
+    auto indices = findQueueFamilies(physicalDevice);
+    gpuTimer.create(physicalDevice, device, dispatcher, indices.graphicsQueue.value(), MAX_FRAMES_IN_FLIGHT,
+                    calibratedTimestampsSupported);
+    if (!gpuTimer.supported()) {
+        std::cerr << "the graphics queue has no timestamps, GPU times are not reported\n";
+        if (dynamicResolutionEnabled) {
+            std::cerr << "the resolution scale stays fixed without GPU times\n";
+        }
+    }
+}
+
+void Graphics::benchmarkBindingModes() {
+    constexpr uint32_t bindsPerRun = 10000;
+    constexpr int runs = 5;
+
+    vk::BufferUsageFlags usage = vk::BufferUsageFlagBits::eUniformBuffer;
+    if (std::find(supportedBindingModes.begin(), supportedBindingModes.end(), BindingMode::DescriptorBuffer) != supportedBindingModes.end()) {
+        usage |= vk::BufferUsageFlagBits::eShaderDeviceAddress;
+    }
+    auto uniformBuffer = memoryAllocator.createBuffer(256, usage, vk::MemoryPropertyFlagBits::eHostVisible);
+    std::array<BufferBinding, 1> bindings = {BufferBinding{.buffer = &uniformBuffer}};
+
+    auto cmdBuffer = device.allocateCommandBuffers({
+            .commandPool = commandPool,
+            .level = vk::CommandBufferLevel::ePrimary,
+            .commandBufferCount = 1,
+    }).front();
+
+    std::cout << "per-draw bind cost, best of " << runs << " runs of " << bindsPerRun << " binds:\n";
+
+    for (auto mode : supportedBindingModes) {
+        ResourceBinder binder;
+        binder.create(physicalDevice, device, memoryAllocator, frameDescriptorAllocator, dispatcher,
+                      mode, drawSetBindings, nullptr, 1);
+
+        auto drawLayout = binder.drawSetLayout();
+        auto benchLayout = device.createPipelineLayout({
+                .setLayoutCount = 1,
+                .pSetLayouts = &drawLayout,
+        });
+
+        double bestNanoseconds = std::numeric_limits<double>::max();
+        for (int run = 0; run < runs; run++) {
+            frameDescriptorAllocator.beginFrame(0);
+            binder.beginFrame(0);
+
+            cmdBuffer.begin(vk::CommandBufferBeginInfo{
+                    .flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit,
+            });
+            binder.bindGlobal(cmdBuffer, vk::PipelineBindPoint::eGraphics, benchLayout);
+
+            auto start = std::chrono::steady_clock::now();
+            for (uint32_t i = 0; i < bindsPerRun; i++) {
+                binder.bindDraw(cmdBuffer, vk::PipelineBindPoint::eGraphics, benchLayout, bindings);
+            }
+            auto end = std::chrono::steady_clock::now();
+
+            cmdBuffer.end();
+            cmdBuffer.reset();
+
+            auto nanoseconds = std::chrono::duration<double, std::nano>(end - start).count() / bindsPerRun;
+            bestNanoseconds = std::min(bestNanoseconds, nanoseconds);
+        }
+
+        std::cout << "  " << bindingModeName(mode) << ": " << bestNanoseconds << " ns\n";
+
+        device.destroy(benchLayout);
+        binder.destroy();
+    }
+
+    frameDescriptorAllocator.beginFrame(currentFrame);
+    device.freeCommandBuffers(commandPool, cmdBuffer);
+    memoryAllocator.destroyBuffer(uniformBuffer);
+}
+
 void Graphics::cmdTransitionImageLayout(vk::CommandBuffer cmdBuffer, vk::Image image, vk::ImageLayout oldLayout,
                                         vk::ImageLayout newLayout) {
+    auto aspect = newLayout == vk::ImageLayout::eDepthStencilAttachmentOptimal ? vk::ImageAspectFlagBits::eDepth
+                                                                               : vk::ImageAspectFlagBits::eColor;
+
     vk::ImageMemoryBarrier barrier{
             .oldLayout = oldLayout,
             .newLayout = newLayout,
@@ -780,7 +2634,7 @@ void Graphics::cmdTransitionImageLayout(vk::CommandBuffer cmdBuffer, vk::Image i
             .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
             .image   = image,
             .subresourceRange = {
-                    .aspectMask = vk::ImageAspectFlagBits::eColor,
+                    .aspectMask = aspect,
                     .baseMipLevel = 0,
                     .levelCount = 1,
                     .baseArrayLayer = 0,
@@ -797,6 +2651,13 @@ void Graphics::cmdTransitionImageLayout(vk::CommandBuffer cmdBuffer, vk::Image i
 
         sourceStage = vk::PipelineStageFlagBits::eTopOfPipe;
         destinationStage = vk::PipelineStageFlagBits::eColorAttachmentOutput;
+    } else if (oldLayout == vk::ImageLayout::eUndefined && newLayout == vk::ImageLayout::eDepthStencilAttachmentOptimal) {
+        // the depth buffer is shared by all frames in flight, so the previous frame's depth writes have to finish first
+        barrier.srcAccessMask = vk::AccessFlagBits::eDepthStencilAttachmentWrite;
+        barrier.dstAccessMask = vk::AccessFlagBits::eDepthStencilAttachmentRead | vk::AccessFlagBits::eDepthStencilAttachmentWrite;
+
+        sourceStage = vk::PipelineStageFlagBits::eLateFragmentTests;
+        destinationStage = vk::PipelineStageFlagBits::eEarlyFragmentTests | vk::PipelineStageFlagBits::eLateFragmentTests;
     } else if (oldLayout == vk::ImageLayout::eColorAttachmentOptimal && newLayout == vk::ImageLayout::ePresentSrcKHR) {
         barrier.srcAccessMask = vk::AccessFlagBits::eColorAttachmentWrite;
         barrier.dstAccessMask = {};
@@ -813,9 +2674,79 @@ void Graphics::cmdTransitionImageLayout(vk::CommandBuffer cmdBuffer, vk::Image i
                               1, &barrier);
 }
 
-int main() {
+static Options parseOptions(int argc, char** argv) {
+    Options options;
+
+    for (int i = 1; i < argc; i++) {
+        std::string argument = argv[i];
+
+        if (argument == "--binding-mode=set") {
+            options.bindingMode = BindingMode::DescriptorSet;
+        } else if (argument == "--binding-mode=push") {
+            options.bindingMode = BindingMode::PushDescriptor;
+        } else if (argument == "--binding-mode=buffer") {
+            options.bindingMode = BindingMode::DescriptorBuffer;
+        } else if (argument == "--benchmark-binding") {
+            options.benchmarkBinding = true;
+        } else if (argument.starts_with("--texture=")) {
+            options.texturePaths.push_back(argument.substr(strlen("--texture=")));
+        } else if (argument.starts_with("--texture-budget-mb=")) {
+            options.textureBudget = std::stoull(argument.substr(strlen("--texture-budget-mb="))) * 1024 * 1024;
+        } else if (argument.starts_with("--memory-limit-percent=")) {
+            options.memoryLimitPercent = std::stoul(argument.substr(strlen("--memory-limit-percent=")));
+        } else if (argument.starts_with("--mesh=")) {
+            options.meshPath = argument.substr(strlen("--mesh="));
+        } else if (argument == "--render-path=vertex") {
+            options.renderPath = RenderPath::Vertex;
+        } else if (argument == "--render-path=compute") {
+            options.renderPath = RenderPath::ComputeIndirect;
+        } else if (argument == "--render-path=mesh") {
+            options.renderPath = RenderPath::MeshShader;
+        } else if (argument.starts_with("--instance-grid=")) {
+            options.instanceGrid = std::max<uint32_t>(std::stoul(argument.substr(strlen("--instance-grid="))), 1);
+        } else if (argument.starts_with("--lod-threshold=")) {
+            options.lodThreshold = std::stof(argument.substr(strlen("--lod-threshold=")));
+        } else if (argument == "--no-occlusion-culling") {
+            options.occlusionCulling = false;
+        } else if (argument.starts_with("--lights=")) {
+            options.lightCount = std::stoul(argument.substr(strlen("--lights=")));
+        } else if (argument == "--shading=forward") {
+            options.deferredShading = false;
+        } else if (argument == "--shading=deferred") {
+            options.deferredShading = true;
+        } else if (argument.starts_with("--dynamic-resolution=")) {
+            options.frameTimeTarget = std::stod(argument.substr(strlen("--dynamic-resolution=")));
+        } else if (argument == "--low-latency") {
+            options.lowLatency = true;
+        } else if (argument.starts_with("--fps-limit=")) {
+            options.frameRateLimit = std::stod(argument.substr(strlen("--fps-limit=")));
+        } else if (argument == "--present=latency") {
+            options.presentPolicy = PresentPolicy::Latency;
+        } else if (argument == "--present=throughput") {
+            options.presentPolicy = PresentPolicy::Throughput;
+        } else if (argument == "--present=power") {
+            options.presentPolicy = PresentPolicy::Power;
+        } else if (argument == "--present=tear-free") {
+            options.presentPolicy = PresentPolicy::TearFree;
+        } else if (argument.starts_with("--trace=")) {
+            options.tracePath = argument.substr(strlen("--trace="));
+        } else if (argument.starts_with("--msaa=")) {
+            options.msaaSamples = std::max<uint32_t>(std::stoul(argument.substr(strlen("--msaa="))), 1);
+        } else {
+            std::cerr << "unknown argument " << argument << std::endl;
+        }
+    }
+
+    return options;
+}
+
+int main(int argc, char** argv) {
     try {
-        std::unique_ptr<Graphics> graphics = std::make_unique<Graphics>();
+        auto options = parseOptions(argc, argv);
+        std::unique_ptr<Graphics> graphics = std::make_unique<Graphics>(options);
+        if (options.benchmarkBinding) {
+            graphics->benchmarkBindingModes();
+        }
         graphics->runMainLoop();
     } catch (std::exception& e) {
         std::cerr << e.what() << std::endl;
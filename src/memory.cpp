@@ -0,0 +1,223 @@
+#include "memory.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+bool MemoryAllocator::checkBudgetSupport(vk::PhysicalDevice physDevice) {
+    auto availableExtensions = physDevice.enumerateDeviceExtensionProperties();
+    return std::any_of(availableExtensions.begin(), availableExtensions.end(),
+                       [](const vk::ExtensionProperties &extension) {
+                           return std::strcmp(extension.extensionName, budgetExtension()) == 0;
+                       });
+}
+
+const char *MemoryAllocator::budgetExtension() {
+    return VK_EXT_MEMORY_BUDGET_EXTENSION_NAME;
+}
+
+void MemoryAllocator::create(vk::PhysicalDevice physDevice, vk::Device logicalDevice, bool bufferDeviceAddress,
+                             bool memoryBudget, uint32_t limitPercent) {
+    physicalDevice = physDevice;
+    device = logicalDevice;
+    properties = physDevice.getMemoryProperties();
+    for (uint32_t heap = 0; heap < VK_MAX_MEMORY_HEAPS; heap++) {
+        heapUsages[heap] = 0;
+        reportedUsages[heap] = 0;
+        usagesAtReport[heap] = 0;
+        // the usual estimate of what a process can use without the extension
+        heapBudgets[heap] = heap < properties.memoryHeapCount ? properties.memoryHeaps[heap].size * 8 / 10 : 0;
+    }
+    overLimitCount = 0;
+    bufferDeviceAddressEnabled = bufferDeviceAddress;
+    memoryBudgetEnabled = memoryBudget;
+    softLimitPercent = std::clamp(limitPercent, 1u, 100u);
+
+    updateBudget();
+}
+
+void MemoryAllocator::destroy() {
+    std::lock_guard lock(listenerMutex);
+    pressureListeners.clear();
+}
+
+void MemoryAllocator::updateBudget() {
+    if (memoryBudgetEnabled) {
+        auto chain = physicalDevice.getMemoryProperties2<vk::PhysicalDeviceMemoryProperties2,
+                                                         vk::PhysicalDeviceMemoryBudgetPropertiesEXT>();
+        const auto &budgetProperties = chain.get<vk::PhysicalDeviceMemoryBudgetPropertiesEXT>();
+        for (uint32_t heap = 0; heap < properties.memoryHeapCount; heap++) {
+            usagesAtReport[heap].store(heapUsages[heap].load(std::memory_order_relaxed), std::memory_order_relaxed);
+            reportedUsages[heap].store(budgetProperties.heapUsage[heap], std::memory_order_relaxed);
+            heapBudgets[heap].store(budgetProperties.heapBudget[heap], std::memory_order_relaxed);
+        }
+    }
+
+    std::lock_guard lock(listenerMutex);
+    for (uint32_t heap = 0; heap < properties.memoryHeapCount; heap++) {
+        auto budget = heapBudget(heap);
+        if (budget.usage <= budget.softLimit) {
+            continue;
+        }
+
+        auto excess = budget.usage - budget.softLimit;
+        for (auto &[id, listener] : pressureListeners) {
+            excess -= std::min(excess, listener(heap, excess));
+            if (excess == 0) {
+                break;
+            }
+        }
+    }
+}
+
+uint32_t MemoryAllocator::addPressureListener(PressureListener listener) {
+    std::lock_guard lock(listenerMutex);
+    auto id = nextListenerId++;
+    pressureListeners.emplace_back(id, std::move(listener));
+    return id;
+}
+
+void MemoryAllocator::removePressureListener(uint32_t id) {
+    std::lock_guard lock(listenerMutex);
+    std::erase_if(pressureListeners, [id](const auto &entry) { return entry.first == id; });
+}
+
+HeapBudget MemoryAllocator::heapBudget(uint32_t heapIndex) const {
+    auto usage = heapUsages[heapIndex].load(std::memory_order_relaxed);
+    if (memoryBudgetEnabled) {
+        // the driver's usage includes what other parts of the process allocated, like the swap chain
+        auto reported = reportedUsages[heapIndex].load(std::memory_order_relaxed) + usage;
+        auto atReport = usagesAtReport[heapIndex].load(std::memory_order_relaxed);
+        usage = reported > atReport ? reported - atReport : 0;
+    }
+
+    auto budget = heapBudgets[heapIndex].load(std::memory_order_relaxed);
+    return HeapBudget{
+            .usage = usage,
+            .budget = budget,
+            .softLimit = budget / 100 * softLimitPercent,
+    };
+}
+
+vk::DeviceSize MemoryAllocator::headroom(uint32_t heapIndex) const {
+    auto budget = heapBudget(heapIndex);
+    return budget.softLimit > budget.usage ? budget.softLimit - budget.usage : 0;
+}
+
+std::optional<uint32_t> MemoryAllocator::findMemoryType(uint32_t typeBits, vk::MemoryPropertyFlags flags,
+                                                        std::optional<vk::DeviceSize> size) const {
+    for (uint32_t i = 0; i < properties.memoryTypeCount; i++) {
+        if ((typeBits & (1u << i)) && (properties.memoryTypes[i].propertyFlags & flags) == flags &&
+            (!size || headroom(properties.memoryTypes[i].heapIndex) >= *size)) {
+            return i;
+        }
+    }
+
+    return std::nullopt;
+}
+
+Allocation MemoryAllocator::allocate(const vk::MemoryRequirements &requirements, vk::MemoryPropertyFlags required,
+                                     vk::MemoryPropertyFlags preferred, bool deviceAddress) {
+    auto memoryType = findMemoryType(requirements.memoryTypeBits, required | preferred, requirements.size);
+    if (!memoryType) {
+        memoryType = findMemoryType(requirements.memoryTypeBits, required, requirements.size);
+    }
+    // the limit is soft, the pressure listeners are asked to make room at the next update
+    if (!memoryType) {
+        memoryType = findMemoryType(requirements.memoryTypeBits, required | preferred);
+        if (!memoryType) {
+            memoryType = findMemoryType(requirements.memoryTypeBits, required);
+        }
+        if (memoryType) {
+            overLimitCount.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    if (!memoryType) {
+        throw std::runtime_error("could not find a suitable memory type");
+    }
+
+    vk::MemoryAllocateFlagsInfo allocateFlags{
+            .flags = vk::MemoryAllocateFlagBits::eDeviceAddress,
+    };
+
+    vk::MemoryAllocateInfo allocInfo{
+            .pNext = deviceAddress ? &allocateFlags : nullptr,
+            .allocationSize = requirements.size,
+            .memoryTypeIndex = *memoryType,
+    };
+
+    Allocation allocation{
+            .memory = device.allocateMemory(allocInfo),
+            .size = requirements.size,
+            .memoryTypeIndex = *memoryType,
+            .heapIndex = properties.memoryTypes[*memoryType].heapIndex,
+    };
+
+    if (properties.memoryTypes[*memoryType].propertyFlags & vk::MemoryPropertyFlagBits::eHostVisible) {
+        allocation.mapped = device.mapMemory(allocation.memory, 0, VK_WHOLE_SIZE);
+    }
+
+    heapUsages[allocation.heapIndex].fetch_add(allocation.size, std::memory_order_relaxed);
+    return allocation;
+}
+
+void MemoryAllocator::free(Allocation &allocation) {
+    if (!allocation.memory) {
+        return;
+    }
+
+    if (allocation.mapped) {
+        device.unmapMemory(allocation.memory);
+    }
+    device.free(allocation.memory);
+    heapUsages[allocation.heapIndex].fetch_sub(allocation.size, std::memory_order_relaxed);
+
+    allocation = {};
+}
+
+Buffer MemoryAllocator::createBuffer(vk::DeviceSize size, vk::BufferUsageFlags usage, vk::MemoryPropertyFlags required,
+                                     vk::MemoryPropertyFlags preferred) {
+    Buffer buffer{
+            .buffer = device.createBuffer({
+                    .size = size,
+                    .usage = usage,
+                    .sharingMode = vk::SharingMode::eExclusive,
+            }),
+            .size = size,
+    };
+
+    bool deviceAddress = bufferDeviceAddressEnabled && (usage & vk::BufferUsageFlagBits::eShaderDeviceAddress);
+
+    buffer.allocation = allocate(device.getBufferMemoryRequirements(buffer.buffer), required, preferred, deviceAddress);
+    device.bindBufferMemory(buffer.buffer, buffer.allocation.memory, 0);
+
+    if (deviceAddress) {
+        buffer.address = device.getBufferAddress({.buffer = buffer.buffer});
+    }
+
+    return buffer;
+}
+
+void MemoryAllocator::destroyBuffer(Buffer &buffer) {
+    device.destroy(buffer.buffer);
+    free(buffer.allocation);
+    buffer = {};
+}
+
+Image MemoryAllocator::createImage(const vk::ImageCreateInfo &createInfo, vk::MemoryPropertyFlags required,
+                                   vk::MemoryPropertyFlags preferred) {
+    Image image{
+            .image = device.createImage(createInfo),
+    };
+
+    image.allocation = allocate(device.getImageMemoryRequirements(image.image), required, preferred);
+    device.bindImageMemory(image.image, image.allocation.memory, 0);
+
+    return image;
+}
+
+void MemoryAllocator::destroyImage(Image &image) {
+    device.destroy(image.image);
+    free(image.allocation);
+    image = {};
+}
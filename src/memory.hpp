@@ -0,0 +1,120 @@
+#pragma once
+
+#define VULKAN_HPP_NO_CONSTRUCTORS
+#include <vulkan/vulkan.hpp>
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <utility>
+#include <vector>
+
+struct Allocation {
+    vk::DeviceMemory memory;
+    vk::DeviceSize size = 0;
+    uint32_t memoryTypeIndex = 0;
+    uint32_t heapIndex = 0;
+    void *mapped = nullptr;
+};
+
+struct Buffer {
+    vk::Buffer buffer;
+    vk::DeviceSize size = 0;
+    vk::DeviceAddress address = 0;
+    Allocation allocation;
+};
+
+struct Image {
+    vk::Image image;
+    Allocation allocation;
+};
+
+struct HeapBudget {
+    vk::DeviceSize usage = 0;     // of this process, estimated between budget updates
+    vk::DeviceSize budget = 0;    // what the process can use before the driver starts paging
+    vk::DeviceSize softLimit = 0; // the share of the budget the allocator aims to stay below
+};
+
+// Thin wrapper around vkAllocateMemory that picks memory types, keeps host visible memory persistently mapped and
+// tracks how many bytes live in every heap. Every resource gets its own allocation. Allocating and freeing may happen on
+// several threads at once.
+//
+// Every heap has a soft limit, a share of its budget. With VK_EXT_memory_budget the budget and the usage of the whole
+// process are read from the driver once per frame, so other processes on the same GPU shrink it, without the budget is
+// 80% of the heap size. Allocations go to memory types of other heaps rather than over the limit when the required
+// flags allow it, and once a heap's usage is over its limit the registered pressure listeners are asked to release
+// the difference.
+class MemoryAllocator {
+public:
+    // Called with a heap and the bytes its usage exceeds the soft limit by, returns how many bytes the listener will
+    // release. Listeners are called on the thread calling updateBudget(), in the order they were added.
+    using PressureListener = std::function<vk::DeviceSize(uint32_t heapIndex, vk::DeviceSize excess)>;
+
+    // VK_EXT_memory_budget
+    static bool checkBudgetSupport(vk::PhysicalDevice physDevice);
+    static const char *budgetExtension();
+
+    // the budget queries require the extension of checkBudgetSupport() to be enabled
+    void create(vk::PhysicalDevice physDevice, vk::Device device, bool bufferDeviceAddress, bool memoryBudget,
+                uint32_t softLimitPercent);
+    void destroy();
+
+    // Reads the budgets and notifies the pressure listeners of heaps over their soft limit, once per frame.
+    void updateBudget();
+    uint32_t addPressureListener(PressureListener listener);
+    void removePressureListener(uint32_t id);
+
+    // memory types of heaps over their soft limit are avoided, preferred flags are dropped if no memory type
+    // satisfies them together with the required ones
+    Allocation allocate(const vk::MemoryRequirements &requirements, vk::MemoryPropertyFlags required,
+                        vk::MemoryPropertyFlags preferred = {}, bool deviceAddress = false);
+    void free(Allocation &allocation);
+
+    Buffer createBuffer(vk::DeviceSize size, vk::BufferUsageFlags usage, vk::MemoryPropertyFlags required,
+                        vk::MemoryPropertyFlags preferred = {});
+    void destroyBuffer(Buffer &buffer);
+
+    Image createImage(const vk::ImageCreateInfo &createInfo, vk::MemoryPropertyFlags required,
+                      vk::MemoryPropertyFlags preferred = {});
+    void destroyImage(Image &image);
+
+    // bytes allocated through this allocator
+    [[nodiscard]] vk::DeviceSize heapUsage(uint32_t heapIndex) const {
+        return heapUsages[heapIndex].load(std::memory_order_relaxed);
+    }
+    [[nodiscard]] HeapBudget heapBudget(uint32_t heapIndex) const;
+    // bytes that can be allocated in the heap before its usage reaches the soft limit
+    [[nodiscard]] vk::DeviceSize headroom(uint32_t heapIndex) const;
+    // allocations that went over a soft limit because no other heap had a suitable memory type
+    [[nodiscard]] uint64_t overLimitAllocations() const { return overLimitCount.load(std::memory_order_relaxed); }
+    [[nodiscard]] bool memoryBudget() const { return memoryBudgetEnabled; }
+    [[nodiscard]] const vk::PhysicalDeviceMemoryProperties &memoryProperties() const { return properties; }
+    [[nodiscard]] bool bufferDeviceAddress() const { return bufferDeviceAddressEnabled; }
+
+private:
+    // with a size only memory types whose heap has that much headroom qualify
+    std::optional<uint32_t> findMemoryType(uint32_t typeBits, vk::MemoryPropertyFlags flags,
+                                           std::optional<vk::DeviceSize> size = std::nullopt) const;
+
+    vk::PhysicalDevice physicalDevice;
+    vk::Device device;
+    vk::PhysicalDeviceMemoryProperties properties;
+    std::array<std::atomic<vk::DeviceSize>, VK_MAX_MEMORY_HEAPS> heapUsages{};
+    bool bufferDeviceAddressEnabled = false;
+
+    bool memoryBudgetEnabled = false;
+    uint32_t softLimitPercent = 100;
+    // the driver's budget and usage at the last update, and this allocator's usage at that time, so allocations made
+    // since can be added to the driver's figure
+    std::array<std::atomic<vk::DeviceSize>, VK_MAX_MEMORY_HEAPS> heapBudgets{};
+    std::array<std::atomic<vk::DeviceSize>, VK_MAX_MEMORY_HEAPS> reportedUsages{};
+    std::array<std::atomic<vk::DeviceSize>, VK_MAX_MEMORY_HEAPS> usagesAtReport{};
+    std::atomic<uint64_t> overLimitCount = 0;
+
+    std::mutex listenerMutex;
+    std::vector<std::pair<uint32_t, PressureListener>> pressureListeners;
+    uint32_t nextListenerId = 0;
+};
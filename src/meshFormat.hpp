@@ -0,0 +1,112 @@
+#pragma once
+
+#include <cstdint>
+
+// On-disk layout of a cooked mesh (.vmesh), written by the mesh cooker (tools/meshCooker): a MeshFileHeader
+// followed by the sections listed in MeshSection. Every section starts at a multiple of MeshSectionAlignment and the
+// sections are stored back to back in section order, so the whole payload can be copied into a single GPU buffer
+// with one memcpy and every section can be bound at its file offset (minus the payload start) without fixups.
+// All data is little endian and already in the layout the shaders consume.
+
+constexpr uint32_t MeshFileMagic = 0x48534d56; // "VMSH"
+constexpr uint32_t MeshFileVersion = 4;
+
+// large enough for every minStorageBufferOffsetAlignment allowed by the spec
+constexpr uint64_t MeshSectionAlignment = 256;
+
+constexpr uint32_t MaxMeshletVertices = 64;
+constexpr uint32_t MaxMeshletTriangles = 124;
+
+constexpr uint32_t MaxMeshLods = 8;
+
+// Layout of the vertex section. Quantized vertices take half the memory and fetch bandwidth of float ones, the
+// shaders decode them with the vertex format as a specialization constant.
+enum MeshVertexFormat : uint32_t {
+    MeshVertexFormatFloat,     // MeshVertex
+    MeshVertexFormatQuantized, // QuantizedMeshVertex
+    MeshVertexFormatCount,
+};
+
+enum MeshSection : uint32_t {
+    MeshSectionVertices,         // MeshVertex or QuantizedMeshVertex [vertexCount], see MeshFileHeader::vertexFormat
+    MeshSectionIndices,          // uint32_t[indexCount], triangle list
+    MeshSectionMeshlets,         // Meshlet[meshletCount]
+    MeshSectionMeshletVertices,  // uint32_t indices into the vertex section, referenced by Meshlet::vertexOffset
+    MeshSectionMeshletTriangles, // uint8_t triples into the meshlet's vertices, every meshlet padded to 4 bytes
+    MeshSectionLods,             // MeshLod[lodCount], finest level first
+    MeshSectionCount,
+};
+
+struct MeshSectionInfo {
+    uint64_t offset;
+    uint64_t size;
+};
+
+struct MeshFileHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    uint32_t meshletCount;
+    uint32_t vertexFormat; // MeshVertexFormat
+    uint32_t lodCount;     // at least 1, at most MaxMeshLods
+    uint32_t reserved;
+    float boundsMin[3];
+    float boundsMax[3];
+    MeshSectionInfo sections[MeshSectionCount];
+};
+
+struct MeshVertex {
+    float position[3];
+    float normal[3];
+    float uv[2];
+};
+
+// Positions are unorm16 within the mesh bounds (position = boundsMin + q / 65535 * (boundsMax - boundsMin)), the
+// normal is octahedral encoded as snorm16 and the uv coordinates are half floats.
+struct QuantizedMeshVertex {
+    uint16_t position[4]; // the fourth component only pads the position to 8 bytes
+    int16_t normal[2];
+    uint16_t uv[2];
+};
+
+constexpr uint64_t meshVertexSize(uint32_t vertexFormat) {
+    return vertexFormat == MeshVertexFormatQuantized ? sizeof(QuantizedMeshVertex) : sizeof(MeshVertex);
+}
+
+constexpr const char *meshVertexFormatName(uint32_t vertexFormat) {
+    return vertexFormat == MeshVertexFormatQuantized ? "quantized" : "float";
+}
+
+// Matches the Meshlet struct in shaders/scene.glsl. A meshlet is invisible when its bounding sphere is outside the
+// frustum or when the camera lies inside the backface cone: dot(center - camera, coneAxis) >=
+// coneCutoff * length(center - camera) + radius. A coneCutoff of 1 disables the cone test.
+struct Meshlet {
+    uint32_t vertexOffset;   // first entry in the meshlet vertex section
+    uint32_t triangleOffset; // byte offset into the meshlet triangle section
+    uint32_t vertexCount;
+    uint32_t triangleCount;
+    float center[3];
+    float radius;
+    float coneAxis[3];
+    float coneCutoff;
+};
+
+// A level of detail is a range of the index section and a range of the meshlet section, all levels share the vertex
+// section. The indices and meshlets of every level are stored after those of the next finer one.
+struct MeshLod {
+    uint32_t indexOffset;
+    uint32_t indexCount;
+    uint32_t meshletOffset;
+    uint32_t meshletCount;
+    // Largest object space distance, estimated with quadric error metrics, by which the level deviates from the source
+    // mesh. The renderer projects it to pixels to pick the coarsest level whose error stays invisible.
+    float error;
+    uint32_t reserved[3];
+};
+
+static_assert(sizeof(MeshFileHeader) <= MeshSectionAlignment);
+static_assert(sizeof(MeshVertex) == 32);
+static_assert(sizeof(QuantizedMeshVertex) == 16);
+static_assert(sizeof(Meshlet) == 48);
+static_assert(sizeof(MeshLod) == 32);
@@ -0,0 +1,239 @@
+#include "meshLoader.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+MappedFile::MappedFile(const std::string &path) {
+    fileHandle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                             FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (fileHandle == INVALID_HANDLE_VALUE) {
+        fileHandle = nullptr;
+        throw std::runtime_error("could not open " + path);
+    }
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(fileHandle, &fileSize) || fileSize.QuadPart == 0) {
+        CloseHandle(fileHandle);
+        fileHandle = nullptr;
+        throw std::runtime_error("could not map " + path);
+    }
+
+    mappingHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mappingHandle) {
+        mappedData = static_cast<const std::byte *>(MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0));
+    }
+    if (!mappedData) {
+        if (mappingHandle) {
+            CloseHandle(mappingHandle);
+            mappingHandle = nullptr;
+        }
+        CloseHandle(fileHandle);
+        fileHandle = nullptr;
+        throw std::runtime_error("could not map " + path);
+    }
+
+    mappedSize = static_cast<size_t>(fileSize.QuadPart);
+}
+
+MappedFile::~MappedFile() {
+    if (mappedData) {
+        UnmapViewOfFile(mappedData);
+    }
+    if (mappingHandle) {
+        CloseHandle(mappingHandle);
+    }
+    if (fileHandle) {
+        CloseHandle(fileHandle);
+    }
+}
+#else
+MappedFile::MappedFile(const std::string &path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("could not open " + path);
+    }
+
+    struct stat status{};
+    if (fstat(fd, &status) != 0 || status.st_size == 0) {
+        close(fd);
+        throw std::runtime_error("could not map " + path);
+    }
+
+    auto size = static_cast<size_t>(status.st_size);
+    void *data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    // the mapping keeps its own reference to the file
+    close(fd);
+    if (data == MAP_FAILED) {
+        throw std::runtime_error("could not map " + path);
+    }
+
+    // the payload is read front to back exactly once, let the kernel read ahead aggressively
+    madvise(data, size, MADV_SEQUENTIAL);
+    madvise(data, size, MADV_WILLNEED);
+
+    mappedData = static_cast<const std::byte *>(data);
+    mappedSize = size;
+}
+
+MappedFile::~MappedFile() {
+    if (mappedData) {
+        munmap(const_cast<std::byte *>(mappedData), mappedSize);
+    }
+}
+#endif
+
+void MeshLoader::create(vk::Device logicalDevice, MemoryAllocator &memoryAllocator, UploadBatcher &uploadBatcher) {
+    device = logicalDevice;
+    allocator = &memoryAllocator;
+    batcher = &uploadBatcher;
+
+    // Writing through a mapping only pays off when all of video memory is host visible (integrated GPUs and
+    // resizable BAR). A small BAR window is better left to resources that are rewritten every frame.
+    const auto &properties = allocator->memoryProperties();
+    vk::DeviceSize largestDeviceHeap = 0;
+    vk::DeviceSize largestMappableDeviceHeap = 0;
+    for (uint32_t i = 0; i < properties.memoryTypeCount; i++) {
+        auto flags = properties.memoryTypes[i].propertyFlags;
+        if (!(flags & vk::MemoryPropertyFlagBits::eDeviceLocal)) {
+            continue;
+        }
+
+        auto heapSize = properties.memoryHeaps[properties.memoryTypes[i].heapIndex].size;
+        largestDeviceHeap = std::max(largestDeviceHeap, heapSize);
+        if ((flags & vk::MemoryPropertyFlagBits::eHostVisible) && (flags & vk::MemoryPropertyFlagBits::eHostCoherent)) {
+            largestMappableDeviceHeap = std::max(largestMappableDeviceHeap, heapSize);
+        }
+    }
+    directUpload = largestDeviceHeap > 0 && largestMappableDeviceHeap == largestDeviceHeap;
+}
+
+void MeshLoader::destroy() {
+}
+
+Mesh MeshLoader::load(const std::string &path) {
+    MappedFile file(path);
+    return upload(file.data(), file.size(), path);
+}
+
+Mesh MeshLoader::upload(const std::byte *fileData, size_t fileSize, const std::string &name) {
+    Mesh mesh;
+    if (fileSize < sizeof(MeshFileHeader)) {
+        throw std::runtime_error("invalid mesh file " + name);
+    }
+    std::memcpy(&mesh.header, fileData, sizeof(MeshFileHeader));
+
+    const auto &header = mesh.header;
+    if (header.magic != MeshFileMagic || header.version != MeshFileVersion || header.indexCount == 0 ||
+        header.vertexFormat >= MeshVertexFormatCount) {
+        throw std::runtime_error("invalid mesh file " + name);
+    }
+
+    // the sections have to be aligned, in order and inside the file, then the payload is one contiguous range
+    uint64_t end = sizeof(MeshFileHeader);
+    for (uint32_t section = 0; section < MeshSectionCount; section++) {
+        const auto &info = header.sections[section];
+        if (info.offset % MeshSectionAlignment != 0 || info.offset < end || info.offset > fileSize ||
+            info.size > fileSize - info.offset) {
+            throw std::runtime_error("invalid mesh file " + name);
+        }
+        end = info.offset + info.size;
+    }
+    if (header.sections[MeshSectionVertices].size != header.vertexCount * meshVertexSize(header.vertexFormat) ||
+        header.sections[MeshSectionIndices].size != uint64_t(header.indexCount) * sizeof(uint32_t) ||
+        header.sections[MeshSectionMeshlets].size != uint64_t(header.meshletCount) * sizeof(Meshlet) ||
+        header.lodCount == 0 || header.lodCount > MaxMeshLods ||
+        header.sections[MeshSectionLods].size != uint64_t(header.lodCount) * sizeof(MeshLod)) {
+        throw std::runtime_error("invalid mesh file " + name);
+    }
+
+    mesh.lods.resize(header.lodCount);
+    std::memcpy(mesh.lods.data(), fileData + header.sections[MeshSectionLods].offset, header.lodCount * sizeof(MeshLod));
+    for (const auto &lod : mesh.lods) {
+        if (uint64_t(lod.indexOffset) + lod.indexCount > header.indexCount ||
+            uint64_t(lod.meshletOffset) + lod.meshletCount > header.meshletCount) {
+            throw std::runtime_error("invalid mesh file " + name);
+        }
+    }
+
+    // the same holds for the ranges every meshlet reads from the meshlet vertex and triangle sections
+    const auto &meshletVertices = header.sections[MeshSectionMeshletVertices];
+    const auto &meshletTriangles = header.sections[MeshSectionMeshletTriangles];
+    if (meshletVertices.size % sizeof(uint32_t) != 0) {
+        throw std::runtime_error("invalid mesh file " + name);
+    }
+    const auto *meshlets = fileData + header.sections[MeshSectionMeshlets].offset;
+    const auto *triangles = reinterpret_cast<const uint8_t *>(fileData + meshletTriangles.offset);
+    for (uint32_t i = 0; i < header.meshletCount; i++) {
+        Meshlet meshlet;
+        std::memcpy(&meshlet, meshlets + i * sizeof(Meshlet), sizeof(Meshlet));
+        if (meshlet.vertexCount > MaxMeshletVertices || meshlet.triangleCount > MaxMeshletTriangles ||
+            uint64_t(meshlet.vertexOffset) + meshlet.vertexCount > meshletVertices.size / sizeof(uint32_t) ||
+            uint64_t(meshlet.triangleOffset) + uint64_t(meshlet.triangleCount) * 3 > meshletTriangles.size) {
+            throw std::runtime_error("invalid mesh file " + name);
+        }
+        for (uint32_t corner = 0; corner < meshlet.triangleCount * 3; corner++) {
+            if (triangles[meshlet.triangleOffset + corner] >= meshlet.vertexCount) {
+                throw std::runtime_error("invalid mesh file " + name);
+            }
+        }
+    }
+
+    // and every vertex index, from the index buffer or a meshlet, has to name a vertex of the vertex section
+    auto checkVertexIndices = [&](const MeshSectionInfo &section) {
+        const auto *indices = fileData + section.offset;
+        for (uint64_t i = 0; i < section.size / sizeof(uint32_t); i++) {
+            uint32_t index;
+            std::memcpy(&index, indices + i * sizeof(uint32_t), sizeof(uint32_t));
+            if (index >= header.vertexCount) {
+                throw std::runtime_error("invalid mesh file " + name);
+            }
+        }
+    };
+    checkVertexIndices(header.sections[MeshSectionIndices]);
+    checkVertexIndices(meshletVertices);
+
+    mesh.payloadOffset = header.sections[0].offset;
+    auto payloadSize = end - mesh.payloadOffset;
+    const auto *payload = fileData + mesh.payloadOffset;
+
+    vk::BufferUsageFlags usage = vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eIndexBuffer |
+                                 vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst;
+    // the sections are registered in the bindless set, which needs their addresses in descriptor buffer mode
+    if (allocator->bufferDeviceAddress()) {
+        usage |= vk::BufferUsageFlagBits::eShaderDeviceAddress;
+    }
+
+    if (directUpload) {
+        mesh.buffer = allocator->createBuffer(payloadSize, usage, vk::MemoryPropertyFlagBits::eDeviceLocal,
+                                              vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
+        auto flags = allocator->memoryProperties().memoryTypes[mesh.buffer.allocation.memoryTypeIndex].propertyFlags;
+        if (mesh.buffer.allocation.mapped && (flags & vk::MemoryPropertyFlagBits::eHostCoherent)) {
+            std::memcpy(mesh.buffer.allocation.mapped, payload, payloadSize);
+            return mesh;
+        }
+    } else {
+        mesh.buffer = allocator->createBuffer(payloadSize, usage, vk::MemoryPropertyFlagBits::eDeviceLocal);
+    }
+
+    batcher->upload(mesh.buffer, 0, payload, payloadSize);
+
+    return mesh;
+}
+
+void MeshLoader::destroyMesh(Mesh &mesh) {
+    allocator->destroyBuffer(mesh.buffer);
+    mesh = {};
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "memory.hpp"
+#include "meshFormat.hpp"
+#include "uploadBatcher.hpp"
+
+#define VULKAN_HPP_NO_CONSTRUCTORS
+#include <vulkan/vulkan.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Read-only memory mapping of a whole file. The pages are faulted in straight from the page cache when they are
+// first touched, so copying out of the mapping costs one memcpy instead of a read into an intermediate buffer.
+class MappedFile {
+public:
+    MappedFile() = default;
+    explicit MappedFile(const std::string &path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    [[nodiscard]] const std::byte *data() const { return mappedData; }
+    [[nodiscard]] size_t size() const { return mappedSize; }
+
+private:
+    const std::byte *mappedData = nullptr;
+    size_t mappedSize = 0;
+#ifdef _WIN32
+    void *fileHandle = nullptr;
+    void *mappingHandle = nullptr;
+#endif
+};
+
+// A cooked mesh living in one device local buffer. The sections keep their relative file layout, so
+// sectionOffset(MeshSectionIndices) is directly usable for bindIndexBuffer and so on.
+struct Mesh {
+    Buffer buffer;
+    MeshFileHeader header{};
+    std::vector<MeshLod> lods; // host copy of the LOD section for level selection
+    vk::DeviceSize payloadOffset = 0; // file offset of the first section, which sits at offset 0 of the buffer
+
+    [[nodiscard]] vk::DeviceSize sectionOffset(MeshSection section) const {
+        return header.sections[section].offset - payloadOffset;
+    }
+    [[nodiscard]] vk::DeviceSize sectionSize(MeshSection section) const { return header.sections[section].size; }
+};
+
+// Loads .vmesh files (see meshFormat.hpp) into video memory. The file is mapped and the section payload is copied
+// in one piece into host visible memory: directly into the mesh buffer when the device has host visible video
+// memory, otherwise into the upload batcher's staging pages, and it is copied with the batcher's next flush. Nothing
+// is parsed or converted.
+class MeshLoader {
+public:
+    void create(vk::Device device, MemoryAllocator &allocator, UploadBatcher &uploadBatcher);
+    void destroy();
+
+    Mesh load(const std::string &path);
+    // uploads a mesh that is already in the cooked layout, fileData points at its MeshFileHeader
+    Mesh upload(const std::byte *fileData, size_t fileSize, const std::string &name);
+    void destroyMesh(Mesh &mesh);
+
+private:
+    vk::Device device;
+    MemoryAllocator *allocator = nullptr;
+    UploadBatcher *batcher = nullptr;
+    bool directUpload = false;
+};
@@ -0,0 +1,169 @@
+#include "meshletCulling.hpp"
+#include "meshletCullShader.h"
+
+#include <cstring>
+
+const char *renderPathName(RenderPath path) {
+    switch (path) {
+        case RenderPath::Vertex:
+            return "vertex";
+        case RenderPath::ComputeIndirect:
+            return "compute indirect";
+        case RenderPath::MeshShader:
+            return "mesh shader";
+    }
+
+    return "unknown";
+}
+
+bool MeshletCuller::checkSupport(vk::PhysicalDevice physDevice) {
+    auto features = physDevice.getFeatures();
+    if (!features.multiDrawIndirect || !features.drawIndirectFirstInstance) {
+        return false;
+    }
+
+    for (const auto &extension : physDevice.enumerateDeviceExtensionProperties()) {
+        if (std::strcmp(extension.extensionName, requiredExtension()) == 0) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void MeshletCuller::enableRequiredFeatures(vk::PhysicalDeviceFeatures &features) {
+    features.multiDrawIndirect = VK_TRUE;
+    features.drawIndirectFirstInstance = VK_TRUE;
+}
+
+const char *MeshletCuller::requiredExtension() {
+    // drawIndirectCount is core in 1.2 but optional, enabling the extension enables it without having to chain
+    // VkPhysicalDeviceVulkan12Features next to the individual feature structs the device is created with
+    return VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME;
+}
+
+void MeshletCuller::create(vk::Device logicalDevice, MemoryAllocator &memoryAllocator, BindlessDescriptorSet &bindlessSet,
+                           const ResourceBinder &resourceBinder, uint32_t frameCount, uint32_t maxDrawCount) {
+    device = logicalDevice;
+    allocator = &memoryAllocator;
+    bindless = &bindlessSet;
+    binder = &resourceBinder;
+    maxDraws = maxDrawCount;
+
+    auto setLayout = bindless->layout();
+    vk::PushConstantRange pushConstantRange{
+            .stageFlags = vk::ShaderStageFlagBits::eCompute,
+            .offset = 0,
+            .size = sizeof(DrawConstants),
+    };
+
+    pipelineLayout = device.createPipelineLayout({
+            .setLayoutCount = 1,
+            .pSetLayouts = &setLayout,
+            .pushConstantRangeCount = 1,
+            .pPushConstantRanges = &pushConstantRange,
+    });
+
+    auto shaderModule = device.createShaderModule({
+            .codeSize = meshlet_cull_spv_len,
+            .pCode = reinterpret_cast<const uint32_t *>(meshlet_cull_spv),
+    });
+
+    pipeline = device.createComputePipeline(nullptr, {
+            .flags = binder->pipelineCreateFlags(),
+            .stage = {
+                    .stage = vk::ShaderStageFlagBits::eCompute,
+                    .module = shaderModule,
+                    .pName = "main",
+            },
+            .layout = pipelineLayout,
+    }).value;
+
+    device.destroyShaderModule(shaderModule);
+
+    vk::BufferUsageFlags usage = vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer |
+                                 vk::BufferUsageFlagBits::eTransferDst;
+    if (allocator->bufferDeviceAddress()) {
+        usage |= vk::BufferUsageFlagBits::eShaderDeviceAddress;
+    }
+
+    for (uint32_t frame = 0; frame < frameCount; frame++) {
+        auto size = CommandsOffset + vk::DeviceSize(maxDraws) * sizeof(MeshletDraw);
+        drawBuffers.push_back(allocator->createBuffer(size, usage, vk::MemoryPropertyFlagBits::eDeviceLocal));
+        drawBufferIndices.push_back(bindless->addStorageBuffer(drawBuffers.back()));
+    }
+}
+
+void MeshletCuller::destroy() {
+    for (size_t frame = 0; frame < drawBuffers.size(); frame++) {
+        bindless->removeStorageBuffer(drawBufferIndices[frame]);
+        allocator->destroyBuffer(drawBuffers[frame]);
+    }
+    drawBuffers.clear();
+    drawBufferIndices.clear();
+
+    device.destroy(pipeline);
+    device.destroy(pipelineLayout);
+}
+
+void MeshletCuller::record(vk::CommandBuffer cmdBuffer, uint32_t frameIndex, const DrawConstants &constants) {
+    beginCull(cmdBuffer, frameIndex, constants);
+    cmdBuffer.dispatch((constants.meshletCount + 63) / 64, constants.instanceCount, 1);
+    endCull(cmdBuffer, frameIndex);
+}
+
+void MeshletCuller::recordIndirect(vk::CommandBuffer cmdBuffer, uint32_t frameIndex, const DrawConstants &constants,
+                                   vk::Buffer dispatchBuffer, vk::DeviceSize dispatchOffset) {
+    beginCull(cmdBuffer, frameIndex, constants);
+    cmdBuffer.dispatchIndirect(dispatchBuffer, dispatchOffset);
+    endCull(cmdBuffer, frameIndex);
+}
+
+void MeshletCuller::beginCull(vk::CommandBuffer cmdBuffer, uint32_t frameIndex, const DrawConstants &constants) {
+    const auto &drawBuffer = drawBuffers[frameIndex];
+
+    // draws recorded earlier in the frame may still read the buffer
+    cmdBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eDrawIndirect | vk::PipelineStageFlagBits::eVertexShader,
+                              vk::PipelineStageFlagBits::eTransfer, {}, 0, nullptr, 0, nullptr, 0, nullptr);
+    cmdBuffer.fillBuffer(drawBuffer.buffer, 0, sizeof(uint32_t), 0);
+
+    vk::BufferMemoryBarrier clearBarrier{
+            .srcAccessMask = vk::AccessFlagBits::eTransferWrite,
+            .dstAccessMask = vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .buffer = drawBuffer.buffer,
+            .offset = 0,
+            .size = VK_WHOLE_SIZE,
+    };
+    cmdBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eComputeShader, {},
+                              0, nullptr, 1, &clearBarrier, 0, nullptr);
+
+    auto pushConstants = constants;
+    pushConstants.drawBufferIndex = drawBufferIndices[frameIndex];
+
+    cmdBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, pipeline);
+    binder->bindGlobal(cmdBuffer, vk::PipelineBindPoint::eCompute, pipelineLayout);
+    cmdBuffer.pushConstants(pipelineLayout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(pushConstants), &pushConstants);
+}
+
+void MeshletCuller::endCull(vk::CommandBuffer cmdBuffer, uint32_t frameIndex) {
+    vk::BufferMemoryBarrier drawBarrier{
+            .srcAccessMask = vk::AccessFlagBits::eShaderWrite,
+            .dstAccessMask = vk::AccessFlagBits::eIndirectCommandRead | vk::AccessFlagBits::eShaderRead,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .buffer = drawBuffers[frameIndex].buffer,
+            .offset = 0,
+            .size = VK_WHOLE_SIZE,
+    };
+    cmdBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader,
+                              vk::PipelineStageFlagBits::eDrawIndirect | vk::PipelineStageFlagBits::eVertexShader, {},
+                              0, nullptr, 1, &drawBarrier, 0, nullptr);
+}
+
+void MeshletCuller::draw(vk::CommandBuffer cmdBuffer, uint32_t frameIndex) const {
+    const auto &drawBuffer = drawBuffers[frameIndex];
+    // the meshlet and instance index after every command are skipped by the stride
+    cmdBuffer.drawIndirectCount(drawBuffer.buffer, CommandsOffset, drawBuffer.buffer, 0, maxDraws, sizeof(MeshletDraw));
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "bindless.hpp"
+#include "memory.hpp"
+#include "resourceBinding.hpp"
+#include "sceneData.hpp"
+
+#define VULKAN_HPP_NO_CONSTRUCTORS
+#include <vulkan/vulkan.hpp>
+
+#include <cstdint>
+#include <vector>
+
+enum class RenderPath {
+    Vertex,          // indexed draw of the whole mesh, no culling
+    ComputeIndirect, // meshlets culled by a compute pass, survivors drawn through drawIndirectCount
+    MeshShader,      // meshlets culled by the task shader and emitted by the mesh shader (VK_EXT_mesh_shader)
+};
+
+const char *renderPathName(RenderPath path);
+
+// Meshlet culling for devices without mesh shaders. A compute pass (shaders/meshletCull.comp) tests the meshlets of
+// every instance's selected level of detail against the frustum and their backface cones and appends a MeshletDraw
+// for each visible one to a per-frame draw buffer. The draws pull their vertices in shaders/meshlet.vert.
+// The draw buffer holds the draw count followed by the draws at CommandsOffset.
+class MeshletCuller {
+public:
+    static constexpr vk::DeviceSize CommandsOffset = 16;
+
+    static bool checkSupport(vk::PhysicalDevice physDevice);
+    static void enableRequiredFeatures(vk::PhysicalDeviceFeatures &features);
+    static const char *requiredExtension();
+
+    void create(vk::Device device, MemoryAllocator &allocator, BindlessDescriptorSet &bindless,
+                const ResourceBinder &resourceBinder, uint32_t frameCount, uint32_t maxDrawCount);
+    void destroy();
+
+    [[nodiscard]] uint32_t drawBufferIndex(uint32_t frameIndex) const { return drawBufferIndices[frameIndex]; }
+
+    // Culls the meshlets of the instances described by constants into the frame's draw buffer. Has to be recorded outside of
+    // rendering, leaves the draw buffer ready for the indirect command read.
+    void record(vk::CommandBuffer cmdBuffer, uint32_t frameIndex, const DrawConstants &constants);
+    // Same as record() but takes the workgroup counts from a VkDispatchIndirectCommand, e.g. the one of an instance
+    // list of the OcclusionCuller. May be recorded more than once per frame, each time replacing the previous draws.
+    void recordIndirect(vk::CommandBuffer cmdBuffer, uint32_t frameIndex, const DrawConstants &constants,
+                        vk::Buffer dispatchBuffer, vk::DeviceSize dispatchOffset);
+    // Issues the draws written by record(), the meshlet pipeline has to be bound.
+    void draw(vk::CommandBuffer cmdBuffer, uint32_t frameIndex) const;
+
+private:
+    void beginCull(vk::CommandBuffer cmdBuffer, uint32_t frameIndex, const DrawConstants &constants);
+    void endCull(vk::CommandBuffer cmdBuffer, uint32_t frameIndex);
+
+    vk::Device device;
+    MemoryAllocator *allocator = nullptr;
+    BindlessDescriptorSet *bindless = nullptr;
+    const ResourceBinder *binder = nullptr;
+    uint32_t maxDraws = 0;
+
+    vk::PipelineLayout pipelineLayout;
+    vk::Pipeline pipeline;
+    std::vector<Buffer> drawBuffers;
+    std::vector<uint32_t> drawBufferIndices;
+};
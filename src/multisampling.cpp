@@ -0,0 +1,167 @@
+#include "multisampling.hpp"
+
+#include <array>
+
+vk::SampleCountFlagBits MultisampleTargets::supportedSampleCount(vk::PhysicalDevice physDevice, uint32_t requested) {
+    auto limits = physDevice.getProperties().limits;
+    auto supported = limits.framebufferColorSampleCounts & limits.framebufferDepthSampleCounts;
+
+    for (auto count : {vk::SampleCountFlagBits::e8, vk::SampleCountFlagBits::e4, vk::SampleCountFlagBits::e2}) {
+        if (static_cast<uint32_t>(count) <= requested && (supported & count)) {
+            return count;
+        }
+    }
+
+    return vk::SampleCountFlagBits::e1;
+}
+
+vk::ResolveModeFlagBits MultisampleTargets::chooseDepthResolveMode(vk::PhysicalDevice physDevice) {
+    auto properties = physDevice.getProperties2<vk::PhysicalDeviceProperties2,
+                                                vk::PhysicalDeviceDepthStencilResolveProperties>();
+    auto resolveProperties = properties.get<vk::PhysicalDeviceDepthStencilResolveProperties>();
+
+    // sample zero is the only mode every device supports
+    if (resolveProperties.supportedDepthResolveModes & vk::ResolveModeFlagBits::eMax) {
+        return vk::ResolveModeFlagBits::eMax;
+    }
+    return vk::ResolveModeFlagBits::eSampleZero;
+}
+
+void MultisampleTargets::create(vk::PhysicalDevice physDevice, vk::Device logicalDevice, MemoryAllocator &memoryAllocator,
+                                vk::SampleCountFlagBits samples, vk::Format colorFormat, vk::Format depthFormat,
+                                vk::Extent2D extent, bool transient) {
+    device = logicalDevice;
+    allocator = &memoryAllocator;
+    sampleCount = samples;
+    depthResolveMode = chooseDepthResolveMode(physDevice);
+    colorImageFormat = colorFormat;
+    depthImageFormat = depthFormat;
+    transientTargets = transient;
+
+    createTargets(extent);
+}
+
+void MultisampleTargets::destroy() {
+    destroyTargets();
+}
+
+void MultisampleTargets::destroy(DeletionQueue &deletionQueue) {
+    deletionQueue.enqueue(colorView);
+    deletionQueue.enqueue(color);
+    deletionQueue.enqueue(depthView);
+    deletionQueue.enqueue(depth);
+}
+
+void MultisampleTargets::resize(vk::Extent2D extent, DeletionQueue &deletionQueue) {
+    destroy(deletionQueue);
+    createTargets(extent);
+}
+
+void MultisampleTargets::createTargets(vk::Extent2D extent) {
+    auto createTarget = [&](vk::Format format, vk::ImageUsageFlags usage, vk::ImageAspectFlags aspect, Image &image,
+                            vk::ImageView &view) {
+        // lazily allocated memory is only backed when the attachment has to leave tile memory
+        vk::MemoryPropertyFlags preferred;
+        if (transientTargets) {
+            usage |= vk::ImageUsageFlagBits::eTransientAttachment;
+            preferred = vk::MemoryPropertyFlagBits::eLazilyAllocated;
+        }
+
+        image = allocator->createImage({
+                .imageType = vk::ImageType::e2D,
+                .format = format,
+                .extent = {
+                        .width = extent.width,
+                        .height = extent.height,
+                        .depth = 1,
+                },
+                .mipLevels = 1,
+                .arrayLayers = 1,
+                .samples = sampleCount,
+                .tiling = vk::ImageTiling::eOptimal,
+                .usage = usage,
+                .sharingMode = vk::SharingMode::eExclusive,
+                .initialLayout = vk::ImageLayout::eUndefined,
+        }, vk::MemoryPropertyFlagBits::eDeviceLocal, preferred);
+
+        view = device.createImageView({
+                .image = image.image,
+                .viewType = vk::ImageViewType::e2D,
+                .format = format,
+                .subresourceRange = {
+                        .aspectMask = aspect,
+                        .baseMipLevel = 0,
+                        .levelCount = 1,
+                        .baseArrayLayer = 0,
+                        .layerCount = 1,
+                },
+        });
+    };
+
+    createTarget(colorImageFormat, vk::ImageUsageFlagBits::eColorAttachment, vk::ImageAspectFlagBits::eColor,
+                 color, colorView);
+    createTarget(depthImageFormat, vk::ImageUsageFlagBits::eDepthStencilAttachment, vk::ImageAspectFlagBits::eDepth,
+                 depth, depthView);
+}
+
+void MultisampleTargets::destroyTargets() {
+    device.destroy(colorView);
+    allocator->destroyImage(color);
+    device.destroy(depthView);
+    allocator->destroyImage(depth);
+}
+
+void MultisampleTargets::beginFrame(vk::CommandBuffer cmdBuffer) {
+    auto barrier = [](vk::Image image, vk::ImageAspectFlags aspect, vk::AccessFlags access, vk::ImageLayout layout) {
+        return vk::ImageMemoryBarrier{
+                .srcAccessMask = access,
+                .dstAccessMask = access,
+                .oldLayout = vk::ImageLayout::eUndefined,
+                .newLayout = layout,
+                .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .image = image,
+                .subresourceRange = {
+                        .aspectMask = aspect,
+                        .baseMipLevel = 0,
+                        .levelCount = 1,
+                        .baseArrayLayer = 0,
+                        .layerCount = 1,
+                },
+        };
+    };
+
+    // the attachments are shared by all frames in flight, the previous frame has to be done with them
+    std::array<vk::ImageMemoryBarrier, 2> barriers = {
+        barrier(color.image, vk::ImageAspectFlagBits::eColor,
+                vk::AccessFlagBits::eColorAttachmentRead | vk::AccessFlagBits::eColorAttachmentWrite,
+                vk::ImageLayout::eColorAttachmentOptimal),
+        barrier(depth.image, vk::ImageAspectFlagBits::eDepth,
+                vk::AccessFlagBits::eDepthStencilAttachmentRead | vk::AccessFlagBits::eDepthStencilAttachmentWrite,
+                vk::ImageLayout::eDepthStencilAttachmentOptimal),
+    };
+
+    auto stages = vk::PipelineStageFlagBits::eColorAttachmentOutput | vk::PipelineStageFlagBits::eEarlyFragmentTests |
+                  vk::PipelineStageFlagBits::eLateFragmentTests;
+    cmdBuffer.pipelineBarrier(stages, stages, {},
+                              0, nullptr, 0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data());
+}
+
+void MultisampleTargets::attach(vk::RenderingAttachmentInfo &colorAttachment, vk::RenderingAttachmentInfo &depthAttachment,
+                                bool resolveColor, bool resolveDepth) const {
+    if (resolveColor) {
+        colorAttachment.resolveMode = vk::ResolveModeFlagBits::eAverage;
+        colorAttachment.resolveImageView = colorAttachment.imageView;
+        colorAttachment.resolveImageLayout = colorAttachment.imageLayout;
+    }
+    colorAttachment.imageView = colorView;
+    colorAttachment.imageLayout = vk::ImageLayout::eColorAttachmentOptimal;
+
+    if (resolveDepth) {
+        depthAttachment.resolveMode = depthResolveMode;
+        depthAttachment.resolveImageView = depthAttachment.imageView;
+        depthAttachment.resolveImageLayout = depthAttachment.imageLayout;
+    }
+    depthAttachment.imageView = depthView;
+    depthAttachment.imageLayout = vk::ImageLayout::eDepthStencilAttachmentOptimal;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "deletionQueue.hpp"
+#include "memory.hpp"
+
+#define VULKAN_HPP_NO_CONSTRUCTORS
+#include <vulkan/vulkan.hpp>
+
+#include <cstdint>
+
+// Multisampled color and depth attachments that stand in for the swap chain image and the depth buffer. Both are
+// resolved inside the rendering through the resolve fields of vk::RenderingAttachmentInfo, so there is no resolve pass
+// and, when nothing has to be loaded again later, the multisampled images are transient and can live in tile memory
+// only. The color resolves into the swap chain image by averaging, the depth into the depth buffer.
+class MultisampleTargets {
+public:
+    // The highest sample count up to requested that both color and depth attachments support.
+    static vk::SampleCountFlagBits supportedSampleCount(vk::PhysicalDevice physDevice, uint32_t requested);
+    // The farthest sample when supported, the occlusion culler's depth pyramid has to stay conservative.
+    static vk::ResolveModeFlagBits chooseDepthResolveMode(vk::PhysicalDevice physDevice);
+
+    void create(vk::PhysicalDevice physDevice, vk::Device device, MemoryAllocator &allocator,
+                vk::SampleCountFlagBits samples, vk::Format colorFormat, vk::Format depthFormat, vk::Extent2D extent,
+                bool transient);
+    void destroy();
+    // hands the attachments to deletionQueue instead of destroying them right away
+    void destroy(DeletionQueue &deletionQueue);
+
+    // Recreates the attachments for a new swap chain extent, the old ones are destroyed through deletionQueue once the
+    // frames in flight are done with them.
+    void resize(vk::Extent2D extent, DeletionQueue &deletionQueue);
+
+    [[nodiscard]] vk::SampleCountFlagBits samples() const { return sampleCount; }
+
+    // Discards the previous frame's contents and prepares both attachments for rendering.
+    void beginFrame(vk::CommandBuffer cmdBuffer);
+    // Replaces the views of color and depth with the multisampled ones, the original views become the resolve targets
+    // where requested. The store ops keep referring to the multisampled contents.
+    void attach(vk::RenderingAttachmentInfo &color, vk::RenderingAttachmentInfo &depth, bool resolveColor,
+                bool resolveDepth) const;
+
+private:
+    void createTargets(vk::Extent2D extent);
+    void destroyTargets();
+
+    vk::Device device;
+    MemoryAllocator *allocator = nullptr;
+    vk::SampleCountFlagBits sampleCount = vk::SampleCountFlagBits::e1;
+    vk::ResolveModeFlagBits depthResolveMode = vk::ResolveModeFlagBits::eSampleZero;
+    vk::Format colorImageFormat = vk::Format::eUndefined;
+    vk::Format depthImageFormat = vk::Format::eUndefined;
+    bool transientTargets = false;
+
+    Image color;
+    vk::ImageView colorView;
+    Image depth;
+    vk::ImageView depthView;
+};
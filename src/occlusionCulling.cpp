@@ -0,0 +1,381 @@
+#include "occlusionCulling.hpp"
+#include "occlusionCullShader.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+void OcclusionCuller::create(vk::Device logicalDevice, MemoryAllocator &memoryAllocator, BindlessDescriptorSet &bindlessSet,
+                             const ResourceBinder &resourceBinder, MipDownsampler &mipDownsampler, uint32_t frameCount,
+                             uint32_t instanceCount, vk::Extent2D depthExtent, vk::PipelineStageFlags consumerStages) {
+    device = logicalDevice;
+    allocator = &memoryAllocator;
+    bindless = &bindlessSet;
+    binder = &resourceBinder;
+    downsampler = &mipDownsampler;
+    maxInstances = instanceCount;
+    listConsumerStages = consumerStages;
+
+    auto setLayout = bindless->layout();
+    vk::PushConstantRange pushConstantRange{
+            .stageFlags = vk::ShaderStageFlagBits::eCompute,
+            .offset = 0,
+            .size = sizeof(PushConstants),
+    };
+
+    pipelineLayout = device.createPipelineLayout({
+            .setLayoutCount = 1,
+            .pSetLayouts = &setLayout,
+            .pushConstantRangeCount = 1,
+            .pPushConstantRanges = &pushConstantRange,
+    });
+
+    auto shaderModule = device.createShaderModule({
+            .codeSize = occlusion_cull_spv_len,
+            .pCode = reinterpret_cast<const uint32_t *>(occlusion_cull_spv),
+    });
+
+    pipeline = device.createComputePipeline(nullptr, {
+            .flags = binder->pipelineCreateFlags(),
+            .stage = {
+                    .stage = vk::ShaderStageFlagBits::eCompute,
+                    .module = shaderModule,
+                    .pName = "main",
+            },
+            .layout = pipelineLayout,
+    }).value;
+
+    device.destroyShaderModule(shaderModule);
+
+    // the pyramid is read with texelFetch semantics, every lookup hits exactly one texel of the chosen level
+    pyramidSampler = device.createSampler({
+            .magFilter = vk::Filter::eNearest,
+            .minFilter = vk::Filter::eNearest,
+            .mipmapMode = vk::SamplerMipmapMode::eNearest,
+            .addressModeU = vk::SamplerAddressMode::eClampToEdge,
+            .addressModeV = vk::SamplerAddressMode::eClampToEdge,
+            .addressModeW = vk::SamplerAddressMode::eClampToEdge,
+            .maxLod = VK_LOD_CLAMP_NONE,
+    });
+    pyramidSamplerIndex = bindless->addSampler(pyramidSampler);
+
+    vk::BufferUsageFlags usage = vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst;
+    if (allocator->bufferDeviceAddress()) {
+        usage |= vk::BufferUsageFlagBits::eShaderDeviceAddress;
+    }
+
+    visibilityBuffer = allocator->createBuffer(vk::DeviceSize(maxInstances) * sizeof(uint32_t), usage,
+                                               vk::MemoryPropertyFlagBits::eDeviceLocal);
+    visibilityBufferIndex = bindless->addStorageBuffer(visibilityBuffer);
+    visibilityInitialized = false;
+
+    for (uint32_t frame = 0; frame < frameCount; frame++) {
+        for (uint32_t phase = 0; phase < 2; phase++) {
+            auto size = DrawsOffset + vk::DeviceSize(maxInstances) * sizeof(vk::DrawIndexedIndirectCommand);
+            listBuffers.push_back(allocator->createBuffer(size, usage | vk::BufferUsageFlagBits::eIndirectBuffer,
+                                                          vk::MemoryPropertyFlagBits::eDeviceLocal));
+            listBufferIndices.push_back(bindless->addStorageBuffer(listBuffers.back()));
+        }
+
+        statisticsBuffers.push_back(allocator->createBuffer(
+                sizeof(OcclusionStatistics), usage,
+                vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent));
+        statisticsBufferIndices.push_back(bindless->addStorageBuffer(statisticsBuffers.back()));
+        std::memset(statisticsBuffers.back().allocation.mapped, 0, sizeof(OcclusionStatistics));
+    }
+    pending.assign(frameCount, false);
+
+    createPyramid(depthExtent);
+}
+
+void OcclusionCuller::destroy() {
+    destroyPyramid();
+
+    for (size_t i = 0; i < listBuffers.size(); i++) {
+        bindless->removeStorageBuffer(listBufferIndices[i]);
+        allocator->destroyBuffer(listBuffers[i]);
+    }
+    listBuffers.clear();
+    listBufferIndices.clear();
+
+    for (size_t i = 0; i < statisticsBuffers.size(); i++) {
+        bindless->removeStorageBuffer(statisticsBufferIndices[i]);
+        allocator->destroyBuffer(statisticsBuffers[i]);
+    }
+    statisticsBuffers.clear();
+    statisticsBufferIndices.clear();
+
+    bindless->removeStorageBuffer(visibilityBufferIndex);
+    allocator->destroyBuffer(visibilityBuffer);
+
+    bindless->removeSampler(pyramidSamplerIndex);
+    device.destroy(pyramidSampler);
+    device.destroy(pipeline);
+    device.destroy(pipelineLayout);
+}
+
+void OcclusionCuller::createPyramid(vk::Extent2D depthExtent) {
+    renderExtent = depthExtent;
+    // rounding down at every level would drop the last odd row or column and shift the texel mapping
+    auto width = std::bit_ceil(std::max(1u, (depthExtent.width + 1) / 2));
+    auto height = std::bit_ceil(std::max(1u, (depthExtent.height + 1) / 2));
+    pyramidExtent = {width, height};
+    auto levels = std::min<uint32_t>(std::bit_width(std::max(width, height)), MipDownsampler::MaxLevels);
+
+    pyramid = allocator->createImage({
+            .imageType = vk::ImageType::e2D,
+            .format = vk::Format::eR32Sfloat,
+            .extent = {
+                    .width = width,
+                    .height = height,
+                    .depth = 1,
+            },
+            .mipLevels = levels,
+            .arrayLayers = 1,
+            .samples = vk::SampleCountFlagBits::e1,
+            .tiling = vk::ImageTiling::eOptimal,
+            .usage = vk::ImageUsageFlagBits::eStorage | vk::ImageUsageFlagBits::eSampled,
+            .sharingMode = vk::SharingMode::eExclusive,
+            .initialLayout = vk::ImageLayout::eUndefined,
+    }, vk::MemoryPropertyFlagBits::eDeviceLocal);
+
+    pyramidView = device.createImageView({
+            .image = pyramid.image,
+            .viewType = vk::ImageViewType::e2D,
+            .format = vk::Format::eR32Sfloat,
+            .subresourceRange = {
+                    .aspectMask = vk::ImageAspectFlagBits::eColor,
+                    .baseMipLevel = 0,
+                    .levelCount = levels,
+                    .baseArrayLayer = 0,
+                    .layerCount = 1,
+            },
+    });
+    pyramidLevels = downsampler->createViews(pyramid.image, vk::Format::eR32Sfloat, levels);
+    pyramidTextureIndex = bindless->addSampledImage(pyramidView, vk::ImageLayout::eGeneral);
+
+    // nothing meaningful was drawn behind the old pyramid, start over with every instance marked invisible: the first
+    // phase draws nothing, the pyramid stays empty and the second phase draws everything in the frustum
+    visibilityInitialized = false;
+}
+
+void OcclusionCuller::destroyPyramid() {
+    bindless->removeSampledImage(pyramidTextureIndex);
+    downsampler->destroyViews(pyramidLevels);
+    device.destroy(pyramidView);
+    allocator->destroyImage(pyramid);
+}
+
+void OcclusionCuller::resize(vk::Extent2D depthExtent, DeletionQueue &deletionQueue) {
+    // the bindless slot is only released once no frame reads it, otherwise the new pyramid could take it over
+    deletionQueue.enqueue([bindlessSet = bindless, index = pyramidTextureIndex] {
+        bindlessSet->removeSampledImage(index);
+    });
+    for (auto view : pyramidLevels.levels) {
+        deletionQueue.enqueue(view);
+    }
+    pyramidLevels.levels.clear();
+    deletionQueue.enqueue(pyramidView);
+    deletionQueue.enqueue(pyramid);
+    createPyramid(depthExtent);
+}
+
+void OcclusionCuller::beginFrame(uint32_t frameIndex) {
+    if (!pending[frameIndex]) {
+        return;
+    }
+    pending[frameIndex] = false;
+
+    OcclusionStatistics frameStatistics;
+    std::memcpy(&frameStatistics, statisticsBuffers[frameIndex].allocation.mapped, sizeof(frameStatistics));
+    totals.firstPhaseInstances += frameStatistics.firstPhaseInstances;
+    totals.secondPhaseInstances += frameStatistics.secondPhaseInstances;
+    totals.occlusionCulled += frameStatistics.occlusionCulled;
+    totals.frustumCulled += frameStatistics.frustumCulled;
+    frames++;
+}
+
+void OcclusionCuller::resetStatistics() {
+    totals = {};
+    frames = 0;
+}
+
+void OcclusionCuller::record(vk::CommandBuffer cmdBuffer, uint32_t frameIndex, OcclusionPhase phase,
+                             const DrawConstants &constants, uint32_t meshletGroupSize) {
+    const auto &list = listBuffers[listSlot(frameIndex, phase)];
+
+    if (phase == OcclusionPhase::Visible) {
+        if (!visibilityInitialized) {
+            cmdBuffer.fillBuffer(visibilityBuffer.buffer, 0, VK_WHOLE_SIZE, 0);
+            visibilityInitialized = true;
+        }
+        cmdBuffer.fillBuffer(statisticsBuffers[frameIndex].buffer, 0, VK_WHOLE_SIZE, 0);
+        pending[frameIndex] = true;
+    }
+
+    // draw count, then the dispatch over (meshlet workgroups, listed instances, 1)
+    const std::array<uint32_t, 4> header = {0, (constants.meshletCount + meshletGroupSize - 1) / meshletGroupSize, 0, 1};
+    cmdBuffer.updateBuffer(list.buffer, 0, sizeof(header), header.data());
+
+    // also orders the visibility flags after the previous frame's second phase and this frame's first
+    vk::MemoryBarrier clearBarrier{
+            .srcAccessMask = vk::AccessFlagBits::eTransferWrite | vk::AccessFlagBits::eShaderWrite,
+            .dstAccessMask = vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite,
+    };
+    cmdBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer | vk::PipelineStageFlagBits::eComputeShader,
+                              vk::PipelineStageFlagBits::eComputeShader, {}, 1, &clearBarrier, 0, nullptr, 0, nullptr);
+
+    PushConstants pushConstants{
+            .frameDataIndex = constants.frameDataIndex,
+            .instanceBufferIndex = constants.instanceBufferIndex,
+            .instanceCount = constants.instanceCount,
+            .visibilityBufferIndex = visibilityBufferIndex,
+            .listBufferIndex = listBufferIndices[listSlot(frameIndex, phase)],
+            .statisticsBufferIndex = statisticsBufferIndices[frameIndex],
+            .pyramidTextureIndex = pyramidTextureIndex,
+            .pyramidSamplerIndex = pyramidSamplerIndex,
+            .pyramidSize = {static_cast<float>(pyramidExtent.width), static_cast<float>(pyramidExtent.height)},
+            .pyramidLevels = static_cast<uint32_t>(pyramidLevels.levels.size()),
+            .phase = static_cast<uint32_t>(phase),
+            // level 0 spans twice its size in depth texels, which may be more than the depth buffer
+            .uvScale = {static_cast<float>(renderExtent.width) / static_cast<float>(2 * pyramidExtent.width),
+                        static_cast<float>(renderExtent.height) / static_cast<float>(2 * pyramidExtent.height)},
+    };
+    for (int axis = 0; axis < 3; axis++) {
+        pushConstants.boundsMin[axis] = constants.positionOffset[axis];
+        pushConstants.boundsMax[axis] = constants.positionOffset[axis] + constants.positionScale[axis];
+    }
+
+    cmdBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, pipeline);
+    binder->bindGlobal(cmdBuffer, vk::PipelineBindPoint::eCompute, pipelineLayout);
+    cmdBuffer.pushConstants(pipelineLayout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(pushConstants), &pushConstants);
+    cmdBuffer.dispatch((constants.instanceCount + 63) / 64, 1, 1);
+
+    vk::MemoryBarrier listBarrier{
+            .srcAccessMask = vk::AccessFlagBits::eShaderWrite,
+            .dstAccessMask = vk::AccessFlagBits::eIndirectCommandRead | vk::AccessFlagBits::eShaderRead,
+    };
+    vk::PipelineStageFlags dstStages = vk::PipelineStageFlagBits::eDrawIndirect | listConsumerStages;
+    if (phase == OcclusionPhase::Disoccluded) {
+        // the statistics are complete, beginFrame reads them once the frame's fence signals
+        listBarrier.dstAccessMask |= vk::AccessFlagBits::eHostRead;
+        dstStages |= vk::PipelineStageFlagBits::eHost;
+    }
+    cmdBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, dstStages, {},
+                              1, &listBarrier, 0, nullptr, 0, nullptr);
+}
+
+void OcclusionCuller::buildDepthPyramid(vk::CommandBuffer cmdBuffer, vk::Image depthImage, vk::ImageView depthView,
+                                        vk::ImageLayout depthLayout) {
+    vk::ImageSubresourceRange depthRange{
+            .aspectMask = vk::ImageAspectFlagBits::eDepth,
+            .baseMipLevel = 0,
+            .levelCount = 1,
+            .baseArrayLayer = 0,
+            .layerCount = 1,
+    };
+    vk::ImageSubresourceRange pyramidRange{
+            .aspectMask = vk::ImageAspectFlagBits::eColor,
+            .baseMipLevel = 0,
+            .levelCount = VK_REMAINING_MIP_LEVELS,
+            .baseArrayLayer = 0,
+            .layerCount = 1,
+    };
+
+    // the previous frame's occlusion test may still read the pyramid, its contents are rebuilt from scratch. A depth
+    // buffer written by a multisample resolve counts as a color attachment write.
+    std::array<vk::ImageMemoryBarrier, 2> before = {
+        vk::ImageMemoryBarrier{
+            .srcAccessMask = vk::AccessFlagBits::eDepthStencilAttachmentWrite | vk::AccessFlagBits::eColorAttachmentWrite,
+            .dstAccessMask = vk::AccessFlagBits::eShaderRead,
+            .oldLayout = depthLayout,
+            .newLayout = vk::ImageLayout::eDepthStencilReadOnlyOptimal,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .image = depthImage,
+            .subresourceRange = depthRange,
+        },
+        vk::ImageMemoryBarrier{
+            .srcAccessMask = {},
+            .dstAccessMask = vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite,
+            .oldLayout = vk::ImageLayout::eUndefined,
+            .newLayout = vk::ImageLayout::eGeneral,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .image = pyramid.image,
+            .subresourceRange = pyramidRange,
+        },
+    };
+    cmdBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eLateFragmentTests | vk::PipelineStageFlagBits::eColorAttachmentOutput |
+                              vk::PipelineStageFlagBits::eComputeShader,
+                              vk::PipelineStageFlagBits::eComputeShader, {},
+                              0, nullptr, 0, nullptr, static_cast<uint32_t>(before.size()), before.data());
+
+    // A depth buffer above the downsampler's source limit is reduced in several dispatches, each one continuing from
+    // the last level the previous one wrote.
+    std::span<const vk::ImageView> levels = pyramidLevels.levels;
+    vk::ImageView source = depthView;
+    auto sourceLayout = vk::ImageLayout::eDepthStencilReadOnlyOptimal;
+    vk::Extent2D sourceExtent{2 * pyramidExtent.width, 2 * pyramidExtent.height};
+    while (true) {
+        auto count = std::max(sourceExtent.width, sourceExtent.height) > MipDownsampler::MaxSourceExtent
+                             ? std::min<size_t>(levels.size(), MipDownsampler::WorkGroupLevels)
+                             : levels.size();
+        downsampler->record(cmdBuffer, source, sourceLayout, sourceExtent, levels.first(count), DownsampleFilter::Max);
+        if (count == levels.size()) {
+            break;
+        }
+
+        vk::MemoryBarrier levelBarrier{
+                .srcAccessMask = vk::AccessFlagBits::eShaderWrite,
+                .dstAccessMask = vk::AccessFlagBits::eShaderRead,
+        };
+        cmdBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader,
+                                  {}, 1, &levelBarrier, 0, nullptr, 0, nullptr);
+        source = levels[count - 1];
+        sourceLayout = vk::ImageLayout::eGeneral;
+        sourceExtent = {std::max(1u, sourceExtent.width >> count), std::max(1u, sourceExtent.height >> count)};
+        levels = levels.subspan(count);
+    }
+
+    std::array<vk::ImageMemoryBarrier, 2> after = {
+        vk::ImageMemoryBarrier{
+            .srcAccessMask = vk::AccessFlagBits::eShaderRead,
+            .dstAccessMask = vk::AccessFlagBits::eDepthStencilAttachmentRead |
+                             vk::AccessFlagBits::eDepthStencilAttachmentWrite,
+            .oldLayout = vk::ImageLayout::eDepthStencilReadOnlyOptimal,
+            .newLayout = depthLayout,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .image = depthImage,
+            .subresourceRange = depthRange,
+        },
+        vk::ImageMemoryBarrier{
+            .srcAccessMask = vk::AccessFlagBits::eShaderWrite,
+            .dstAccessMask = vk::AccessFlagBits::eShaderRead,
+            .oldLayout = vk::ImageLayout::eGeneral,
+            .newLayout = vk::ImageLayout::eGeneral,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .image = pyramid.image,
+            .subresourceRange = pyramidRange,
+        },
+    };
+    cmdBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader,
+                              vk::PipelineStageFlagBits::eComputeShader | vk::PipelineStageFlagBits::eEarlyFragmentTests |
+                              vk::PipelineStageFlagBits::eLateFragmentTests, {},
+                              0, nullptr, 0, nullptr, static_cast<uint32_t>(after.size()), after.data());
+}
+
+void OcclusionCuller::draw(vk::CommandBuffer cmdBuffer, uint32_t frameIndex, OcclusionPhase phase) const {
+    const auto &list = listBuffers[listSlot(frameIndex, phase)];
+    cmdBuffer.drawIndexedIndirectCount(list.buffer, DrawsOffset, list.buffer, 0, maxInstances,
+                                       sizeof(vk::DrawIndexedIndirectCommand));
+}
+
+void OcclusionCuller::drawMeshTasks(vk::CommandBuffer cmdBuffer, uint32_t frameIndex, OcclusionPhase phase,
+                                    const vk::DispatchLoaderDynamic &dispatcher) const {
+    const auto &list = listBuffers[listSlot(frameIndex, phase)];
+    cmdBuffer.drawMeshTasksIndirectEXT(list.buffer, DispatchOffset, 1, sizeof(vk::DrawMeshTasksIndirectCommandEXT),
+                                       dispatcher);
+}
@@ -0,0 +1,146 @@
+#pragma once
+
+#include "bindless.hpp"
+#include "deletionQueue.hpp"
+#include "downsampler.hpp"
+#include "memory.hpp"
+#include "resourceBinding.hpp"
+#include "sceneData.hpp"
+
+#define VULKAN_HPP_NO_CONSTRUCTORS
+#include <vulkan/vulkan.hpp>
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+enum class OcclusionPhase : uint32_t {
+    Visible = 0,     // instances visible in the previous frame, drawn before the depth pyramid is built
+    Disoccluded = 1, // instances that pass the test against this frame's pyramid but were not drawn before
+};
+
+// Instance counts of one frame, summed over frames until resetStatistics().
+struct OcclusionStatistics {
+    uint32_t firstPhaseInstances;  // drawn because they were visible in the previous frame
+    uint32_t secondPhaseInstances; // drawn after passing the occlusion test
+    uint32_t occlusionCulled;      // inside the frustum but hidden behind the depth pyramid
+    uint32_t frustumCulled;
+};
+
+// Two phase hierarchical-Z occlusion culling of whole instances (shaders/occlusionCull.comp). Every frame the
+// instances that were visible in the previous one are drawn first, their depth is reduced into a pyramid of
+// farthest depths with the MipDownsampler, and every instance is tested against it. The visible ones that were not
+// drawn yet follow in a second pass, the test results decide what the next frame draws first.
+// Each phase writes an instance list per frame: the draw count, a dispatch or mesh task command over
+// (meshlet workgroups, draw count, 1) at DispatchOffset and an indexed draw per instance at DrawsOffset, whose
+// firstInstance is the instance index. The lists feed drawIndexedIndirectCount directly and the meshlet paths through
+// DrawConstants::instanceListIndex. Needs the same device features as the MeshletCuller.
+class OcclusionCuller {
+public:
+    static constexpr vk::DeviceSize DispatchOffset = 4;
+    static constexpr vk::DeviceSize DrawsOffset = 16;
+
+    // consumerStages are the stages reading the instance lists besides the indirect command read
+    void create(vk::Device device, MemoryAllocator &allocator, BindlessDescriptorSet &bindless,
+                const ResourceBinder &resourceBinder, MipDownsampler &downsampler, uint32_t frameCount,
+                uint32_t maxInstances, vk::Extent2D depthExtent, vk::PipelineStageFlags consumerStages);
+    void destroy();
+
+    // Recreates the depth pyramid for a new depth buffer size, the old one is destroyed through deletionQueue once the
+    // frames in flight are done with it.
+    void resize(vk::Extent2D depthExtent, DeletionQueue &deletionQueue);
+    // The top left part of the depth buffer the frame renders to, all of it unless the resolution is scaled. The
+    // texels outside of it only ever make the pyramid more conservative.
+    void setRenderExtent(vk::Extent2D extent) { renderExtent = extent; }
+
+    // Must only be called after the fence of the frame that last used frameIndex has been waited on.
+    void beginFrame(uint32_t frameIndex);
+
+    // Writes the phase's instance list of the frame for the instances in constants. meshletGroupSize is the number of
+    // meshlets a workgroup of the consumer handles. Has to be recorded outside of rendering, the Disoccluded phase
+    // after buildDepthPyramid().
+    void record(vk::CommandBuffer cmdBuffer, uint32_t frameIndex, OcclusionPhase phase, const DrawConstants &constants,
+                uint32_t meshletGroupSize);
+    // Reduces the depth buffer written by the Visible phase into the pyramid. Expects the depth image in depthLayout,
+    // the layout it is attached with, and leaves it there, ready to be loaded by the Disoccluded pass.
+    void buildDepthPyramid(vk::CommandBuffer cmdBuffer, vk::Image depthImage, vk::ImageView depthView,
+                           vk::ImageLayout depthLayout = vk::ImageLayout::eDepthStencilAttachmentOptimal);
+
+    // Indexed draws of the listed instances, the index buffer has to be bound.
+    void draw(vk::CommandBuffer cmdBuffer, uint32_t frameIndex, OcclusionPhase phase) const;
+    void drawMeshTasks(vk::CommandBuffer cmdBuffer, uint32_t frameIndex, OcclusionPhase phase,
+                       const vk::DispatchLoaderDynamic &dispatcher) const;
+
+    [[nodiscard]] vk::Buffer listBuffer(uint32_t frameIndex, OcclusionPhase phase) const {
+        return listBuffers[listSlot(frameIndex, phase)].buffer;
+    }
+    [[nodiscard]] uint32_t listBufferIndex(uint32_t frameIndex, OcclusionPhase phase) const {
+        return listBufferIndices[listSlot(frameIndex, phase)];
+    }
+
+    [[nodiscard]] const OcclusionStatistics &statistics() const { return totals; }
+    [[nodiscard]] uint32_t statisticsFrames() const { return frames; }
+    void resetStatistics();
+
+private:
+    struct PushConstants {
+        uint32_t frameDataIndex;
+        uint32_t instanceBufferIndex;
+        uint32_t instanceCount;
+        uint32_t visibilityBufferIndex;
+        uint32_t listBufferIndex;
+        uint32_t statisticsBufferIndex;
+        uint32_t pyramidTextureIndex;
+        uint32_t pyramidSamplerIndex;
+        float boundsMin[4];
+        float boundsMax[4];
+        float pyramidSize[2];
+        uint32_t pyramidLevels;
+        uint32_t phase;
+        float uvScale[2];
+    };
+
+    [[nodiscard]] static size_t listSlot(uint32_t frameIndex, OcclusionPhase phase) {
+        return frameIndex * 2 + static_cast<uint32_t>(phase);
+    }
+
+    void createPyramid(vk::Extent2D depthExtent);
+    void destroyPyramid();
+
+    vk::Device device;
+    MemoryAllocator *allocator = nullptr;
+    BindlessDescriptorSet *bindless = nullptr;
+    const ResourceBinder *binder = nullptr;
+    MipDownsampler *downsampler = nullptr;
+    uint32_t maxInstances = 0;
+    vk::PipelineStageFlags listConsumerStages;
+
+    vk::PipelineLayout pipelineLayout;
+    vk::Pipeline pipeline;
+
+    // Farthest depth pyramid. Level 0 is the power of two that covers half of the depth buffer, so every level is exactly
+    // half of the one above and each texel covers a whole number of depth texels. Texels past the depth buffer's edge
+    // repeat it.
+    vk::Extent2D pyramidExtent;
+    vk::Extent2D renderExtent;
+    Image pyramid;
+    vk::ImageView pyramidView;
+    MipChainViews pyramidLevels;
+    vk::Sampler pyramidSampler;
+    uint32_t pyramidTextureIndex = 0;
+    uint32_t pyramidSamplerIndex = 0;
+
+    // one flag per instance: visible at the end of the previous frame, shared by all frames in flight
+    Buffer visibilityBuffer;
+    uint32_t visibilityBufferIndex = 0;
+    bool visibilityInitialized = false;
+
+    std::vector<Buffer> listBuffers; // listSlot(frame, phase)
+    std::vector<uint32_t> listBufferIndices;
+    std::vector<Buffer> statisticsBuffers; // host visible, one per frame
+    std::vector<uint32_t> statisticsBufferIndices;
+    std::vector<bool> pending; // statistics written by a recorded frame and not read back yet
+
+    OcclusionStatistics totals{};
+    uint32_t frames = 0;
+};
@@ -0,0 +1,380 @@
+#include "overlay.hpp"
+#include "overlayFragmentShader.h"
+#include "overlayVertexShader.h"
+
+#include <imgui.h>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstring>
+
+// buffers start this large and grow to the next power of two
+static constexpr vk::DeviceSize MinBufferSize = 64 * 1024;
+
+void Overlay::create(vk::Device logicalDevice, MemoryAllocator &memoryAllocator, BindlessDescriptorSet &bindlessSet,
+                     const ResourceBinder &resourceBinder, UploadBatcher &uploadBatcher, vk::Format format,
+                     uint32_t frameCount) {
+    device = logicalDevice;
+    allocator = &memoryAllocator;
+    bindless = &bindlessSet;
+    binder = &resourceBinder;
+
+    ImGui::CreateContext();
+    auto &io = ImGui::GetIO();
+    io.IniFilename = nullptr;
+    io.BackendRendererName = "VulkanTest";
+    io.BackendFlags |= ImGuiBackendFlags_RendererHasVtxOffset;
+    ImGui::StyleColorsDark();
+
+    sampler = device.createSampler({
+            .magFilter = vk::Filter::eLinear,
+            .minFilter = vk::Filter::eLinear,
+            .mipmapMode = vk::SamplerMipmapMode::eNearest,
+            .addressModeU = vk::SamplerAddressMode::eClampToEdge,
+            .addressModeV = vk::SamplerAddressMode::eClampToEdge,
+            .addressModeW = vk::SamplerAddressMode::eClampToEdge,
+    });
+    samplerIndex = bindless->addSampler(sampler);
+
+    createPipeline(format);
+    createFontTexture(uploadBatcher);
+    frameBuffers.resize(frameCount);
+}
+
+void Overlay::destroy() {
+    for (auto &buffers : frameBuffers) {
+        allocator->destroyBuffer(buffers.vertices);
+        allocator->destroyBuffer(buffers.indices);
+    }
+    frameBuffers.clear();
+
+    bindless->removeSampledImage(fontIndex);
+    device.destroy(fontView);
+    allocator->destroyImage(fontImage);
+    bindless->removeSampler(samplerIndex);
+    device.destroy(sampler);
+    device.destroy(pipeline);
+    device.destroy(pipelineLayout);
+
+    ImGui::DestroyContext();
+}
+
+void Overlay::createPipeline(vk::Format format) {
+    auto setLayout = bindless->layout();
+    vk::PushConstantRange pushConstantRange{
+            .stageFlags = vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment,
+            .offset = 0,
+            .size = sizeof(PushConstants),
+    };
+    pipelineLayout = device.createPipelineLayout({
+            .setLayoutCount = 1,
+            .pSetLayouts = &setLayout,
+            .pushConstantRangeCount = 1,
+            .pPushConstantRanges = &pushConstantRange,
+    });
+
+    auto vertexModule = device.createShaderModule({
+            .codeSize = overlay_vert_spv_len,
+            .pCode = reinterpret_cast<const uint32_t *>(overlay_vert_spv),
+    });
+    auto fragmentModule = device.createShaderModule({
+            .codeSize = overlay_frag_spv_len,
+            .pCode = reinterpret_cast<const uint32_t *>(overlay_frag_spv),
+    });
+
+    std::array<vk::PipelineShaderStageCreateInfo, 2> stages = {
+        vk::PipelineShaderStageCreateInfo{
+            .stage = vk::ShaderStageFlagBits::eVertex,
+            .module = vertexModule,
+            .pName = "main",
+        },
+        vk::PipelineShaderStageCreateInfo{
+            .stage = vk::ShaderStageFlagBits::eFragment,
+            .module = fragmentModule,
+            .pName = "main",
+        },
+    };
+
+    vk::VertexInputBindingDescription binding{
+            .binding = 0,
+            .stride = sizeof(ImDrawVert),
+            .inputRate = vk::VertexInputRate::eVertex,
+    };
+    std::array<vk::VertexInputAttributeDescription, 3> attributes = {
+        vk::VertexInputAttributeDescription{
+            .location = 0,
+            .binding = 0,
+            .format = vk::Format::eR32G32Sfloat,
+            .offset = offsetof(ImDrawVert, pos),
+        },
+        vk::VertexInputAttributeDescription{
+            .location = 1,
+            .binding = 0,
+            .format = vk::Format::eR32G32Sfloat,
+            .offset = offsetof(ImDrawVert, uv),
+        },
+        vk::VertexInputAttributeDescription{
+            .location = 2,
+            .binding = 0,
+            .format = vk::Format::eR8G8B8A8Unorm,
+            .offset = offsetof(ImDrawVert, col),
+        },
+    };
+    vk::PipelineVertexInputStateCreateInfo vertexInput{
+            .vertexBindingDescriptionCount = 1,
+            .pVertexBindingDescriptions = &binding,
+            .vertexAttributeDescriptionCount = static_cast<uint32_t>(attributes.size()),
+            .pVertexAttributeDescriptions = attributes.data(),
+    };
+    vk::PipelineInputAssemblyStateCreateInfo inputAssembly{
+            .topology = vk::PrimitiveTopology::eTriangleList,
+    };
+    vk::PipelineViewportStateCreateInfo viewportState{
+            .viewportCount = 1,
+            .scissorCount = 1,
+    };
+    vk::PipelineRasterizationStateCreateInfo rasterizer{
+            .polygonMode = vk::PolygonMode::eFill,
+            .cullMode = vk::CullModeFlagBits::eNone,
+            .frontFace = vk::FrontFace::eCounterClockwise,
+            .lineWidth = 1.0f,
+    };
+    vk::PipelineMultisampleStateCreateInfo multisampling{
+            .rasterizationSamples = vk::SampleCountFlagBits::e1,
+    };
+    // ImGui's colors are not premultiplied
+    vk::PipelineColorBlendAttachmentState blendAttachment{
+            .blendEnable = VK_TRUE,
+            .srcColorBlendFactor = vk::BlendFactor::eSrcAlpha,
+            .dstColorBlendFactor = vk::BlendFactor::eOneMinusSrcAlpha,
+            .colorBlendOp = vk::BlendOp::eAdd,
+            .srcAlphaBlendFactor = vk::BlendFactor::eOne,
+            .dstAlphaBlendFactor = vk::BlendFactor::eOneMinusSrcAlpha,
+            .alphaBlendOp = vk::BlendOp::eAdd,
+            .colorWriteMask = vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG |
+                              vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA,
+    };
+    vk::PipelineColorBlendStateCreateInfo colorBlending{
+            .attachmentCount = 1,
+            .pAttachments = &blendAttachment,
+    };
+
+    std::array<vk::DynamicState, 2> dynamicStates = {vk::DynamicState::eViewport, vk::DynamicState::eScissor};
+    vk::PipelineDynamicStateCreateInfo dynamicState{
+            .dynamicStateCount = static_cast<uint32_t>(dynamicStates.size()),
+            .pDynamicStates = dynamicStates.data(),
+    };
+
+    vk::PipelineRenderingCreateInfo renderingInfo{
+            .colorAttachmentCount = 1,
+            .pColorAttachmentFormats = &format,
+    };
+
+    pipeline = device.createGraphicsPipeline(nullptr, {
+            .pNext = &renderingInfo,
+            .flags = binder->pipelineCreateFlags(),
+            .stageCount = static_cast<uint32_t>(stages.size()),
+            .pStages = stages.data(),
+            .pVertexInputState = &vertexInput,
+            .pInputAssemblyState = &inputAssembly,
+            .pViewportState = &viewportState,
+            .pRasterizationState = &rasterizer,
+            .pMultisampleState = &multisampling,
+            .pColorBlendState = &colorBlending,
+            .pDynamicState = &dynamicState,
+            .layout = pipelineLayout,
+    }).value;
+
+    device.destroyShaderModule(vertexModule);
+    device.destroyShaderModule(fragmentModule);
+}
+
+void Overlay::createFontTexture(UploadBatcher &uploadBatcher) {
+    unsigned char *pixels = nullptr;
+    int width = 0;
+    int height = 0;
+    ImGui::GetIO().Fonts->GetTexDataAsRGBA32(&pixels, &width, &height);
+    auto size = static_cast<vk::DeviceSize>(width) * height * 4;
+
+    fontImage = allocator->createImage({
+            .imageType = vk::ImageType::e2D,
+            .format = vk::Format::eR8G8B8A8Unorm,
+            .extent = {
+                    .width = static_cast<uint32_t>(width),
+                    .height = static_cast<uint32_t>(height),
+                    .depth = 1,
+            },
+            .mipLevels = 1,
+            .arrayLayers = 1,
+            .samples = vk::SampleCountFlagBits::e1,
+            .tiling = vk::ImageTiling::eOptimal,
+            .usage = vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled,
+            .sharingMode = vk::SharingMode::eExclusive,
+            .initialLayout = vk::ImageLayout::eUndefined,
+    }, vk::MemoryPropertyFlagBits::eDeviceLocal);
+
+    vk::ImageSubresourceRange subresourceRange{
+            .aspectMask = vk::ImageAspectFlagBits::eColor,
+            .baseMipLevel = 0,
+            .levelCount = 1,
+            .baseArrayLayer = 0,
+            .layerCount = 1,
+    };
+    fontView = device.createImageView({
+            .image = fontImage.image,
+            .viewType = vk::ImageViewType::e2D,
+            .format = vk::Format::eR8G8B8A8Unorm,
+            .subresourceRange = subresourceRange,
+    });
+
+    vk::BufferImageCopy region{
+            .imageSubresource = {
+                    .aspectMask = vk::ImageAspectFlagBits::eColor,
+                    .mipLevel = 0,
+                    .baseArrayLayer = 0,
+                    .layerCount = 1,
+            },
+            .imageExtent = {
+                    .width = static_cast<uint32_t>(width),
+                    .height = static_cast<uint32_t>(height),
+                    .depth = 1,
+            },
+    };
+    uploadBatcher.upload(fontImage.image, subresourceRange, {&region, 1}, pixels, size);
+
+    fontIndex = bindless->addSampledImage(fontView);
+    ImGui::GetIO().Fonts->SetTexID(reinterpret_cast<ImTextureID>(static_cast<intptr_t>(fontIndex)));
+}
+
+void Overlay::reserve(Buffer &buffer, vk::DeviceSize size, vk::BufferUsageFlags usage) {
+    if (buffer.size >= size) {
+        return;
+    }
+
+    // only called for the frame slot being recorded, whose previous use has finished
+    allocator->destroyBuffer(buffer);
+    buffer = allocator->createBuffer(std::bit_ceil(std::max(size, MinBufferSize)), usage,
+                                     vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+                                     vk::MemoryPropertyFlagBits::eDeviceLocal);
+}
+
+void Overlay::beginFrame(uint32_t frameIndex, vk::Extent2D extent, float deltaSeconds) {
+    currentFrame = frameIndex;
+    displayExtent = extent;
+
+    auto &io = ImGui::GetIO();
+    io.DisplaySize = ImVec2(static_cast<float>(extent.width), static_cast<float>(extent.height));
+    // ImGui asserts on a zero time step
+    io.DeltaTime = std::max(deltaSeconds, 1e-6f);
+    ImGui::NewFrame();
+}
+
+void Overlay::record(vk::CommandBuffer cmdBuffer, vk::ImageView output) {
+    ImGui::Render();
+    auto drawData = ImGui::GetDrawData();
+    draws = 0;
+    vertices = static_cast<uint32_t>(drawData->TotalVtxCount);
+    if (drawData->TotalVtxCount == 0) {
+        return;
+    }
+
+    auto &buffers = frameBuffers[currentFrame];
+    reserve(buffers.vertices, drawData->TotalVtxCount * sizeof(ImDrawVert), vk::BufferUsageFlagBits::eVertexBuffer);
+    reserve(buffers.indices, drawData->TotalIdxCount * sizeof(ImDrawIdx), vk::BufferUsageFlagBits::eIndexBuffer);
+
+    auto vertexData = static_cast<ImDrawVert *>(buffers.vertices.allocation.mapped);
+    auto indexData = static_cast<ImDrawIdx *>(buffers.indices.allocation.mapped);
+    for (int i = 0; i < drawData->CmdListsCount; i++) {
+        const auto list = drawData->CmdLists[i];
+        std::memcpy(vertexData, list->VtxBuffer.Data, list->VtxBuffer.Size * sizeof(ImDrawVert));
+        std::memcpy(indexData, list->IdxBuffer.Data, list->IdxBuffer.Size * sizeof(ImDrawIdx));
+        vertexData += list->VtxBuffer.Size;
+        indexData += list->IdxBuffer.Size;
+    }
+
+    vk::RenderingAttachmentInfo outputAttachment{
+            .imageView = output,
+            .imageLayout = vk::ImageLayout::eColorAttachmentOptimal,
+            .loadOp = vk::AttachmentLoadOp::eLoad,
+            .storeOp = vk::AttachmentStoreOp::eStore,
+    };
+    cmdBuffer.beginRendering({
+            .renderArea = {
+                    .extent = displayExtent,
+            },
+            .layerCount = 1,
+            .colorAttachmentCount = 1,
+            .pColorAttachments = &outputAttachment,
+    });
+
+    vk::Viewport viewport{
+            .width = drawData->DisplaySize.x,
+            .height = drawData->DisplaySize.y,
+            .minDepth = 0.0f,
+            .maxDepth = 1.0f,
+    };
+    cmdBuffer.setViewport(0, viewport);
+
+    PushConstants pushConstants{
+            .scale = {2.0f / drawData->DisplaySize.x, 2.0f / drawData->DisplaySize.y},
+            .translate = {-1.0f - drawData->DisplayPos.x * 2.0f / drawData->DisplaySize.x,
+                          -1.0f - drawData->DisplayPos.y * 2.0f / drawData->DisplaySize.y},
+            .textureIndex = fontIndex,
+            .samplerIndex = samplerIndex,
+    };
+    auto stages = vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment;
+
+    cmdBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline);
+    binder->bindGlobal(cmdBuffer, vk::PipelineBindPoint::eGraphics, pipelineLayout);
+    cmdBuffer.pushConstants(pipelineLayout, stages, 0, sizeof(pushConstants), &pushConstants);
+    cmdBuffer.bindVertexBuffers(0, buffers.vertices.buffer, vk::DeviceSize{0});
+    cmdBuffer.bindIndexBuffer(buffers.indices.buffer, 0,
+                              sizeof(ImDrawIdx) == 2 ? vk::IndexType::eUint16 : vk::IndexType::eUint32);
+
+    uint32_t textureIndex = fontIndex;
+    uint32_t listVertexOffset = 0;
+    uint32_t listIndexOffset = 0;
+    for (int i = 0; i < drawData->CmdListsCount; i++) {
+        const auto list = drawData->CmdLists[i];
+        for (const auto &command : list->CmdBuffer) {
+            if (command.UserCallback) {
+                // resetting the render state would only repeat what is bound already
+                if (command.UserCallback != ImDrawCallback_ResetRenderState) {
+                    command.UserCallback(list, &command);
+                }
+                continue;
+            }
+
+            auto clipMin = ImVec2(std::max(command.ClipRect.x - drawData->DisplayPos.x, 0.0f),
+                                  std::max(command.ClipRect.y - drawData->DisplayPos.y, 0.0f));
+            auto clipMax = ImVec2(std::min(command.ClipRect.z - drawData->DisplayPos.x, drawData->DisplaySize.x),
+                                  std::min(command.ClipRect.w - drawData->DisplayPos.y, drawData->DisplaySize.y));
+            if (clipMax.x <= clipMin.x || clipMax.y <= clipMin.y) {
+                continue;
+            }
+            vk::Rect2D scissor{
+                    .offset = {static_cast<int32_t>(clipMin.x), static_cast<int32_t>(clipMin.y)},
+                    .extent = {static_cast<uint32_t>(clipMax.x - clipMin.x), static_cast<uint32_t>(clipMax.y - clipMin.y)},
+            };
+            cmdBuffer.setScissor(0, scissor);
+
+            // the texture id is a bindless index, see createFontTexture
+            auto commandTexture = static_cast<uint32_t>(reinterpret_cast<intptr_t>(command.GetTexID()));
+            if (commandTexture != textureIndex) {
+                textureIndex = commandTexture;
+                cmdBuffer.pushConstants(pipelineLayout, stages, offsetof(PushConstants, textureIndex),
+                                        sizeof(textureIndex), &textureIndex);
+            }
+
+            cmdBuffer.drawIndexed(command.ElemCount, 1, listIndexOffset + command.IdxOffset,
+                                  static_cast<int32_t>(listVertexOffset + command.VtxOffset), 0);
+            draws++;
+        }
+        listVertexOffset += list->VtxBuffer.Size;
+        listIndexOffset += list->IdxBuffer.Size;
+    }
+
+    cmdBuffer.endRendering();
+}
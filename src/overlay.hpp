@@ -0,0 +1,72 @@
+#pragma once
+
+#include "bindless.hpp"
+#include "memory.hpp"
+#include "resourceBinding.hpp"
+#include "uploadBatcher.hpp"
+
+#define VULKAN_HPP_NO_CONSTRUCTORS
+#include <vulkan/vulkan.hpp>
+
+#include <cstdint>
+#include <vector>
+
+// Draws Dear ImGui windows over the finished frame with a dynamic rendering pass of its own that loads the swap chain
+// image. The draw lists are rendered here instead of by the bundled imgui_impl_vulkan, which predates dynamic
+// rendering, and the font atlas is sampled through the bindless set. Vertices and indices go into host visible buffers
+// per frame in flight that only grow, so a steady overlay doesn't allocate. ImGui gets the display size and frame
+// time from the render thread and no input, the GLFW backend would poll the window from the wrong thread.
+class Overlay {
+public:
+    void create(vk::Device device, MemoryAllocator &allocator, BindlessDescriptorSet &bindless,
+                const ResourceBinder &resourceBinder, UploadBatcher &uploadBatcher, vk::Format format,
+                uint32_t frameCount);
+    void destroy();
+
+    // Starts an ImGui frame for the frame slot, the windows are built between this and record().
+    void beginFrame(uint32_t frameIndex, vk::Extent2D extent, float deltaSeconds);
+    // Renders the windows onto output, has to be recorded outside of rendering with output in color attachment layout.
+    void record(vk::CommandBuffer cmdBuffer, vk::ImageView output);
+
+    // the last record()'s draws and vertices
+    [[nodiscard]] uint32_t drawCount() const { return draws; }
+    [[nodiscard]] uint32_t vertexCount() const { return vertices; }
+
+private:
+    struct PushConstants {
+        float scale[2];
+        float translate[2];
+        uint32_t textureIndex;
+        uint32_t samplerIndex;
+    };
+
+    struct FrameBuffers {
+        Buffer vertices;
+        Buffer indices;
+    };
+
+    void createPipeline(vk::Format format);
+    void createFontTexture(UploadBatcher &uploadBatcher);
+    void reserve(Buffer &buffer, vk::DeviceSize size, vk::BufferUsageFlags usage);
+
+    vk::Device device;
+    MemoryAllocator *allocator = nullptr;
+    BindlessDescriptorSet *bindless = nullptr;
+    const ResourceBinder *binder = nullptr;
+
+    vk::PipelineLayout pipelineLayout;
+    vk::Pipeline pipeline;
+    vk::Sampler sampler;
+    uint32_t samplerIndex = 0;
+
+    Image fontImage;
+    vk::ImageView fontView;
+    uint32_t fontIndex = 0;
+
+    std::vector<FrameBuffers> frameBuffers;
+    uint32_t currentFrame = 0;
+    vk::Extent2D displayExtent;
+
+    uint32_t draws = 0;
+    uint32_t vertices = 0;
+};
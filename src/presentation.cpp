@@ -0,0 +1,231 @@
+#include "presentation.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+const char *presentPolicyName(PresentPolicy policy) {
+    switch (policy) {
+        case PresentPolicy::Latency:
+            return "latency";
+        case PresentPolicy::Throughput:
+            return "throughput";
+        case PresentPolicy::Power:
+            return "power";
+        case PresentPolicy::TearFree:
+            return "tear-free";
+    }
+
+    return "unknown";
+}
+
+static bool containsExtension(const std::vector<vk::ExtensionProperties> &available, const char *name) {
+    return std::any_of(available.begin(), available.end(), [name](const vk::ExtensionProperties &extension) {
+        return std::strcmp(extension.extensionName, name) == 0;
+    });
+}
+
+bool Presenter::checkInstanceSupport() {
+    auto availableExtensions = vk::enumerateInstanceExtensionProperties();
+    for (auto required : requiredInstanceExtensions()) {
+        if (!containsExtension(availableExtensions, required)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::array<const char *, 2> Presenter::requiredInstanceExtensions() {
+    return {VK_KHR_GET_SURFACE_CAPABILITIES_2_EXTENSION_NAME, VK_EXT_SURFACE_MAINTENANCE_1_EXTENSION_NAME};
+}
+
+bool Presenter::checkSupport(vk::PhysicalDevice physDevice) {
+    if (!containsExtension(physDevice.enumerateDeviceExtensionProperties(), requiredExtension())) {
+        return false;
+    }
+
+    auto features = physDevice.getFeatures2<vk::PhysicalDeviceFeatures2,
+                                            vk::PhysicalDeviceSwapchainMaintenance1FeaturesEXT>();
+    return features.get<vk::PhysicalDeviceSwapchainMaintenance1FeaturesEXT>().swapchainMaintenance1;
+}
+
+const char *Presenter::requiredExtension() {
+    return VK_EXT_SWAPCHAIN_MAINTENANCE_1_EXTENSION_NAME;
+}
+
+vk::PresentModeKHR Presenter::choosePresentMode(PresentPolicy policy, const std::vector<vk::PresentModeKHR> &available) {
+    std::vector<vk::PresentModeKHR> preferred;
+    switch (policy) {
+        case PresentPolicy::Latency:
+            preferred = {vk::PresentModeKHR::eImmediate, vk::PresentModeKHR::eMailbox, vk::PresentModeKHR::eFifoRelaxed};
+            break;
+        case PresentPolicy::Throughput:
+            preferred = {vk::PresentModeKHR::eMailbox, vk::PresentModeKHR::eImmediate};
+            break;
+        case PresentPolicy::Power:
+            break;
+        case PresentPolicy::TearFree:
+            preferred = {vk::PresentModeKHR::eMailbox};
+            break;
+    }
+
+    for (auto mode : preferred) {
+        if (std::find(available.begin(), available.end(), mode) != available.end()) {
+            return mode;
+        }
+    }
+
+    // FIFO is the only mode every device supports
+    return vk::PresentModeKHR::eFifo;
+}
+
+void Presenter::create(vk::PhysicalDevice physDevice, vk::Device logicalDevice,
+                       const vk::DispatchLoaderDynamic &dynamicDispatcher, bool enableMaintenance, uint32_t frameCount) {
+    physicalDevice = physDevice;
+    device = logicalDevice;
+    dispatcher = &dynamicDispatcher;
+    maintenance = enableMaintenance;
+    framesInFlight = frameCount;
+
+    if (maintenance) {
+        for (uint32_t i = 0; i < frameCount; i++) {
+            presentFences.push_back(device.createFence({
+                .flags = vk::FenceCreateFlagBits::eSignaled,
+            }));
+        }
+    }
+}
+
+void Presenter::destroy() {
+    waitForPresents();
+    for (const auto &retired : retiredSwapchains) {
+        destroyRetired(retired);
+    }
+    retiredSwapchains.clear();
+
+    for (auto fence : presentFences) {
+        device.destroy(fence);
+    }
+    presentFences.clear();
+}
+
+std::vector<vk::PresentModeKHR> Presenter::compatibleModes(vk::SurfaceKHR surface, vk::PresentModeKHR mode) const {
+    vk::SurfacePresentModeEXT surfacePresentMode{
+            .presentMode = mode,
+    };
+    vk::PhysicalDeviceSurfaceInfo2KHR surfaceInfo{
+            .pNext = &surfacePresentMode,
+            .surface = surface,
+    };
+    vk::SurfacePresentModeCompatibilityEXT compatibility;
+    vk::SurfaceCapabilities2KHR capabilities{
+            .pNext = &compatibility,
+    };
+
+    // the first query only returns the number of compatible modes
+    if (physicalDevice.getSurfaceCapabilities2KHR(&surfaceInfo, &capabilities, *dispatcher) != vk::Result::eSuccess) {
+        return {mode};
+    }
+    std::vector<vk::PresentModeKHR> modes(compatibility.presentModeCount);
+    compatibility.pPresentModes = modes.data();
+    if (physicalDevice.getSurfaceCapabilities2KHR(&surfaceInfo, &capabilities, *dispatcher) != vk::Result::eSuccess) {
+        return {mode};
+    }
+    modes.resize(compatibility.presentModeCount);
+
+    if (std::find(modes.begin(), modes.end(), mode) == modes.end()) {
+        modes.push_back(mode);
+    }
+    return modes;
+}
+
+void Presenter::prepareSwapchain(vk::SurfaceKHR surface, const std::vector<vk::PresentModeKHR> &available,
+                                 PresentPolicy policy, vk::SwapchainCreateInfoKHR &createInfo) {
+    currentMode = choosePresentMode(policy, available);
+    createInfo.presentMode = currentMode;
+
+    if (!maintenance) {
+        switchableModes = {currentMode};
+        return;
+    }
+
+    switchableModes = compatibleModes(surface, currentMode);
+    presentModesInfo = vk::SwapchainPresentModesCreateInfoEXT{
+            .pNext = createInfo.pNext,
+            .presentModeCount = static_cast<uint32_t>(switchableModes.size()),
+            .pPresentModes = switchableModes.data(),
+    };
+    createInfo.pNext = &presentModesInfo;
+}
+
+bool Presenter::switchPolicy(PresentPolicy policy, const std::vector<vk::PresentModeKHR> &available) {
+    auto mode = choosePresentMode(policy, available);
+    if (std::find(switchableModes.begin(), switchableModes.end(), mode) == switchableModes.end()) {
+        return false;
+    }
+
+    currentMode = mode;
+    return true;
+}
+
+void Presenter::beginFrame(uint32_t frameIndex) {
+    if (maintenance &&
+        device.waitForFences(1, &presentFences[frameIndex], VK_TRUE, UINT64_MAX) != vk::Result::eSuccess) {
+        throw std::runtime_error("could not wait for present fence");
+    }
+
+    // every frame slot has been waited for since the swap chain was retired, so its last presents are done
+    std::erase_if(retiredSwapchains, [this](const RetiredSwapchain &retired) {
+        if (presentedFrames < retired.retiredFrame + framesInFlight) {
+            return false;
+        }
+        destroyRetired(retired);
+        return true;
+    });
+}
+
+void Presenter::tagPresent(vk::PresentInfoKHR &presentInfo, uint32_t frameIndex) {
+    presentedFrames++;
+    if (!maintenance) {
+        return;
+    }
+
+    if (device.resetFences(1, &presentFences[frameIndex]) != vk::Result::eSuccess) {
+        throw std::runtime_error("could not reset present fence");
+    }
+
+    // the mode applies from this present on, the swap chain keeps it for presents that don't pass one
+    presentModeInfo = vk::SwapchainPresentModeInfoEXT{
+            .pNext = presentInfo.pNext,
+            .swapchainCount = presentInfo.swapchainCount,
+            .pPresentModes = &currentMode,
+    };
+    presentFenceInfo = vk::SwapchainPresentFenceInfoEXT{
+            .pNext = &presentModeInfo,
+            .swapchainCount = presentInfo.swapchainCount,
+            .pFences = &presentFences[frameIndex],
+    };
+    presentInfo.pNext = &presentFenceInfo;
+}
+
+void Presenter::waitForPresents() {
+    if (!presentFences.empty() &&
+        device.waitForFences(static_cast<uint32_t>(presentFences.size()), presentFences.data(), VK_TRUE, UINT64_MAX) !=
+        vk::Result::eSuccess) {
+        throw std::runtime_error("could not wait for present fences");
+    }
+}
+
+void Presenter::retire(vk::SwapchainKHR swapChain, std::vector<vk::ImageView> imageViews) {
+    retiredSwapchains.push_back({
+            .swapChain = swapChain,
+            .imageViews = std::move(imageViews),
+            .retiredFrame = presentedFrames,
+    });
+}
+
+void Presenter::destroyRetired(const RetiredSwapchain &retired) {
+    for (auto imageView : retired.imageViews) {
+        device.destroy(imageView);
+    }
+    device.destroy(retired.swapChain);
+}
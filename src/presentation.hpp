@@ -0,0 +1,87 @@
+#pragma once
+
+#define VULKAN_HPP_NO_CONSTRUCTORS
+#include <vulkan/vulkan.hpp>
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+enum class PresentPolicy {
+    Latency,    // the newest frame goes on screen right away, tearing is allowed (immediate)
+    Throughput, // the GPU never waits for the display, without tearing when possible (mailbox)
+    Power,      // one frame per vertical blank, the CPU and GPU idle in between (FIFO)
+    TearFree,   // the lowest latency that never tears (mailbox, otherwise FIFO)
+};
+
+const char *presentPolicyName(PresentPolicy policy);
+
+// Chooses the swap chain's present mode from a PresentPolicy and switches it at runtime. With
+// VK_EXT_swapchain_maintenance1 the swap chain is created with every present mode that is compatible with the chosen
+// one, a switch between those only changes the mode passed to the next present, and every present signals a fence once
+// its wait semaphore and image are released. A mode outside that set needs a new swap chain, which is created from the
+// old one without waiting for the device. The old swap chain and its views are retired and destroyed once the frames
+// that presented to it are done.
+class Presenter {
+public:
+    // VK_EXT_surface_maintenance1 and the VK_KHR_get_surface_capabilities2 it depends on
+    static bool checkInstanceSupport();
+    static std::array<const char *, 2> requiredInstanceExtensions();
+    static bool checkSupport(vk::PhysicalDevice physDevice);
+    static const char *requiredExtension();
+
+    static vk::PresentModeKHR choosePresentMode(PresentPolicy policy, const std::vector<vk::PresentModeKHR> &available);
+
+    // maintenance requires the instance extensions and the device feature of checkSupport() to be enabled
+    void create(vk::PhysicalDevice physDevice, vk::Device device, const vk::DispatchLoaderDynamic &dispatcher,
+                bool maintenance, uint32_t frameCount);
+    void destroy();
+
+    [[nodiscard]] bool maintenanceEnabled() const { return maintenance; }
+    [[nodiscard]] vk::PresentModeKHR presentMode() const { return currentMode; }
+
+    // Sets the present mode of createInfo for policy, with maintenance chains the modes it can later switch to.
+    // createInfo has to be used before the next call.
+    void prepareSwapchain(vk::SurfaceKHR surface, const std::vector<vk::PresentModeKHR> &available, PresentPolicy policy,
+                          vk::SwapchainCreateInfoKHR &createInfo);
+    // Switches the current swap chain to the mode of policy. Returns false when it has to be recreated for that.
+    bool switchPolicy(PresentPolicy policy, const std::vector<vk::PresentModeKHR> &available);
+
+    // Blocks until the last present of this frame slot released its wait semaphore, without maintenance the frame's
+    // fence has to stand in for it. Also destroys retired swap chains that are no longer presented to.
+    void beginFrame(uint32_t frameIndex);
+    // Chains the present mode and the frame's present fence into presentInfo, which must be presented before the next
+    // call.
+    void tagPresent(vk::PresentInfoKHR &presentInfo, uint32_t frameIndex);
+    // Blocks until every present has released its resources, e.g. before the swap chain is destroyed.
+    void waitForPresents();
+
+    // Hands over a swap chain that was replaced, destroyed together with its views once its presents are done.
+    void retire(vk::SwapchainKHR swapChain, std::vector<vk::ImageView> imageViews);
+
+private:
+    struct RetiredSwapchain {
+        vk::SwapchainKHR swapChain;
+        std::vector<vk::ImageView> imageViews;
+        uint64_t retiredFrame;
+    };
+
+    std::vector<vk::PresentModeKHR> compatibleModes(vk::SurfaceKHR surface, vk::PresentModeKHR mode) const;
+    void destroyRetired(const RetiredSwapchain &retired);
+
+    vk::PhysicalDevice physicalDevice;
+    vk::Device device;
+    const vk::DispatchLoaderDynamic *dispatcher = nullptr;
+    bool maintenance = false;
+    uint32_t framesInFlight = 0;
+
+    vk::PresentModeKHR currentMode = vk::PresentModeKHR::eFifo;
+    std::vector<vk::PresentModeKHR> switchableModes;
+    vk::SwapchainPresentModesCreateInfoEXT presentModesInfo;
+    vk::SwapchainPresentModeInfoEXT presentModeInfo;
+    vk::SwapchainPresentFenceInfoEXT presentFenceInfo;
+
+    std::vector<vk::Fence> presentFences;
+    uint64_t presentedFrames = 0;
+    std::vector<RetiredSwapchain> retiredSwapchains;
+};
@@ -0,0 +1,246 @@
+#include "resourceBinding.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+
+const char *bindingModeName(BindingMode mode) {
+    switch (mode) {
+        case BindingMode::DescriptorSet:
+            return "descriptor set";
+        case BindingMode::PushDescriptor:
+            return "push descriptor";
+        case BindingMode::DescriptorBuffer:
+            return "descriptor buffer";
+    }
+
+    return "unknown";
+}
+
+const char *ResourceBinder::requiredExtension(BindingMode mode) {
+    switch (mode) {
+        case BindingMode::PushDescriptor:
+            return VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME;
+        case BindingMode::DescriptorBuffer:
+            return VK_EXT_DESCRIPTOR_BUFFER_EXTENSION_NAME;
+        default:
+            return nullptr;
+    }
+}
+
+bool ResourceBinder::checkSupport(vk::PhysicalDevice physDevice, BindingMode mode) {
+    auto extension = requiredExtension(mode);
+    if (!extension) {
+        return true;
+    }
+
+    bool extensionFound = false;
+    for (const auto &availableExtension : physDevice.enumerateDeviceExtensionProperties()) {
+        if (strcmp(extension, availableExtension.extensionName) == 0) {
+            extensionFound = true;
+            break;
+        }
+    }
+
+    if (!extensionFound) {
+        return false;
+    }
+
+    if (mode == BindingMode::DescriptorBuffer) {
+        auto features = physDevice.getFeatures2<vk::PhysicalDeviceFeatures2,
+                                                vk::PhysicalDeviceDescriptorBufferFeaturesEXT,
+                                                vk::PhysicalDeviceBufferDeviceAddressFeatures>();
+        auto properties = physDevice.getProperties2<vk::PhysicalDeviceProperties2, vk::PhysicalDeviceDescriptorBufferPropertiesEXT>();
+        auto &limits = properties.get<vk::PhysicalDeviceDescriptorBufferPropertiesEXT>();
+
+        // the bindless buffer and the per-draw ring are bound at the same time
+        return features.get<vk::PhysicalDeviceDescriptorBufferFeaturesEXT>().descriptorBuffer &&
+               features.get<vk::PhysicalDeviceBufferDeviceAddressFeatures>().bufferDeviceAddress &&
+               limits.maxDescriptorBufferBindings >= 2 &&
+               limits.maxResourceDescriptorBufferBindings >= 2 &&
+               limits.maxSamplerDescriptorBufferBindings >= 1;
+    }
+
+    return true;
+}
+
+void ResourceBinder::create(vk::PhysicalDevice physDevice, vk::Device logicalDevice, MemoryAllocator &memoryAllocator,
+                            DescriptorAllocator &frameDescriptorAllocator, const vk::DispatchLoaderDynamic &dynamicDispatcher,
+                            BindingMode mode, std::span<const vk::DescriptorSetLayoutBinding> drawBindings,
+                            const BindlessDescriptorSet *bindlessSet, uint32_t frameCount) {
+    if (drawBindings.size() > MaxDrawBindings) {
+        throw std::runtime_error("too many bindings in per-draw descriptor set");
+    }
+
+    device = logicalDevice;
+    allocator = &memoryAllocator;
+    descriptorAllocator = &frameDescriptorAllocator;
+    dispatcher = &dynamicDispatcher;
+    bindless = bindlessSet;
+    bindingMode = mode;
+
+    bindingNumbers.clear();
+    bindingTypes.clear();
+    for (const auto &binding : drawBindings) {
+        bindingNumbers.push_back(binding.binding);
+        bindingTypes.push_back(binding.descriptorType);
+    }
+
+    vk::DescriptorSetLayoutCreateFlags layoutFlags;
+    if (mode == BindingMode::PushDescriptor) {
+        layoutFlags = vk::DescriptorSetLayoutCreateFlagBits::ePushDescriptorKHR;
+    } else if (mode == BindingMode::DescriptorBuffer) {
+        layoutFlags = vk::DescriptorSetLayoutCreateFlagBits::eDescriptorBufferEXT;
+    }
+
+    setLayout = device.createDescriptorSetLayout({
+            .flags = layoutFlags,
+            .bindingCount = static_cast<uint32_t>(drawBindings.size()),
+            .pBindings = drawBindings.data(),
+    });
+
+    if (mode != BindingMode::DescriptorBuffer) {
+        return;
+    }
+
+    auto properties = physDevice.getProperties2<vk::PhysicalDeviceProperties2, vk::PhysicalDeviceDescriptorBufferPropertiesEXT>();
+    descriptorBufferProperties = properties.get<vk::PhysicalDeviceDescriptorBufferPropertiesEXT>();
+    descriptorBufferProperties.pNext = nullptr;
+
+    bindingOffsets.clear();
+    for (const auto &binding : drawBindings) {
+        bindingOffsets.push_back(device.getDescriptorSetLayoutBindingOffsetEXT(setLayout, binding.binding, *dispatcher));
+    }
+
+    auto alignment = descriptorBufferProperties.descriptorBufferOffsetAlignment;
+    auto layoutSize = device.getDescriptorSetLayoutSizeEXT(setLayout, *dispatcher);
+    setStride = (layoutSize + alignment - 1) / alignment * alignment;
+    frameRegionSize = setStride * MaxDrawSetsPerFrame;
+
+    ringBuffer = allocator->createBuffer(frameRegionSize * frameCount,
+                                         vk::BufferUsageFlagBits::eResourceDescriptorBufferEXT |
+                                         vk::BufferUsageFlagBits::eShaderDeviceAddress,
+                                         vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+                                         vk::MemoryPropertyFlagBits::eDeviceLocal);
+}
+
+void ResourceBinder::destroy() {
+    if (ringBuffer.buffer) {
+        allocator->destroyBuffer(ringBuffer);
+    }
+    device.destroy(setLayout);
+    setLayout = nullptr;
+}
+
+void ResourceBinder::beginFrame(uint32_t frameIndex) {
+    frameBegin = frameRegionSize * frameIndex;
+    frameOffset = frameBegin;
+}
+
+vk::PipelineCreateFlags ResourceBinder::pipelineCreateFlags() const {
+    if (bindingMode == BindingMode::DescriptorBuffer) {
+        return vk::PipelineCreateFlagBits::eDescriptorBufferEXT;
+    }
+
+    return {};
+}
+
+void ResourceBinder::bindGlobal(vk::CommandBuffer cmdBuffer, vk::PipelineBindPoint bindPoint, vk::PipelineLayout pipelineLayout) const {
+    if (bindingMode != BindingMode::DescriptorBuffer) {
+        if (bindless) {
+            cmdBuffer.bindDescriptorSets(bindPoint, pipelineLayout, 0, bindless->set(), {});
+        }
+        return;
+    }
+
+    std::array<vk::DescriptorBufferBindingInfoEXT, 2> bufferBindings;
+    uint32_t bufferCount = 0;
+
+    if (bindless) {
+        bufferBindings[bufferCount++] = bindless->descriptorBufferBinding();
+    }
+    bufferBindings[bufferCount++] = vk::DescriptorBufferBindingInfoEXT{
+            .address = ringBuffer.address,
+            .usage = vk::BufferUsageFlagBits::eResourceDescriptorBufferEXT,
+    };
+
+    cmdBuffer.bindDescriptorBuffersEXT(bufferCount, bufferBindings.data(), *dispatcher);
+
+    if (bindless) {
+        uint32_t bufferIndex = 0;
+        vk::DeviceSize offset = 0;
+        cmdBuffer.setDescriptorBufferOffsetsEXT(bindPoint, pipelineLayout, 0, 1, &bufferIndex, &offset, *dispatcher);
+    }
+}
+
+void ResourceBinder::bindDraw(vk::CommandBuffer cmdBuffer, vk::PipelineBindPoint bindPoint, vk::PipelineLayout pipelineLayout,
+                              std::span<const BufferBinding> buffers) {
+    auto setIndex = drawSetIndex();
+
+    if (bindingMode == BindingMode::DescriptorBuffer) {
+        if (frameOffset + setStride > frameBegin + frameRegionSize) {
+            throw std::runtime_error("per-draw descriptor buffer is full");
+        }
+
+        auto setMemory = static_cast<std::byte *>(ringBuffer.allocation.mapped) + frameOffset;
+
+        for (size_t i = 0; i < buffers.size(); i++) {
+            const auto &binding = buffers[i];
+            vk::DescriptorAddressInfoEXT addressInfo{
+                    .address = binding.buffer->address + binding.offset,
+                    .range = binding.range == VK_WHOLE_SIZE ? binding.buffer->size - binding.offset : binding.range,
+            };
+
+            vk::DescriptorGetInfoEXT getInfo{.type = bindingTypes[i]};
+            size_t descriptorSize;
+            if (bindingTypes[i] == vk::DescriptorType::eUniformBuffer) {
+                getInfo.data.pUniformBuffer = &addressInfo;
+                descriptorSize = descriptorBufferProperties.uniformBufferDescriptorSize;
+            } else {
+                getInfo.data.pStorageBuffer = &addressInfo;
+                descriptorSize = descriptorBufferProperties.storageBufferDescriptorSize;
+            }
+
+            device.getDescriptorEXT(getInfo, descriptorSize, setMemory + bindingOffsets[i], *dispatcher);
+        }
+
+        uint32_t bufferIndex = bindless ? 1 : 0;
+        cmdBuffer.setDescriptorBufferOffsetsEXT(bindPoint, pipelineLayout, setIndex, 1, &bufferIndex, &frameOffset, *dispatcher);
+
+        frameOffset += setStride;
+        return;
+    }
+
+    std::array<vk::DescriptorBufferInfo, MaxDrawBindings> bufferInfos;
+    std::array<vk::WriteDescriptorSet, MaxDrawBindings> writes;
+
+    for (size_t i = 0; i < buffers.size(); i++) {
+        bufferInfos[i] = vk::DescriptorBufferInfo{
+                .buffer = buffers[i].buffer->buffer,
+                .offset = buffers[i].offset,
+                .range = buffers[i].range,
+        };
+        writes[i] = vk::WriteDescriptorSet{
+                .dstBinding = bindingNumbers[i],
+                .descriptorCount = 1,
+                .descriptorType = bindingTypes[i],
+                .pBufferInfo = &bufferInfos[i],
+        };
+    }
+
+    auto writeCount = static_cast<uint32_t>(buffers.size());
+
+    if (bindingMode == BindingMode::PushDescriptor) {
+        cmdBuffer.pushDescriptorSetKHR(bindPoint, pipelineLayout, setIndex, writeCount, writes.data(), *dispatcher);
+        return;
+    }
+
+    auto descriptorSet = descriptorAllocator->allocate(setLayout);
+    for (uint32_t i = 0; i < writeCount; i++) {
+        writes[i].dstSet = descriptorSet;
+    }
+
+    device.updateDescriptorSets(writeCount, writes.data(), 0, nullptr);
+    cmdBuffer.bindDescriptorSets(bindPoint, pipelineLayout, setIndex, 1, &descriptorSet, 0, nullptr);
+}
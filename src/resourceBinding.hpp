@@ -0,0 +1,82 @@
+#pragma once
+
+#include "bindless.hpp"
+#include "descriptorAllocator.hpp"
+#include "memory.hpp"
+
+#define VULKAN_HPP_NO_CONSTRUCTORS
+#include <vulkan/vulkan.hpp>
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+enum class BindingMode {
+    DescriptorSet,
+    PushDescriptor,
+    DescriptorBuffer,
+};
+
+const char *bindingModeName(BindingMode mode);
+
+struct BufferBinding {
+    const Buffer *buffer = nullptr;
+    vk::DeviceSize offset = 0;
+    vk::DeviceSize range = VK_WHOLE_SIZE;
+};
+
+// Binds the global bindless set and small per-draw sets of buffers through one of three backends:
+// - DescriptorSet: per-draw sets are allocated from the frame's DescriptorAllocator, written and bound
+// - PushDescriptor: per-draw descriptors are pushed straight into the command buffer (VK_KHR_push_descriptor)
+// - DescriptorBuffer: per-draw descriptors are written into a mapped per-frame ring buffer and bound by offset
+//   (VK_EXT_descriptor_buffer), the bindless set has to live in a descriptor buffer as well in this mode
+// Pipelines drawing with the binder need pipelineCreateFlags() and a layout of
+// [bindless set (optional), drawSetLayout()].
+class ResourceBinder {
+public:
+    static constexpr uint32_t MaxDrawSetsPerFrame = 16384;
+    static constexpr uint32_t MaxDrawBindings = 8;
+
+    static bool checkSupport(vk::PhysicalDevice physDevice, BindingMode mode);
+    static const char *requiredExtension(BindingMode mode);
+
+    void create(vk::PhysicalDevice physDevice, vk::Device device, MemoryAllocator &allocator,
+                DescriptorAllocator &descriptorAllocator, const vk::DispatchLoaderDynamic &dispatcher,
+                BindingMode mode, std::span<const vk::DescriptorSetLayoutBinding> drawBindings,
+                const BindlessDescriptorSet *bindless, uint32_t frameCount);
+    void destroy();
+
+    // Must only be called after the fence of the frame that last used frameIndex has been waited on.
+    void beginFrame(uint32_t frameIndex);
+
+    void bindGlobal(vk::CommandBuffer cmdBuffer, vk::PipelineBindPoint bindPoint, vk::PipelineLayout pipelineLayout) const;
+    // buffers[i] is bound to the i-th entry of the drawBindings passed to create()
+    void bindDraw(vk::CommandBuffer cmdBuffer, vk::PipelineBindPoint bindPoint, vk::PipelineLayout pipelineLayout,
+                  std::span<const BufferBinding> buffers);
+
+    [[nodiscard]] BindingMode mode() const { return bindingMode; }
+    [[nodiscard]] vk::DescriptorSetLayout drawSetLayout() const { return setLayout; }
+    [[nodiscard]] uint32_t drawSetIndex() const { return bindless ? 1 : 0; }
+    [[nodiscard]] vk::PipelineCreateFlags pipelineCreateFlags() const;
+
+private:
+    vk::Device device;
+    MemoryAllocator *allocator = nullptr;
+    DescriptorAllocator *descriptorAllocator = nullptr;
+    const vk::DispatchLoaderDynamic *dispatcher = nullptr;
+    const BindlessDescriptorSet *bindless = nullptr;
+
+    BindingMode bindingMode = BindingMode::DescriptorSet;
+    vk::DescriptorSetLayout setLayout;
+    std::vector<uint32_t> bindingNumbers;
+    std::vector<vk::DescriptorType> bindingTypes;
+
+    // descriptor buffer mode only
+    vk::PhysicalDeviceDescriptorBufferPropertiesEXT descriptorBufferProperties;
+    std::vector<vk::DeviceSize> bindingOffsets;
+    vk::DeviceSize setStride = 0;
+    vk::DeviceSize frameRegionSize = 0;
+    Buffer ringBuffer;
+    vk::DeviceSize frameBegin = 0;
+    vk::DeviceSize frameOffset = 0;
+};
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstdint>
+
+// Data shared with the mesh shaders, mirrors shaders/scene.glsl.
+
+// Written by the host every frame into a buffer registered in the bindless set.
+struct FrameData {
+    float viewProj[16];        // column major
+    float frustumPlanes[6][4]; // normalized, xyz points into the frustum
+    float cameraPosition[4];
+    float view[16];
+    float projection[4];  // [0][0] and [1][1] of the projection matrix, near and far plane distance
+    float clusterGrid[4]; // tile size in pixels, scale and bias from the log of the view depth to the depth slice
+    float viewport[4];    // size in pixels, zw unused
+    float inverseViewProj[16]; // world positions from depth in the deferred lighting pass
+};
+
+// DrawConstants::instanceListIndex when every instance is drawn
+constexpr uint32_t NoInstanceList = ~0u;
+
+// Push constants of every mesh pipeline, the buffer fields are bindless storage buffer indices.
+struct DrawConstants {
+    uint32_t frameDataIndex;
+    uint32_t vertexBufferIndex;
+    uint32_t meshletBufferIndex;
+    uint32_t meshletVertexBufferIndex;
+    uint32_t meshletTriangleBufferIndex;
+    uint32_t meshletCount; // meshlets of the finest level, the most any instance draws
+    uint32_t drawBufferIndex;
+    uint32_t instanceBufferIndex;
+    uint32_t instanceCount;
+    uint32_t instanceListIndex; // NoInstanceList or an instance list of the OcclusionCuller
+    uint32_t lightBufferIndex;
+    uint32_t clusterBufferIndex; // light lists of the froxels, written by the LightClusterer
+    float positionOffset[4]; // maps quantized positions from 0..1 to the mesh bounds
+    float positionScale[4];
+};
+
+// One drawn copy of the mesh, written by the host every frame together with the ranges of the level of detail
+// selected for it, see MeshLod.
+struct InstanceData {
+    float offset[4]; // object to world translation, w is unused
+    uint32_t indexOffset;
+    uint32_t indexCount;
+    uint32_t meshletOffset;
+    uint32_t meshletCount;
+};
+
+// Written by the meshlet culling pass: a VkDrawIndirectCommand drawing one meshlet of one instance, followed by what
+// shaders/meshlet.vert needs to find them. firstInstance is the slot of the draw itself.
+struct MeshletDraw {
+    uint32_t vertexCount;
+    uint32_t instanceCount;
+    uint32_t firstVertex;
+    uint32_t firstInstance;
+    uint32_t meshletIndex;
+    uint32_t instanceIndex;
+    uint32_t padding[2];
+};
+
+constexpr uint32_t LightTypePoint = 0;
+constexpr uint32_t LightTypeSpot = 1;
+
+// A point or spot light, written by the host every frame. The light fades out smoothly towards range, spot lights
+// between the inner and outer cone cosines.
+struct LightData {
+    float position[3];
+    float range;
+    float color[3]; // premultiplied by the intensity
+    uint32_t type;
+    float direction[3]; // spot lights only, normalized
+    float spotCosOuter;
+    float spotCosInner;
+    uint32_t padding[3];
+};
+
+static_assert(sizeof(FrameData) == 352);
+static_assert(sizeof(DrawConstants) == 80);
+static_assert(sizeof(InstanceData) == 32);
+static_assert(sizeof(MeshletDraw) == 32);
+static_assert(sizeof(LightData) == 64);
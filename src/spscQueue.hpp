@@ -0,0 +1,57 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <optional>
+
+// Bounded queue between exactly one producer thread, which calls push(), and one consumer thread, which calls pop().
+// Neither side locks or blocks. The indices count up forever and are wrapped by the power of two capacity, so a full
+// queue is told apart from an empty one by their difference. Each side keeps a copy of the other side's index and only
+// reloads it when the copy says the queue is full or empty, so the shared cache lines move as rarely as possible.
+template<typename T, size_t Capacity>
+class SpscQueue {
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "the capacity has to be a power of two");
+
+public:
+    // Returns false when the queue is full, value is not enqueued then.
+    bool push(const T &value) {
+        auto write = writeIndex.load(std::memory_order_relaxed);
+        if (write - cachedReadIndex == Capacity) {
+            cachedReadIndex = readIndex.load(std::memory_order_acquire);
+            if (write - cachedReadIndex == Capacity) {
+                return false;
+            }
+        }
+
+        slots[write & (Capacity - 1)] = value;
+        writeIndex.store(write + 1, std::memory_order_release);
+        return true;
+    }
+
+    std::optional<T> pop() {
+        auto read = readIndex.load(std::memory_order_relaxed);
+        if (read == cachedWriteIndex) {
+            cachedWriteIndex = writeIndex.load(std::memory_order_acquire);
+            if (read == cachedWriteIndex) {
+                return std::nullopt;
+            }
+        }
+
+        T value = slots[read & (Capacity - 1)];
+        readIndex.store(read + 1, std::memory_order_release);
+        return value;
+    }
+
+private:
+    static constexpr size_t CacheLineSize = 64;
+
+    // producer side
+    alignas(CacheLineSize) std::atomic<size_t> writeIndex{0};
+    size_t cachedReadIndex = 0;
+    // consumer side
+    alignas(CacheLineSize) std::atomic<size_t> readIndex{0};
+    size_t cachedWriteIndex = 0;
+
+    alignas(CacheLineSize) std::array<T, Capacity> slots{};
+};
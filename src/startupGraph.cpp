@@ -0,0 +1,106 @@
+#include "startupGraph.hpp"
+#include "trace.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <iomanip>
+#include <stdexcept>
+
+StartupGraph::Step StartupGraph::add(const char *name, std::function<void()> function,
+                                     std::initializer_list<Step> dependencies) {
+    auto step = static_cast<Step>(steps.size());
+    auto &state = steps.emplace_back();
+    state.name = name;
+    state.function = std::move(function);
+    state.dependencyCount = static_cast<uint32_t>(dependencies.size());
+
+    for (auto dependency : dependencies) {
+        if (dependency >= step) {
+            throw std::runtime_error("could not add startup step, its dependencies have to be added first");
+        }
+        steps[dependency].dependents.push_back(step);
+    }
+    return step;
+}
+
+void StartupGraph::run(JobSystem &jobs) {
+    failed = false;
+    error = nullptr;
+    for (auto &state : steps) {
+        state.remainingDependencies.store(state.dependencyCount, std::memory_order_relaxed);
+        state.executed = false;
+    }
+
+    runStart = Clock::now();
+    JobCounter counter;
+    for (Step step = 0; step < steps.size(); step++) {
+        if (steps[step].dependencyCount == 0) {
+            start(jobs, step, counter);
+        }
+    }
+    jobs.wait(counter);
+    totalMilliseconds = std::chrono::duration<double, std::milli>(Clock::now() - runStart).count();
+
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+void StartupGraph::start(JobSystem &jobs, Step step, JobCounter &counter) {
+    jobs.run([this, &jobs, step, &counter] { execute(jobs, step, counter); }, &counter);
+}
+
+void StartupGraph::execute(JobSystem &jobs, Step step, JobCounter &counter) {
+    auto &state = steps[step];
+
+    // the dependents are still released after a failure, they skip themselves, so every step's job finishes
+    if (!failed.load(std::memory_order_acquire)) {
+        auto start = Clock::now();
+        try {
+            TRACE_ZONE(state.name);
+            state.function();
+        } catch (...) {
+            std::lock_guard lock(errorMutex);
+            if (!error) {
+                error = std::current_exception();
+            }
+            failed.store(true, std::memory_order_release);
+        }
+        auto end = Clock::now();
+
+        state.executed = true;
+        state.startMilliseconds = std::chrono::duration<double, std::milli>(start - runStart).count();
+        state.milliseconds = std::chrono::duration<double, std::milli>(end - start).count();
+    }
+
+    for (auto dependent : state.dependents) {
+        if (steps[dependent].remainingDependencies.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            start(jobs, dependent, counter);
+        }
+    }
+}
+
+void StartupGraph::report(std::ostream &out) const {
+    size_t nameWidth = 0;
+    for (const auto &state : steps) {
+        nameWidth = std::max(nameWidth, strlen(state.name));
+    }
+
+    double stepMilliseconds = 0.0;
+    auto flags = out.flags();
+    auto precision = out.precision();
+    out << std::fixed << std::setprecision(2) << "startup steps:\n";
+    for (const auto &state : steps) {
+        out << "  " << std::left << std::setw(static_cast<int>(nameWidth)) << state.name << std::right;
+        if (state.executed) {
+            out << "  at " << std::setw(8) << state.startMilliseconds << " ms, took " << std::setw(8)
+                << state.milliseconds << " ms\n";
+        } else {
+            out << "  skipped\n";
+        }
+        stepMilliseconds += state.milliseconds;
+    }
+    out << "startup took " << totalMilliseconds << " ms for " << stepMilliseconds << " ms of steps\n";
+    out.flags(flags);
+    out.precision(precision);
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "jobSystem.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <initializer_list>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+// Initialization steps and the steps each of them needs to be done first. run() starts every step on the job system as
+// soon as its dependencies have finished, so independent steps run concurrently, and records when each one started and
+// how long it took.
+class StartupGraph {
+public:
+    using Step = uint32_t;
+    using Clock = std::chrono::steady_clock;
+
+    // The dependencies have to be added before.
+    Step add(const char *name, std::function<void()> function, std::initializer_list<Step> dependencies = {});
+
+    // Runs all steps and returns once they are done. After a step threw, the steps that haven't started yet are
+    // skipped and the first exception is rethrown.
+    void run(JobSystem &jobs);
+
+    // every step's start and wall time relative to the start of run(), in the order they were added
+    void report(std::ostream &out) const;
+
+private:
+    struct StepState {
+        const char *name;
+        std::function<void()> function;
+        std::vector<Step> dependents;
+        uint32_t dependencyCount = 0;
+        std::atomic<uint32_t> remainingDependencies = 0;
+
+        bool executed = false;
+        double startMilliseconds = 0.0;
+        double milliseconds = 0.0;
+    };
+
+    void start(JobSystem &jobs, Step step, JobCounter &counter);
+    void execute(JobSystem &jobs, Step step, JobCounter &counter);
+
+    // a deque, the atomics can't be moved
+    std::deque<StepState> steps;
+    Clock::time_point runStart;
+    double totalMilliseconds = 0.0;
+
+    std::atomic<bool> failed = false;
+    std::mutex errorMutex;
+    std::exception_ptr error;
+};
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstdint>
+
+// On-disk layout of a streamable texture (.vtex): a TextureFileHeader, one TextureMipInfo per mip level
+// (level 0 is the full resolution image) and the tightly packed data of every level at the recorded offsets.
+// Levels are stored consecutively in level order, so any range of levels can be read with a single contiguous read.
+// Written by the TextureCooker (tools/textureCooker).
+
+constexpr uint32_t TextureFileMagic = 0x58455456; // "VTEX"
+constexpr uint32_t TextureFileVersion = 1;
+
+struct TextureFileHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t format; // VkFormat
+    uint32_t width;
+    uint32_t height;
+    uint32_t mipCount;
+};
+
+struct TextureMipInfo {
+    uint64_t offset;
+    uint64_t size;
+};
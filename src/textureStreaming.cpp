@@ -0,0 +1,722 @@
+#include "textureStreaming.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <stdexcept>
+
+namespace {
+
+vk::Extent3D mipExtent(const TextureFileHeader &header, uint32_t mipLevel) {
+    return vk::Extent3D{
+            .width = std::max(1u, header.width >> mipLevel),
+            .height = std::max(1u, header.height >> mipLevel),
+            .depth = 1,
+    };
+}
+
+vk::ImageCreateInfo imageCreateInfo(const TextureFileHeader &header, uint32_t residentMip, bool generatedMips) {
+    auto format = static_cast<vk::Format>(header.format);
+    vk::ImageCreateFlags flags;
+    vk::ImageUsageFlags usage = vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferDst |
+                                vk::ImageUsageFlagBits::eTransferSrc;
+    if (generatedMips) {
+        usage |= vk::ImageUsageFlagBits::eStorage;
+        if (MipDownsampler::storageFormat(format) != format) {
+            flags = vk::ImageCreateFlagBits::eMutableFormat | vk::ImageCreateFlagBits::eExtendedUsage;
+        }
+    }
+
+    return vk::ImageCreateInfo{
+            .flags = flags,
+            .imageType = vk::ImageType::e2D,
+            .format = static_cast<vk::Format>(header.format),
+            .extent = mipExtent(header, residentMip),
+            .mipLevels = header.mipCount - residentMip,
+            .arrayLayers = 1,
+            .samples = vk::SampleCountFlagBits::e1,
+            .tiling = vk::ImageTiling::eOptimal,
+            .usage = usage,
+            .sharingMode = vk::SharingMode::eExclusive,
+            .initialLayout = vk::ImageLayout::eUndefined,
+    };
+}
+
+struct TexelBlock {
+    uint32_t extent; // width and height in texels
+    uint32_t size;   // bytes
+};
+
+// the formats the loader can verify level sizes for
+std::optional<TexelBlock> texelBlock(vk::Format format) {
+    switch (format) {
+    case vk::Format::eR8G8B8A8Unorm:
+    case vk::Format::eR8G8B8A8Srgb:
+    case vk::Format::eB8G8R8A8Unorm:
+    case vk::Format::eB8G8R8A8Srgb:
+        return TexelBlock{1, 4};
+    case vk::Format::eBc1RgbaUnormBlock:
+    case vk::Format::eBc1RgbaSrgbBlock:
+    case vk::Format::eBc4UnormBlock:
+        return TexelBlock{4, 8};
+    case vk::Format::eBc3UnormBlock:
+    case vk::Format::eBc3SrgbBlock:
+    case vk::Format::eBc5UnormBlock:
+    case vk::Format::eBc7UnormBlock:
+    case vk::Format::eBc7SrgbBlock:
+        return TexelBlock{4, 16};
+    default:
+        return std::nullopt;
+    }
+}
+
+vk::ImageMemoryBarrier imageBarrier(vk::Image image, uint32_t levelCount, vk::ImageLayout oldLayout, vk::ImageLayout newLayout,
+                                    vk::AccessFlags srcAccess, vk::AccessFlags dstAccess) {
+    return vk::ImageMemoryBarrier{
+            .srcAccessMask = srcAccess,
+            .dstAccessMask = dstAccess,
+            .oldLayout = oldLayout,
+            .newLayout = newLayout,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .image = image,
+            .subresourceRange = {
+                    .aspectMask = vk::ImageAspectFlagBits::eColor,
+                    .baseMipLevel = 0,
+                    .levelCount = levelCount,
+                    .baseArrayLayer = 0,
+                    .layerCount = 1,
+            },
+    };
+}
+
+}
+
+void TextureStreamer::create(vk::Device logicalDevice, MemoryAllocator &memoryAllocator, BindlessDescriptorSet &bindlessSet,
+                             UploadBatcher &uploadBatcher, MipDownsampler &mipDownsampler, vk::Queue uploadQueue,
+                             uint32_t queueFamily, vk::DeviceSize budget) {
+    device = logicalDevice;
+    allocator = &memoryAllocator;
+    bindless = &bindlessSet;
+    batcher = &uploadBatcher;
+    downsampler = &mipDownsampler;
+    queue = uploadQueue;
+    memoryBudget = budget;
+    pressureListener = allocator->addPressureListener([this](uint32_t heapIndex, vk::DeviceSize excess) {
+        return relievePressure(heapIndex, excess);
+    });
+
+    commandPool = device.createCommandPool({
+            .flags = vk::CommandPoolCreateFlagBits::eTransient,
+            .queueFamilyIndex = queueFamily,
+    });
+
+    stopLoader = false;
+    loader = std::thread(&TextureStreamer::loaderThread, this);
+}
+
+void TextureStreamer::destroy() {
+    {
+        std::lock_guard lock(loaderMutex);
+        stopLoader = true;
+    }
+    loaderCondition.notify_one();
+    loader.join();
+
+    allocator->removePressureListener(pressureListener);
+    retireCompletedBatches(true);
+
+    for (auto &texture : textures) {
+        bindless->removeSampledImage(texture.bindlessIndex);
+        device.destroy(texture.view);
+        allocator->destroyImage(texture.image);
+    }
+    textures.clear();
+    totalResidentBytes = 0;
+    pressureRelease = 0;
+    imageHeap.reset();
+
+    loadRequests.clear();
+    loadResults.clear();
+
+    device.destroy(commandPool);
+}
+
+std::vector<std::byte> TextureStreamer::readFile(const std::string &path, uint64_t offset, uint64_t size) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        throw std::runtime_error("could not open texture " + path);
+    }
+
+    std::vector<std::byte> data(size);
+    file.seekg(static_cast<std::streamoff>(offset));
+    file.read(reinterpret_cast<char *>(data.data()), static_cast<std::streamsize>(size));
+    if (!file) {
+        throw std::runtime_error("could not read texture " + path);
+    }
+
+    return data;
+}
+
+TextureHandle TextureStreamer::load(const std::string &path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        throw std::runtime_error("could not open texture " + path);
+    }
+
+    Texture texture{.path = path};
+    file.read(reinterpret_cast<char *>(&texture.header), sizeof(texture.header));
+    const auto &header = texture.header;
+    if (!file || header.magic != TextureFileMagic || header.version != TextureFileVersion || header.width == 0 ||
+        header.height == 0 || header.mipCount == 0 ||
+        header.mipCount > static_cast<uint32_t>(std::bit_width(std::max(header.width, header.height)))) {
+        throw std::runtime_error("invalid texture file " + path);
+    }
+    auto block = texelBlock(static_cast<vk::Format>(header.format));
+    if (!block) {
+        throw std::runtime_error("unsupported format in texture " + path);
+    }
+
+    texture.mips.resize(header.mipCount);
+    file.read(reinterpret_cast<char *>(texture.mips.data()),
+              static_cast<std::streamsize>(texture.mips.size() * sizeof(TextureMipInfo)));
+    if (!file) {
+        throw std::runtime_error("invalid texture file " + path);
+    }
+
+    // every level has to hold exactly its texels and follow the previous one within the file, a truncated or corrupt
+    // file would otherwise be read and copied out of bounds
+    file.seekg(0, std::ios::end);
+    auto fileSize = static_cast<uint64_t>(file.tellg());
+    auto expectedOffset = static_cast<uint64_t>(sizeof(TextureFileHeader) + texture.mips.size() * sizeof(TextureMipInfo));
+    for (uint32_t level = 0; level < header.mipCount; level++) {
+        auto extent = mipExtent(header, level);
+        auto blocksX = (extent.width + block->extent - 1) / block->extent;
+        auto blocksY = (extent.height + block->extent - 1) / block->extent;
+        const auto &mip = texture.mips[level];
+        if ((level == 0 ? mip.offset < expectedOffset : mip.offset != expectedOffset) ||
+            mip.size != static_cast<uint64_t>(blocksX) * blocksY * block->size || mip.offset > fileSize ||
+            mip.size > fileSize - mip.offset) {
+            throw std::runtime_error("invalid texture file " + path);
+        }
+        expectedOffset = mip.offset + mip.size;
+    }
+
+    // a file with just the full resolution level gets the rest of the chain from the downsampler, as far as it goes
+    auto fullChain = static_cast<uint32_t>(std::bit_width(std::max(header.width, header.height)));
+    if (header.mipCount == 1 && fullChain > 1) {
+        if (MipDownsampler::canGenerateMips(static_cast<vk::Format>(header.format)) &&
+            std::max(header.width, header.height) <= MipDownsampler::MaxSourceExtent) {
+            texture.generatedMips = true;
+            texture.mipsPending = true;
+            texture.header.mipCount = std::min(fullChain, MipDownsampler::MaxLevels + 1);
+        } else {
+            std::cerr << "cannot generate mips for texture " << path << ", it is sampled without them" << std::endl;
+        }
+    }
+
+    texture.tailMip = texture.generatedMips ? 0 : texture.header.mipCount - 1;
+    for (uint32_t level = 0; level < texture.tailMip; level++) {
+        auto extent = mipExtent(texture.header, level);
+        if (std::max(extent.width, extent.height) <= TailExtent) {
+            texture.tailMip = level;
+            break;
+        }
+    }
+    texture.requestedMip = texture.tailMip;
+
+    // what every residency costs in video memory, the budget counts allocations rather than file sizes
+    for (uint32_t mip = 0; mip <= texture.tailMip; mip++) {
+        auto createInfo = imageCreateInfo(header, mip, texture.generatedMips);
+        texture.residentSizes.push_back(device.getImageMemoryRequirements(vk::DeviceImageMemoryRequirements{
+                .pCreateInfo = &createInfo,
+        }).memoryRequirements.size);
+    }
+
+    auto tailOffset = texture.mips[texture.tailMip].offset;
+    auto &lastMip = texture.mips.back();
+    auto tailData = readFile(path, tailOffset, lastMip.offset + lastMip.size - tailOffset);
+
+    // a fresh image has nothing to copy over, so the tail goes out with the other uploads of the frame
+    auto [image, view] = createImage(texture, texture.tailMip);
+    auto storedLevels = static_cast<uint32_t>(texture.mips.size());
+    auto levelCount = storedLevels - texture.tailMip;
+
+    std::vector<vk::BufferImageCopy> copies;
+    for (auto level = texture.tailMip; level < storedLevels; level++) {
+        copies.push_back(vk::BufferImageCopy{
+                .bufferOffset = texture.mips[level].offset - tailOffset,
+                .imageSubresource = {vk::ImageAspectFlagBits::eColor, level - texture.tailMip, 0, 1},
+                .imageExtent = mipExtent(texture.header, level),
+        });
+    }
+    batcher->upload(image.image, {vk::ImageAspectFlagBits::eColor, 0, levelCount, 0, 1}, copies,
+                    tailData.data(), tailData.size());
+
+    texture.image = image;
+    texture.view = view;
+    texture.bindlessIndex = bindless->addSampledImage(view);
+    texture.residentMip = texture.tailMip;
+    totalResidentBytes += image.allocation.size;
+    imageHeap = image.allocation.heapIndex;
+
+    auto handle = static_cast<TextureHandle>(textures.size());
+    textures.push_back(std::move(texture));
+
+    return handle;
+}
+
+void TextureStreamer::requestLod(TextureHandle handle, uint32_t mipLevel) {
+    auto &texture = textures[handle];
+    mipLevel = std::min(mipLevel, texture.header.mipCount - 1);
+
+    if (texture.lastRequestFrame != frameNumber) {
+        texture.requestedMip = mipLevel;
+        texture.lastRequestFrame = frameNumber;
+    } else {
+        texture.requestedMip = std::min(texture.requestedMip, mipLevel);
+    }
+}
+
+uint32_t TextureStreamer::lodForFootprint(TextureHandle handle, float pixels) const {
+    const auto &texture = textures[handle];
+    auto size = static_cast<float>(std::max(texture.header.width, texture.header.height));
+    if (pixels >= size) {
+        return 0;
+    }
+    if (pixels <= 1.0f) {
+        return texture.header.mipCount - 1;
+    }
+    return std::min(static_cast<uint32_t>(std::log2(size / pixels)), texture.header.mipCount - 1);
+}
+
+void TextureStreamer::update() {
+    retireCompletedBatches(false);
+
+    std::vector<LoadResult> results;
+    {
+        std::lock_guard lock(loaderMutex);
+        results.swap(loadResults);
+    }
+
+    // a level only becomes usable once every coarser level is resident, which holds since levels are loaded in order
+    std::vector<LoadResult> uploads;
+    vk::DeviceSize stagingSize = 0;
+    for (auto &result : results) {
+        auto &texture = textures[result.texture];
+        texture.loadPending = false;
+        loadsInFlight--;
+        bytesInFlight -= levelBytes(texture, result.firstMip);
+
+        if (result.data.empty()) {
+            texture.loadFailed = true;
+            continue;
+        }
+
+        stagingSize += result.data.size();
+        uploads.push_back(std::move(result));
+    }
+
+    // evictions asked for by memory pressure come on top of the streamer's own budget, and loads only go into the
+    // headroom left below the heap's soft limit
+    auto evictionLimit = memoryBudget;
+    if (pressureRelease > 0) {
+        evictionLimit = std::min(evictionLimit, totalResidentBytes - std::min(totalResidentBytes, pressureRelease));
+        pressureRelease = 0;
+    }
+    auto loadLimit = memoryBudget;
+    if (imageHeap) {
+        loadLimit = std::min(loadLimit, totalResidentBytes + allocator->headroom(*imageHeap));
+    }
+
+    auto evictions = chooseEvictions(evictionLimit, uploads);
+
+    std::vector<TextureHandle> mipGenerations;
+    for (TextureHandle handle = 0; handle < textures.size(); handle++) {
+        if (textures[handle].mipsPending) {
+            mipGenerations.push_back(handle);
+        }
+    }
+
+    if (!uploads.empty() || !evictions.empty() || !mipGenerations.empty()) {
+        auto batch = beginBatch(stagingSize);
+
+        // the first level went out with the batcher's flush, which was submitted before this batch
+        for (auto handle : mipGenerations) {
+            auto &texture = textures[handle];
+            auto views = downsampler->createViews(texture.image.image, static_cast<vk::Format>(texture.header.format),
+                                                  texture.header.mipCount);
+            downsampler->generateMips(batch.cmdBuffer, texture.image.image, views,
+                                      {texture.header.width, texture.header.height},
+                                      vk::ImageLayout::eShaderReadOnlyOptimal, vk::PipelineStageFlagBits::eTransfer,
+                                      vk::AccessFlagBits::eTransferWrite, DownsampleFilter::Kaiser);
+            batch.mipViews.push_back(std::move(views));
+            texture.mipsPending = false;
+        }
+
+        vk::DeviceSize stagingOffset = 0;
+        for (const auto &upload : uploads) {
+            std::memcpy(static_cast<std::byte *>(batch.staging.allocation.mapped) + stagingOffset,
+                        upload.data.data(), upload.data.size());
+
+            StagedLevels staged{
+                    .firstMip = upload.firstMip,
+                    .mipCount = 1,
+                    .stagingOffset = stagingOffset,
+            };
+            rebuild(batch, upload.texture, upload.firstMip, &staged);
+
+            stagingOffset += upload.data.size();
+        }
+
+        for (const auto &[handle, newResidentMip] : evictions) {
+            rebuild(batch, handle, newResidentMip, nullptr);
+        }
+
+        submitBatch(std::move(batch));
+    }
+
+    queueLoads(loadLimit);
+
+    frameNumber++;
+}
+
+vk::DeviceSize TextureStreamer::relievePressure(uint32_t heapIndex, vk::DeviceSize excess) {
+    if (heapIndex != imageHeap) {
+        return 0;
+    }
+
+    // earlier evictions are still on their way out, the usage only drops once their batches have executed
+    if (excess <= retiredBytes) {
+        return excess;
+    }
+
+    vk::DeviceSize evictable = 0;
+    for (const auto &texture : textures) {
+        evictable += texture.residentSizes[texture.residentMip] - texture.residentSizes[texture.tailMip];
+    }
+
+    auto release = std::min(excess - retiredBytes, evictable);
+    pressureRelease = std::max(pressureRelease, release);
+    return retiredBytes + release;
+}
+
+std::vector<std::pair<TextureHandle, uint32_t>> TextureStreamer::chooseEvictions(
+        vk::DeviceSize limit, const std::vector<LoadResult> &uploads) const {
+    std::map<TextureHandle, uint32_t> newResidency;
+    auto resident = totalResidentBytes;
+
+    // a level that just finished loading counts as resident and isn't evicted again by the batch that uploads it
+    std::vector<bool> uploaded(textures.size(), false);
+    for (const auto &upload : uploads) {
+        uploaded[upload.texture] = true;
+        resident += levelBytes(textures[upload.texture], upload.firstMip);
+    }
+
+    auto residentMip = [&](TextureHandle handle) {
+        auto it = newResidency.find(handle);
+        return it != newResidency.end() ? it->second : textures[handle].residentMip;
+    };
+
+    while (resident > limit) {
+        // levels finer than anything requested go first, then the least recently requested textures
+        std::optional<TextureHandle> victim;
+        bool victimUnneeded = false;
+
+        for (TextureHandle handle = 0; handle < textures.size(); handle++) {
+            const auto &texture = textures[handle];
+            auto mip = residentMip(handle);
+            if (texture.loadPending || uploaded[handle] || mip >= texture.tailMip) {
+                continue;
+            }
+
+            bool requestedNow = texture.lastRequestFrame == frameNumber;
+            bool unneeded = !requestedNow || mip < texture.requestedMip;
+            if (requestedNow && !unneeded) {
+                continue;
+            }
+
+            if (!victim || (unneeded && !victimUnneeded) ||
+                (unneeded == victimUnneeded && texture.lastRequestFrame < textures[*victim].lastRequestFrame)) {
+                victim = handle;
+                victimUnneeded = unneeded;
+            }
+        }
+
+        if (!victim) {
+            break;
+        }
+
+        auto mip = residentMip(*victim);
+        resident -= std::min(resident, levelBytes(textures[*victim], mip));
+        newResidency[*victim] = mip + 1;
+    }
+
+    return {newResidency.begin(), newResidency.end()};
+}
+
+void TextureStreamer::queueLoads(vk::DeviceSize limit) {
+    // memory held by levels nobody asked for this frame can be reclaimed, so loads may count on it
+    vk::DeviceSize reclaimable = 0;
+    for (const auto &texture : textures) {
+        if (texture.lastRequestFrame != frameNumber) {
+            reclaimable += texture.residentSizes[texture.residentMip] - texture.residentSizes[texture.tailMip];
+        }
+    }
+
+    std::vector<TextureHandle> candidates;
+    for (TextureHandle handle = 0; handle < textures.size(); handle++) {
+        const auto &texture = textures[handle];
+        if (texture.lastRequestFrame == frameNumber && texture.requestedMip < texture.residentMip &&
+            !texture.loadPending && !texture.loadFailed) {
+            candidates.push_back(handle);
+        }
+    }
+
+    // the textures missing the most detail are served first
+    std::sort(candidates.begin(), candidates.end(), [this](TextureHandle a, TextureHandle b) {
+        return textures[a].residentMip - textures[a].requestedMip > textures[b].residentMip - textures[b].requestedMip;
+    });
+
+    std::lock_guard lock(loaderMutex);
+    for (auto handle : candidates) {
+        if (loadsInFlight >= MaxLoadsInFlight) {
+            break;
+        }
+
+        auto &texture = textures[handle];
+        auto mipLevel = texture.residentMip - 1;
+        auto size = levelBytes(texture, mipLevel);
+
+        if (totalResidentBytes + bytesInFlight + size > limit + reclaimable) {
+            continue;
+        }
+
+        texture.loadPending = true;
+        loadsInFlight++;
+        bytesInFlight += size;
+
+        loadRequests.push_back(LoadRequest{
+                .texture = handle,
+                .mipLevel = mipLevel,
+                .path = texture.path,
+                .offset = texture.mips[mipLevel].offset,
+                .size = texture.mips[mipLevel].size,
+        });
+    }
+
+    loaderCondition.notify_one();
+}
+
+void TextureStreamer::loaderThread() {
+    while (true) {
+        LoadRequest request;
+        {
+            std::unique_lock lock(loaderMutex);
+            loaderCondition.wait(lock, [this] { return stopLoader || !loadRequests.empty(); });
+            if (stopLoader) {
+                return;
+            }
+
+            request = std::move(loadRequests.front());
+            loadRequests.pop_front();
+        }
+
+        LoadResult result{
+                .texture = request.texture,
+                .firstMip = request.mipLevel,
+        };
+
+        try {
+            result.data = readFile(request.path, request.offset, request.size);
+        } catch (std::exception const &e) {
+            std::cerr << "texture streaming failed: " << e.what() << std::endl;
+        }
+
+        std::lock_guard lock(loaderMutex);
+        loadResults.push_back(std::move(result));
+    }
+}
+
+TextureStreamer::UploadBatch TextureStreamer::beginBatch(vk::DeviceSize stagingSize) {
+    UploadBatch batch{
+            .cmdBuffer = device.allocateCommandBuffers({
+                    .commandPool = commandPool,
+                    .level = vk::CommandBufferLevel::ePrimary,
+                    .commandBufferCount = 1,
+            }).front(),
+            .fence = device.createFence({}),
+    };
+
+    if (stagingSize > 0) {
+        batch.staging = allocator->createBuffer(stagingSize, vk::BufferUsageFlagBits::eTransferSrc,
+                                                vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
+    }
+
+    batch.cmdBuffer.begin(vk::CommandBufferBeginInfo{
+            .flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit,
+    });
+
+    return batch;
+}
+
+void TextureStreamer::submitBatch(UploadBatch &&batch) {
+    batch.cmdBuffer.end();
+
+    vk::SubmitInfo submitInfo{
+            .commandBufferCount = 1,
+            .pCommandBuffers = &batch.cmdBuffer,
+    };
+
+    if (queue.submit(1, &submitInfo, batch.fence) != vk::Result::eSuccess) {
+        throw std::runtime_error("could not submit texture upload");
+    }
+
+    batches.push_back(std::move(batch));
+}
+
+vk::DeviceSize TextureStreamer::levelBytes(const Texture &texture, uint32_t mipLevel) {
+    auto finer = texture.residentSizes[mipLevel];
+    auto coarser = texture.residentSizes[mipLevel + 1];
+    return finer - std::min(finer, coarser);
+}
+
+std::pair<Image, vk::ImageView> TextureStreamer::createImage(const Texture &texture, uint32_t residentMip) {
+    auto levelCount = texture.header.mipCount - residentMip;
+    auto format = static_cast<vk::Format>(texture.header.format);
+
+    auto image = allocator->createImage(imageCreateInfo(texture.header, residentMip, texture.generatedMips),
+                                        vk::MemoryPropertyFlagBits::eDeviceLocal);
+
+    // with generated mips an sRGB image also has the storage usage, which its own format doesn't support
+    vk::ImageViewUsageCreateInfo sampledUsage{
+            .usage = vk::ImageUsageFlagBits::eSampled,
+    };
+    bool restrictUsage = texture.generatedMips && MipDownsampler::storageFormat(format) != format;
+
+    auto view = device.createImageView({
+            .pNext = restrictUsage ? &sampledUsage : nullptr,
+            .image = image.image,
+            .viewType = vk::ImageViewType::e2D,
+            .format = format,
+            .subresourceRange = {
+                    .aspectMask = vk::ImageAspectFlagBits::eColor,
+                    .baseMipLevel = 0,
+                    .levelCount = levelCount,
+                    .baseArrayLayer = 0,
+                    .layerCount = 1,
+            },
+    });
+
+    return {image, view};
+}
+
+void TextureStreamer::rebuild(UploadBatch &batch, TextureHandle handle, uint32_t newResidentMip, const StagedLevels *staged) {
+    auto &texture = textures[handle];
+    auto cmdBuffer = batch.cmdBuffer;
+    auto levelCount = texture.header.mipCount - newResidentMip;
+    auto [image, view] = createImage(texture, newResidentMip);
+
+    bool hasOldImage = static_cast<bool>(texture.image.image);
+    auto oldLevelCount = texture.header.mipCount - texture.residentMip;
+
+    // the source barrier covers every frame submitted so far, so the old image is no longer sampled once it
+    // changes layout, and all later frames use the new image
+    std::vector<vk::ImageMemoryBarrier> barriers = {
+            imageBarrier(image.image, levelCount, vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal,
+                         {}, vk::AccessFlagBits::eTransferWrite),
+    };
+    if (hasOldImage) {
+        barriers.push_back(imageBarrier(texture.image.image, oldLevelCount, vk::ImageLayout::eShaderReadOnlyOptimal,
+                                        vk::ImageLayout::eTransferSrcOptimal, {}, vk::AccessFlagBits::eTransferRead));
+    }
+    cmdBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eAllCommands, vk::PipelineStageFlagBits::eTransfer, {},
+                              0, nullptr, 0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data());
+
+    if (hasOldImage) {
+        std::vector<vk::ImageCopy> copies;
+        for (auto level = std::max(newResidentMip, texture.residentMip); level < texture.header.mipCount; level++) {
+            copies.push_back(vk::ImageCopy{
+                    .srcSubresource = {vk::ImageAspectFlagBits::eColor, level - texture.residentMip, 0, 1},
+                    .dstSubresource = {vk::ImageAspectFlagBits::eColor, level - newResidentMip, 0, 1},
+                    .extent = mipExtent(texture.header, level),
+            });
+        }
+
+        cmdBuffer.copyImage(texture.image.image, vk::ImageLayout::eTransferSrcOptimal,
+                            image.image, vk::ImageLayout::eTransferDstOptimal, copies);
+    }
+
+    if (staged) {
+        std::vector<vk::BufferImageCopy> copies;
+        auto firstOffset = texture.mips[staged->firstMip].offset;
+        for (auto level = staged->firstMip; level < staged->firstMip + staged->mipCount; level++) {
+            copies.push_back(vk::BufferImageCopy{
+                    .bufferOffset = staged->stagingOffset + texture.mips[level].offset - firstOffset,
+                    .imageSubresource = {vk::ImageAspectFlagBits::eColor, level - newResidentMip, 0, 1},
+                    .imageExtent = mipExtent(texture.header, level),
+            });
+        }
+
+        cmdBuffer.copyBufferToImage(batch.staging.buffer, image.image, vk::ImageLayout::eTransferDstOptimal, copies);
+    }
+
+    auto readBarrier = imageBarrier(image.image, levelCount, vk::ImageLayout::eTransferDstOptimal,
+                                    vk::ImageLayout::eShaderReadOnlyOptimal,
+                                    vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eShaderRead);
+    cmdBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eAllCommands, {},
+                              0, nullptr, 0, nullptr, 1, &readBarrier);
+
+    if (hasOldImage) {
+        totalResidentBytes -= texture.image.allocation.size;
+        retiredBytes += texture.image.allocation.size;
+        batch.retired.push_back(RetiredImage{
+                .image = texture.image,
+                .view = texture.view,
+                .bindlessIndex = texture.bindlessIndex,
+        });
+    }
+
+    texture.image = image;
+    texture.view = view;
+    texture.bindlessIndex = bindless->addSampledImage(view);
+    texture.residentMip = newResidentMip;
+    totalResidentBytes += image.allocation.size;
+    imageHeap = image.allocation.heapIndex;
+}
+
+void TextureStreamer::retireCompletedBatches(bool wait) {
+    while (!batches.empty()) {
+        auto &batch = batches.front();
+
+        if (wait) {
+            if (device.waitForFences(1, &batch.fence, VK_TRUE, UINT64_MAX) != vk::Result::eSuccess) {
+                throw std::runtime_error("could not wait for fences");
+            }
+        } else if (device.getFenceStatus(batch.fence) != vk::Result::eSuccess) {
+            break;
+        }
+
+        for (auto &retired : batch.retired) {
+            retiredBytes -= retired.image.allocation.size;
+            bindless->removeSampledImage(retired.bindlessIndex);
+            device.destroy(retired.view);
+            allocator->destroyImage(retired.image);
+        }
+
+        for (auto &views : batch.mipViews) {
+            downsampler->destroyViews(views);
+        }
+        if (batch.staging.buffer) {
+            allocator->destroyBuffer(batch.staging);
+        }
+        device.freeCommandBuffers(commandPool, batch.cmdBuffer);
+        device.destroy(batch.fence);
+
+        batches.pop_front();
+    }
+}
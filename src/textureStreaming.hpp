@@ -0,0 +1,164 @@
+#pragma once
+
+#include "bindless.hpp"
+#include "downsampler.hpp"
+#include "memory.hpp"
+#include "textureFormat.hpp"
+#include "uploadBatcher.hpp"
+
+#define VULKAN_HPP_NO_CONSTRUCTORS
+#include <vulkan/vulkan.hpp>
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using TextureHandle = uint32_t;
+
+// Streams the mip levels of .vtex textures (see textureFormat.hpp) in and out of video memory.
+// Registering a texture only reads its mip tail and stages it with the upload batcher, so it can be sampled in the
+// very first frame after the batcher's next flush. Finer levels are
+// read from disk on a loader thread one level at a time once requestLod() asks for them, and when the resident
+// size exceeds the budget the finest levels of the least recently requested textures are dropped again.
+// Changing the residency of a texture rebuilds its image with the new level range on the GPU and registers the
+// new view under a new bindless index, so bindlessIndex() has to be read every frame.
+// Files that store only the full resolution level get their mip chain generated on the GPU with the MipDownsampler
+// right after the level is uploaded. Such textures are resident as a whole and never streamed.
+// Besides its own budget the streamer listens for memory pressure on the heap of its images: loads only go into the
+// allocator's headroom below the heap's soft limit, and when the heap is over the limit the streamer evicts levels
+// until its share of the excess is released.
+class TextureStreamer {
+public:
+    // levels whose larger side is at most TailExtent are loaded at registration and never evicted
+    static constexpr uint32_t TailExtent = 64;
+    static constexpr uint32_t MaxLoadsInFlight = 8;
+
+    void create(vk::Device device, MemoryAllocator &allocator, BindlessDescriptorSet &bindless,
+                UploadBatcher &uploadBatcher, MipDownsampler &downsampler, vk::Queue queue, uint32_t queueFamily,
+                vk::DeviceSize budget);
+    void destroy();
+
+    TextureHandle load(const std::string &path);
+    void requestLod(TextureHandle texture, uint32_t mipLevel);
+    // The coarsest level that still has a texel per pixel when the texture is stretched over pixels on screen.
+    [[nodiscard]] uint32_t lodForFootprint(TextureHandle texture, float pixels) const;
+
+    // Uploads finished loads, evicts over budget and queues new loads. Must be called before recording a frame,
+    // after every frame that may sample the textures has been submitted.
+    void update();
+
+    [[nodiscard]] uint32_t bindlessIndex(TextureHandle texture) const { return textures[texture].bindlessIndex; }
+    [[nodiscard]] vk::DeviceSize residentBytes() const { return totalResidentBytes; }
+    [[nodiscard]] vk::DeviceSize budget() const { return memoryBudget; }
+
+private:
+    struct Texture {
+        std::string path;
+        TextureFileHeader header;
+        std::vector<TextureMipInfo> mips;
+
+        // allocation size of the image when resident from level i, for every level down to the tail
+        std::vector<vk::DeviceSize> residentSizes;
+
+        Image image;
+        vk::ImageView view;
+        uint32_t bindlessIndex = 0;
+
+        uint32_t residentMip = 0;   // finest level currently in the image
+        uint32_t tailMip = 0;       // first level of the mip tail
+        uint32_t requestedMip = 0;
+        uint64_t lastRequestFrame = 0;
+        bool loadPending = false;
+        bool loadFailed = false;
+        bool generatedMips = false; // levels below the first are built on the GPU
+        bool mipsPending = false;   // and haven't been yet
+    };
+
+    // carries a copy of everything the loader thread needs, it never touches the texture list
+    struct LoadRequest {
+        TextureHandle texture;
+        uint32_t mipLevel;
+        std::string path;
+        uint64_t offset;
+        uint64_t size;
+    };
+
+    struct LoadResult {
+        TextureHandle texture;
+        uint32_t firstMip;
+        std::vector<std::byte> data;
+    };
+
+    // level data that is copied into the rebuilt image from the batch's staging buffer
+    struct StagedLevels {
+        uint32_t firstMip;
+        uint32_t mipCount;
+        vk::DeviceSize stagingOffset;
+    };
+
+    // resources of the previous residency that stay alive until the rebuild that replaced them has executed
+    struct RetiredImage {
+        Image image;
+        vk::ImageView view;
+        uint32_t bindlessIndex;
+    };
+
+    struct UploadBatch {
+        vk::CommandBuffer cmdBuffer;
+        vk::Fence fence;
+        Buffer staging;
+        std::vector<RetiredImage> retired;
+        std::vector<MipChainViews> mipViews;
+    };
+
+    static std::vector<std::byte> readFile(const std::string &path, uint64_t offset, uint64_t size);
+    // video memory that making level mipLevel resident adds, mipLevel has to be above the tail
+    static vk::DeviceSize levelBytes(const Texture &texture, uint32_t mipLevel);
+
+    void loaderThread();
+    std::pair<Image, vk::ImageView> createImage(const Texture &texture, uint32_t residentMip);
+    UploadBatch beginBatch(vk::DeviceSize stagingSize);
+    void submitBatch(UploadBatch &&batch);
+    void rebuild(UploadBatch &batch, TextureHandle handle, uint32_t newResidentMip, const StagedLevels *staged);
+    vk::DeviceSize relievePressure(uint32_t heapIndex, vk::DeviceSize excess);
+    // uploads are the levels the same batch adds, their textures keep what they will have resident
+    std::vector<std::pair<TextureHandle, uint32_t>> chooseEvictions(vk::DeviceSize limit,
+                                                                    const std::vector<LoadResult> &uploads) const;
+    void queueLoads(vk::DeviceSize limit);
+    void retireCompletedBatches(bool wait);
+
+    vk::Device device;
+    MemoryAllocator *allocator = nullptr;
+    BindlessDescriptorSet *bindless = nullptr;
+    UploadBatcher *batcher = nullptr;
+    MipDownsampler *downsampler = nullptr;
+    vk::Queue queue;
+    vk::CommandPool commandPool;
+
+    std::vector<Texture> textures;
+    std::deque<UploadBatch> batches;
+    vk::DeviceSize memoryBudget = 0;
+    vk::DeviceSize totalResidentBytes = 0;
+    uint64_t frameNumber = 0;
+    uint32_t loadsInFlight = 0;
+    vk::DeviceSize bytesInFlight = 0;
+
+    uint32_t pressureListener = 0;
+    std::optional<uint32_t> imageHeap;
+    vk::DeviceSize pressureRelease = 0; // bytes to evict at the next update
+    vk::DeviceSize retiredBytes = 0;    // held by replaced images until their batch has executed
+
+    std::thread loader;
+    std::mutex loaderMutex;
+    std::condition_variable loaderCondition;
+    std::deque<LoadRequest> loadRequests;
+    std::vector<LoadResult> loadResults;
+    bool stopLoader = false;
+};
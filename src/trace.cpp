@@ -0,0 +1,213 @@
+#include "trace.hpp"
+
+#ifdef ENABLE_TRACING
+
+#include "spscQueue.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct TraceEvent {
+    const char *name;
+    int64_t begin;
+    int64_t end;
+    bool gpu;
+};
+
+// zones per thread between two exports, enough for a 10 ms stall at several hundred thousand zones per second
+constexpr size_t BufferCapacity = 1 << 14;
+constexpr auto ExportInterval = std::chrono::milliseconds(10);
+// the GPU track's thread id, recording threads count up from 1
+constexpr uint32_t GpuTrack = 0;
+
+struct ThreadBuffer {
+    SpscQueue<TraceEvent, BufferCapacity> events;
+    uint32_t threadId = 0;
+    std::string name;
+    std::atomic<uint64_t> droppedEvents = 0;
+};
+
+struct TraceState {
+    std::atomic<bool> running = false;
+
+    // guards the thread list and the names, the exporter drains the buffers under it
+    std::mutex mutex;
+    std::vector<std::unique_ptr<ThreadBuffer>> threads;
+
+    std::thread exporter;
+    std::mutex exporterMutex;
+    std::condition_variable exporterCondition;
+    bool exporterStopping = false;
+
+    std::ofstream file;
+    int64_t startTime = 0;
+    bool firstEvent = true;
+};
+
+// constructed on first use, zones may be recorded during static initialization
+TraceState &traceState() {
+    static TraceState state;
+    return state;
+}
+
+// owned by the trace state, so zones recorded by threads that have exited are still exported
+thread_local ThreadBuffer *threadBuffer = nullptr;
+
+ThreadBuffer &currentThreadBuffer() {
+    if (!threadBuffer) {
+        auto &state = traceState();
+        std::lock_guard lock(state.mutex);
+        auto &buffer = state.threads.emplace_back(std::make_unique<ThreadBuffer>());
+        buffer->threadId = static_cast<uint32_t>(state.threads.size());
+        buffer->name = "thread " + std::to_string(buffer->threadId);
+        threadBuffer = buffer.get();
+    }
+    return *threadBuffer;
+}
+
+void push(const TraceEvent &event) {
+    auto &buffer = currentThreadBuffer();
+    if (!buffer.events.push(event)) {
+        buffer.droppedEvents.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void writeMicroseconds(std::ostream &out, int64_t nanoseconds) {
+    out << nanoseconds / 1000 << '.' << std::setw(3) << std::setfill('0') << nanoseconds % 1000;
+}
+
+// Writes every buffered zone, only one thread may drain at a time.
+void drainBuffers(TraceState &state) {
+    std::lock_guard lock(state.mutex);
+    for (auto &buffer : state.threads) {
+        while (auto event = buffer->events.pop()) {
+            // zones recorded before the trace started, or partly before it
+            if (event->end < state.startTime) {
+                continue;
+            }
+            auto begin = std::max(event->begin, state.startTime);
+
+            state.file << (state.firstEvent ? "\n" : ",\n") << R"({"name":")" << event->name
+                       << R"(","ph":"X","pid":1,"tid":)" << (event->gpu ? GpuTrack : buffer->threadId) << R"(,"ts":)";
+            writeMicroseconds(state.file, begin - state.startTime);
+            state.file << R"(,"dur":)";
+            writeMicroseconds(state.file, event->end - begin);
+            state.file << '}';
+            state.firstEvent = false;
+        }
+    }
+}
+
+void exportLoop(TraceState &state) {
+    TRACE_THREAD_NAME("trace exporter");
+    std::unique_lock lock(state.exporterMutex);
+    while (!state.exporterCondition.wait_for(lock, ExportInterval, [&state] { return state.exporterStopping; })) {
+        lock.unlock();
+        drainBuffers(state);
+        lock.lock();
+    }
+}
+
+}
+
+int64_t Tracer::now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool Tracer::running() {
+    return traceState().running.load(std::memory_order_relaxed);
+}
+
+void Tracer::start(const std::string &path) {
+    auto &state = traceState();
+    if (state.running) {
+        return;
+    }
+
+    state.file.open(path, std::ios::trunc);
+    if (!state.file) {
+        std::cerr << "could not open trace file " << path << "\n";
+        return;
+    }
+    state.file << R"({"displayTimeUnit":"ms","traceEvents":[)";
+    state.firstEvent = true;
+
+    // zones left over from an earlier trace, nothing else reads the buffers yet
+    {
+        std::lock_guard lock(state.mutex);
+        for (auto &buffer : state.threads) {
+            while (buffer->events.pop()) {
+            }
+            buffer->droppedEvents = 0;
+        }
+    }
+
+    state.startTime = now();
+    state.exporterStopping = false;
+    state.exporter = std::thread(exportLoop, std::ref(state));
+    state.running.store(true, std::memory_order_release);
+}
+
+void Tracer::stop() {
+    auto &state = traceState();
+    if (!state.running) {
+        return;
+    }
+    state.running.store(false, std::memory_order_release);
+
+    {
+        std::lock_guard lock(state.exporterMutex);
+        state.exporterStopping = true;
+    }
+    state.exporterCondition.notify_one();
+    state.exporter.join();
+    drainBuffers(state);
+
+    uint64_t droppedEvents = 0;
+    std::lock_guard lock(state.mutex);
+    state.file << (state.firstEvent ? "\n" : ",\n")
+               << R"({"name":"thread_name","ph":"M","pid":1,"tid":)" << GpuTrack << R"(,"args":{"name":"GPU"}})";
+    for (const auto &buffer : state.threads) {
+        state.file << ",\n" << R"({"name":"thread_name","ph":"M","pid":1,"tid":)" << buffer->threadId
+                   << R"(,"args":{"name":")" << buffer->name << R"("}})";
+        droppedEvents += buffer->droppedEvents;
+    }
+    state.file << "\n]}\n";
+    state.file.close();
+
+    if (droppedEvents > 0) {
+        std::cerr << droppedEvents << " trace zones were dropped, the exporter fell behind\n";
+    }
+}
+
+void Tracer::setThreadName(const std::string &name) {
+    auto &buffer = currentThreadBuffer();
+    std::lock_guard lock(traceState().mutex);
+    buffer.name = name;
+}
+
+void Tracer::recordZone(const char *name, int64_t begin, int64_t end) {
+    if (traceState().running.load(std::memory_order_relaxed)) {
+        push({name, begin, end, false});
+    }
+}
+
+void Tracer::recordGpuZone(const char *name, int64_t begin, int64_t end) {
+    if (traceState().running.load(std::memory_order_relaxed)) {
+        push({name, begin, end, true});
+    }
+}
+
+#endif
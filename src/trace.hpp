@@ -0,0 +1,67 @@
+#pragma once
+
+// CPU trace zones, compiled in only with ENABLE_TRACING (the TRACING CMake option). Without it the macros expand to
+// nothing and no tracing code is built.
+//
+// A zone is recorded once it ends, as its name, begin and end in steady_clock nanoseconds, into a lock free ring
+// buffer of the recording thread that only the exporter thread reads. While a trace is running the exporter drains
+// the buffers every few milliseconds and appends the zones to a Chrome trace JSON file, which chrome://tracing and the
+// Perfetto UI open. Zones that don't fit into a full buffer are dropped and counted. GPU scopes converted to the same
+// clock go onto a track of their own, so bubbles between submitting work and the GPU executing it show up side by
+// side with the CPU zones.
+
+#ifdef ENABLE_TRACING
+
+#include <cstdint>
+#include <string>
+
+class Tracer {
+public:
+    static int64_t now();
+    [[nodiscard]] static bool running();
+
+    // Starts writing a trace to path, does nothing when one is already running.
+    static void start(const std::string &path);
+    // Writes the zones that are still buffered and closes the file.
+    static void stop();
+
+    // shown as the calling thread's name in the trace
+    static void setThreadName(const std::string &name);
+
+    // Records a zone of the calling thread, or of the GPU track. The name has to be a string literal or outlive the
+    // trace otherwise.
+    static void recordZone(const char *name, int64_t begin, int64_t end);
+    static void recordGpuZone(const char *name, int64_t begin, int64_t end);
+};
+
+class TraceZone {
+public:
+    // without a running trace a zone costs a load of the running flag
+    explicit TraceZone(const char *zoneName) : name(zoneName), begin(Tracer::running() ? Tracer::now() : 0) {}
+    ~TraceZone() {
+        if (begin != 0) {
+            Tracer::recordZone(name, begin, Tracer::now());
+        }
+    }
+
+    TraceZone(const TraceZone &) = delete;
+    TraceZone &operator=(const TraceZone &) = delete;
+
+private:
+    const char *name;
+    int64_t begin;
+};
+
+#define TRACE_CONCATENATE_INNER(a, b) a##b
+#define TRACE_CONCATENATE(a, b) TRACE_CONCATENATE_INNER(a, b)
+#define TRACE_ZONE(name) TraceZone TRACE_CONCATENATE(traceZone, __LINE__)(name)
+#define TRACE_THREAD_NAME(name) Tracer::setThreadName(name)
+#define TRACE_GPU_ZONE(name, begin, end) Tracer::recordGpuZone(name, begin, end)
+
+#else
+
+#define TRACE_ZONE(name)
+#define TRACE_THREAD_NAME(name)
+#define TRACE_GPU_ZONE(name, begin, end)
+
+#endif
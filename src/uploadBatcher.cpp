@@ -0,0 +1,342 @@
+#include "uploadBatcher.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <tuple>
+#include <utility>
+
+void UploadBatcher::create(vk::Device logicalDevice, MemoryAllocator &memoryAllocator, vk::Queue uploadQueue,
+                           uint32_t queueFamily) {
+    device = logicalDevice;
+    allocator = &memoryAllocator;
+    queue = uploadQueue;
+    nextToken = 1;
+    totals = {};
+
+    commandPool = device.createCommandPool({
+            .flags = vk::CommandPoolCreateFlagBits::eTransient | vk::CommandPoolCreateFlagBits::eResetCommandBuffer,
+            .queueFamilyIndex = queueFamily,
+    });
+
+    vk::SemaphoreTypeCreateInfo typeInfo{
+            .semaphoreType = vk::SemaphoreType::eTimeline,
+            .initialValue = 0,
+    };
+    timeline = device.createSemaphore({
+            .pNext = &typeInfo,
+    });
+}
+
+void UploadBatcher::destroy() {
+    wait(nextToken - 1);
+    retireCompleted();
+
+    for (auto &page : stagedPages) {
+        allocator->destroyBuffer(page.buffer);
+    }
+    stagedPages.clear();
+    bufferCopies.clear();
+    imageCopies.clear();
+    for (auto &page : freePages) {
+        allocator->destroyBuffer(page.buffer);
+    }
+    freePages.clear();
+    freeCommandBuffers.clear();
+
+    device.destroy(commandPool);
+    device.destroy(timeline);
+}
+
+UploadBatcher::Page &UploadBatcher::stage(const void *data, vk::DeviceSize size, vk::DeviceSize &offset) {
+    auto createPage = [this](vk::DeviceSize pageSize) {
+        return Page{
+                .buffer = allocator->createBuffer(pageSize, vk::BufferUsageFlagBits::eTransferSrc,
+                                                  vk::MemoryPropertyFlagBits::eHostVisible |
+                                                  vk::MemoryPropertyFlagBits::eHostCoherent),
+        };
+    };
+
+    Page *page = nullptr;
+    if (size > PageSize) {
+        // gets a page of its own, ahead of the one that is being filled
+        stagedPages.insert(stagedPages.begin(), createPage(size));
+        page = &stagedPages.front();
+        offset = 0;
+    } else {
+        if (!stagedPages.empty()) {
+            auto &current = stagedPages.back();
+            offset = (current.used + StagingAlignment - 1) & ~(StagingAlignment - 1);
+            if (offset + size <= current.buffer.size) {
+                page = &current;
+            }
+        }
+        if (!page) {
+            if (freePages.empty()) {
+                stagedPages.push_back(createPage(PageSize));
+            } else {
+                stagedPages.push_back(std::move(freePages.back()));
+                freePages.pop_back();
+            }
+            page = &stagedPages.back();
+            offset = 0;
+        }
+    }
+
+    std::memcpy(static_cast<std::byte *>(page->buffer.allocation.mapped) + offset, data, size);
+    page->used = offset + size;
+    stagedBytes += size;
+    stagedRequests++;
+    return *page;
+}
+
+UploadToken UploadBatcher::upload(const Buffer &destination, vk::DeviceSize offset, const void *data,
+                                  vk::DeviceSize size) {
+    std::lock_guard lock(mutex);
+    // nothing is staged, so the token of the last flush already covers it
+    if (size == 0) {
+        return nextToken - 1;
+    }
+    vk::DeviceSize stagingOffset = 0;
+    auto &page = stage(data, size, stagingOffset);
+    bufferCopies.push_back(BufferCopy{
+            .staging = page.buffer.buffer,
+            .destination = destination.buffer,
+            .region = {
+                    .srcOffset = stagingOffset,
+                    .dstOffset = offset,
+                    .size = size,
+            },
+    });
+    return nextToken;
+}
+
+UploadToken UploadBatcher::upload(vk::Image destination, const vk::ImageSubresourceRange &range,
+                                  std::span<const vk::BufferImageCopy> regions, const void *data, vk::DeviceSize size,
+                                  vk::ImageLayout finalLayout) {
+    std::lock_guard lock(mutex);
+    vk::DeviceSize stagingOffset = 0;
+    auto &page = stage(data, size, stagingOffset);
+
+    ImageCopy copy{
+            .staging = page.buffer.buffer,
+            .destination = destination,
+            .range = range,
+            .finalLayout = finalLayout,
+            .regions = {regions.begin(), regions.end()},
+    };
+    for (auto &region : copy.regions) {
+        region.bufferOffset += stagingOffset;
+    }
+    imageCopies.push_back(std::move(copy));
+    return nextToken;
+}
+
+void UploadBatcher::recordCopies(vk::CommandBuffer cmdBuffer, std::vector<BufferCopy> &buffers,
+                                 const std::vector<ImageCopy> &images, uint64_t &copyCount) const {
+    std::vector<vk::ImageMemoryBarrier> barriers;
+    for (const auto &image : images) {
+        barriers.push_back(vk::ImageMemoryBarrier{
+                .srcAccessMask = {},
+                .dstAccessMask = vk::AccessFlagBits::eTransferWrite,
+                .oldLayout = vk::ImageLayout::eUndefined,
+                .newLayout = vk::ImageLayout::eTransferDstOptimal,
+                .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .image = image.destination,
+                .subresourceRange = image.range,
+        });
+    }
+    if (!barriers.empty()) {
+        cmdBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eTransfer, {},
+                                  0, nullptr, 0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data());
+    }
+
+    // Copies to a destination are recorded in the order they were staged, one command per run from the same page
+    // with the regions that continue each other in both merged. Regions written since the last barrier mustn't be
+    // overlapped, neither within a command nor by a later one, so an overlapping copy waits for them and the last
+    // upload to a range wins.
+    std::stable_sort(buffers.begin(), buffers.end(), [](const BufferCopy &a, const BufferCopy &b) {
+        return a.destination < b.destination;
+    });
+    vk::MemoryBarrier writeBarrier{
+            .srcAccessMask = vk::AccessFlagBits::eTransferWrite,
+            .dstAccessMask = vk::AccessFlagBits::eTransferWrite,
+    };
+    std::vector<vk::BufferCopy> regions;
+    // destination ranges of the current destination copied since the last barrier
+    std::vector<std::pair<vk::DeviceSize, vk::DeviceSize>> written;
+    auto recordRegions = [&](const BufferCopy &copy) {
+        if (!regions.empty()) {
+            cmdBuffer.copyBuffer(copy.staging, copy.destination, regions);
+            copyCount += regions.size();
+            regions.clear();
+        }
+    };
+    for (size_t i = 0; i < buffers.size(); i++) {
+        const auto &copy = buffers[i];
+        auto begin = copy.region.dstOffset;
+        auto end = begin + copy.region.size;
+        bool overlaps = std::any_of(written.begin(), written.end(), [&](const auto &range) {
+            return begin < range.second && range.first < end;
+        });
+        if (overlaps) {
+            recordRegions(buffers[i - 1]);
+            cmdBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eTransfer, {},
+                                      1, &writeBarrier, 0, nullptr, 0, nullptr);
+            written.clear();
+        }
+        written.emplace_back(begin, end);
+
+        if (!regions.empty() && regions.back().srcOffset + regions.back().size == copy.region.srcOffset &&
+            regions.back().dstOffset + regions.back().size == copy.region.dstOffset) {
+            regions.back().size += copy.region.size;
+        } else {
+            regions.push_back(copy.region);
+        }
+
+        bool lastOfDestination = i + 1 == buffers.size() || buffers[i + 1].destination != copy.destination;
+        if (lastOfDestination || buffers[i + 1].staging != copy.staging) {
+            recordRegions(copy);
+        }
+        if (lastOfDestination) {
+            written.clear();
+        }
+    }
+
+    for (const auto &image : images) {
+        cmdBuffer.copyBufferToImage(image.staging, image.destination, vk::ImageLayout::eTransferDstOptimal,
+                                    image.regions);
+        copyCount += image.regions.size();
+    }
+
+    // the buffers may be read by any later work on the queue
+    vk::MemoryBarrier bufferBarrier{
+            .srcAccessMask = vk::AccessFlagBits::eTransferWrite,
+            .dstAccessMask = vk::AccessFlagBits::eMemoryRead,
+    };
+    barriers.clear();
+    for (const auto &image : images) {
+        barriers.push_back(vk::ImageMemoryBarrier{
+                .srcAccessMask = vk::AccessFlagBits::eTransferWrite,
+                .dstAccessMask = vk::AccessFlagBits::eMemoryRead,
+                .oldLayout = vk::ImageLayout::eTransferDstOptimal,
+                .newLayout = image.finalLayout,
+                .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .image = image.destination,
+                .subresourceRange = image.range,
+        });
+    }
+    cmdBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eAllCommands, {},
+                              1, &bufferBarrier, 0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data());
+}
+
+void UploadBatcher::flush() {
+    retireCompleted();
+
+    std::vector<BufferCopy> buffers;
+    std::vector<ImageCopy> images;
+    Submission submission;
+    uint64_t bytes = 0;
+    uint64_t requests = 0;
+    {
+        std::lock_guard lock(mutex);
+        if (bufferCopies.empty() && imageCopies.empty()) {
+            return;
+        }
+        buffers.swap(bufferCopies);
+        images.swap(imageCopies);
+        submission.pages.swap(stagedPages);
+        submission.token = nextToken++;
+        bytes = std::exchange(stagedBytes, 0);
+        requests = std::exchange(stagedRequests, 0);
+    }
+
+    if (freeCommandBuffers.empty()) {
+        submission.cmdBuffer = device.allocateCommandBuffers({
+                .commandPool = commandPool,
+                .level = vk::CommandBufferLevel::ePrimary,
+                .commandBufferCount = 1,
+        }).front();
+    } else {
+        submission.cmdBuffer = freeCommandBuffers.back();
+        freeCommandBuffers.pop_back();
+    }
+
+    submission.cmdBuffer.begin(vk::CommandBufferBeginInfo{
+            .flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit,
+    });
+    uint64_t copyCount = 0;
+    recordCopies(submission.cmdBuffer, buffers, images, copyCount);
+    submission.cmdBuffer.end();
+
+    vk::TimelineSemaphoreSubmitInfo timelineInfo{
+            .signalSemaphoreValueCount = 1,
+            .pSignalSemaphoreValues = &submission.token,
+    };
+    vk::SubmitInfo submitInfo{
+            .pNext = &timelineInfo,
+            .commandBufferCount = 1,
+            .pCommandBuffers = &submission.cmdBuffer,
+            .signalSemaphoreCount = 1,
+            .pSignalSemaphores = &timeline,
+    };
+    if (queue.submit(1, &submitInfo, nullptr) != vk::Result::eSuccess) {
+        throw std::runtime_error("could not submit uploads");
+    }
+
+    {
+        std::lock_guard lock(mutex);
+        totals.bytes += bytes;
+        totals.requests += requests;
+        totals.copies += copyCount;
+        totals.submits++;
+    }
+    submissions.push_back(std::move(submission));
+}
+
+void UploadBatcher::retireCompleted() {
+    auto completedToken = device.getSemaphoreCounterValue(timeline);
+    while (!submissions.empty() && submissions.front().token <= completedToken) {
+        auto &submission = submissions.front();
+        for (auto &page : submission.pages) {
+            bool keep = false;
+            if (page.buffer.size == PageSize) {
+                // stage() takes free pages on the uploading threads
+                std::lock_guard lock(mutex);
+                keep = freePages.size() < MaxFreePages;
+                if (keep) {
+                    page.used = 0;
+                    freePages.push_back(std::move(page));
+                }
+            }
+            if (!keep) {
+                allocator->destroyBuffer(page.buffer);
+            }
+        }
+        submission.cmdBuffer.reset();
+        freeCommandBuffers.push_back(submission.cmdBuffer);
+        submissions.pop_front();
+    }
+}
+
+bool UploadBatcher::completed(UploadToken token) const {
+    return device.getSemaphoreCounterValue(timeline) >= token;
+}
+
+void UploadBatcher::wait(UploadToken token) const {
+    vk::SemaphoreWaitInfo waitInfo{
+            .semaphoreCount = 1,
+            .pSemaphores = &timeline,
+            .pValues = &token,
+    };
+    if (device.waitSemaphores(waitInfo, UINT64_MAX) != vk::Result::eSuccess) {
+        throw std::runtime_error("could not wait for uploads");
+    }
+}
+
+UploadBatcher::Statistics UploadBatcher::statistics() const {
+    std::lock_guard lock(mutex);
+    return totals;
+}
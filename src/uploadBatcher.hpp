@@ -0,0 +1,112 @@
+#pragma once
+
+#include "memory.hpp"
+
+#define VULKAN_HPP_NO_CONSTRUCTORS
+#include <vulkan/vulkan.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <span>
+#include <vector>
+
+// value of the batcher's timeline semaphore once an upload has executed
+using UploadToken = uint64_t;
+
+// Gathers uploads into buffers and freshly created images and submits them together. The data is copied into large
+// host visible staging pages right away, flush() records every copy staged since the last one into a single command
+// buffer, merging buffer regions that are contiguous in both the page and the destination, and submits it once.
+// Uploads to overlapping ranges of a buffer are applied in the order they were staged.
+// Each submit signals a timeline semaphore with its token, and its pages return to the pool once the semaphore passes
+// it. Uploads may be staged from any thread. Work submitted to the same queue after a flush sees the uploaded data.
+class UploadBatcher {
+public:
+    static constexpr vk::DeviceSize PageSize = 8ull * 1024 * 1024;
+    // staging offsets suit every texel block size and buffer copy
+    static constexpr vk::DeviceSize StagingAlignment = 16;
+    // empty pages kept for later uploads, the rest are freed
+    static constexpr size_t MaxFreePages = 4;
+
+    struct Statistics {
+        uint64_t bytes = 0;
+        uint64_t requests = 0;
+        uint64_t copies = 0; // copy regions recorded after merging
+        uint64_t submits = 0;
+    };
+
+    void create(vk::Device device, MemoryAllocator &allocator, vk::Queue queue, uint32_t queueFamily);
+    // Waits for the submitted uploads, uploads that were never flushed are dropped.
+    void destroy();
+
+    // Stages size bytes to be copied to offset in destination. An empty upload returns a token that was submitted.
+    UploadToken upload(const Buffer &destination, vk::DeviceSize offset, const void *data, vk::DeviceSize size);
+    // Stages the levels of an image that hasn't been used yet, the regions' buffer offsets are relative to data.
+    // range goes from undefined to the transfer destination layout and ends up in finalLayout.
+    UploadToken upload(vk::Image destination, const vk::ImageSubresourceRange &range,
+                       std::span<const vk::BufferImageCopy> regions, const void *data, vk::DeviceSize size,
+                       vk::ImageLayout finalLayout = vk::ImageLayout::eShaderReadOnlyOptimal);
+
+    // Submits everything staged since the last flush. Has to be called on the thread that submits to the queue,
+    // before the work that uses the uploads.
+    void flush();
+
+    [[nodiscard]] bool completed(UploadToken token) const;
+    void wait(UploadToken token) const;
+
+    // totals since create()
+    [[nodiscard]] Statistics statistics() const;
+
+private:
+    struct Page {
+        Buffer buffer;
+        vk::DeviceSize used = 0;
+    };
+
+    struct BufferCopy {
+        vk::Buffer staging;
+        vk::Buffer destination;
+        vk::BufferCopy region;
+    };
+
+    struct ImageCopy {
+        vk::Buffer staging;
+        vk::Image destination;
+        vk::ImageSubresourceRange range;
+        vk::ImageLayout finalLayout;
+        std::vector<vk::BufferImageCopy> regions;
+    };
+
+    struct Submission {
+        UploadToken token;
+        vk::CommandBuffer cmdBuffer;
+        std::vector<Page> pages;
+    };
+
+    // returns the page holding the data, must be called with the mutex held
+    Page &stage(const void *data, vk::DeviceSize size, vk::DeviceSize &offset);
+    void retireCompleted();
+    void recordCopies(vk::CommandBuffer cmdBuffer, std::vector<BufferCopy> &bufferCopies,
+                      const std::vector<ImageCopy> &imageCopies, uint64_t &copyCount) const;
+
+    vk::Device device;
+    MemoryAllocator *allocator = nullptr;
+    vk::Queue queue;
+    vk::CommandPool commandPool;
+    vk::Semaphore timeline;
+
+    mutable std::mutex mutex;
+    UploadToken nextToken = 1;
+    std::vector<Page> stagedPages; // the last one takes the next upload
+    std::vector<BufferCopy> bufferCopies;
+    std::vector<ImageCopy> imageCopies;
+    uint64_t stagedBytes = 0;
+    uint64_t stagedRequests = 0;
+    Statistics totals;
+    std::vector<Page> freePages;
+
+    // only touched by flush() and destroy()
+    std::vector<vk::CommandBuffer> freeCommandBuffers;
+    std::deque<Submission> submissions;
+};
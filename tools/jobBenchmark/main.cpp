@@ -0,0 +1,162 @@
+#include "jobSystem.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+
+// Microbenchmarks for src/jobSystem.hpp: what spawning and finishing a job costs, and how a parallelFor over a
+// compute bound loop scales with the number of threads.
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// every measurement is repeated and the fastest run is reported, the others are disturbed by the rest of the system
+constexpr int Repetitions = 5;
+
+template<typename F>
+double fastestMilliseconds(F &&function) {
+    double fastest = std::numeric_limits<double>::max();
+    for (int i = 0; i < Repetitions; i++) {
+        auto start = Clock::now();
+        function();
+        fastest = std::min(fastest, std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+    }
+    return fastest;
+}
+
+// Empty jobs spawned by a thread that isn't a worker, they all go through the shared queue.
+double externalSpawnNanoseconds(JobSystem &jobs, uint32_t jobCount) {
+    auto milliseconds = fastestMilliseconds([&] {
+        JobCounter counter;
+        for (uint32_t i = 0; i < jobCount; i++) {
+            jobs.run([] {}, &counter);
+        }
+        jobs.wait(counter);
+    });
+    return milliseconds * 1e6 / jobCount;
+}
+
+// Empty jobs spawned by a worker into its own deque, the others steal them.
+double workerSpawnNanoseconds(JobSystem &jobs, uint32_t jobCount) {
+    auto milliseconds = fastestMilliseconds([&] {
+        JobCounter spawner;
+        jobs.run([&] {
+            JobCounter counter;
+            for (uint32_t i = 0; i < jobCount; i++) {
+                jobs.run([] {}, &counter);
+            }
+            jobs.wait(counter);
+        }, &spawner);
+        jobs.wait(spawner);
+    });
+    return milliseconds * 1e6 / jobCount;
+}
+
+// A parallelFor whose ranges are only a few instructions, so nearly all of the time is splitting and stealing.
+double parallelForNanoseconds(JobSystem &jobs, uint32_t count) {
+    std::vector<uint32_t> values(count);
+    auto milliseconds = fastestMilliseconds([&] {
+        jobs.parallelFor(count, 1, [&](uint32_t begin, uint32_t end) {
+            for (auto i = begin; i < end; i++) {
+                values[i] = i;
+            }
+        });
+    });
+    return milliseconds * 1e6 / count;
+}
+
+// A chain of jobs that each depend on the previous one's counter.
+double dependencyNanoseconds(JobSystem &jobs, uint32_t chainLength) {
+    auto milliseconds = fastestMilliseconds([&] {
+        std::vector<JobCounter> counters(chainLength);
+        for (uint32_t i = 0; i < chainLength; i++) {
+            jobs.run([] {}, &counters[i], i > 0 ? &counters[i - 1] : nullptr);
+        }
+        jobs.wait(counters.back());
+        for (auto &counter : counters) {
+            jobs.wait(counter);
+        }
+    });
+    return milliseconds * 1e6 / chainLength;
+}
+
+double computeMilliseconds(JobSystem &jobs, std::vector<float> &values, uint32_t minRange) {
+    return fastestMilliseconds([&] {
+        jobs.parallelFor(static_cast<uint32_t>(values.size()), minRange, [&](uint32_t begin, uint32_t end) {
+            for (auto i = begin; i < end; i++) {
+                auto x = static_cast<float>(i);
+                for (int step = 0; step < 32; step++) {
+                    x = std::sqrt(x * 1.0001f + 1.0f);
+                }
+                values[i] = x;
+            }
+        });
+    });
+}
+
+}
+
+int main(int argc, char **argv) {
+    uint32_t jobCount = 1'000'000;
+    uint32_t elementCount = 1 << 22;
+    uint32_t minRange = 256;
+    for (int i = 1; i < argc; i++) {
+        std::string argument = argv[i];
+        if (argument.starts_with("--jobs=")) {
+            jobCount = std::max<uint32_t>(std::stoul(argument.substr(strlen("--jobs="))), 1);
+        } else if (argument.starts_with("--elements=")) {
+            elementCount = std::max<uint32_t>(std::stoul(argument.substr(strlen("--elements="))), 1);
+        } else if (argument.starts_with("--min-range=")) {
+            minRange = std::max<uint32_t>(std::stoul(argument.substr(strlen("--min-range="))), 1);
+        } else {
+            std::cerr << "usage: " << argv[0] << " [--jobs=<n>] [--elements=<n>] [--min-range=<n>]\n";
+            return 1;
+        }
+    }
+
+    auto threadCount = JobSystem::defaultWorkerCount() + 1;
+
+    {
+        JobSystem jobs;
+        jobs.create(JobSystem::defaultWorkerCount());
+        std::cout << "overhead with " << threadCount << " threads, per job:\n"
+                  << "  spawned by another thread: " << externalSpawnNanoseconds(jobs, jobCount) << " ns\n"
+                  << "  spawned by a worker: " << workerSpawnNanoseconds(jobs, jobCount) << " ns\n"
+                  << "  parallelFor element: " << parallelForNanoseconds(jobs, jobCount) << " ns\n"
+                  << "  dependency chain link: " << dependencyNanoseconds(jobs, std::min(jobCount, 100'000u))
+                  << " ns\n";
+        jobs.destroy();
+    }
+
+    // the calling thread takes part in the parallelFor, so n threads need n - 1 workers
+    std::cout << "parallelFor over " << elementCount << " elements, at least " << minRange << " per range:\n";
+    std::vector<float> values(elementCount);
+    double singleThreaded = 0.0;
+    std::vector<uint32_t> threadCounts;
+    for (uint32_t threads = 1; threads < threadCount; threads *= 2) {
+        threadCounts.push_back(threads);
+    }
+    threadCounts.push_back(threadCount);
+
+    for (auto threads : threadCounts) {
+        JobSystem jobs;
+        jobs.create(threads - 1);
+        auto milliseconds = computeMilliseconds(jobs, values, minRange);
+        jobs.destroy();
+
+        if (threads == 1) {
+            singleThreaded = milliseconds;
+        }
+        std::cout << "  " << threads << " threads: " << milliseconds << " ms, speedup " << singleThreaded / milliseconds
+                  << ", efficiency " << singleThreaded / milliseconds / threads * 100.0 << "%\n";
+    }
+
+    return 0;
+}
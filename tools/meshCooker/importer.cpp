@@ -0,0 +1,616 @@
+#include "importer.hpp"
+#include "json.hpp"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace {
+
+std::string readFile(const std::filesystem::path &path) {
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file) {
+        throw std::runtime_error("could not open " + path.string());
+    }
+
+    std::string data(static_cast<size_t>(file.tellg()), '\0');
+    file.seekg(0);
+    file.read(data.data(), static_cast<std::streamsize>(data.size()));
+    if (!file) {
+        throw std::runtime_error("could not read " + path.string());
+    }
+
+    return data;
+}
+
+// area weighted face normals for the vertices the source has no normal for
+void generateNormals(ImportedMesh &mesh) {
+    std::vector<glm::vec3> normals(mesh.vertices.size(), glm::vec3(0.0f));
+
+    for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+        auto a = glm::make_vec3(mesh.vertices[mesh.indices[i]].position);
+        auto b = glm::make_vec3(mesh.vertices[mesh.indices[i + 1]].position);
+        auto c = glm::make_vec3(mesh.vertices[mesh.indices[i + 2]].position);
+        auto normal = glm::cross(b - a, c - a);
+
+        for (size_t corner = 0; corner < 3; corner++) {
+            normals[mesh.indices[i + corner]] += normal;
+        }
+    }
+
+    for (size_t i = 0; i < mesh.vertices.size(); i++) {
+        if (glm::length(glm::make_vec3(mesh.vertices[i].normal)) > 0.0f) {
+            continue;
+        }
+
+        auto length = glm::length(normals[i]);
+        auto normal = length > 0.0f ? normals[i] / length : glm::vec3(0.0f, 0.0f, 1.0f);
+        std::memcpy(mesh.vertices[i].normal, glm::value_ptr(normal), sizeof(mesh.vertices[i].normal));
+    }
+}
+
+// --- OBJ ---
+
+std::string_view nextToken(std::string_view &line) {
+    auto start = line.find_first_not_of(" \t");
+    if (start == std::string_view::npos) {
+        line = {};
+        return {};
+    }
+    line.remove_prefix(start);
+
+    auto end = line.find_first_of(" \t");
+    auto token = line.substr(0, end);
+    line.remove_prefix(end == std::string_view::npos ? line.size() : end);
+    return token;
+}
+
+float parseFloat(std::string_view token) {
+    float value = 0.0f;
+    std::from_chars(token.data(), token.data() + token.size(), value);
+    return value;
+}
+
+// OBJ indices are 1 based, negative ones count back from the last element, 0 means absent
+int64_t resolveObjIndex(std::string_view token, size_t count) {
+    if (token.empty()) {
+        return -1;
+    }
+
+    int64_t index = 0;
+    std::from_chars(token.data(), token.data() + token.size(), index);
+    if (index < 0) {
+        index += static_cast<int64_t>(count);
+    } else {
+        index -= 1;
+    }
+
+    if (index < 0 || index >= static_cast<int64_t>(count)) {
+        throw std::runtime_error("obj face references a missing element");
+    }
+    return index;
+}
+
+struct ObjCorner {
+    int64_t position;
+    int64_t uv;
+    int64_t normal;
+
+    bool operator==(const ObjCorner &) const = default;
+};
+
+struct ObjCornerHash {
+    size_t operator()(const ObjCorner &corner) const {
+        auto hash = std::hash<int64_t>{}(corner.position);
+        hash ^= std::hash<int64_t>{}(corner.uv) + 0x9e3779b97f4a7c15ull + (hash << 6) + (hash >> 2);
+        hash ^= std::hash<int64_t>{}(corner.normal) + 0x9e3779b97f4a7c15ull + (hash << 6) + (hash >> 2);
+        return hash;
+    }
+};
+
+}
+
+ImportedMesh importObj(const std::filesystem::path &path) {
+    auto text = readFile(path);
+
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec2> uvs;
+    std::vector<glm::vec3> normals;
+
+    ImportedMesh mesh;
+    std::unordered_map<ObjCorner, uint32_t, ObjCornerHash> cornerIndices;
+    std::vector<uint32_t> polygon;
+    bool missingNormals = false;
+
+    std::string_view remaining = text;
+    while (!remaining.empty()) {
+        auto lineEnd = remaining.find('\n');
+        auto line = remaining.substr(0, lineEnd);
+        remaining.remove_prefix(lineEnd == std::string_view::npos ? remaining.size() : lineEnd + 1);
+
+        if (!line.empty() && line.back() == '\r') {
+            line.remove_suffix(1);
+        }
+
+        auto keyword = nextToken(line);
+        if (keyword == "v") {
+            auto x = parseFloat(nextToken(line));
+            auto y = parseFloat(nextToken(line));
+            auto z = parseFloat(nextToken(line));
+            positions.emplace_back(x, y, z);
+        } else if (keyword == "vt") {
+            auto u = parseFloat(nextToken(line));
+            auto v = parseFloat(nextToken(line));
+            uvs.emplace_back(u, 1.0f - v);
+        } else if (keyword == "vn") {
+            auto x = parseFloat(nextToken(line));
+            auto y = parseFloat(nextToken(line));
+            auto z = parseFloat(nextToken(line));
+            normals.emplace_back(x, y, z);
+        } else if (keyword == "f") {
+            polygon.clear();
+
+            for (auto token = nextToken(line); !token.empty(); token = nextToken(line)) {
+                auto firstSlash = token.find('/');
+                auto secondSlash = firstSlash == std::string_view::npos ? std::string_view::npos : token.find('/', firstSlash + 1);
+
+                ObjCorner corner{
+                        .position = resolveObjIndex(token.substr(0, firstSlash), positions.size()),
+                        .uv = firstSlash == std::string_view::npos ? -1 :
+                              resolveObjIndex(token.substr(firstSlash + 1, secondSlash - firstSlash - 1), uvs.size()),
+                        .normal = secondSlash == std::string_view::npos ? -1 :
+                                  resolveObjIndex(token.substr(secondSlash + 1), normals.size()),
+                };
+                missingNormals |= corner.normal < 0;
+
+                auto [it, inserted] = cornerIndices.try_emplace(corner, static_cast<uint32_t>(mesh.vertices.size()));
+                if (inserted) {
+                    MeshVertex vertex{};
+                    std::memcpy(vertex.position, glm::value_ptr(positions[corner.position]), sizeof(vertex.position));
+                    if (corner.normal >= 0) {
+                        std::memcpy(vertex.normal, glm::value_ptr(normals[corner.normal]), sizeof(vertex.normal));
+                    }
+                    if (corner.uv >= 0) {
+                        std::memcpy(vertex.uv, glm::value_ptr(uvs[corner.uv]), sizeof(vertex.uv));
+                    }
+                    mesh.vertices.push_back(vertex);
+                }
+                polygon.push_back(it->second);
+            }
+
+            // polygons are triangulated as fans
+            for (size_t i = 2; i < polygon.size(); i++) {
+                mesh.indices.insert(mesh.indices.end(), {polygon[0], polygon[i - 1], polygon[i]});
+            }
+        }
+    }
+
+    if (missingNormals) {
+        generateNormals(mesh);
+    }
+
+    return mesh;
+}
+
+// --- glTF ---
+
+namespace {
+
+constexpr uint32_t GlbMagic = 0x46546c67;     // "glTF"
+constexpr uint32_t GlbJsonChunk = 0x4e4f534a; // "JSON"
+constexpr uint32_t GlbBinaryChunk = 0x004e4942; // "BIN\0"
+
+constexpr int ComponentByte = 5120;
+constexpr int ComponentUnsignedByte = 5121;
+constexpr int ComponentShort = 5122;
+constexpr int ComponentUnsignedShort = 5123;
+constexpr int ComponentUnsignedInt = 5125;
+constexpr int ComponentFloat = 5126;
+
+constexpr int ModeTriangles = 4;
+
+std::string decodeBase64(std::string_view text) {
+    auto decodeChar = [](char c) -> int {
+        if (c >= 'A' && c <= 'Z') return c - 'A';
+        if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+        if (c >= '0' && c <= '9') return c - '0' + 52;
+        if (c == '+') return 62;
+        if (c == '/') return 63;
+        return -1;
+    };
+
+    std::string result;
+    result.reserve(text.size() * 3 / 4);
+
+    uint32_t bits = 0;
+    int bitCount = 0;
+    for (char c : text) {
+        auto value = decodeChar(c);
+        if (value < 0) {
+            continue;
+        }
+        bits = (bits << 6) | static_cast<uint32_t>(value);
+        bitCount += 6;
+        if (bitCount >= 8) {
+            bitCount -= 8;
+            result += static_cast<char>((bits >> bitCount) & 0xff);
+        }
+    }
+
+    return result;
+}
+
+class GltfDocument {
+public:
+    explicit GltfDocument(const std::filesystem::path &path) {
+        auto data = readFile(path);
+        std::string_view json = data;
+        std::string_view binaryChunk;
+
+        uint32_t magic = 0;
+        if (data.size() >= 12) {
+            std::memcpy(&magic, data.data(), sizeof(magic));
+        }
+
+        if (magic == GlbMagic) {
+            size_t offset = 12;
+            json = {};
+            while (offset + 8 <= data.size()) {
+                uint32_t chunkLength = 0;
+                uint32_t chunkType = 0;
+                std::memcpy(&chunkLength, data.data() + offset, sizeof(chunkLength));
+                std::memcpy(&chunkType, data.data() + offset + 4, sizeof(chunkType));
+                offset += 8;
+                if (chunkLength > data.size() - offset) {
+                    throw std::runtime_error("truncated glb chunk in " + path.string());
+                }
+
+                if (chunkType == GlbJsonChunk) {
+                    json = std::string_view(data).substr(offset, chunkLength);
+                } else if (chunkType == GlbBinaryChunk) {
+                    binaryChunk = std::string_view(data).substr(offset, chunkLength);
+                }
+                offset += (chunkLength + 3) & ~3u;
+            }
+        }
+
+        document = JsonValue::parse(json);
+
+        for (const auto &buffer : document["buffers"].isArray() ? document["buffers"].array() : JsonValue::Array{}) {
+            if (!buffer.contains("uri")) {
+                buffers.emplace_back(binaryChunk);
+                continue;
+            }
+
+            const auto &uri = buffer["uri"].string();
+            if (uri.starts_with("data:")) {
+                auto comma = uri.find(',');
+                if (comma == std::string::npos || uri.substr(0, comma).find(";base64") == std::string::npos) {
+                    throw std::runtime_error("unsupported buffer uri in " + path.string());
+                }
+                buffers.push_back(decodeBase64(std::string_view(uri).substr(comma + 1)));
+            } else {
+                buffers.push_back(readFile(path.parent_path() / uri));
+            }
+        }
+    }
+
+    [[nodiscard]] const JsonValue &json() const { return document; }
+
+    // reads a float accessor with components per element, converting normalized integers
+    std::vector<float> readFloats(size_t accessorIndex, int components) const {
+        const auto &accessor = document["accessors"][accessorIndex];
+        auto count = static_cast<size_t>(accessor["count"].number());
+        auto componentType = static_cast<int>(accessor["componentType"].number());
+        bool normalized = accessor["normalized"].isBool() && accessor["normalized"].boolean();
+
+        std::vector<float> result(count * components);
+        forEachComponent(accessor, components, [&](size_t element, int component, const char *source) {
+            float value = 0.0f;
+            switch (componentType) {
+                case ComponentFloat:
+                    std::memcpy(&value, source, sizeof(float));
+                    break;
+                case ComponentUnsignedByte:
+                    value = static_cast<float>(static_cast<uint8_t>(*source)) / (normalized ? 255.0f : 1.0f);
+                    break;
+                case ComponentByte:
+                    value = std::max(static_cast<float>(static_cast<int8_t>(*source)) / (normalized ? 127.0f : 1.0f), -1.0f);
+                    break;
+                case ComponentUnsignedShort: {
+                    uint16_t raw;
+                    std::memcpy(&raw, source, sizeof(raw));
+                    value = static_cast<float>(raw) / (normalized ? 65535.0f : 1.0f);
+                    break;
+                }
+                case ComponentShort: {
+                    int16_t raw;
+                    std::memcpy(&raw, source, sizeof(raw));
+                    value = std::max(static_cast<float>(raw) / (normalized ? 32767.0f : 1.0f), -1.0f);
+                    break;
+                }
+                default:
+                    throw std::runtime_error("unsupported accessor component type");
+            }
+            result[element * components + component] = value;
+        });
+
+        return result;
+    }
+
+    std::vector<uint32_t> readIndices(size_t accessorIndex) const {
+        const auto &accessor = document["accessors"][accessorIndex];
+        auto count = static_cast<size_t>(accessor["count"].number());
+        auto componentType = static_cast<int>(accessor["componentType"].number());
+
+        std::vector<uint32_t> result(count);
+        forEachComponent(accessor, 1, [&](size_t element, int, const char *source) {
+            switch (componentType) {
+                case ComponentUnsignedByte:
+                    result[element] = static_cast<uint8_t>(*source);
+                    break;
+                case ComponentUnsignedShort: {
+                    uint16_t raw;
+                    std::memcpy(&raw, source, sizeof(raw));
+                    result[element] = raw;
+                    break;
+                }
+                case ComponentUnsignedInt:
+                    std::memcpy(&result[element], source, sizeof(uint32_t));
+                    break;
+                default:
+                    throw std::runtime_error("unsupported index component type");
+            }
+        });
+
+        return result;
+    }
+
+private:
+    static size_t componentSize(int componentType) {
+        switch (componentType) {
+            case ComponentByte:
+            case ComponentUnsignedByte:
+                return 1;
+            case ComponentShort:
+            case ComponentUnsignedShort:
+                return 2;
+            default:
+                return 4;
+        }
+    }
+
+    template<typename Visit>
+    void forEachComponent(const JsonValue &accessor, int components, Visit &&visit) const {
+        if (accessor.contains("sparse")) {
+            throw std::runtime_error("sparse accessors are not supported");
+        }
+
+        auto count = static_cast<size_t>(accessor["count"].number());
+        auto size = componentSize(static_cast<int>(accessor["componentType"].number()));
+
+        // accessors without a buffer view are all zeros
+        if (!accessor.contains("bufferView")) {
+            static const char zeros[4] = {};
+            for (size_t element = 0; element < count; element++) {
+                for (int component = 0; component < components; component++) {
+                    visit(element, component, zeros);
+                }
+            }
+            return;
+        }
+
+        const auto &view = document["bufferViews"][static_cast<size_t>(accessor["bufferView"].number())];
+        const auto &buffer = buffers.at(static_cast<size_t>(view["buffer"].number()));
+        auto offset = static_cast<size_t>(view.numberOr("byteOffset", 0) + accessor.numberOr("byteOffset", 0));
+        auto stride = static_cast<size_t>(view.numberOr("byteStride", 0));
+        if (stride == 0) {
+            stride = size * components;
+        }
+
+        if (count > 0 && offset + (count - 1) * stride + size * components > buffer.size()) {
+            throw std::runtime_error("accessor reads past the end of its buffer");
+        }
+
+        for (size_t element = 0; element < count; element++) {
+            for (int component = 0; component < components; component++) {
+                visit(element, component, buffer.data() + offset + element * stride + component * size);
+            }
+        }
+    }
+
+    JsonValue document;
+    std::vector<std::string> buffers;
+};
+
+glm::mat4 nodeTransform(const JsonValue &node) {
+    if (node.contains("matrix")) {
+        glm::mat4 matrix;
+        for (int i = 0; i < 16; i++) {
+            glm::value_ptr(matrix)[i] = static_cast<float>(node["matrix"][i].number());
+        }
+        return matrix;
+    }
+
+    glm::vec3 translation(0.0f);
+    glm::quat rotation(1.0f, 0.0f, 0.0f, 0.0f);
+    glm::vec3 scale(1.0f);
+    if (node.contains("translation")) {
+        for (int i = 0; i < 3; i++) {
+            translation[i] = static_cast<float>(node["translation"][i].number());
+        }
+    }
+    if (node.contains("rotation")) {
+        const auto &r = node["rotation"];
+        rotation = glm::quat(static_cast<float>(r[3].number()), static_cast<float>(r[0].number()),
+                             static_cast<float>(r[1].number()), static_cast<float>(r[2].number()));
+    }
+    if (node.contains("scale")) {
+        for (int i = 0; i < 3; i++) {
+            scale[i] = static_cast<float>(node["scale"][i].number());
+        }
+    }
+
+    auto matrix = glm::mat4_cast(rotation);
+    matrix[0] *= scale.x;
+    matrix[1] *= scale.y;
+    matrix[2] *= scale.z;
+    matrix[3] = glm::vec4(translation, 1.0f);
+    return matrix;
+}
+
+void appendPrimitive(const GltfDocument &gltf, const JsonValue &primitive, const glm::mat4 &transform,
+                     ImportedMesh &mesh, bool &missingNormals) {
+    if (primitive.numberOr("mode", ModeTriangles) != ModeTriangles) {
+        std::cerr << "skipping a primitive that is not a triangle list\n";
+        return;
+    }
+
+    const auto &attributes = primitive["attributes"];
+    if (!attributes.contains("POSITION")) {
+        return;
+    }
+
+    auto positions = gltf.readFloats(static_cast<size_t>(attributes["POSITION"].number()), 3);
+    auto vertexCount = positions.size() / 3;
+
+    std::vector<float> normals;
+    if (attributes.contains("NORMAL")) {
+        normals = gltf.readFloats(static_cast<size_t>(attributes["NORMAL"].number()), 3);
+    } else {
+        missingNormals = true;
+    }
+
+    std::vector<float> uvs;
+    if (attributes.contains("TEXCOORD_0")) {
+        uvs = gltf.readFloats(static_cast<size_t>(attributes["TEXCOORD_0"].number()), 2);
+    }
+
+    auto normalTransform = glm::transpose(glm::inverse(glm::mat3(transform)));
+    auto baseVertex = static_cast<uint32_t>(mesh.vertices.size());
+
+    for (size_t i = 0; i < vertexCount; i++) {
+        MeshVertex vertex{};
+
+        auto position = glm::vec3(transform * glm::vec4(glm::make_vec3(&positions[i * 3]), 1.0f));
+        std::memcpy(vertex.position, glm::value_ptr(position), sizeof(vertex.position));
+
+        if (!normals.empty()) {
+            auto normal = normalTransform * glm::make_vec3(&normals[i * 3]);
+            auto length = glm::length(normal);
+            normal = length > 0.0f ? normal / length : glm::vec3(0.0f, 0.0f, 1.0f);
+            std::memcpy(vertex.normal, glm::value_ptr(normal), sizeof(vertex.normal));
+        }
+        if (!uvs.empty()) {
+            vertex.uv[0] = uvs[i * 2];
+            vertex.uv[1] = uvs[i * 2 + 1];
+        }
+
+        mesh.vertices.push_back(vertex);
+    }
+
+    std::vector<uint32_t> indices;
+    if (primitive.contains("indices")) {
+        indices = gltf.readIndices(static_cast<size_t>(primitive["indices"].number()));
+    } else {
+        indices.resize(vertexCount);
+        for (uint32_t i = 0; i < vertexCount; i++) {
+            indices[i] = i;
+        }
+    }
+
+    // a mirroring transform flips the winding
+    bool flip = glm::determinant(glm::mat3(transform)) < 0.0f;
+    for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+        for (auto corner : {indices[i], indices[i + 1], indices[i + 2]}) {
+            if (corner >= vertexCount) {
+                throw std::runtime_error("gltf primitive references a missing vertex");
+            }
+        }
+
+        mesh.indices.push_back(baseVertex + indices[i]);
+        mesh.indices.push_back(baseVertex + indices[flip ? i + 2 : i + 1]);
+        mesh.indices.push_back(baseVertex + indices[flip ? i + 1 : i + 2]);
+    }
+}
+
+void appendNode(const GltfDocument &gltf, size_t nodeIndex, const glm::mat4 &parentTransform,
+                ImportedMesh &mesh, bool &missingNormals, int depth) {
+    if (depth > 64) {
+        throw std::runtime_error("gltf node hierarchy is too deep or cyclic");
+    }
+
+    const auto &node = gltf.json()["nodes"][nodeIndex];
+    auto transform = parentTransform * nodeTransform(node);
+
+    if (node.contains("mesh")) {
+        const auto &gltfMesh = gltf.json()["meshes"][static_cast<size_t>(node["mesh"].number())];
+        for (const auto &primitive : gltfMesh["primitives"].array()) {
+            appendPrimitive(gltf, primitive, transform, mesh, missingNormals);
+        }
+    }
+
+    if (node.contains("children")) {
+        for (const auto &child : node["children"].array()) {
+            appendNode(gltf, static_cast<size_t>(child.number()), transform, mesh, missingNormals, depth + 1);
+        }
+    }
+}
+
+}
+
+ImportedMesh importGltf(const std::filesystem::path &path) {
+    GltfDocument gltf(path);
+    const auto &json = gltf.json();
+
+    ImportedMesh mesh;
+    bool missingNormals = false;
+
+    if (json["scenes"].isArray() && json["scenes"].size() > 0) {
+        auto sceneIndex = static_cast<size_t>(json.numberOr("scene", 0));
+        const auto &scene = json["scenes"][sceneIndex];
+        if (scene.contains("nodes")) {
+            for (const auto &node : scene["nodes"].array()) {
+                appendNode(gltf, static_cast<size_t>(node.number()), glm::mat4(1.0f), mesh, missingNormals, 0);
+            }
+        }
+    } else if (json["meshes"].isArray()) {
+        // documents without a scene are libraries, every mesh is taken untransformed
+        for (const auto &gltfMesh : json["meshes"].array()) {
+            for (const auto &primitive : gltfMesh["primitives"].array()) {
+                appendPrimitive(gltf, primitive, glm::mat4(1.0f), mesh, missingNormals);
+            }
+        }
+    }
+
+    if (missingNormals) {
+        generateNormals(mesh);
+    }
+
+    return mesh;
+}
+
+ImportedMesh importMesh(const std::filesystem::path &path) {
+    auto extension = path.extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+
+    if (extension == ".obj") {
+        return importObj(path);
+    }
+    if (extension == ".gltf" || extension == ".glb") {
+        return importGltf(path);
+    }
+
+    throw std::runtime_error("unsupported mesh format " + extension);
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include "meshFormat.hpp"
+
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+// Indexed triangle list in the cooked vertex layout. glTF node transforms are already applied, normals are
+// generated when the source has none and texture coordinates have their origin in the top left corner.
+struct ImportedMesh {
+    std::vector<MeshVertex> vertices;
+    std::vector<uint32_t> indices;
+};
+
+// picks the importer from the file extension: .obj, .gltf or .glb
+ImportedMesh importMesh(const std::filesystem::path &path);
+
+ImportedMesh importObj(const std::filesystem::path &path);
+ImportedMesh importGltf(const std::filesystem::path &path);
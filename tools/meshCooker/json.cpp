@@ -0,0 +1,290 @@
+#include "json.hpp"
+
+#include <charconv>
+#include <cstdint>
+#include <stdexcept>
+
+class JsonParser {
+public:
+    explicit JsonParser(std::string_view text) : text(text) {}
+
+    JsonValue parseDocument() {
+        auto value = parseValue();
+        skipWhitespace();
+        if (position != text.size()) {
+            fail("trailing characters");
+        }
+        return value;
+    }
+
+private:
+    [[noreturn]] void fail(const char *message) const {
+        throw std::runtime_error("invalid json at offset " + std::to_string(position) + ": " + message);
+    }
+
+    void skipWhitespace() {
+        while (position < text.size() && (text[position] == ' ' || text[position] == '\t' ||
+                                          text[position] == '\n' || text[position] == '\r')) {
+            position++;
+        }
+    }
+
+    char peek() {
+        skipWhitespace();
+        if (position >= text.size()) {
+            fail("unexpected end");
+        }
+        return text[position];
+    }
+
+    void expect(char c) {
+        if (peek() != c) {
+            fail("unexpected character");
+        }
+        position++;
+    }
+
+    bool consume(std::string_view literal) {
+        if (text.substr(position, literal.size()) == literal) {
+            position += literal.size();
+            return true;
+        }
+        return false;
+    }
+
+    JsonValue parseValue() {
+        JsonValue result;
+        char c = peek();
+
+        if (c == '{') {
+            result.value = parseObject();
+        } else if (c == '[') {
+            result.value = parseArray();
+        } else if (c == '"') {
+            result.value = parseString();
+        } else if (consume("true")) {
+            result.value = true;
+        } else if (consume("false")) {
+            result.value = false;
+        } else if (consume("null")) {
+            result.value = nullptr;
+        } else {
+            result.value = parseNumber();
+        }
+
+        return result;
+    }
+
+    JsonValue::Object parseObject() {
+        JsonValue::Object object;
+        expect('{');
+        if (peek() == '}') {
+            position++;
+            return object;
+        }
+
+        while (true) {
+            if (peek() != '"') {
+                fail("expected member name");
+            }
+            auto key = parseString();
+            expect(':');
+            object.insert_or_assign(std::move(key), parseValue());
+
+            if (peek() == ',') {
+                position++;
+                continue;
+            }
+            expect('}');
+            return object;
+        }
+    }
+
+    JsonValue::Array parseArray() {
+        JsonValue::Array array;
+        expect('[');
+        if (peek() == ']') {
+            position++;
+            return array;
+        }
+
+        while (true) {
+            array.push_back(parseValue());
+
+            if (peek() == ',') {
+                position++;
+                continue;
+            }
+            expect(']');
+            return array;
+        }
+    }
+
+    static void appendUtf8(std::string &out, uint32_t codePoint) {
+        if (codePoint < 0x80) {
+            out += static_cast<char>(codePoint);
+        } else if (codePoint < 0x800) {
+            out += static_cast<char>(0xc0 | (codePoint >> 6));
+            out += static_cast<char>(0x80 | (codePoint & 0x3f));
+        } else if (codePoint < 0x10000) {
+            out += static_cast<char>(0xe0 | (codePoint >> 12));
+            out += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3f));
+            out += static_cast<char>(0x80 | (codePoint & 0x3f));
+        } else {
+            out += static_cast<char>(0xf0 | (codePoint >> 18));
+            out += static_cast<char>(0x80 | ((codePoint >> 12) & 0x3f));
+            out += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3f));
+            out += static_cast<char>(0x80 | (codePoint & 0x3f));
+        }
+    }
+
+    uint32_t parseHex4() {
+        if (position + 4 > text.size()) {
+            fail("truncated escape");
+        }
+        uint32_t result = 0;
+        auto [end, error] = std::from_chars(text.data() + position, text.data() + position + 4, result, 16);
+        if (error != std::errc() || end != text.data() + position + 4) {
+            fail("invalid escape");
+        }
+        position += 4;
+        return result;
+    }
+
+    std::string parseString() {
+        expect('"');
+        std::string result;
+
+        while (true) {
+            if (position >= text.size()) {
+                fail("unterminated string");
+            }
+
+            char c = text[position++];
+            if (c == '"') {
+                return result;
+            }
+            if (c != '\\') {
+                result += c;
+                continue;
+            }
+
+            if (position >= text.size()) {
+                fail("unterminated string");
+            }
+            switch (text[position++]) {
+                case '"': result += '"'; break;
+                case '\\': result += '\\'; break;
+                case '/': result += '/'; break;
+                case 'b': result += '\b'; break;
+                case 'f': result += '\f'; break;
+                case 'n': result += '\n'; break;
+                case 'r': result += '\r'; break;
+                case 't': result += '\t'; break;
+                case 'u': {
+                    auto codePoint = parseHex4();
+                    if (codePoint >= 0xd800 && codePoint < 0xdc00 && consume("\\u")) {
+                        auto low = parseHex4();
+                        codePoint = 0x10000 + ((codePoint - 0xd800) << 10) + (low - 0xdc00);
+                    }
+                    appendUtf8(result, codePoint);
+                    break;
+                }
+                default:
+                    fail("invalid escape");
+            }
+        }
+    }
+
+    double parseNumber() {
+        double result = 0;
+        auto [end, error] = std::from_chars(text.data() + position, text.data() + text.size(), result);
+        if (error != std::errc()) {
+            fail("invalid value");
+        }
+        position = end - text.data();
+        return result;
+    }
+
+    std::string_view text;
+    size_t position = 0;
+};
+
+JsonValue JsonValue::parse(std::string_view text) {
+    return JsonParser(text).parseDocument();
+}
+
+bool JsonValue::boolean() const {
+    if (auto boolean = std::get_if<bool>(&value)) {
+        return *boolean;
+    }
+    throw std::runtime_error("json value is not a boolean");
+}
+
+double JsonValue::number() const {
+    if (auto number = std::get_if<double>(&value)) {
+        return *number;
+    }
+    throw std::runtime_error("json value is not a number");
+}
+
+const std::string &JsonValue::string() const {
+    if (auto string = std::get_if<std::string>(&value)) {
+        return *string;
+    }
+    throw std::runtime_error("json value is not a string");
+}
+
+const JsonValue::Array &JsonValue::array() const {
+    if (auto array = std::get_if<Array>(&value)) {
+        return *array;
+    }
+    throw std::runtime_error("json value is not an array");
+}
+
+const JsonValue::Object &JsonValue::object() const {
+    if (auto object = std::get_if<Object>(&value)) {
+        return *object;
+    }
+    throw std::runtime_error("json value is not an object");
+}
+
+const JsonValue &JsonValue::operator[](std::string_view key) const {
+    static const JsonValue null;
+
+    if (auto object = std::get_if<Object>(&value)) {
+        auto it = object->find(key);
+        if (it != object->end()) {
+            return it->second;
+        }
+    }
+    return null;
+}
+
+const JsonValue &JsonValue::operator[](size_t index) const {
+    const auto &elements = array();
+    if (index >= elements.size()) {
+        throw std::runtime_error("json array index out of range");
+    }
+    return elements[index];
+}
+
+bool JsonValue::contains(std::string_view key) const {
+    auto object = std::get_if<Object>(&value);
+    return object && object->find(key) != object->end();
+}
+
+size_t JsonValue::size() const {
+    if (auto array = std::get_if<Array>(&value)) {
+        return array->size();
+    }
+    if (auto object = std::get_if<Object>(&value)) {
+        return object->size();
+    }
+    return 0;
+}
+
+double JsonValue::numberOr(std::string_view key, double fallback) const {
+    const auto &member = (*this)[key];
+    return member.isNumber() ? member.number() : fallback;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <map>
+#include <string>
+#include <string_view>
+#include <variant>
+#include <vector>
+
+// Just enough JSON to read glTF documents. Parse errors throw std::runtime_error.
+class JsonValue {
+public:
+    using Array = std::vector<JsonValue>;
+    using Object = std::map<std::string, JsonValue, std::less<>>;
+
+    static JsonValue parse(std::string_view text);
+
+    [[nodiscard]] bool isNull() const { return std::holds_alternative<std::nullptr_t>(value); }
+    [[nodiscard]] bool isBool() const { return std::holds_alternative<bool>(value); }
+    [[nodiscard]] bool isNumber() const { return std::holds_alternative<double>(value); }
+    [[nodiscard]] bool isString() const { return std::holds_alternative<std::string>(value); }
+    [[nodiscard]] bool isArray() const { return std::holds_alternative<Array>(value); }
+    [[nodiscard]] bool isObject() const { return std::holds_alternative<Object>(value); }
+
+    [[nodiscard]] bool boolean() const;
+    [[nodiscard]] double number() const;
+    [[nodiscard]] const std::string &string() const;
+    [[nodiscard]] const Array &array() const;
+    [[nodiscard]] const Object &object() const;
+
+    // member access on objects, returns a null value for missing members so lookups can be chained
+    [[nodiscard]] const JsonValue &operator[](std::string_view key) const;
+    [[nodiscard]] const JsonValue &operator[](size_t index) const;
+    [[nodiscard]] bool contains(std::string_view key) const;
+    [[nodiscard]] size_t size() const;
+
+    [[nodiscard]] double numberOr(std::string_view key, double fallback) const;
+
+private:
+    friend class JsonParser;
+
+    std::variant<std::nullptr_t, bool, double, std::string, Array, Object> value;
+};
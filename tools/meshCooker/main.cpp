@@ -0,0 +1,233 @@
+#include "importer.hpp"
+#include "jobSystem.hpp"
+#include "meshlets.hpp"
+#include "meshFormat.hpp"
+#include "optimization.hpp"
+#include "quantization.hpp"
+#include "simplification.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+// Converts OBJ and glTF files into the .vmesh layout the renderer maps straight into video memory,
+// see src/meshFormat.hpp.
+
+namespace {
+
+// cache size the vertex cache statistics are reported for, a typical post-transform cache
+constexpr uint32_t ReportedCacheSize = 16;
+
+uint64_t alignUp(uint64_t value, uint64_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+void writeMesh(const std::string &path, const ImportedMesh &mesh, const MeshletData &meshlets,
+               const std::vector<MeshLod> &lods, MeshVertexFormat vertexFormat) {
+    MeshFileHeader header{
+            .magic = MeshFileMagic,
+            .version = MeshFileVersion,
+            .vertexCount = static_cast<uint32_t>(mesh.vertices.size()),
+            .indexCount = static_cast<uint32_t>(mesh.indices.size()),
+            .meshletCount = static_cast<uint32_t>(meshlets.meshlets.size()),
+            .vertexFormat = vertexFormat,
+            .lodCount = static_cast<uint32_t>(lods.size()),
+    };
+
+    for (int axis = 0; axis < 3; axis++) {
+        header.boundsMin[axis] = std::numeric_limits<float>::max();
+        header.boundsMax[axis] = std::numeric_limits<float>::lowest();
+    }
+    for (const auto &vertex : mesh.vertices) {
+        for (int axis = 0; axis < 3; axis++) {
+            header.boundsMin[axis] = std::min(header.boundsMin[axis], vertex.position[axis]);
+            header.boundsMax[axis] = std::max(header.boundsMax[axis], vertex.position[axis]);
+        }
+    }
+
+    std::vector<QuantizedMeshVertex> quantizedVertices;
+    const void *vertexData = mesh.vertices.data();
+    if (vertexFormat == MeshVertexFormatQuantized) {
+        quantizedVertices = quantizeVertices(mesh.vertices, header.boundsMin, header.boundsMax);
+        vertexData = quantizedVertices.data();
+    }
+
+    struct SectionData {
+        const void *data;
+        uint64_t size;
+    };
+    SectionData sections[MeshSectionCount] = {
+            {vertexData, mesh.vertices.size() * meshVertexSize(vertexFormat)},
+            {mesh.indices.data(), mesh.indices.size() * sizeof(uint32_t)},
+            {meshlets.meshlets.data(), meshlets.meshlets.size() * sizeof(Meshlet)},
+            {meshlets.vertices.data(), meshlets.vertices.size() * sizeof(uint32_t)},
+            {meshlets.triangles.data(), meshlets.triangles.size()},
+            {lods.data(), lods.size() * sizeof(MeshLod)},
+    };
+
+    uint64_t offset = sizeof(MeshFileHeader);
+    for (uint32_t section = 0; section < MeshSectionCount; section++) {
+        offset = alignUp(offset, MeshSectionAlignment);
+        header.sections[section] = MeshSectionInfo{.offset = offset, .size = sections[section].size};
+        offset += sections[section].size;
+    }
+
+    std::ofstream file(path, std::ios::binary);
+    if (!file) {
+        throw std::runtime_error("could not create " + path);
+    }
+
+    static const char padding[MeshSectionAlignment] = {};
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    uint64_t written = sizeof(header);
+
+    for (uint32_t section = 0; section < MeshSectionCount; section++) {
+        file.write(padding, static_cast<std::streamsize>(header.sections[section].offset - written));
+        file.write(static_cast<const char *>(sections[section].data), static_cast<std::streamsize>(sections[section].size));
+        written = header.sections[section].offset + sections[section].size;
+    }
+
+    if (!file) {
+        throw std::runtime_error("could not write " + path);
+    }
+}
+
+// Simplifies the mesh into a LOD chain and optimizes every level, the levels in parallel. Afterwards mesh.indices holds
+// the indices of all levels, finest first, and the vertices are ordered by first use across the levels.
+std::vector<MeshLod> buildLods(JobSystem &jobs, ImportedMesh &mesh, uint32_t maxLods, bool optimize,
+                               float overdrawThreshold) {
+    auto levels = buildLodChain(mesh.indices, mesh.vertices, maxLods);
+
+    if (optimize) {
+        jobs.parallelFor(static_cast<uint32_t>(levels.size()), 1, [&](uint32_t begin, uint32_t end) {
+            for (auto i = begin; i < end; i++) {
+                optimizeVertexCache(levels[i].indices, mesh.vertices.size());
+                optimizeOverdraw(levels[i].indices, mesh.vertices, overdrawThreshold);
+            }
+        });
+    }
+
+    std::vector<MeshLod> lods;
+    mesh.indices.clear();
+    for (auto &level : levels) {
+        lods.push_back(MeshLod{
+                .indexOffset = static_cast<uint32_t>(mesh.indices.size()),
+                .indexCount = static_cast<uint32_t>(level.indices.size()),
+                .error = level.error,
+        });
+        mesh.indices.insert(mesh.indices.end(), level.indices.begin(), level.indices.end());
+    }
+
+    // the coarser levels only use vertices of the finest one, which comes first and gets the linear fetch order
+    if (optimize) {
+        optimizeVertexFetch(mesh.indices, mesh.vertices);
+    }
+    return lods;
+}
+
+// Builds the meshlets of every level in parallel and appends them in level order.
+MeshletData buildLodMeshlets(JobSystem &jobs, const ImportedMesh &mesh, std::vector<MeshLod> &lods) {
+    std::vector<MeshletData> levels(lods.size());
+    jobs.parallelFor(static_cast<uint32_t>(lods.size()), 1, [&](uint32_t begin, uint32_t end) {
+        for (auto i = begin; i < end; i++) {
+            std::vector<uint32_t> indices(mesh.indices.begin() + lods[i].indexOffset,
+                                          mesh.indices.begin() + lods[i].indexOffset + lods[i].indexCount);
+            levels[i] = buildMeshlets(indices, mesh.vertices);
+        }
+    });
+
+    MeshletData data;
+    for (size_t i = 0; i < lods.size(); i++) {
+        auto &lod = lods[i];
+        const auto &level = levels[i];
+
+        lod.meshletOffset = static_cast<uint32_t>(data.meshlets.size());
+        lod.meshletCount = static_cast<uint32_t>(level.meshlets.size());
+        for (auto meshlet : level.meshlets) {
+            meshlet.vertexOffset += static_cast<uint32_t>(data.vertices.size());
+            meshlet.triangleOffset += static_cast<uint32_t>(data.triangles.size());
+            data.meshlets.push_back(meshlet);
+        }
+        data.vertices.insert(data.vertices.end(), level.vertices.begin(), level.vertices.end());
+        data.triangles.insert(data.triangles.end(), level.triangles.begin(), level.triangles.end());
+    }
+    return data;
+}
+
+}
+
+int main(int argc, char **argv) {
+    auto vertexFormat = MeshVertexFormatQuantized;
+    bool optimize = true;
+    float overdrawThreshold = 1.05f;
+    uint32_t maxLods = MaxMeshLods;
+    std::vector<std::string> paths;
+    for (int i = 1; i < argc; i++) {
+        std::string argument = argv[i];
+        if (argument == "--vertex-format=float") {
+            vertexFormat = MeshVertexFormatFloat;
+        } else if (argument == "--vertex-format=quantized") {
+            vertexFormat = MeshVertexFormatQuantized;
+        } else if (argument == "--no-optimize") {
+            optimize = false;
+        } else if (argument.starts_with("--overdraw-threshold=")) {
+            overdrawThreshold = std::stof(argument.substr(strlen("--overdraw-threshold=")));
+        } else if (argument.starts_with("--lods=")) {
+            maxLods = std::clamp<uint32_t>(std::stoul(argument.substr(strlen("--lods="))), 1, MaxMeshLods);
+        } else {
+            paths.push_back(argument);
+        }
+    }
+
+    if (paths.size() != 2) {
+        std::cerr << "usage: " << argv[0]
+                  << " [--vertex-format=float|quantized] [--no-optimize] [--overdraw-threshold=<t>] [--lods=<n>]"
+                     " <input.obj|input.gltf|input.glb> <output.vmesh>\n";
+        return 1;
+    }
+    const auto &inputPath = paths[0];
+    const auto &outputPath = paths[1];
+
+    try {
+        auto start = std::chrono::steady_clock::now();
+        JobSystem jobs;
+        jobs.create(JobSystem::defaultWorkerCount());
+
+        auto mesh = importMesh(inputPath);
+        if (mesh.indices.empty()) {
+            throw std::runtime_error("no triangles in " + inputPath);
+        }
+
+        auto before = analyzeVertexCache(mesh.indices, mesh.vertices.size(), ReportedCacheSize);
+        auto lods = buildLods(jobs, mesh, maxLods, optimize, overdrawThreshold);
+        std::vector<uint32_t> finestIndices(mesh.indices.begin(), mesh.indices.begin() + lods[0].indexCount);
+        auto after = analyzeVertexCache(finestIndices, mesh.vertices.size(), ReportedCacheSize);
+
+        auto meshlets = buildLodMeshlets(jobs, mesh, lods);
+        jobs.destroy();
+        writeMesh(outputPath, mesh, meshlets, lods, vertexFormat);
+
+        auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << outputPath << ": " << mesh.vertices.size() << " vertices, " << lods[0].indexCount / 3
+                  << " triangles, " << lods[0].meshletCount << " meshlets, cooked in " << seconds << " s\n";
+        for (size_t i = 0; i < lods.size(); i++) {
+            std::cout << "LOD " << i << ": " << lods[i].indexCount / 3 << " triangles, " << lods[i].meshletCount
+                      << " meshlets, error " << lods[i].error << "\n";
+        }
+        std::cout << "vertex data: " << mesh.vertices.size() * meshVertexSize(vertexFormat) / 1024.0 << " KB "
+                  << meshVertexFormatName(vertexFormat) << ", "
+                  << mesh.vertices.size() * meshVertexSize(MeshVertexFormatFloat) / 1024.0 << " KB as float\n";
+        std::cout << "vertex cache (" << ReportedCacheSize << " entry FIFO): ACMR " << before.acmr << " -> " << after.acmr
+                  << ", ATVR " << before.atvr << " -> " << after.atvr << "\n";
+    } catch (std::exception &e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,252 @@
+#include "meshlets.hpp"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <optional>
+
+namespace {
+
+// triangles using every vertex, emitted triangles are removed so only live candidates are scanned
+struct TriangleAdjacency {
+    std::vector<uint32_t> offsets;
+    std::vector<uint32_t> counts;
+    std::vector<uint32_t> triangles;
+
+    TriangleAdjacency(const std::vector<uint32_t> &indices, size_t vertexCount)
+            : offsets(vertexCount, 0), counts(vertexCount, 0), triangles(indices.size()) {
+        for (auto index : indices) {
+            counts[index]++;
+        }
+
+        uint32_t offset = 0;
+        for (size_t vertex = 0; vertex < vertexCount; vertex++) {
+            offsets[vertex] = offset;
+            offset += counts[vertex];
+            counts[vertex] = 0;
+        }
+
+        for (size_t i = 0; i < indices.size(); i++) {
+            auto vertex = indices[i];
+            triangles[offsets[vertex] + counts[vertex]++] = static_cast<uint32_t>(i / 3);
+        }
+    }
+
+    void remove(uint32_t vertex, uint32_t triangle) {
+        auto *begin = &triangles[offsets[vertex]];
+        auto *end = begin + counts[vertex];
+        auto it = std::find(begin, end, triangle);
+        if (it != end) {
+            *it = *(end - 1);
+            counts[vertex]--;
+        }
+    }
+};
+
+glm::vec3 position(const std::vector<MeshVertex> &vertices, uint32_t index) {
+    return glm::make_vec3(vertices[index].position);
+}
+
+// Ritter's bounding sphere, within a few percent of the optimum for the small point sets of a meshlet
+void computeSphere(Meshlet &meshlet, const uint32_t *meshletVertices, const std::vector<MeshVertex> &vertices) {
+    auto first = position(vertices, meshletVertices[0]);
+
+    auto farthestFrom = [&](glm::vec3 point) {
+        auto farthest = point;
+        float farthestDistance = -1.0f;
+        for (uint32_t i = 0; i < meshlet.vertexCount; i++) {
+            auto candidate = position(vertices, meshletVertices[i]);
+            auto distance = glm::dot(candidate - point, candidate - point);
+            if (distance > farthestDistance) {
+                farthest = candidate;
+                farthestDistance = distance;
+            }
+        }
+        return farthest;
+    };
+
+    auto a = farthestFrom(first);
+    auto b = farthestFrom(a);
+    auto center = (a + b) * 0.5f;
+    auto radius = glm::length(b - a) * 0.5f;
+
+    for (uint32_t i = 0; i < meshlet.vertexCount; i++) {
+        auto point = position(vertices, meshletVertices[i]);
+        auto distance = glm::length(point - center);
+        if (distance > radius) {
+            auto newRadius = (radius + distance) * 0.5f;
+            center += (point - center) * ((newRadius - radius) / distance);
+            radius = newRadius;
+        }
+    }
+
+    std::copy_n(glm::value_ptr(center), 3, meshlet.center);
+    meshlet.radius = radius;
+}
+
+// The cone contains the normals of all triangles. It is only useful when they all lie within a hemisphere,
+// otherwise the meshlet is visible from every direction and the cone test is disabled.
+void computeCone(Meshlet &meshlet, const uint32_t *meshletVertices, const uint8_t *triangles,
+                 const std::vector<MeshVertex> &vertices) {
+    std::vector<glm::vec3> normals;
+    normals.reserve(meshlet.triangleCount);
+
+    glm::vec3 axis(0.0f);
+    for (uint32_t i = 0; i < meshlet.triangleCount; i++) {
+        auto a = position(vertices, meshletVertices[triangles[i * 3]]);
+        auto b = position(vertices, meshletVertices[triangles[i * 3 + 1]]);
+        auto c = position(vertices, meshletVertices[triangles[i * 3 + 2]]);
+        auto normal = glm::cross(b - a, c - a);
+        auto length = glm::length(normal);
+        if (length > 0.0f) {
+            normals.push_back(normal / length);
+            axis += normal / length;
+        }
+    }
+
+    meshlet.coneAxis[0] = 0.0f;
+    meshlet.coneAxis[1] = 0.0f;
+    meshlet.coneAxis[2] = 0.0f;
+    meshlet.coneCutoff = 1.0f;
+
+    auto axisLength = glm::length(axis);
+    if (normals.empty() || axisLength == 0.0f) {
+        return;
+    }
+    axis /= axisLength;
+
+    float minDot = 1.0f;
+    for (const auto &normal : normals) {
+        minDot = std::min(minDot, glm::dot(normal, axis));
+    }
+    if (minDot <= 0.0f) {
+        return;
+    }
+
+    std::copy_n(glm::value_ptr(axis), 3, meshlet.coneAxis);
+    // sine of the cone's half angle, i.e. the cosine of the complementary angle the view vector has to exceed
+    meshlet.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+}
+
+}
+
+MeshletData buildMeshlets(const std::vector<uint32_t> &indices, const std::vector<MeshVertex> &vertices) {
+    MeshletData data;
+
+    auto triangleCount = static_cast<uint32_t>(indices.size() / 3);
+    TriangleAdjacency adjacency(indices, vertices.size());
+    std::vector<bool> emitted(triangleCount, false);
+
+    // local index of every mesh vertex in the current meshlet, 0xff when it is not part of it
+    std::vector<uint8_t> localIndices(vertices.size(), 0xff);
+    Meshlet current{};
+    glm::vec3 positionSum(0.0f);
+    uint32_t nextUnemitted = 0;
+
+    auto newVertexCount = [&](uint32_t triangle) {
+        uint32_t count = 0;
+        for (uint32_t corner = 0; corner < 3; corner++) {
+            count += localIndices[indices[triangle * 3 + corner]] == 0xff;
+        }
+        return count;
+    };
+
+    auto flush = [&] {
+        if (current.triangleCount == 0) {
+            return;
+        }
+
+        for (uint32_t i = 0; i < current.vertexCount; i++) {
+            localIndices[data.vertices[current.vertexOffset + i]] = 0xff;
+        }
+
+        computeSphere(current, &data.vertices[current.vertexOffset], vertices);
+        computeCone(current, &data.vertices[current.vertexOffset], &data.triangles[current.triangleOffset], vertices);
+
+        // every meshlet starts on a 4 byte boundary so shaders can fetch its triangles as whole words
+        while (data.triangles.size() % 4 != 0) {
+            data.triangles.push_back(0);
+        }
+
+        data.meshlets.push_back(current);
+        positionSum = glm::vec3(0.0f);
+        current = Meshlet{
+                .vertexOffset = static_cast<uint32_t>(data.vertices.size()),
+                .triangleOffset = static_cast<uint32_t>(data.triangles.size()),
+        };
+    };
+
+    for (uint32_t emittedCount = 0; emittedCount < triangleCount; emittedCount++) {
+        // the live neighbour sharing the most vertices with the meshlet, ties go to the one closest to its centroid
+        std::optional<uint32_t> best;
+        uint32_t bestNewVertices = 4;
+        uint32_t bestLiveNeighbours = 0;
+        float bestDistance = 0.0f;
+        auto centroid = current.vertexCount > 0 ? positionSum / static_cast<float>(current.vertexCount) : glm::vec3(0.0f);
+
+        for (uint32_t i = 0; i < current.vertexCount; i++) {
+            auto vertex = data.vertices[current.vertexOffset + i];
+            for (uint32_t j = 0; j < adjacency.counts[vertex]; j++) {
+                auto triangle = adjacency.triangles[adjacency.offsets[vertex] + j];
+                auto newVertices = newVertexCount(triangle);
+                if (newVertices > bestNewVertices) {
+                    continue;
+                }
+
+                // triangles whose vertices have few live neighbours left sit on the border of the unprocessed
+                // region, taking them first avoids leaving behind islands that end up as tiny meshlets
+                uint32_t liveNeighbours = 0;
+                for (uint32_t corner = 0; corner < 3; corner++) {
+                    liveNeighbours += adjacency.counts[indices[triangle * 3 + corner]];
+                }
+
+                auto center = (position(vertices, indices[triangle * 3]) + position(vertices, indices[triangle * 3 + 1]) +
+                               position(vertices, indices[triangle * 3 + 2])) / 3.0f;
+                auto distance = glm::dot(center - centroid, center - centroid);
+                if (newVertices < bestNewVertices ||
+                    liveNeighbours < bestLiveNeighbours ||
+                    (liveNeighbours == bestLiveNeighbours && distance < bestDistance)) {
+                    best = triangle;
+                    bestNewVertices = newVertices;
+                    bestLiveNeighbours = liveNeighbours;
+                    bestDistance = distance;
+                }
+            }
+        }
+
+        if (!best) {
+            // the meshlet has no live neighbours left, continue with the next triangle in index order
+            flush();
+            while (emitted[nextUnemitted]) {
+                nextUnemitted++;
+            }
+            best = nextUnemitted;
+        } else if (current.vertexCount + bestNewVertices > MaxMeshletVertices ||
+                   current.triangleCount + 1 > MaxMeshletTriangles) {
+            // the neighbour seeds the next meshlet, which keeps consecutive meshlets close together
+            flush();
+        }
+
+        auto triangle = *best;
+        emitted[triangle] = true;
+
+        for (uint32_t corner = 0; corner < 3; corner++) {
+            auto vertex = indices[triangle * 3 + corner];
+            adjacency.remove(vertex, triangle);
+
+            if (localIndices[vertex] == 0xff) {
+                localIndices[vertex] = static_cast<uint8_t>(current.vertexCount++);
+                data.vertices.push_back(vertex);
+                positionSum += position(vertices, vertex);
+            }
+            data.triangles.push_back(localIndices[vertex]);
+        }
+        current.triangleCount++;
+    }
+
+    flush();
+
+    return data;
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include "meshFormat.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct MeshletData {
+    std::vector<Meshlet> meshlets;
+    std::vector<uint32_t> vertices;
+    std::vector<uint8_t> triangles;
+};
+
+// Splits a triangle list into meshlets of at most MaxMeshletVertices vertices and MaxMeshletTriangles triangles.
+// Meshlets are grown greedily from triangles that share the most vertices with the meshlet so far, which keeps
+// them compact and their bounds tight. Every meshlet gets a bounding sphere and a backface cone for culling.
+MeshletData buildMeshlets(const std::vector<uint32_t> &indices, const std::vector<MeshVertex> &vertices);
@@ -0,0 +1,319 @@
+#include "optimization.hpp"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+namespace {
+
+// cache model of the vertex cache optimization, larger than any real cache so the order degrades gracefully
+constexpr uint32_t ForsythCacheSize = 32;
+// cache model used to find cluster boundaries for the overdraw optimization
+constexpr uint32_t ClusterCacheSize = 16;
+
+float forsythVertexScore(int cachePosition, uint32_t remainingTriangles) {
+    if (remainingTriangles == 0) {
+        return -1.0f;
+    }
+
+    float score = 0.0f;
+    if (cachePosition >= 0) {
+        // the vertices of the last triangle get a fixed score so its neighbours are not preferred over each other
+        if (cachePosition < 3) {
+            score = 0.75f;
+        } else {
+            score = std::pow(1.0f - static_cast<float>(cachePosition - 3) / (ForsythCacheSize - 3), 1.5f);
+        }
+    }
+
+    // vertices with few triangles left are finished first, so they do not have to be loaded again later
+    return score + 2.0f / std::sqrt(static_cast<float>(remainingTriangles));
+}
+
+// FIFO cache simulation, a vertex hits when fewer than cacheSize misses happened since it was last loaded
+struct FifoCache {
+    std::vector<uint32_t> timestamps;
+    uint32_t cacheSize;
+    uint32_t time;
+
+    FifoCache(size_t vertexCount, uint32_t size) : timestamps(vertexCount, 0), cacheSize(size), time(size + 1) {}
+
+    void reset() {
+        time += cacheSize + 1;
+    }
+
+    // returns the number of misses of the triangle
+    uint32_t access(const uint32_t *triangle) {
+        uint32_t misses = 0;
+        for (uint32_t corner = 0; corner < 3; corner++) {
+            auto vertex = triangle[corner];
+            if (time - timestamps[vertex] > cacheSize) {
+                timestamps[vertex] = time++;
+                misses++;
+            }
+        }
+        return misses;
+    }
+};
+
+}
+
+VertexCacheStatistics analyzeVertexCache(const std::vector<uint32_t> &indices, size_t vertexCount, uint32_t cacheSize) {
+    FifoCache cache(vertexCount, cacheSize);
+    std::vector<bool> used(vertexCount, false);
+
+    uint64_t misses = 0;
+    for (size_t i = 0; i < indices.size(); i += 3) {
+        misses += cache.access(&indices[i]);
+        for (uint32_t corner = 0; corner < 3; corner++) {
+            used[indices[i + corner]] = true;
+        }
+    }
+
+    auto usedCount = std::count(used.begin(), used.end(), true);
+    auto triangleCount = indices.size() / 3;
+
+    return VertexCacheStatistics{
+            .acmr = triangleCount > 0 ? static_cast<float>(misses) / static_cast<float>(triangleCount) : 0.0f,
+            .atvr = usedCount > 0 ? static_cast<float>(misses) / static_cast<float>(usedCount) : 0.0f,
+    };
+}
+
+void optimizeVertexCache(std::vector<uint32_t> &indices, size_t vertexCount) {
+    auto triangleCount = indices.size() / 3;
+    if (triangleCount == 0) {
+        return;
+    }
+
+    // live triangles of every vertex, the first remaining[vertex] entries of its range
+    std::vector<uint32_t> offsets(vertexCount + 1, 0);
+    for (auto index : indices) {
+        offsets[index + 1]++;
+    }
+    std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+
+    std::vector<uint32_t> remaining(vertexCount, 0);
+    std::vector<uint32_t> vertexTriangles(indices.size());
+    for (size_t i = 0; i < indices.size(); i++) {
+        auto vertex = indices[i];
+        vertexTriangles[offsets[vertex] + remaining[vertex]++] = static_cast<uint32_t>(i / 3);
+    }
+
+    std::vector<int> cachePositions(vertexCount, -1);
+    std::vector<float> vertexScores(vertexCount);
+    for (size_t vertex = 0; vertex < vertexCount; vertex++) {
+        vertexScores[vertex] = forsythVertexScore(-1, remaining[vertex]);
+    }
+
+    std::vector<float> triangleScores(triangleCount);
+    for (size_t triangle = 0; triangle < triangleCount; triangle++) {
+        triangleScores[triangle] = vertexScores[indices[triangle * 3]] + vertexScores[indices[triangle * 3 + 1]] +
+                                   vertexScores[indices[triangle * 3 + 2]];
+    }
+
+    std::vector<bool> emitted(triangleCount, false);
+    std::vector<uint32_t> cache;
+    std::vector<uint32_t> newCache;
+    std::vector<uint32_t> result;
+    result.reserve(indices.size());
+
+    size_t nextUnemitted = 0;
+    int64_t best = -1;
+
+    for (size_t emittedCount = 0; emittedCount < triangleCount; emittedCount++) {
+        if (best < 0) {
+            // nothing in the cache has triangles left, continue with the next one in the original order
+            while (emitted[nextUnemitted]) {
+                nextUnemitted++;
+            }
+            best = static_cast<int64_t>(nextUnemitted);
+        }
+
+        auto triangle = static_cast<uint32_t>(best);
+        const auto *corners = &indices[triangle * 3];
+        emitted[triangle] = true;
+        result.insert(result.end(), corners, corners + 3);
+
+        for (uint32_t corner = 0; corner < 3; corner++) {
+            auto vertex = corners[corner];
+            auto *begin = &vertexTriangles[offsets[vertex]];
+            auto *end = begin + remaining[vertex];
+            auto it = std::find(begin, end, triangle);
+            if (it != end) {
+                *it = *(end - 1);
+                remaining[vertex]--;
+            }
+        }
+
+        // the triangle's vertices move to the front, everything else is pushed back
+        newCache.assign(corners, corners + 3);
+        for (auto vertex : cache) {
+            if (vertex != corners[0] && vertex != corners[1] && vertex != corners[2]) {
+                newCache.push_back(vertex);
+            }
+        }
+        for (size_t i = ForsythCacheSize; i < newCache.size(); i++) {
+            cachePositions[newCache[i]] = -1;
+        }
+
+        // rescore every vertex whose cache position or remaining count changed and propagate to its live triangles
+        auto rescore = [&](uint32_t vertex) {
+            auto score = forsythVertexScore(cachePositions[vertex], remaining[vertex]);
+            auto delta = score - vertexScores[vertex];
+            vertexScores[vertex] = score;
+            for (uint32_t i = 0; i < remaining[vertex]; i++) {
+                triangleScores[vertexTriangles[offsets[vertex] + i]] += delta;
+            }
+        };
+
+        for (size_t i = ForsythCacheSize; i < newCache.size(); i++) {
+            rescore(newCache[i]);
+        }
+        if (newCache.size() > ForsythCacheSize) {
+            newCache.resize(ForsythCacheSize);
+        }
+        for (size_t i = 0; i < newCache.size(); i++) {
+            cachePositions[newCache[i]] = static_cast<int>(i);
+            rescore(newCache[i]);
+        }
+        std::swap(cache, newCache);
+
+        // the next triangle is the best live one using a cached vertex
+        best = -1;
+        float bestScore = 0.0f;
+        for (auto vertex : cache) {
+            for (uint32_t i = 0; i < remaining[vertex]; i++) {
+                auto candidate = vertexTriangles[offsets[vertex] + i];
+                if (best < 0 || triangleScores[candidate] > bestScore) {
+                    best = candidate;
+                    bestScore = triangleScores[candidate];
+                }
+            }
+        }
+    }
+
+    indices = std::move(result);
+}
+
+void optimizeOverdraw(std::vector<uint32_t> &indices, const std::vector<MeshVertex> &vertices, float threshold) {
+    auto triangleCount = indices.size() / 3;
+    if (triangleCount == 0) {
+        return;
+    }
+
+    FifoCache cache(vertices.size(), ClusterCacheSize);
+
+    // hard boundaries: triangles where the cache order restarts and all three vertices miss
+    std::vector<size_t> hardBoundaries = {0};
+    for (size_t triangle = 0; triangle < triangleCount; triangle++) {
+        if (cache.access(&indices[triangle * 3]) == 3 && triangle > 0) {
+            hardBoundaries.push_back(triangle);
+        }
+    }
+    hardBoundaries.push_back(triangleCount);
+
+    // soft boundaries: a hard cluster is split as soon as its first part alone is within threshold of the ACMR of the
+    // whole cluster, splitting there costs at most that much vertex reuse
+    std::vector<size_t> boundaries;
+    for (size_t cluster = 0; cluster + 1 < hardBoundaries.size(); cluster++) {
+        auto begin = hardBoundaries[cluster];
+        auto end = hardBoundaries[cluster + 1];
+
+        cache.reset();
+        uint32_t clusterMisses = 0;
+        for (auto triangle = begin; triangle < end; triangle++) {
+            clusterMisses += cache.access(&indices[triangle * 3]);
+        }
+        auto clusterAcmr = static_cast<float>(clusterMisses) / static_cast<float>(end - begin);
+
+        cache.reset();
+        boundaries.push_back(begin);
+        uint32_t misses = 0;
+        size_t start = begin;
+        for (auto triangle = begin; triangle < end; triangle++) {
+            misses += cache.access(&indices[triangle * 3]);
+            auto acmr = static_cast<float>(misses) / static_cast<float>(triangle + 1 - start);
+            if (triangle + 1 < end && acmr <= clusterAcmr * threshold) {
+                boundaries.push_back(triangle + 1);
+                start = triangle + 1;
+                misses = 0;
+                cache.reset();
+            }
+        }
+    }
+    boundaries.push_back(triangleCount);
+
+    auto position = [&](uint32_t index) {
+        return glm::make_vec3(vertices[index].position);
+    };
+
+    glm::vec3 meshCenter(0.0f);
+    for (const auto &vertex : vertices) {
+        meshCenter += glm::make_vec3(vertex.position);
+    }
+    meshCenter /= static_cast<float>(std::max<size_t>(vertices.size(), 1));
+
+    // clusters whose area weighted normal points away from the mesh center are drawn first
+    struct Cluster {
+        size_t begin;
+        size_t end;
+        float sortKey;
+    };
+    std::vector<Cluster> clusters;
+    for (size_t i = 0; i + 1 < boundaries.size(); i++) {
+        Cluster cluster{.begin = boundaries[i], .end = boundaries[i + 1], .sortKey = 0.0f};
+
+        glm::vec3 centroid(0.0f);
+        glm::vec3 normal(0.0f);
+        float area = 0.0f;
+        for (auto triangle = cluster.begin; triangle < cluster.end; triangle++) {
+            auto a = position(indices[triangle * 3]);
+            auto b = position(indices[triangle * 3 + 1]);
+            auto c = position(indices[triangle * 3 + 2]);
+            auto weightedNormal = glm::cross(b - a, c - a);
+            auto triangleArea = glm::length(weightedNormal);
+
+            centroid += (a + b + c) * (triangleArea / 3.0f);
+            normal += weightedNormal;
+            area += triangleArea;
+        }
+
+        auto normalLength = glm::length(normal);
+        if (area > 0.0f && normalLength > 0.0f) {
+            cluster.sortKey = glm::dot(centroid / area - meshCenter, normal / normalLength);
+        }
+        clusters.push_back(cluster);
+    }
+
+    std::stable_sort(clusters.begin(), clusters.end(), [](const Cluster &a, const Cluster &b) {
+        return a.sortKey > b.sortKey;
+    });
+
+    std::vector<uint32_t> result;
+    result.reserve(indices.size());
+    for (const auto &cluster : clusters) {
+        result.insert(result.end(), indices.begin() + static_cast<ptrdiff_t>(cluster.begin * 3),
+                      indices.begin() + static_cast<ptrdiff_t>(cluster.end * 3));
+    }
+    indices = std::move(result);
+}
+
+void optimizeVertexFetch(std::vector<uint32_t> &indices, std::vector<MeshVertex> &vertices) {
+    constexpr uint32_t Unused = ~0u;
+    std::vector<uint32_t> remap(vertices.size(), Unused);
+    std::vector<MeshVertex> reordered;
+    reordered.reserve(vertices.size());
+
+    for (auto &index : indices) {
+        if (remap[index] == Unused) {
+            remap[index] = static_cast<uint32_t>(reordered.size());
+            reordered.push_back(vertices[index]);
+        }
+        index = remap[index];
+    }
+
+    vertices = std::move(reordered);
+}
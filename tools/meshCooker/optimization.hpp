@@ -0,0 +1,31 @@
+#pragma once
+
+#include "meshFormat.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Index and vertex buffer reordering for the GPU's post-transform vertex cache, overdraw and vertex fetch.
+// Run in this order, each pass keeps what the previous one achieved.
+
+struct VertexCacheStatistics {
+    float acmr; // average cache miss ratio, transformed vertices per triangle: 0.5 at best, 3 at worst
+    float atvr; // average transformed vertex ratio, transformed vertices per vertex: 1 at best
+};
+
+// Simulates a FIFO post-transform cache of cacheSize entries.
+VertexCacheStatistics analyzeVertexCache(const std::vector<uint32_t> &indices, size_t vertexCount, uint32_t cacheSize);
+
+// Reorders triangles for vertex cache reuse with Forsyth's linear-speed algorithm, which does not depend on the
+// exact cache size of the GPU.
+void optimizeVertexCache(std::vector<uint32_t> &indices, size_t vertexCount);
+
+// Splits the cache optimized triangle order into clusters and draws the clusters facing away from the mesh center
+// first, so that they occlude the inner ones (Sander et al., "Fast Triangle Reordering for Vertex Locality and Reduced
+// Overdraw"). threshold bounds how much the clusters may worsen the ACMR: 1 keeps only the natural cache restarts as
+// cluster boundaries, higher values create smaller clusters and less overdraw.
+void optimizeOverdraw(std::vector<uint32_t> &indices, const std::vector<MeshVertex> &vertices, float threshold);
+
+// Reorders vertices by first use so that vertex fetch walks memory linearly, drops unreferenced vertices.
+void optimizeVertexFetch(std::vector<uint32_t> &indices, std::vector<MeshVertex> &vertices);
@@ -0,0 +1,108 @@
+#include "quantization.hpp"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+
+namespace {
+
+uint16_t quantizeUnorm16(float value) {
+    return static_cast<uint16_t>(std::lround(std::clamp(value, 0.0f, 1.0f) * 65535.0f));
+}
+
+int16_t quantizeSnorm16(float value) {
+    return static_cast<int16_t>(std::lround(std::clamp(value, -1.0f, 1.0f) * 32767.0f));
+}
+
+// Projects the unit sphere onto an octahedron and unfolds it into the [-1, 1] square, the lower hemisphere is folded
+// over the diagonals. Decoded by octahedralDecode in shaders/scene.glsl.
+glm::vec2 octahedralEncode(glm::vec3 normal) {
+    auto length = std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+    if (length == 0.0f) {
+        return glm::vec2(0.0f);
+    }
+
+    auto projected = glm::vec2(normal) / length;
+    if (normal.z < 0.0f) {
+        auto signs = glm::vec2(projected.x >= 0.0f ? 1.0f : -1.0f, projected.y >= 0.0f ? 1.0f : -1.0f);
+        projected = (1.0f - glm::abs(glm::vec2(projected.y, projected.x))) * signs;
+    }
+    return projected;
+}
+
+}
+
+uint16_t floatToHalf(float value) {
+    auto bits = std::bit_cast<uint32_t>(value);
+    auto sign = static_cast<uint16_t>((bits >> 16) & 0x8000);
+    auto exponent = static_cast<int32_t>((bits >> 23) & 0xff);
+    auto mantissa = bits & 0x7fffff;
+
+    if (exponent == 0xff) {
+        // infinity stays infinity, NaN keeps a mantissa bit
+        return sign | 0x7c00 | (mantissa ? 0x200 : 0);
+    }
+
+    auto halfExponent = exponent - 127 + 15;
+    if (halfExponent >= 0x1f) {
+        return sign | 0x7c00;
+    }
+
+    if (halfExponent <= 0) {
+        // subnormal half, or zero when the value is too small
+        if (halfExponent < -10) {
+            return sign;
+        }
+        mantissa |= 0x800000;
+        auto shift = static_cast<uint32_t>(14 - halfExponent);
+        auto half = mantissa >> shift;
+        auto remainder = mantissa & ((1u << shift) - 1);
+        auto halfway = 1u << (shift - 1);
+        if (remainder > halfway || (remainder == halfway && (half & 1))) {
+            half++;
+        }
+        return sign | static_cast<uint16_t>(half);
+    }
+
+    auto half = static_cast<uint32_t>(halfExponent << 10) | (mantissa >> 13);
+    auto remainder = mantissa & 0x1fff;
+    // a carry out of the mantissa correctly bumps the exponent, up to infinity
+    if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1))) {
+        half++;
+    }
+    return sign | static_cast<uint16_t>(half);
+}
+
+std::vector<QuantizedMeshVertex> quantizeVertices(const std::vector<MeshVertex> &vertices, const float boundsMin[3],
+                                                  const float boundsMax[3]) {
+    auto minimum = glm::make_vec3(boundsMin);
+    auto extent = glm::make_vec3(boundsMax) - minimum;
+    // flat meshes have a zero extent on one axis, every position sits at the minimum there
+    auto inverseExtent = glm::vec3(extent.x > 0.0f ? 1.0f / extent.x : 0.0f,
+                                   extent.y > 0.0f ? 1.0f / extent.y : 0.0f,
+                                   extent.z > 0.0f ? 1.0f / extent.z : 0.0f);
+
+    std::vector<QuantizedMeshVertex> quantized(vertices.size());
+    for (size_t i = 0; i < vertices.size(); i++) {
+        const auto &vertex = vertices[i];
+        auto &result = quantized[i];
+
+        auto position = (glm::make_vec3(vertex.position) - minimum) * inverseExtent;
+        for (int axis = 0; axis < 3; axis++) {
+            result.position[axis] = quantizeUnorm16(position[axis]);
+        }
+        result.position[3] = 0;
+
+        auto normal = octahedralEncode(glm::make_vec3(vertex.normal));
+        result.normal[0] = quantizeSnorm16(normal.x);
+        result.normal[1] = quantizeSnorm16(normal.y);
+
+        result.uv[0] = floatToHalf(vertex.uv[0]);
+        result.uv[1] = floatToHalf(vertex.uv[1]);
+    }
+
+    return quantized;
+}
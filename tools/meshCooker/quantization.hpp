@@ -0,0 +1,13 @@
+#pragma once
+
+#include "meshFormat.hpp"
+
+#include <cstdint>
+#include <vector>
+
+// Encodes vertices as QuantizedMeshVertex, positions relative to the given mesh bounds.
+std::vector<QuantizedMeshVertex> quantizeVertices(const std::vector<MeshVertex> &vertices, const float boundsMin[3],
+                                                  const float boundsMax[3]);
+
+// IEEE half float with round to nearest even, overflow saturates to infinity.
+uint16_t floatToHalf(float value);
@@ -0,0 +1,300 @@
+#include "simplification.hpp"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+#include <unordered_map>
+
+namespace {
+
+// a level that removes less than this fraction of the previous level's triangles ends the chain
+constexpr float MinLevelReduction = 0.1f;
+// collapses that bend a triangle's normal further than about 75 degrees are rejected
+constexpr double MinNormalCosine = 0.25;
+
+// Sum of squared distances to a set of planes, weighted by triangle area: Q(p) = p^T A p + 2 b.p + c.
+struct Quadric {
+    double a00 = 0, a01 = 0, a02 = 0, a11 = 0, a12 = 0, a22 = 0;
+    double b0 = 0, b1 = 0, b2 = 0;
+    double c = 0;
+    double weight = 0;
+
+    static Quadric fromPlane(const glm::dvec3 &normal, double distance, double weight) {
+        return Quadric{
+                .a00 = normal.x * normal.x * weight,
+                .a01 = normal.x * normal.y * weight,
+                .a02 = normal.x * normal.z * weight,
+                .a11 = normal.y * normal.y * weight,
+                .a12 = normal.y * normal.z * weight,
+                .a22 = normal.z * normal.z * weight,
+                .b0 = normal.x * distance * weight,
+                .b1 = normal.y * distance * weight,
+                .b2 = normal.z * distance * weight,
+                .c = distance * distance * weight,
+                .weight = weight,
+        };
+    }
+
+    Quadric &operator+=(const Quadric &other) {
+        a00 += other.a00, a01 += other.a01, a02 += other.a02;
+        a11 += other.a11, a12 += other.a12, a22 += other.a22;
+        b0 += other.b0, b1 += other.b1, b2 += other.b2;
+        c += other.c;
+        weight += other.weight;
+        return *this;
+    }
+
+    // area weighted mean squared distance of p to the planes
+    double error(const glm::dvec3 &p) const {
+        auto value = a00 * p.x * p.x + a11 * p.y * p.y + a22 * p.z * p.z +
+                     2.0 * (a01 * p.x * p.y + a02 * p.x * p.z + a12 * p.y * p.z) +
+                     2.0 * (b0 * p.x + b1 * p.y + b2 * p.z) + c;
+        return weight > 0.0 ? std::max(value, 0.0) / weight : 0.0;
+    }
+};
+
+struct Collapse {
+    uint32_t from;
+    uint32_t to;
+    double cost;
+};
+
+class Simplifier {
+public:
+    Simplifier(const std::vector<uint32_t> &sourceIndices, const std::vector<MeshVertex> &vertices)
+        : indices(sourceIndices), positions(vertices.size()), quadrics(vertices.size()),
+          locked(vertices.size(), false) {
+        for (size_t i = 0; i < vertices.size(); i++) {
+            positions[i] = glm::dvec3(glm::make_vec3(vertices[i].position));
+        }
+
+        lockSeamsAndBorders();
+
+        for (size_t i = 0; i < indices.size(); i += 3) {
+            auto p0 = positions[indices[i]];
+            auto normal = glm::cross(positions[indices[i + 1]] - p0, positions[indices[i + 2]] - p0);
+            auto area = glm::length(normal);
+            if (area == 0.0) {
+                continue;
+            }
+            normal /= area;
+            auto quadric = Quadric::fromPlane(normal, -glm::dot(normal, p0), area * 0.5);
+            for (uint32_t corner = 0; corner < 3; corner++) {
+                quadrics[indices[i + corner]] += quadric;
+            }
+        }
+    }
+
+    const std::vector<uint32_t> &currentIndices() const {
+        return indices;
+    }
+
+    float currentError() const {
+        return static_cast<float>(std::sqrt(maxCost));
+    }
+
+    // Collapses edges in passes of independent collapses, cheapest first, until the index count is at most
+    // targetIndexCount or no valid collapse is left.
+    void simplify(size_t targetIndexCount) {
+        while (indices.size() > targetIndexCount) {
+            if (!collapsePass((indices.size() - targetIndexCount) / 3)) {
+                break;
+            }
+        }
+    }
+
+private:
+    std::vector<uint32_t> indices;
+    std::vector<glm::dvec3> positions;
+    std::vector<Quadric> quadrics;
+    std::vector<bool> locked;
+    double maxCost = 0.0;
+
+    void lockSeamsAndBorders() {
+        // vertices that share a position differ in their attributes, moving one of them would tear the surface open
+        std::unordered_map<glm::dvec3, uint32_t, PositionHash> welded;
+        std::vector<uint32_t> positionIds(positions.size());
+        std::vector<uint32_t> positionUses;
+        for (size_t i = 0; i < positions.size(); i++) {
+            auto [it, inserted] = welded.try_emplace(positions[i], static_cast<uint32_t>(positionUses.size()));
+            if (inserted) {
+                positionUses.push_back(0);
+            }
+            positionIds[i] = it->second;
+            positionUses[it->second]++;
+        }
+
+        // edges used by a single triangle lie on an open border
+        std::unordered_map<uint64_t, uint32_t> edgeUses;
+        auto edgeKey = [&](uint32_t a, uint32_t b) {
+            auto idA = positionIds[a];
+            auto idB = positionIds[b];
+            return (static_cast<uint64_t>(std::min(idA, idB)) << 32) | std::max(idA, idB);
+        };
+        for (size_t i = 0; i < indices.size(); i += 3) {
+            for (uint32_t corner = 0; corner < 3; corner++) {
+                edgeUses[edgeKey(indices[i + corner], indices[i + (corner + 1) % 3])]++;
+            }
+        }
+
+        std::vector<bool> lockedPositions(positionUses.size(), false);
+        for (const auto &[key, uses] : edgeUses) {
+            if (uses == 1) {
+                lockedPositions[key >> 32] = true;
+                lockedPositions[key & 0xffffffffu] = true;
+            }
+        }
+
+        for (size_t i = 0; i < positions.size(); i++) {
+            locked[i] = positionUses[positionIds[i]] > 1 || lockedPositions[positionIds[i]];
+        }
+    }
+
+    struct PositionHash {
+        size_t operator()(const glm::dvec3 &p) const {
+            uint64_t bits[3];
+            std::memcpy(bits, &p, sizeof(bits));
+            return std::hash<uint64_t>()(bits[0] ^ (bits[1] * 0x9e3779b97f4a7c15ull) ^ (bits[2] * 0xc2b2ae3d27d4eb4full));
+        }
+    };
+
+    // true if moving from onto to flips or degenerates one of the triangles around from that survive the collapse
+    bool flipsTriangle(uint32_t from, uint32_t to, const std::vector<uint32_t> &offsets,
+                       const std::vector<uint32_t> &vertexTriangles) const {
+        for (auto i = offsets[from]; i < offsets[from + 1]; i++) {
+            const auto *triangle = &indices[vertexTriangles[i] * 3];
+            if (triangle[0] == to || triangle[1] == to || triangle[2] == to) {
+                continue;
+            }
+
+            glm::dvec3 before[3];
+            glm::dvec3 after[3];
+            for (uint32_t corner = 0; corner < 3; corner++) {
+                before[corner] = positions[triangle[corner]];
+                after[corner] = positions[triangle[corner] == from ? to : triangle[corner]];
+            }
+
+            auto normalBefore = glm::cross(before[1] - before[0], before[2] - before[0]);
+            auto normalAfter = glm::cross(after[1] - after[0], after[2] - after[0]);
+            if (glm::dot(normalBefore, normalAfter) <=
+                MinNormalCosine * glm::length(normalBefore) * glm::length(normalAfter)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool collapsePass(size_t trianglesToRemove) {
+        auto triangleCount = indices.size() / 3;
+
+        std::vector<uint32_t> offsets(positions.size() + 1, 0);
+        for (auto index : indices) {
+            offsets[index + 1]++;
+        }
+        std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+        std::vector<uint32_t> vertexTriangles(indices.size());
+        {
+            auto cursor = offsets;
+            for (size_t i = 0; i < indices.size(); i++) {
+                vertexTriangles[cursor[indices[i]]++] = static_cast<uint32_t>(i / 3);
+            }
+        }
+
+        // every edge of every triangle in both directions, an interior edge shows up twice which does no harm
+        std::vector<Collapse> collapses;
+        collapses.reserve(indices.size() * 2);
+        for (size_t triangle = 0; triangle < triangleCount; triangle++) {
+            for (uint32_t corner = 0; corner < 3; corner++) {
+                auto a = indices[triangle * 3 + corner];
+                auto b = indices[triangle * 3 + (corner + 1) % 3];
+                if (!locked[a]) {
+                    collapses.push_back({.from = a, .to = b, .cost = quadrics[a].error(positions[b])});
+                }
+                if (!locked[b]) {
+                    collapses.push_back({.from = b, .to = a, .cost = quadrics[b].error(positions[a])});
+                }
+            }
+        }
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse &a, const Collapse &b) {
+            return a.cost < b.cost;
+        });
+
+        // collapses within a pass must not share a one-ring, their flip checks would see stale geometry
+        std::vector<bool> touched(positions.size(), false);
+        std::vector<uint32_t> remap(positions.size());
+        std::iota(remap.begin(), remap.end(), 0u);
+
+        size_t removed = 0;
+        bool collapsed = false;
+        for (const auto &collapse : collapses) {
+            if (removed >= trianglesToRemove) {
+                break;
+            }
+            if (touched[collapse.from] || touched[collapse.to]) {
+                continue;
+            }
+            if (flipsTriangle(collapse.from, collapse.to, offsets, vertexTriangles)) {
+                continue;
+            }
+
+            for (auto i = offsets[collapse.from]; i < offsets[collapse.from + 1]; i++) {
+                const auto *triangle = &indices[vertexTriangles[i] * 3];
+                for (uint32_t corner = 0; corner < 3; corner++) {
+                    touched[triangle[corner]] = true;
+                }
+                if (triangle[0] == collapse.to || triangle[1] == collapse.to || triangle[2] == collapse.to) {
+                    removed++;
+                }
+            }
+            touched[collapse.to] = true;
+
+            remap[collapse.from] = collapse.to;
+            quadrics[collapse.to] += quadrics[collapse.from];
+            maxCost = std::max(maxCost, collapse.cost);
+            collapsed = true;
+        }
+
+        // apply the pass and drop the triangles that became degenerate
+        size_t write = 0;
+        for (size_t i = 0; i < indices.size(); i += 3) {
+            auto a = remap[indices[i]];
+            auto b = remap[indices[i + 1]];
+            auto c = remap[indices[i + 2]];
+            if (a != b && b != c && c != a) {
+                indices[write++] = a;
+                indices[write++] = b;
+                indices[write++] = c;
+            }
+        }
+        indices.resize(write);
+
+        return collapsed;
+    }
+};
+
+}
+
+std::vector<SimplifiedLevel> buildLodChain(const std::vector<uint32_t> &indices, const std::vector<MeshVertex> &vertices,
+                                           uint32_t maxLevels) {
+    std::vector<SimplifiedLevel> levels;
+    levels.push_back({.indices = indices, .error = 0.0f});
+
+    Simplifier simplifier(indices, vertices);
+    while (levels.size() < maxLevels) {
+        auto previousCount = levels.back().indices.size();
+        simplifier.simplify(previousCount / 6 * 3);
+
+        const auto &simplified = simplifier.currentIndices();
+        if (simplified.empty() ||
+            static_cast<float>(simplified.size()) > static_cast<float>(previousCount) * (1.0f - MinLevelReduction)) {
+            break;
+        }
+        levels.push_back({.indices = simplified, .error = simplifier.currentError()});
+    }
+
+    return levels;
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include "meshFormat.hpp"
+
+#include <cstdint>
+#include <vector>
+
+struct SimplifiedLevel {
+    std::vector<uint32_t> indices;
+    float error; // object space distance to the source surface, see MeshLod::error
+};
+
+// Builds a chain of progressively coarser index buffers over the same vertices with quadric error edge collapses
+// (Garland and Heckbert). Every level targets half the triangles of the one before, the chain ends after maxLevels
+// levels or when the mesh cannot be reduced any further. Vertices are only ever collapsed onto other vertices, so
+// every level indexes a subset of the source vertices. Vertices on open borders and on attribute seams (several
+// vertices sharing one position) stay in place, which keeps the levels free of cracks.
+// The first level is the source index buffer with an error of 0.
+std::vector<SimplifiedLevel> buildLodChain(const std::vector<uint32_t> &indices, const std::vector<MeshVertex> &vertices,
+                                           uint32_t maxLevels);
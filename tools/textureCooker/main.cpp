@@ -0,0 +1,216 @@
+#include "textureFormat.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Converts binary PPM and PAM images into the .vtex layout the texture streamer reads level by level,
+// see src/textureFormat.hpp.
+
+namespace {
+
+// VkFormat values, the cooker doesn't depend on the Vulkan headers
+constexpr uint32_t FormatR8G8B8A8Unorm = 37;
+constexpr uint32_t FormatR8G8B8A8Srgb = 43;
+
+struct Image {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    std::vector<uint8_t> texels; // RGBA8
+};
+
+std::string readToken(std::istream &input) {
+    std::string token;
+    while (input >> token) {
+        if (token.front() != '#') {
+            return token;
+        }
+        std::getline(input, token);
+    }
+    throw std::runtime_error("unexpected end of header");
+}
+
+// Reads a binary PPM (P6) or PAM (P7, RGB or RGB_ALPHA) image with 8 bits per channel.
+Image readImage(const std::string &path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        throw std::runtime_error("could not open " + path);
+    }
+
+    Image image;
+    uint32_t channels = 3;
+    uint32_t maxValue = 0;
+    auto magic = readToken(file);
+    if (magic == "P6") {
+        image.width = std::stoul(readToken(file));
+        image.height = std::stoul(readToken(file));
+        maxValue = std::stoul(readToken(file));
+    } else if (magic == "P7") {
+        for (auto token = readToken(file); token != "ENDHDR"; token = readToken(file)) {
+            if (token == "WIDTH") {
+                image.width = std::stoul(readToken(file));
+            } else if (token == "HEIGHT") {
+                image.height = std::stoul(readToken(file));
+            } else if (token == "DEPTH") {
+                channels = std::stoul(readToken(file));
+            } else if (token == "MAXVAL") {
+                maxValue = std::stoul(readToken(file));
+            } else if (token == "TUPLTYPE") {
+                readToken(file);
+            }
+        }
+    } else {
+        throw std::runtime_error(path + " is not a binary PPM or PAM image");
+    }
+    // a single whitespace character separates the header from the texels
+    file.get();
+
+    if (image.width == 0 || image.height == 0 || maxValue != 255 || (channels != 3 && channels != 4)) {
+        throw std::runtime_error("unsupported image " + path + ", only 8 bit RGB and RGBA are read");
+    }
+
+    std::vector<uint8_t> data(static_cast<size_t>(image.width) * image.height * channels);
+    file.read(reinterpret_cast<char *>(data.data()), static_cast<std::streamsize>(data.size()));
+    if (!file) {
+        throw std::runtime_error("could not read " + path);
+    }
+
+    image.texels.resize(static_cast<size_t>(image.width) * image.height * 4);
+    for (size_t texel = 0; texel < static_cast<size_t>(image.width) * image.height; texel++) {
+        for (uint32_t channel = 0; channel < 4; channel++) {
+            image.texels[texel * 4 + channel] = channel < channels ? data[texel * channels + channel] : 255;
+        }
+    }
+    return image;
+}
+
+float srgbToLinear(float value) {
+    return value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+}
+
+float linearToSrgb(float value) {
+    return value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+}
+
+// Halves the image with a box filter, averaging the color in linear space when it is stored as sRGB. The last row or
+// column of an odd extent is clamped into the last 2x2 footprint.
+Image downsample(const Image &source, bool srgb) {
+    Image result;
+    result.width = std::max(1u, source.width / 2);
+    result.height = std::max(1u, source.height / 2);
+    result.texels.resize(static_cast<size_t>(result.width) * result.height * 4);
+
+    for (uint32_t y = 0; y < result.height; y++) {
+        for (uint32_t x = 0; x < result.width; x++) {
+            for (uint32_t channel = 0; channel < 4; channel++) {
+                bool encoded = srgb && channel < 3;
+                float sum = 0.0f;
+                for (uint32_t dy = 0; dy < 2; dy++) {
+                    for (uint32_t dx = 0; dx < 2; dx++) {
+                        auto sx = std::min(x * 2 + dx, source.width - 1);
+                        auto sy = std::min(y * 2 + dy, source.height - 1);
+                        auto value = source.texels[(static_cast<size_t>(sy) * source.width + sx) * 4 + channel] / 255.0f;
+                        sum += encoded ? srgbToLinear(value) : value;
+                    }
+                }
+                auto average = sum * 0.25f;
+                auto value = encoded ? linearToSrgb(average) : average;
+                result.texels[(static_cast<size_t>(y) * result.width + x) * 4 + channel] =
+                        static_cast<uint8_t>(std::clamp(value * 255.0f + 0.5f, 0.0f, 255.0f));
+            }
+        }
+    }
+    return result;
+}
+
+void writeTexture(const std::string &path, const std::vector<Image> &levels, uint32_t format) {
+    TextureFileHeader header{
+            .magic = TextureFileMagic,
+            .version = TextureFileVersion,
+            .format = format,
+            .width = levels.front().width,
+            .height = levels.front().height,
+            .mipCount = static_cast<uint32_t>(levels.size()),
+    };
+
+    std::vector<TextureMipInfo> mips;
+    uint64_t offset = sizeof(header) + levels.size() * sizeof(TextureMipInfo);
+    for (const auto &level : levels) {
+        mips.push_back(TextureMipInfo{.offset = offset, .size = level.texels.size()});
+        offset += level.texels.size();
+    }
+
+    std::ofstream file(path, std::ios::binary);
+    if (!file) {
+        throw std::runtime_error("could not create " + path);
+    }
+
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char *>(mips.data()), static_cast<std::streamsize>(mips.size() * sizeof(TextureMipInfo)));
+    for (const auto &level : levels) {
+        file.write(reinterpret_cast<const char *>(level.texels.data()), static_cast<std::streamsize>(level.texels.size()));
+    }
+
+    if (!file) {
+        throw std::runtime_error("could not write " + path);
+    }
+}
+
+}
+
+int main(int argc, char **argv) {
+    bool srgb = true;
+    bool topLevelOnly = false;
+    std::vector<std::string> paths;
+    for (int i = 1; i < argc; i++) {
+        std::string argument = argv[i];
+        if (argument == "--linear") {
+            srgb = false;
+        } else if (argument == "--top-level-only") {
+            topLevelOnly = true;
+        } else {
+            paths.push_back(argument);
+        }
+    }
+
+    if (paths.size() != 2) {
+        std::cerr << "usage: " << argv[0] << " [--linear] [--top-level-only] <input.ppm|input.pam> <output.vtex>\n";
+        return 1;
+    }
+    const auto &inputPath = paths[0];
+    const auto &outputPath = paths[1];
+
+    try {
+        auto start = std::chrono::steady_clock::now();
+
+        std::vector<Image> levels;
+        levels.push_back(readImage(inputPath));
+        // without the lower levels the renderer generates them on the GPU
+        auto levelCount = topLevelOnly ? 1 : std::bit_width(std::max(levels.front().width, levels.front().height));
+        while (levels.size() < static_cast<size_t>(levelCount)) {
+            levels.push_back(downsample(levels.back(), srgb));
+        }
+
+        writeTexture(outputPath, levels, srgb ? FormatR8G8B8A8Srgb : FormatR8G8B8A8Unorm);
+
+        uint64_t size = 0;
+        for (const auto &level : levels) {
+            size += level.texels.size();
+        }
+        auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << outputPath << ": " << levels.front().width << "x" << levels.front().height << ", " << levels.size()
+                  << " levels, " << size / 1024.0 << " KB " << (srgb ? "sRGB" : "linear") << ", cooked in " << seconds
+                  << " s\n";
+    } catch (std::exception &e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}